@@ -50,6 +50,10 @@ static const char *TAG = "can";
 #include "ovms_command.h"
 #include "metrics_standard.h"
 #include "vehicle_poller.h"
+#include "esp_timer.h"
+#include "canformat_crtd.h"
+#include "canformat_cbin.h"
+#include "ovms_vfs.h"
 
 #if defined(CONFIG_OVMS_COMP_ESP32CAN) || \
     defined(CONFIG_OVMS_COMP_MCP2515) || \
@@ -61,6 +65,12 @@ static const bool includeCAN = false;
 
 can MyCan __attribute__ ((init_priority (4510)));
 
+// Serializes frame ring writes from concurrent frame deliveries:
+static portMUX_TYPE can_ring_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+// Protects the 64 bit RX statistics totals against torn reads:
+static portMUX_TYPE can_rxstats_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
 ////////////////////////////////////////////////////////////////////////
 // CAN command processing
 ////////////////////////////////////////////////////////////////////////
@@ -388,6 +398,9 @@ void can_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, c
     writer->printf("Wdg Timer: %20" PRId32 " sec(s)\n",monotonictime-sbus->m_watchdog_timer);
     }
   writer->printf("Err Resets:%20d\n",sbus->m_status.error_resets);
+
+  MyCan.OutputRxStats(writer);
+  MyCan.OutputSubscribers(writer);
   }
 
 void can_explain_flags(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
@@ -442,6 +455,233 @@ void can_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, con
     }
   }
 
+static int can_test_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv, bool complete)
+  {
+  if (argc == 1)
+    return vfs_expand(writer, argv[0], complete, false, true) ? argc : -1;
+  if (argc <= 3)
+    return argc;
+  return -1;
+  }
+
+typedef std::vector<CAN_log_message_t, ExtRamAllocator<CAN_log_message_t>> can_test_msgs_t;
+
+static bool can_test_read_trace(OvmsWriter* writer, const char* path, can_test_msgs_t& msgs)
+  {
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    {
+    writer->printf("Error: Could not open %s\n",path);
+    return false;
+    }
+  canformat_crtd crtd("crtd");
+  uint8_t buf[256];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+    uint8_t* b = buf;
+    bool hasmore = false;
+    while (len > 0 || hasmore)
+      {
+      CAN_log_message_t msg;
+      memset(&msg,0,sizeof(msg));
+      hasmore = false;
+      size_t used = crtd.put(&msg, b, len, &hasmore);
+      b += used;
+      len -= used;
+      if (msg.type == CAN_LogFrame_RX || msg.type == CAN_LogFrame_TX)
+        msgs.push_back(msg);
+      if (used == 0 && !hasmore)
+        break;
+      }
+    }
+  fclose(f);
+  return true;
+  }
+
+/**
+ * test canfilter: time building & looking up the compiled canfilter, using
+ *  the received frames of a CRTD trace and a reproducible set of pseudo
+ *  random filter ranges.
+ */
+void can_test_filter(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  if (MyConfig.ProtectedPath(argv[0]))
+    {
+    writer->puts("Error: protected path");
+    return;
+    }
+  int nranges = (argc > 1) ? atoi(argv[1]) : 300;
+  if (nranges < 1) nranges = 1;
+  int loops = (argc > 2) ? atoi(argv[2]) : 10;
+  if (loops < 1) loops = 1;
+
+  // Read received frames from the CRTD trace:
+  can_test_msgs_t msgs;
+  if (!can_test_read_trace(writer, argv[0], msgs))
+    return;
+  std::vector<CAN_frame_t, ExtRamAllocator<CAN_frame_t>> frames;
+  for (const CAN_log_message_t& msg : msgs)
+    {
+    if (msg.type == CAN_LogFrame_RX)
+      frames.push_back(msg.frame);
+    }
+  msgs.clear();
+  if (frames.empty())
+    {
+    writer->puts("Error: No received frames found in trace");
+    return;
+    }
+
+  // Build the filter: half of the ranges close to the trace IDs, so
+  // there are hits, the rest spread over the standard & extended ID space
+  canfilter filter;
+  uint32_t seed = 0x2545F491;
+  auto rnd = [&seed]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+  int64_t started = esp_timer_get_time();
+  filter.BeginUpdate();
+  for (int i = 0; i < nranges; i++)
+    {
+    uint32_t r = rnd();
+    uint8_t bus = r % 3;
+    uint32_t id_from, id_to;
+    if (i & 1)
+      {
+      id_from = frames[rnd() % frames.size()].MsgID;
+      id_to = id_from + (r >> 8) % 4;
+      }
+    else if (r & 0x100)
+      {
+      id_from = rnd() % 0x800;
+      id_to = MIN(id_from + (r >> 9) % 16, 0x7FF);
+      }
+    else
+      {
+      id_from = 0x800 + rnd() % 0x1FFFF000;
+      id_to = id_from + (r >> 9) % 0x1000;
+      }
+    filter.AddFilter(bus, id_from, id_to);
+    }
+  filter.EndUpdate();
+  int64_t elapsed0 = esp_timer_get_time() - started;
+
+  // Lookup:
+  uint32_t hits = 0;
+  started = esp_timer_get_time();
+  for (int loop = 0; loop < loops; loop++)
+    {
+    for (const CAN_frame_t& frame : frames)
+      hits += filter.IsFiltered(&frame);
+    }
+  int64_t elapsed1 = esp_timer_get_time() - started;
+
+  uint32_t total = frames.size() * loops;
+  writer->printf("Trace:    %u frames, %u filtered/pass\n", (unsigned)frames.size(), hits / loops);
+  writer->printf("Filter:   %d ranges, built in %" PRId64 " us\n", nranges, elapsed0);
+  writer->printf("Lookup:   %" PRId64 " us, %.2f us/frame\n", elapsed1, (double)elapsed1 / total);
+  }
+
+/**
+ * test canformat: compare the crtd and cbin log formats on the frames
+ *  of a CRTD trace (encoding time & size), and verify the cbin round trip.
+ */
+void can_test_format(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  if (MyConfig.ProtectedPath(argv[0]))
+    {
+    writer->puts("Error: protected path");
+    return;
+    }
+  int loops = (argc > 1) ? atoi(argv[1]) : 3;
+  if (loops < 1) loops = 1;
+
+  can_test_msgs_t msgs;
+  if (!can_test_read_trace(writer, argv[0], msgs))
+    return;
+  if (msgs.empty())
+    {
+    writer->puts("Error: No frames found in trace");
+    return;
+    }
+
+  // Encode:
+  canformat_crtd crtd("crtd");
+  canformat_cbin cbin("cbin");
+  size_t size_crtd = 0, size_cbin = 0;
+  int64_t started = esp_timer_get_time();
+  for (int loop = 0; loop < loops; loop++)
+    {
+    size_crtd = crtd.getheader(NULL).size();
+    for (CAN_log_message_t& msg : msgs)
+      size_crtd += crtd.get(&msg).size();
+    }
+  int64_t elapsed_crtd = esp_timer_get_time() - started;
+
+  std::vector<uint8_t, ExtRamAllocator<uint8_t>> data;
+  started = esp_timer_get_time();
+  for (int loop = 0; loop < loops; loop++)
+    {
+    std::string result = cbin.getheader(NULL);
+    size_cbin = result.size();
+    for (CAN_log_message_t& msg : msgs)
+      {
+      result = cbin.get(&msg);
+      size_cbin += result.size();
+      if (loop == 0) data.insert(data.end(), result.begin(), result.end());
+      }
+    result = cbin.getfooter();
+    size_cbin += result.size();
+    if (loop == 0) data.insert(data.end(), result.begin(), result.end());
+    }
+  int64_t elapsed_cbin = esp_timer_get_time() - started;
+
+  // Decode & verify the cbin round trip:
+  canformat_cbin decoder("cbin");
+  decoder.SetServeMode(canformat::Simulate);
+  uint32_t decoded = 0, mismatches = 0;
+  uint8_t* b = data.data();
+  size_t len = data.size();
+  bool hasmore = false;
+  started = esp_timer_get_time();
+  while (len > 0 || hasmore)
+    {
+    CAN_log_message_t msg;
+    memset(&msg,0,sizeof(msg));
+    hasmore = false;
+    size_t used = decoder.put(&msg, b, MIN(len, 256), &hasmore);
+    b += used;
+    len -= used;
+    if (msg.type != CAN_LogNone)
+      {
+      const CAN_log_message_t* ref = (decoded < msgs.size()) ? &msgs[decoded] : NULL;
+      if (ref == NULL || msg.type != ref->type || timercmp(&msg.timestamp, &ref->timestamp, !=) ||
+          msg.frame.origin != ref->frame.origin || msg.frame.MsgID != ref->frame.MsgID ||
+          msg.frame.FIR.B.FF != ref->frame.FIR.B.FF || msg.frame.FIR.B.DLC != ref->frame.FIR.B.DLC ||
+          memcmp(msg.frame.data.u8, ref->frame.data.u8, msg.frame.FIR.B.DLC) != 0)
+        {
+        if (mismatches++ < 5)
+          writer->printf("Mismatch: message %u id %" PRIx32 "\n", decoded, msg.frame.MsgID);
+        }
+      decoded++;
+      }
+    if (used == 0 && !hasmore)
+      break;
+    }
+  int64_t elapsed_dec = esp_timer_get_time() - started;
+
+  uint32_t total = msgs.size() * loops;
+  writer->printf("Trace:    %u frames\n", (unsigned)msgs.size());
+  writer->printf("crtd:     %u bytes, %.1f bytes/frame, encode %.2f us/frame\n",
+    (unsigned)size_crtd, (double)size_crtd / msgs.size(), (double)elapsed_crtd / total);
+  writer->printf("cbin:     %u bytes, %.1f bytes/frame, encode %.2f us/frame, decode %.2f us/frame\n",
+    (unsigned)size_cbin, (double)size_cbin / msgs.size(), (double)elapsed_cbin / total,
+    (double)elapsed_dec / msgs.size());
+  if (size_cbin > 0)
+    writer->printf("Ratio:    %.1fx\n", (double)size_crtd / size_cbin);
+  writer->printf("Results:  %s (%u decoded, %u mismatches)\n",
+    (mismatches == 0 && decoded == msgs.size()) ? "identical" : "DIFFERENT", decoded, mismatches);
+  }
+
 void can_clearstatus(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   const char* bus = cmd->GetParent()->GetName();
@@ -509,11 +749,16 @@ void can_set_register(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
 
 canfilter::canfilter()
   {
+  m_compiled = NULL;
+  m_readers = 0;
+  m_updating = 0;
   }
 
 canfilter::~canfilter()
   {
   ClearFilters();
+  for (CAN_filter_compiled_t* compiled : m_retired)
+    FreeCompiled(compiled);
   }
 
 void canfilter::ClearFilters()
@@ -523,6 +768,25 @@ void canfilter::ClearFilters()
     delete filter;
     }
   m_filters.clear();
+  if (!m_updating)
+    Compile();
+  }
+
+/**
+ * BeginUpdate / EndUpdate: batch filter changes
+ *  Changes between BeginUpdate() and EndUpdate() are compiled once by the
+ *  final EndUpdate(), instead of once per change. Until then, IsFiltered()
+ *  continues to use the previous lookup.
+ */
+void canfilter::BeginUpdate()
+  {
+  m_updating++;
+  }
+
+void canfilter::EndUpdate()
+  {
+  if (m_updating > 0 && --m_updating == 0)
+    Compile();
   }
 
 /** Add a filter to the list (what is allowed).
@@ -548,6 +812,8 @@ bool canfilter::AddFilter(uint8_t bus, uint32_t id_from, uint32_t id_to)
   f->id_from = id_from;
   f->id_to = id_to;
   m_filters.push_back(f);
+  if (!m_updating)
+    Compile();
   return true;
   }
 /** Add a filter string.
@@ -622,44 +888,164 @@ bool canfilter::RemoveFilter(uint8_t bus, uint32_t id_from, uint32_t id_to)
       {
       delete filter;
       m_filters.erase(it);
+      if (!m_updating)
+        Compile();
       return true;
       }
     }
   return false;
   }
 
-bool canfilter::IsFiltered(const CAN_frame_t* p_frame)
+/**
+ * Compile: build the lookup structures from the filter list
+ *  For each bus key, the ranges of the bus and of the "any bus" filters
+ *  are sorted and merged into a list of disjoint ranges. If any standard
+ *  IDs are covered, a bitmap for all standard IDs per bus key is created
+ *  additionally, so standard frames are checked by a single bit test.
+ */
+void canfilter::Compile()
   {
-  if (m_filters.size() == 0) return true;
-  if (! p_frame) return false;
+  CAN_filter_compiled_t* compiled = NULL;
+  bool hasstd = false;
 
-  uint8_t buskey = 0;
-  if (p_frame->origin)
-    buskey = (p_frame->origin->m_busnumber + 1);
+  if (!m_filters.empty())
+    {
+    compiled = new CAN_filter_compiled_t;
+    compiled->stdbitmap = NULL;
+    compiled->busmask = 0;
+    }
 
   for (CAN_filter_t* filter : m_filters)
     {
-    if ((filter->bus)&&(filter->bus != buskey)) continue;
-    if ((p_frame->MsgID >= filter->id_from) && (p_frame->MsgID <= filter->id_to))
-      return true;
+    CAN_filter_range_t range = { filter->id_from, filter->id_to };
+    if (filter->bus == 0)
+      {
+      for (int buskey = 0; buskey < CAN_FILTER_BUSKEYS; buskey++)
+        compiled->ranges[buskey].push_back(range);
+      }
+    else
+      {
+      compiled->ranges[filter->bus].push_back(range);
+      compiled->busmask |= (1 << filter->bus);
+      }
+    if (filter->id_from <= 0x7FF)
+      hasstd = true;
     }
 
-  return false;
-  }
+  for (int buskey = 0; compiled && buskey < CAN_FILTER_BUSKEYS; buskey++)
+    {
+    CAN_filter_range_list_t& list = compiled->ranges[buskey];
+    std::sort(list.begin(), list.end(),
+      [](const CAN_filter_range_t& a, const CAN_filter_range_t& b)
+        { return a.id_from < b.id_from; });
+    size_t cnt = 0;
+    for (size_t i = 0; i < list.size(); i++)
+      {
+      if (cnt > 0 && (list[cnt-1].id_to == UINT32_MAX || list[i].id_from <= list[cnt-1].id_to + 1))
+        list[cnt-1].id_to = MAX(list[cnt-1].id_to, list[i].id_to);
+      else
+        list[cnt++] = list[i];
+      }
+    list.resize(cnt);
+    list.shrink_to_fit();
+    }
 
-bool canfilter::IsFiltered(canbus* bus)
-  {
-  if (m_filters.size() == 0) return true;
-  if (bus == NULL) return true;
+  if (hasstd)
+    {
+    uint32_t* stdbitmap = (uint32_t*) ExternalRamCalloc(CAN_FILTER_BUSKEYS*CAN_FILTER_STDWORDS, sizeof(uint32_t));
+    if (stdbitmap)
+      {
+      for (int buskey = 0; buskey < CAN_FILTER_BUSKEYS; buskey++)
+        {
+        uint32_t* bitmap = &stdbitmap[buskey*CAN_FILTER_STDWORDS];
+        for (CAN_filter_range_t& range : compiled->ranges[buskey])
+          {
+          if (range.id_from > 0x7FF) break;
+          uint32_t id_to = MIN(range.id_to, 0x7FF);
+          for (uint32_t id = range.id_from; id <= id_to; id++)
+            bitmap[id >> 5] |= (1U << (id & 31));
+          }
+        }
+      }
+    // else: fall back to the range search
+    compiled->stdbitmap = stdbitmap;
+    }
 
-  uint8_t buskey = bus->m_busnumber+1;
+  CAN_filter_compiled_t* previous = m_compiled;
+  m_compiled = compiled;
+  Retire(previous);
+  }
 
-  for (CAN_filter_t* filter : m_filters)
+/**
+ * Retire: queue a replaced lookup for release, free all queued lookups if
+ *  no IsFiltered() is in progress. A caller entering after the new lookup
+ *  has been published cannot see the retired ones.
+ */
+void canfilter::Retire(CAN_filter_compiled_t* compiled)
+  {
+  if (compiled)
+    m_retired.push_back(compiled);
+  if (!m_retired.empty() && m_readers == 0)
     {
-    if ((filter->bus)&&(filter->bus == buskey)) return true;
+    for (CAN_filter_compiled_t* retired : m_retired)
+      FreeCompiled(retired);
+    m_retired.clear();
     }
+  }
 
-  return false;
+void canfilter::FreeCompiled(CAN_filter_compiled_t* compiled)
+  {
+  if (compiled->stdbitmap)
+    free(compiled->stdbitmap);
+  delete compiled;
+  }
+
+static bool canfilter_match(const CAN_filter_compiled_t* compiled, const CAN_frame_t* p_frame)
+  {
+  uint8_t buskey = 0;
+  if (p_frame->origin)
+    buskey = (p_frame->origin->m_busnumber + 1);
+  uint32_t id = p_frame->MsgID;
+
+  if (id <= 0x7FF && compiled->stdbitmap)
+    return (compiled->stdbitmap[buskey*CAN_FILTER_STDWORDS + (id >> 5)] & (1U << (id & 31))) != 0;
+
+  // Binary search for the last range starting at or below id:
+  const CAN_filter_range_list_t& ranges = compiled->ranges[buskey];
+  auto it = std::upper_bound(ranges.begin(), ranges.end(), id,
+    [](uint32_t id, const CAN_filter_range_t& range) { return id < range.id_from; });
+  if (it == ranges.begin())
+    return false;
+  --it;
+  return (id <= it->id_to);
+  }
+
+bool canfilter::IsFiltered(const CAN_frame_t* p_frame)
+  {
+  m_readers++;
+  CAN_filter_compiled_t* compiled = m_compiled;
+  bool match;
+  if (!compiled)
+    match = true;
+  else if (!p_frame)
+    match = false;
+  else
+    match = canfilter_match(compiled, p_frame);
+  m_readers--;
+  return match;
+  }
+
+bool canfilter::IsFiltered(canbus* bus)
+  {
+  m_readers++;
+  CAN_filter_compiled_t* compiled = m_compiled;
+  bool match;
+  if (!compiled || bus == NULL)
+    match = true;
+  else
+    match = (compiled->busmask & (1 << (bus->m_busnumber+1))) != 0;
+  m_readers--;
+  return match;
   }
 
 std::string canfilter::Info()
@@ -683,6 +1069,212 @@ std::string canfilter::Info()
   return buf.str();
   }
 
+////////////////////////////////////////////////////////////////////////
+// CAN frame dispatch table
+////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t can_dispatch_hash(uint32_t key)
+  {
+  key ^= key >> 16;
+  key *= 0x45d9f3b;
+  key ^= key >> 16;
+  return key;
+  }
+
+candispatch::candispatch()
+  {
+  m_std = NULL;
+  m_ext = NULL;
+  m_extsize = 0;
+  m_extused = 0;
+  m_fallback = 0;
+  }
+
+candispatch::~candispatch()
+  {
+  if (m_std)
+    {
+    for (int i = 0; i < CAN_DISPATCH_BUSKEYS*CAN_DISPATCH_STDBLOCKS; i++)
+      {
+      if (m_std[i].ids) free(m_std[i].ids);
+      }
+    free(m_std);
+    }
+  if (m_ext) free(m_ext);
+  }
+
+/**
+ * Add: add the ID ranges of a subscriber filter to the table
+ */
+void candispatch::Add(int slot, const canfilter* filter)
+  {
+  CAN_dispatch_mask_t bit = ((CAN_dispatch_mask_t)1) << slot;
+  const CAN_filter_compiled_t* compiled = filter->m_compiled;
+  if (!compiled)
+    return;
+  for (uint8_t buskey = 0; buskey < CAN_DISPATCH_BUSKEYS; buskey++)
+    {
+    for (const CAN_filter_range_t& range : compiled->ranges[buskey])
+      AddRange(buskey, range.id_from, range.id_to, bit);
+    }
+  }
+
+void candispatch::AddRange(uint8_t buskey, uint32_t id_from, uint32_t id_to, CAN_dispatch_mask_t bit)
+  {
+  if (id_from <= 0x7FF)
+    {
+    AddStd(buskey, id_from, MIN(id_to, 0x7FF), bit);
+    if (id_to <= 0x7FF)
+      return;
+    id_from = 0x800;
+    }
+  if (id_from > 0x1FFFFFFF)
+    return;
+  id_to = MIN(id_to, 0x1FFFFFFF);
+
+  if (id_to - id_from < CAN_DISPATCH_EXPAND)
+    {
+    for (uint32_t id = id_from; id <= id_to; id++)
+      AddExt((((uint32_t)buskey) << 29) | id, bit);
+    }
+  else
+    {
+    for (extrange_t& r : m_extranges)
+      {
+      if (r.buskey == buskey && r.id_from == id_from && r.id_to == id_to)
+        {
+        r.mask |= bit;
+        return;
+        }
+      }
+    m_extranges.push_back({ buskey, id_from, id_to, bit });
+    }
+  }
+
+void candispatch::AddStd(uint8_t buskey, uint32_t id_from, uint32_t id_to, CAN_dispatch_mask_t bit)
+  {
+  if (!m_std)
+    {
+    m_std = (stdblock_t*) ExternalRamCalloc(CAN_DISPATCH_BUSKEYS*CAN_DISPATCH_STDBLOCKS, sizeof(stdblock_t));
+    if (!m_std)
+      {
+      m_fallback |= bit;
+      return;
+      }
+    }
+
+  stdblock_t* blocks = &m_std[buskey * CAN_DISPATCH_STDBLOCKS];
+  uint32_t id = id_from;
+  while (id <= id_to)
+    {
+    stdblock_t* block = &blocks[id >> 5];
+    if ((id & 31) == 0 && id + 31 <= id_to)
+      {
+      // Range covers the whole block:
+      block->all |= bit;
+      id += 32;
+      continue;
+      }
+    if (!block->ids)
+      {
+      block->ids = (CAN_dispatch_mask_t*) ExternalRamCalloc(32, sizeof(CAN_dispatch_mask_t));
+      if (!block->ids)
+        {
+        m_fallback |= bit;
+        return;
+        }
+      }
+    block->ids[id & 31] |= bit;
+    id++;
+    }
+  }
+
+void candispatch::AddExt(uint32_t key, CAN_dispatch_mask_t bit)
+  {
+  if ((m_extused + 1) * 2 > m_extsize)
+    {
+    ResizeExt(m_extsize ? m_extsize * 2 : 64);
+    if ((m_extused + 1) * 2 > m_extsize)
+      {
+      m_fallback |= bit;
+      return;
+      }
+    }
+  uint32_t mask = m_extsize - 1;
+  uint32_t pos = can_dispatch_hash(key) & mask;
+  while (m_ext[pos].key != 0 && m_ext[pos].key != key)
+    pos = (pos + 1) & mask;
+  if (m_ext[pos].key == 0)
+    {
+    m_ext[pos].key = key;
+    m_extused++;
+    }
+  m_ext[pos].mask |= bit;
+  }
+
+void candispatch::ResizeExt(uint32_t newsize)
+  {
+  extentry_t* ext = (extentry_t*) ExternalRamCalloc(newsize, sizeof(extentry_t));
+  if (!ext)
+    return;
+  uint32_t mask = newsize - 1;
+  for (uint32_t i = 0; i < m_extsize; i++)
+    {
+    if (m_ext[i].key == 0) continue;
+    uint32_t pos = can_dispatch_hash(m_ext[i].key) & mask;
+    while (ext[pos].key != 0)
+      pos = (pos + 1) & mask;
+    ext[pos] = m_ext[i];
+    }
+  if (m_ext) free(m_ext);
+  m_ext = ext;
+  m_extsize = newsize;
+  }
+
+/**
+ * Lookup: get the subscriber slots interested in a frame
+ */
+CAN_dispatch_mask_t candispatch::Lookup(const CAN_frame_t* frame) const
+  {
+  CAN_dispatch_mask_t mask = m_fallback;
+  uint8_t buskey = (frame->origin) ? frame->origin->m_busnumber + 1 : 0;
+  uint32_t id = frame->MsgID;
+
+  if (id <= 0x7FF)
+    {
+    if (m_std)
+      {
+      const stdblock_t* block = &m_std[buskey * CAN_DISPATCH_STDBLOCKS + (id >> 5)];
+      mask |= block->all;
+      if (block->ids)
+        mask |= block->ids[id & 31];
+      }
+    return mask;
+    }
+
+  if (m_ext && id <= 0x1FFFFFFF)
+    {
+    uint32_t key = (((uint32_t)buskey) << 29) | id;
+    uint32_t hmask = m_extsize - 1;
+    uint32_t pos = can_dispatch_hash(key) & hmask;
+    while (m_ext[pos].key != 0)
+      {
+      if (m_ext[pos].key == key)
+        {
+        mask |= m_ext[pos].mask;
+        break;
+        }
+      pos = (pos + 1) & hmask;
+      }
+    }
+  for (const extrange_t& r : m_extranges)
+    {
+    if (r.buskey == buskey && id >= r.id_from && id <= r.id_to)
+      mask |= r.mask;
+    }
+  return mask;
+  }
+
 ////////////////////////////////////////////////////////////////////////
 // CAN logging and tracing
 // These structures are involved in formatting, logging and tracing of
@@ -718,6 +1310,19 @@ void can::LogFrame(canbus* bus, CAN_log_type_t type, const CAN_frame_t* frame)
     }
   }
 
+void can::LogFrames(CAN_log_type_t type, const CAN_frame_t* frames, int count)
+  {
+  OvmsRecMutexLock lock(&m_loggermap_mutex);
+  if (m_loggermap.empty())
+    return;
+
+  for (canlog_map_t::iterator it=m_loggermap.begin(); it!=m_loggermap.end(); ++it)
+    {
+    for (int i = 0; i < count; i++)
+      it->second->LogFrame(frames[i].origin, type, &frames[i]);
+    }
+  }
+
 void can::LogStatus(canbus* bus, CAN_log_type_t type, const CAN_status_t* status)
   {
   OvmsRecMutexLock lock(&m_loggermap_mutex);
@@ -828,6 +1433,7 @@ uint32_t can::AddLogger(canlog* logger, int filterc, const char* const* filterv,
   if (filterc>0)
     {
     canfilter *filter = new canfilter();
+    filter->BeginUpdate();
     for (int k=0;k<filterc;k++)
       {
       if (!filter->AddFilter(filterv[k]))
@@ -836,6 +1442,7 @@ uint32_t can::AddLogger(canlog* logger, int filterc, const char* const* filterv,
           writer->printf("Filter '%s' is invalid\n", filterv[k] );
         }
       }
+    filter->EndUpdate();
     logger->SetFilter(filter);
     }
 
@@ -896,10 +1503,12 @@ uint32_t can::AddPlayer(canplay* player, int filterc, const char* const* filterv
   if (filterc>0)
     {
     canfilter *filter = new canfilter();
+    filter->BeginUpdate();
     for (int k=0;k<filterc;k++)
       {
       filter->AddFilter(filterv[k]);
       }
+    filter->EndUpdate();
     player->SetFilter(filter);
     }
 
@@ -965,57 +1574,154 @@ void can::CAN_rxtask(void *pvParameters)
   {
   can *me = (can*)pvParameters;
   CAN_queue_msg_t msg;
+  CAN_frame_t frames[CAN_RX_BATCH];
+  int nframes, nmsgs;
 
   while(1)
     {
     if (xQueueReceive(me->m_rxqueue,&msg, (portTickType)portMAX_DELAY)==pdTRUE)
       {
-      switch(msg.type)
+      int64_t start = esp_timer_get_time();
+      uint32_t depth = uxQueueMessagesWaiting(me->m_rxqueue) + 1;
+      if (depth > me->m_rx_queue_max)
+        me->m_rx_queue_max = depth;
+
+      // Drain up to CAN_RX_BATCH messages, process frames in batches,
+      // keep the order relative to other messages:
+      nframes = 0;
+      nmsgs = 0;
+      do
         {
-        case CAN_frame:
-          me->IncomingFrame(&msg.body.frame);
-          break;
-        case CAN_asyncinterrupthandler:
+        nmsgs++;
+        if (msg.type == CAN_frame)
           {
-          bool loop;
-          // Loop until all interrupts are handled
-          do {
-            uint32_t receivedFrames;
-            loop = msg.body.bus->AsynchronousInterruptHandler(&msg.body.frame, &receivedFrames);
-            } while (loop);
-          break;
+          frames[nframes++] = msg.body.frame;
           }
-        case CAN_txcallback:
-          msg.body.bus->TxCallback(&msg.body.frame, true);
-          break;
-        case CAN_txfailedcallback:
-          msg.body.bus->TxCallback(&msg.body.frame, false);
-          break;
-        case CAN_logerror:
-          msg.body.bus->LogStatus(CAN_LogStatus_Error);
-          break;
-        case CAN_logstatus:
-          msg.body.bus->LogStatus(CAN_LogStatus_Statistics);
-          break;
-        default:
-          break;
-        }
+        else
+          {
+          if (nframes > 0)
+            {
+            me->IncomingFrames(frames, nframes);
+            nframes = 0;
+            }
+          me->ProcessMessage(&msg);
+          }
+        } while (nmsgs < CAN_RX_BATCH && xQueueReceive(me->m_rxqueue, &msg, 0) == pdTRUE);
+      if (nframes > 0)
+        me->IncomingFrames(frames, nframes);
+
+      int64_t elapsed = esp_timer_get_time() - start;
+      portENTER_CRITICAL(&can_rxstats_spinlock);
+      me->m_rx_wakeups++;
+      me->m_rx_msgs += nmsgs;
+      me->m_rx_time += elapsed;
+      portEXIT_CRITICAL(&can_rxstats_spinlock);
       }
     }
   }
 
-const char *valid_baud[] = {
-  "33333", "50000", "83333", "100000", "125000", "250000", "500000", "1000000"
-};
-
-static int can_start_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv, bool complete)
+void can::ProcessMessage(CAN_queue_msg_t* msg)
   {
-  if (argc == 1)
+  switch(msg->type)
     {
-    const size_t baud_count = sizeof(valid_baud) / sizeof(valid_baud[0]);
-    const char *token = argv[0];
-
-    if (complete)
+    case CAN_frame:
+      IncomingFrame(&msg->body.frame);
+      break;
+    case CAN_asyncinterrupthandler:
+      {
+      bool loop;
+      // Loop until all interrupts are handled
+      do {
+        uint32_t receivedFrames;
+        loop = msg->body.bus->AsynchronousInterruptHandler(&msg->body.frame, &receivedFrames);
+        } while (loop);
+      break;
+      }
+    case CAN_txcallback:
+      msg->body.bus->TxCallback(&msg->body.frame, true);
+      break;
+    case CAN_txfailedcallback:
+      msg->body.bus->TxCallback(&msg->body.frame, false);
+      break;
+    case CAN_logerror:
+      msg->body.bus->LogStatus(CAN_LogStatus_Error);
+      break;
+    case CAN_logstatus:
+      msg->body.bus->LogStatus(CAN_LogStatus_Statistics);
+      break;
+    default:
+      break;
+    }
+  }
+
+/**
+ * UpdateMetrics: publish CAN RX task statistics (rates & loads since last call)
+ */
+void can::UpdateMetrics()
+  {
+  if (StandardMetrics.ms_m_can_rx_rate == NULL)
+    return;
+
+  int64_t now = esp_timer_get_time();
+  float elapsed = now - m_rx_last.time;
+  portENTER_CRITICAL(&can_rxstats_spinlock);
+  uint32_t wakeups = m_rx_wakeups, msgs = m_rx_msgs;
+  uint64_t frames = m_rx_frames, busy = m_rx_time;
+  uint64_t callbacks = m_rx_time_callbacks, log = m_rx_time_log, listeners = m_rx_time_listeners;
+  portEXIT_CRITICAL(&can_rxstats_spinlock);
+  uint32_t dwakeups = wakeups - m_rx_last.wakeups;
+  uint32_t dmsgs = msgs - m_rx_last.msgs;
+
+  StandardMetrics.ms_m_can_rx_rate->SetValue((int)((frames - m_rx_last.frames) * 1000000.0f / elapsed));
+  StandardMetrics.ms_m_can_rx_queue_max->SetValue((int)m_rx_queue_max);
+  StandardMetrics.ms_m_can_rx_batch->SetValue((dwakeups) ? (float)dmsgs / dwakeups : 0.0f);
+  StandardMetrics.ms_m_can_load->SetValue(TRUNCPREC((busy - m_rx_last.busy) * 100 / elapsed, 2));
+  StandardMetrics.ms_m_can_load_callbacks->SetValue(TRUNCPREC((callbacks - m_rx_last.callbacks) * 100 / elapsed, 2));
+  StandardMetrics.ms_m_can_load_log->SetValue(TRUNCPREC((log - m_rx_last.log) * 100 / elapsed, 2));
+  StandardMetrics.ms_m_can_load_listeners->SetValue(TRUNCPREC((listeners - m_rx_last.listeners) * 100 / elapsed, 2));
+
+  m_rx_last.time = now;
+  m_rx_last.wakeups = wakeups;
+  m_rx_last.msgs = msgs;
+  m_rx_last.frames = frames;
+  m_rx_last.busy = busy;
+  m_rx_last.callbacks = callbacks;
+  m_rx_last.log = log;
+  m_rx_last.listeners = listeners;
+  }
+
+void can::Ticker10(std::string event, void* data)
+  {
+  UpdateMetrics();
+  }
+
+void can::OutputRxStats(OvmsWriter* writer)
+  {
+  portENTER_CRITICAL(&can_rxstats_spinlock);
+  uint32_t wakeups = m_rx_wakeups, msgs = m_rx_msgs;
+  uint64_t frames = m_rx_frames, busy = m_rx_time;
+  uint64_t callbacks = m_rx_time_callbacks, log = m_rx_time_log, listeners = m_rx_time_listeners;
+  portEXIT_CRITICAL(&can_rxstats_spinlock);
+
+  writer->printf("\nRX task:   %20" PRIu64 " frames, %" PRIu32 " wakeups (%.1f msgs/wakeup)\n",
+    frames, wakeups, (wakeups) ? (float)msgs / wakeups : 0.0f);
+  writer->printf("RX queue:  %20" PRIu32 " max depth\n", m_rx_queue_max);
+  writer->printf("RX time:   %20" PRIu64 " us (callbacks %" PRIu64 ", log %" PRIu64 ", listeners %" PRIu64 ")\n",
+    busy, callbacks, log, listeners);
+  }
+
+const char *valid_baud[] = {
+  "33333", "50000", "83333", "100000", "125000", "250000", "500000", "1000000"
+};
+
+static int can_start_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv, bool complete)
+  {
+  if (argc == 1)
+    {
+    const size_t baud_count = sizeof(valid_baud) / sizeof(valid_baud[0]);
+    const char *token = argv[0];
+
+    if (complete)
       {
       bool match = false;
       unsigned int index = 0;
@@ -1065,6 +1771,24 @@ static int can_dbc_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, cons
 
 can::can()
   {
+  m_dispatch_slots = 0;
+  m_subscribers = NULL;
+  m_delivering.reserve(4);
+  m_ring = NULL;
+  m_ring_head = 0;
+  for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+    m_ringreaders[i] = NULL;
+  m_ringreaders_mask = 0;
+  m_rx_queue_max = 0;
+  m_rx_wakeups = 0;
+  m_rx_msgs = 0;
+  m_rx_frames = 0;
+  m_rx_time = 0;
+  m_rx_time_callbacks = 0;
+  m_rx_time_log = 0;
+  m_rx_time_listeners = 0;
+  memset(&m_rx_last, 0, sizeof(m_rx_last));
+
   if (!includeCAN) return;
 
   ESP_LOGI(TAG, "Initialising CAN (4510)");
@@ -1110,8 +1834,19 @@ can::can()
 
   cmd_can->RegisterCommand("list", "List CAN buses", can_list);
 
+  OvmsCommand* cmd_test = MyCommandApp.RegisterCommand("test","Test framework");
+  cmd_test->RegisterCommand("canfilter", "Test canfilter build & lookup performance", can_test_filter,
+    "<crtdfile> [<ranges>] [<loops>]", 1, 3, true, can_test_validate);
+  cmd_test->RegisterCommand("canformat", "Compare the crtd & cbin log formats", can_test_format,
+    "<crtdfile> [<loops>]", 1, 2, true, can_test_validate);
+
   m_rxqueue = xQueueCreate(CONFIG_OVMS_HW_CAN_RX_QUEUE_SIZE,sizeof(CAN_queue_msg_t));
-  xTaskCreatePinnedToCore(CAN_rxtask, "OVMS CanRx", 2*2048, (void*)this, 23, &m_rxtask, CORE(0));
+  xTaskCreatePinnedToCore(CAN_rxtask, "OVMS CanRx", 2*2048+512, (void*)this, 23, &m_rxtask, CORE(0));
+
+  #undef bind  // Kludgy, but works
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyEvents.RegisterEvent(TAG, "ticker.10", std::bind(&can::Ticker10, this, _1, _2));
   }
 
 can::~can()
@@ -1139,12 +1874,45 @@ canbus* can::GetBus(int busnumber)
 
 void can::IncomingFrame(CAN_frame_t* p_frame)
   {
-  p_frame->origin->m_status.packets_rx++;
-  p_frame->origin->m_watchdog_timer = monotonictime;
+  IncomingFrames(p_frame, 1);
+  }
 
-  ExecuteCallbacks(p_frame, false, true /*ignored*/);
-  p_frame->origin->LogFrame(CAN_LogFrame_RX, p_frame);
-  NotifyListeners(p_frame, false);
+/**
+ * IncomingFrames: process a batch of received frames
+ *  The frames are passed through each stage (callbacks, logging, listeners)
+ *  as a batch, so per stage setup costs (locks, lookups) are shared.
+ *  The whole batch is delivered to one subscriber snapshot, subscribers
+ *  (de)registered meanwhile take effect with the next batch.
+ */
+void can::IncomingFrames(CAN_frame_t* frames, int count)
+  {
+  int64_t t0 = esp_timer_get_time();
+  cansubscribers* subscribers = AcquireSubscribers();
+  for (int i = 0; i < count; i++)
+    {
+    CAN_frame_t* p_frame = &frames[i];
+    p_frame->origin->m_status.packets_rx++;
+    p_frame->origin->m_watchdog_timer = monotonictime;
+    if (subscribers)
+      ExecuteCallbacks(subscribers, p_frame, false, true /*ignored*/);
+    }
+  int64_t t1 = esp_timer_get_time();
+  LogFrames(CAN_LogFrame_RX, frames, count);
+  int64_t t2 = esp_timer_get_time();
+  if (subscribers)
+    {
+    for (int i = 0; i < count; i++)
+      NotifyListeners(subscribers, &frames[i], false);
+    }
+  ReleaseSubscribers(subscribers);
+  int64_t t3 = esp_timer_get_time();
+
+  portENTER_CRITICAL(&can_rxstats_spinlock);
+  m_rx_frames += count;
+  m_rx_time_callbacks += t1 - t0;
+  m_rx_time_log += t2 - t1;
+  m_rx_time_listeners += t3 - t2;
+  portEXIT_CRITICAL(&can_rxstats_spinlock);
   }
 
 /**
@@ -1160,31 +1928,287 @@ void can::IncomingFrame(CAN_frame_t* p_frame)
  * You're free to use whatever queue size is appropriate for your task, but be
  * aware the system will silently drop queue overflows. The vehicle poller
  * takes care of registering a queue and provides an additional filter API.
+ * Queue overflows are counted per listener and shown by "can status".
+ * 
+ * Received frames are processed in batches: listeners get a batch of frames
+ * after all callbacks and logging have been done for the whole batch.
+ * 
+ * High volume listeners should use a ring reader instead (see below), that
+ * avoids copying each frame into every queue and allows batch processing.
  * 
  * If you need to process incoming frames or TX results as fast as possible,
  * register a synchronous CAN callback -- see below.
  */
-void can::RegisterListener(QueueHandle_t queue, bool txfeedback /*=false*/)
+void can::RegisterListener(QueueHandle_t queue, bool txfeedback /*=false*/, const char* filter /*=NULL*/)
   {
-  m_listeners[queue] = txfeedback;
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  CanListenerEntry* entry = new CanListenerEntry(txfeedback, CreateFilter(filter));
+  entry->m_slot = AllocDispatchSlot(entry->m_filter);
+  auto it = m_listeners.find(queue);
+  if (it != m_listeners.end())
+    {
+    // Re-registration: update the filter, keep the statistics
+    entry->m_hits = it->second->m_hits;
+    entry->m_drops = it->second->m_drops;
+    FreeDispatchSlot(it->second->m_slot);
+    m_retired_listeners.push_back(it->second);
+    }
+  m_listeners[queue] = entry;
+  PublishSubscribers();
+  FreeRetired();
   }
 
+/**
+ * DeregisterListener: remove a listener queue
+ *  Returns after deliveries in progress have finished, so the queue may
+ *  be deleted afterwards. Exception: called from a callback or listener
+ *  notification (i.e. from within a delivery), the current batch may
+ *  still be sent to the queue.
+ */
 void can::DeregisterListener(QueueHandle_t queue)
   {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
   auto it = m_listeners.find(queue);
   if (it != m_listeners.end())
+    {
+    CanListenerEntry* entry = it->second;
     m_listeners.erase(it);
+    FreeDispatchSlot(entry->m_slot);
+    m_retired_listeners.push_back(entry);
+    PublishSubscribers();
+    SyncSubscribers();
+    }
   }
 
 void can::NotifyListeners(const CAN_frame_t* frame, bool tx)
   {
-  for (CanListenerMap_t::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
+  cansubscribers* subscribers = AcquireSubscribers();
+  if (subscribers)
+    NotifyListeners(subscribers, frame, tx);
+  ReleaseSubscribers(subscribers);
+  }
+
+void can::NotifyListeners(cansubscribers* subscribers, const CAN_frame_t* frame, bool tx)
+  {
+  CAN_dispatch_mask_t mask = subscribers->Lookup(frame);
+  for (auto& it : subscribers->m_listeners)
+    {
+    CanListenerEntry* entry = it.second;
+    if (tx && !entry->m_txfeedback)
+      continue;
+    if (entry->m_slot >= 0)
+      {
+      if (!(mask & (((CAN_dispatch_mask_t)1) << entry->m_slot)))
+        continue;
+      }
+    else if (entry->m_filter && !entry->m_filter->IsFiltered(frame))
+      {
+      continue;
+      }
+    if (xQueueSend(it.first,frame,0) == pdTRUE)
+      entry->m_hits++;
+    else
+      entry->m_drops++;
+    }
+
+  if (subscribers->m_ringreaders_mask)
+    NotifyRingReaders(subscribers, frame, tx, mask);
+  }
+
+/**
+ * RegisterRingReader: register an asynchronous CAN frame processor using the
+ *  shared frame ring instead of a listener queue
+ *
+ * Frames for ring readers are stored once, readers fetch their frames in
+ * batches using canringreader::Read(). Use this instead of RegisterListener()
+ * for high volume listeners. Returns NULL if no reader slot is available.
+ */
+canringreader* can::RegisterRingReader(const char* name, bool txfeedback /*=false*/, const char* filter /*=NULL*/)
+  {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  if (!m_ring)
+    {
+    m_ring = (CAN_ring_slot_t*) calloc(CAN_RING_SIZE, sizeof(CAN_ring_slot_t));
+    if (!m_ring)
+      {
+      ESP_LOGE(TAG, "RegisterRingReader: %s: out of memory for frame ring", name);
+      return NULL;
+      }
+    }
+  int index;
+  for (index = 0; index < CAN_RING_MAXREADERS; index++)
+    {
+    if (m_ringreaders[index] == NULL) break;
+    }
+  if (index == CAN_RING_MAXREADERS)
+    {
+    ESP_LOGE(TAG, "RegisterRingReader: %s: too many ring readers", name);
+    return NULL;
+    }
+
+  canringreader* reader = new canringreader(name, txfeedback, CreateFilter(filter));
+  reader->m_index = index;
+  reader->m_slot = AllocDispatchSlot(reader->m_filter);
+  reader->m_cursor = m_ring_head.load(std::memory_order_acquire);
+  m_ringreaders[index] = reader;
+  m_ringreaders_mask |= (1 << index);
+  PublishSubscribers();
+  FreeRetired();
+  return reader;
+  }
+
+/**
+ * DeregisterRingReader: remove and delete a ring reader
+ *  The reader is deleted once no delivery can use its filter or signal
+ *  anymore: deliveries in progress are waited for (see DeregisterListener()),
+ *  called from within a delivery the reader is freed by the last delivery
+ *  using a snapshot containing it.
+ */
+void can::DeregisterRingReader(canringreader* reader)
+  {
+  if (!reader) return;
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  if (m_ringreaders[reader->m_index] == reader)
+    {
+    m_ringreaders_mask &= ~(1 << reader->m_index);
+    m_ringreaders[reader->m_index] = NULL;
+    FreeDispatchSlot(reader->m_slot);
+    m_retired_ringreaders.push_back(reader);
+    PublishSubscribers();
+    SyncSubscribers();
+    }
+  else
     {
-    if (!tx || (tx && it->second))
-      xQueueSend(it->first,frame,0);
+    delete reader;
     }
   }
 
+/**
+ * NotifyRingReaders: store the frame in the ring if any reader wants it
+ *  Deliveries may run concurrently (e.g. CAN task & log player), the ring
+ *  spinlock keeps the slot write a single writer. The snapshot keeps the
+ *  readers alive. The slot sequence number is set first, so readers still
+ *  expecting the previous frame in that slot detect the overwrite.
+ */
+void can::NotifyRingReaders(cansubscribers* subscribers, const CAN_frame_t* frame, bool tx, CAN_dispatch_mask_t mask)
+  {
+  uint32_t readers = 0;
+  for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+    {
+    canringreader* reader = subscribers->m_ringreaders[i];
+    if (!reader)
+      continue;
+    if (tx && !reader->m_txfeedback)
+      continue;
+    if (reader->m_slot >= 0)
+      {
+      if (!(mask & (((CAN_dispatch_mask_t)1) << reader->m_slot)))
+        continue;
+      }
+    else if (reader->m_filter && !reader->m_filter->IsFiltered(frame))
+      {
+      continue;
+      }
+    readers |= (1 << i);
+    }
+  if (!readers)
+    return;
+
+  portENTER_CRITICAL(&can_ring_spinlock);
+  uint32_t seq = m_ring_head.load(std::memory_order_relaxed);
+  CAN_ring_slot_t* slot = &m_ring[seq & (CAN_RING_SIZE-1)];
+  slot->seq.store(seq, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->readers = readers;
+  slot->frame = *frame;
+  m_ring_head.store(seq+1, std::memory_order_release);
+  portEXIT_CRITICAL(&can_ring_spinlock);
+
+  for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+    {
+    canringreader* reader = subscribers->m_ringreaders[i];
+    if (reader && (readers & (1 << i)))
+      xSemaphoreGive(reader->m_signal);
+    }
+  }
+
+canringreader::canringreader(const char* name, bool txfeedback, canfilter* filter)
+  {
+  m_name = name;
+  m_txfeedback = txfeedback;
+  m_filter = filter;
+  m_slot = -1;
+  m_index = -1;
+  m_cursor = 0;
+  m_signal = xSemaphoreCreateBinary();
+  m_hits = 0;
+  m_drops = 0;
+  }
+
+canringreader::~canringreader()
+  {
+  if (m_filter) delete m_filter;
+  vSemaphoreDelete(m_signal);
+  }
+
+/**
+ * Read: fetch the next frames addressed to this reader from the ring
+ *  Blocks up to maxwait ticks if no frame is available.
+ *  Returns the number of frames copied to frames[] (0 = timeout).
+ */
+int canringreader::Read(CAN_frame_t* frames, int maxframes, TickType_t maxwait)
+  {
+  CAN_ring_slot_t* ring = MyCan.m_ring;
+  uint32_t bit = (1 << m_index);
+  int cnt = 0;
+
+  while (true)
+    {
+    uint32_t head = MyCan.m_ring_head.load(std::memory_order_acquire);
+    if (head - m_cursor > CAN_RING_SIZE)
+      {
+      // Reader fell behind, skip the overwritten slots:
+      m_drops += head - m_cursor - CAN_RING_SIZE;
+      m_cursor = head - CAN_RING_SIZE;
+      }
+    while (m_cursor != head && cnt < maxframes)
+      {
+      uint32_t seq = m_cursor++;
+      CAN_ring_slot_t* slot = &ring[seq & (CAN_RING_SIZE-1)];
+      if (slot->seq.load(std::memory_order_acquire) != seq)
+        {
+        m_drops++;
+        continue;
+        }
+      uint32_t readers = slot->readers;
+      if (!(readers & bit))
+        continue;
+      frames[cnt] = slot->frame;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->seq.load(std::memory_order_relaxed) != seq)
+        {
+        // Overwritten while copying:
+        m_drops++;
+        continue;
+        }
+      cnt++;
+      }
+    if (cnt > 0 || maxwait == 0)
+      break;
+    if (xSemaphoreTake(m_signal, maxwait) != pdTRUE)
+      break;
+    }
+
+  m_hits += cnt;
+  return cnt;
+  }
+
+uint32_t canringreader::GetBacklog()
+  {
+  uint32_t backlog = MyCan.m_ring_head.load(std::memory_order_relaxed) - m_cursor;
+  return (backlog > CAN_RING_SIZE) ? CAN_RING_SIZE : backlog;
+  }
+
 /**
  * RegisterCallback: register a synchronous CAN frame processor
  * 
@@ -1196,20 +2220,33 @@ void can::NotifyListeners(const CAN_frame_t* frame, bool tx)
  * e.g. to override control messages on the bus.
  * 
  * Callbacks are executed within the CAN task context, before the frames get
- * distributed to the listener queues (see above).
+ * distributed to the listener queues (see above). Received frames are
+ * processed in batches: all callbacks run for each frame of a batch, then
+ * the batch is logged, then passed to the listeners. So a listener may see
+ * a frame only after callbacks have already processed later frames.
  * 
  * Callbacks need to be highly optimized, and must not block. Avoid writing
  * to metrics (as they may have listeners), avoid any kind of network or
  * file operations or complex calculations (floating point math), avoid
  * ESP_LOG* logging (as that may block). You may raise events from a callback,
  * and you may write to queues/semaphores non-blocking.
+ * 
+ * Callbacks run without the subscriber lock, so a callback may register or
+ * deregister CAN subscribers; changes take effect with the next frame batch.
+ * Deregistration waits for deliveries in progress on other tasks, so a
+ * callback must not block waiting for a task deregistering a subscriber.
  */
-void can::RegisterCallback(const char* caller, CanFrameCallback callback, bool txfeedback /*=false*/)
+void can::RegisterCallback(const char* caller, CanFrameCallback callback, bool txfeedback /*=false*/, const char* filter /*=NULL*/)
   {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  CanFrameCallbackEntry* entry = new CanFrameCallbackEntry(caller, callback, CreateFilter(filter));
+  entry->m_slot = AllocDispatchSlot(entry->m_filter);
   if (txfeedback)
-    m_txcallbacks.push_back(new CanFrameCallbackEntry(caller, callback));
+    m_txcallbacks.push_back(entry);
   else
-    m_rxcallbacks.push_back(new CanFrameCallbackEntry(caller, callback));
+    m_rxcallbacks.push_back(entry);
+  PublishSubscribers();
+  FreeRetired();
   }
 
 /**
@@ -1223,23 +2260,128 @@ void can::RegisterCallback(const char* caller, CanFrameCallback callback, bool t
  * call OvmsVehicle::RegisterCanBus(), so if you need to add a critical callback
  * later on, use this API method to prioritize your callback.
  */
-void can::RegisterCallbackFront(const char* caller, CanFrameCallback callback, bool txfeedback /*=false*/)
+void can::RegisterCallbackFront(const char* caller, CanFrameCallback callback, bool txfeedback /*=false*/, const char* filter /*=NULL*/)
   {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  CanFrameCallbackEntry* entry = new CanFrameCallbackEntry(caller, callback, CreateFilter(filter));
+  entry->m_slot = AllocDispatchSlot(entry->m_filter);
   if (txfeedback)
-    m_txcallbacks.push_front(new CanFrameCallbackEntry(caller, callback));
+    m_txcallbacks.push_front(entry);
   else
-    m_rxcallbacks.push_front(new CanFrameCallbackEntry(caller, callback));
+    m_rxcallbacks.push_front(entry);
+  PublishSubscribers();
+  FreeRetired();
   }
 
+/**
+ * DeregisterCallback: remove all callbacks registered by caller
+ *  Returns after deliveries in progress have finished, so the callback
+ *  target may be destroyed afterwards. Exception: called from within a
+ *  delivery (e.g. by a callback), the callback may still be executed
+ *  for the remaining frames of the current batch.
+ */
 void can::DeregisterCallback(const char* caller)
   {
-  m_rxcallbacks.remove_if([caller](CanFrameCallbackEntry* entry){ return strcmp(entry->m_caller, caller)==0; });
-  m_txcallbacks.remove_if([caller](CanFrameCallbackEntry* entry){ return strcmp(entry->m_caller, caller)==0; });
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  bool removed = false;
+  auto match = [caller](CanFrameCallbackEntry* entry){ return strcmp(entry->m_caller, caller)==0; };
+  for (CanFrameCallbackList_t* list : { &m_rxcallbacks, &m_txcallbacks })
+    {
+    for (auto it = list->begin(); it != list->end(); )
+      {
+      if (match(*it))
+        {
+        FreeDispatchSlot((*it)->m_slot);
+        m_retired_callbacks.push_back(*it);
+        it = list->erase(it);
+        removed = true;
+        }
+      else
+        ++it;
+      }
+    }
+  if (!removed)
+    return;
+  PublishSubscribers();
+  SyncSubscribers();
+  }
+
+/**
+ * SetCallbackFilter: change the ID filter of the callbacks registered by caller
+ *  The callbacks keep their position and statistics.
+ *  - filter: see RegisterCallback(), NULL/empty = all frames
+ */
+void can::SetCallbackFilter(const char* caller, const char* filter)
+  {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  bool changed = false;
+  for (CanFrameCallbackList_t* list : { &m_rxcallbacks, &m_txcallbacks })
+    {
+    for (auto it = list->begin(); it != list->end(); ++it)
+      {
+      CanFrameCallbackEntry* entry = *it;
+      if (strcmp(entry->m_caller, caller) != 0)
+        continue;
+      CanFrameCallbackEntry* update = new CanFrameCallbackEntry(caller, entry->m_callback, CreateFilter(filter));
+      update->m_hits = entry->m_hits;
+      update->m_time = entry->m_time;
+      FreeDispatchSlot(entry->m_slot);
+      update->m_slot = AllocDispatchSlot(update->m_filter);
+      m_retired_callbacks.push_back(entry);
+      *it = update;
+      changed = true;
+      }
+    }
+  if (!changed)
+    return;
+  PublishSubscribers();
+  FreeRetired();
+  }
+
+static inline bool can_execute_callback(CanFrameCallbackEntry* entry, CAN_dispatch_mask_t mask,
+                                        const CAN_frame_t* frame, bool success)
+  {
+  if (entry->m_slot >= 0)
+    {
+    if (!(mask & (((CAN_dispatch_mask_t)1) << entry->m_slot)))
+      return false;
+    }
+  else if (entry->m_filter && !entry->m_filter->IsFiltered(frame))
+    {
+    return false;
+    }
+  int64_t started = esp_timer_get_time();
+  entry->m_callback(frame, success);
+  entry->m_time += esp_timer_get_time() - started;
+  entry->m_hits++;
+  return true;
   }
 
 int can::ExecuteCallbacks(const CAN_frame_t* frame, bool tx, bool success)
+  {
+  cansubscribers* subscribers = AcquireSubscribers();
+  int cnt;
+  if (subscribers)
+    {
+    cnt = ExecuteCallbacks(subscribers, frame, tx, success);
+    }
+  else
+    {
+    cnt = 0;
+    if (tx && frame->callback)
+      {
+      (*(frame->callback))(frame, success);
+      cnt++;
+      }
+    }
+  ReleaseSubscribers(subscribers);
+  return cnt;
+  }
+
+int can::ExecuteCallbacks(cansubscribers* subscribers, const CAN_frame_t* frame, bool tx, bool success)
   {
   int cnt = 0;
+  CAN_dispatch_mask_t mask = subscribers->Lookup(frame);
   if (tx)
     {
     if (frame->callback)
@@ -1248,24 +2390,251 @@ int can::ExecuteCallbacks(const CAN_frame_t* frame, bool tx, bool success)
       (*(frame->callback))(frame, success);
       cnt++;
       }
-    for (auto entry : m_txcallbacks)
+    for (auto entry : subscribers->m_txcallbacks)
       {
       // invoke generic tx callbacks
-      entry->m_callback(frame, success);
-      cnt++;
+      if (can_execute_callback(entry, mask, frame, success))
+        cnt++;
       }
     }
   else
     {
-    for (auto entry : m_rxcallbacks)
+    for (auto entry : subscribers->m_rxcallbacks)
       {
-      entry->m_callback(frame, success);
-      cnt++;
+      if (can_execute_callback(entry, mask, frame, success))
+        cnt++;
       }
     }
   return cnt;
   }
 
+/**
+ * CreateFilter: parse a subscriber ID filter
+ *  - filter: list of canfilter specs separated by spaces or commas,
+ *    e.g. "1:7e8-7ef 2:18daf100-18daf1ff"; NULL/empty = all frames
+ */
+canfilter* can::CreateFilter(const char* filter)
+  {
+  if (filter == NULL || *filter == 0)
+    return NULL;
+
+  canfilter* f = new canfilter();
+  f->BeginUpdate();
+  std::string specs(filter);
+  size_t pos = 0;
+  while (pos < specs.size())
+    {
+    size_t end = specs.find_first_of(" ,", pos);
+    if (end == std::string::npos) end = specs.size();
+    if (end > pos)
+      {
+      std::string spec = specs.substr(pos, end-pos);
+      if (!f->AddFilter(spec.c_str()))
+        ESP_LOGW(TAG, "Invalid CAN subscriber filter '%s'", spec.c_str());
+      }
+    pos = end + 1;
+    }
+  f->EndUpdate();
+
+  if (!f->HasFilters())
+    {
+    delete f;
+    return NULL;
+    }
+  return f;
+  }
+
+int can::AllocDispatchSlot(canfilter* filter)
+  {
+  if (filter == NULL)
+    return -1;
+  for (int slot = 0; slot < CAN_DISPATCH_SLOTS; slot++)
+    {
+    CAN_dispatch_mask_t bit = ((CAN_dispatch_mask_t)1) << slot;
+    if (!(m_dispatch_slots & bit))
+      {
+      m_dispatch_slots |= bit;
+      return slot;
+      }
+    }
+  // No slot left: the filter will be checked per frame
+  ESP_LOGW(TAG, "CAN dispatch table full, filter will not be indexed");
+  return -1;
+  }
+
+void can::FreeDispatchSlot(int slot)
+  {
+  if (slot >= 0)
+    m_dispatch_slots &= ~(((CAN_dispatch_mask_t)1) << slot);
+  }
+
+/**
+ * PublishSubscribers: build a new snapshot from the subscriber lists
+ *  Called with the subscriber lock held. The replaced snapshot is freed
+ *  immediately if no delivery uses it, else by the last delivery using it.
+ */
+void can::PublishSubscribers()
+  {
+  cansubscribers* subscribers = new cansubscribers();
+  subscribers->m_rxcallbacks.assign(m_rxcallbacks.begin(), m_rxcallbacks.end());
+  subscribers->m_txcallbacks.assign(m_txcallbacks.begin(), m_txcallbacks.end());
+  subscribers->m_listeners.assign(m_listeners.begin(), m_listeners.end());
+  for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+    subscribers->m_ringreaders[i] = m_ringreaders[i];
+  subscribers->m_ringreaders_mask = m_ringreaders_mask;
+
+  if (m_dispatch_slots)
+    {
+    candispatch* dispatch = new candispatch();
+    for (auto entry : m_rxcallbacks)
+      if (entry->m_slot >= 0) dispatch->Add(entry->m_slot, entry->m_filter);
+    for (auto entry : m_txcallbacks)
+      if (entry->m_slot >= 0) dispatch->Add(entry->m_slot, entry->m_filter);
+    for (auto it : m_listeners)
+      if (it.second->m_slot >= 0) dispatch->Add(it.second->m_slot, it.second->m_filter);
+    for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+      {
+      canringreader* reader = m_ringreaders[i];
+      if (reader && reader->m_slot >= 0) dispatch->Add(reader->m_slot, reader->m_filter);
+      }
+    subscribers->m_dispatch = dispatch;
+    }
+
+  cansubscribers* previous = m_subscribers;
+  m_subscribers = subscribers;
+  if (previous)
+    {
+    if (--previous->m_refs == 0)
+      delete previous;
+    else
+      m_subscribers_retired.push_back(previous);
+    }
+  }
+
+/**
+ * SyncSubscribers: wait until no delivery uses a replaced snapshot anymore,
+ *  then free the removed subscribers. Called once locked by the subscriber
+ *  lock, the lock is released while waiting. If the calling task is within
+ *  a delivery itself, waiting would deadlock: the removed subscribers are
+ *  then freed by the last delivery using a replaced snapshot.
+ */
+void can::SyncSubscribers()
+  {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  if (std::find(m_delivering.begin(), m_delivering.end(), self) == m_delivering.end())
+    {
+    while (!m_subscribers_retired.empty())
+      {
+      m_subscriber_mutex.Unlock();
+      vTaskDelay(1);
+      m_subscriber_mutex.Lock();
+      }
+    }
+  FreeRetired();
+  }
+
+/**
+ * FreeRetired: free the removed subscribers if no replaced snapshot
+ *  (that may still reference them) is in use. Subscriber lock held.
+ */
+void can::FreeRetired()
+  {
+  if (!m_subscribers_retired.empty())
+    return;
+  for (CanFrameCallbackEntry* entry : m_retired_callbacks)
+    delete entry;
+  m_retired_callbacks.clear();
+  for (CanListenerEntry* entry : m_retired_listeners)
+    delete entry;
+  m_retired_listeners.clear();
+  for (canringreader* reader : m_retired_ringreaders)
+    delete reader;
+  m_retired_ringreaders.clear();
+  }
+
+/**
+ * AcquireSubscribers: get a reference to the current snapshot for a delivery
+ *  Returns NULL if no subscriber has been registered yet.
+ */
+cansubscribers* can::AcquireSubscribers()
+  {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  cansubscribers* subscribers = m_subscribers;
+  if (subscribers)
+    {
+    subscribers->m_refs++;
+    m_delivering.push_back(xTaskGetCurrentTaskHandle());
+    }
+  return subscribers;
+  }
+
+void can::ReleaseSubscribers(cansubscribers* subscribers)
+  {
+  if (!subscribers)
+    return;
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+  auto it = std::find(m_delivering.begin(), m_delivering.end(), xTaskGetCurrentTaskHandle());
+  if (it != m_delivering.end())
+    m_delivering.erase(it);
+  if (--subscribers->m_refs == 0)
+    {
+    m_subscribers_retired.remove(subscribers);
+    delete subscribers;
+    FreeRetired();
+    }
+  }
+
+cansubscribers::cansubscribers()
+  {
+  m_refs = 1;
+  for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+    m_ringreaders[i] = NULL;
+  m_ringreaders_mask = 0;
+  m_dispatch = NULL;
+  }
+
+cansubscribers::~cansubscribers()
+  {
+  if (m_dispatch)
+    delete m_dispatch;
+  }
+
+void can::OutputSubscribers(OvmsWriter* writer)
+  {
+  OvmsRecMutexLock lock(&m_subscriber_mutex);
+
+  writer->printf("\nCallbacks (all buses):      Hits    Avg[us]  Filter\n");
+  for (int tx = 0; tx < 2; tx++)
+    {
+    for (auto entry : (tx) ? m_txcallbacks : m_rxcallbacks)
+      {
+      writer->printf("  %s %-16.16s %10" PRIu32 " %10.1f  %s\n",
+        (tx) ? "TX" : "RX", entry->m_caller, entry->m_hits,
+        (entry->m_hits) ? (double)entry->m_time / entry->m_hits : 0.0,
+        (entry->m_filter) ? entry->m_filter->Info().c_str() : "-");
+      }
+    }
+  writer->printf("Listeners (all buses):      Hits      Drops  Filter\n");
+  for (auto it : m_listeners)
+    {
+    writer->printf("  %s %-16p %10" PRIu32 " %10" PRIu32 "  %s\n",
+      (it.second->m_txfeedback) ? "TX" : "RX", it.first, it.second->m_hits, it.second->m_drops,
+      (it.second->m_filter) ? it.second->m_filter->Info().c_str() : "-");
+    }
+  if (m_ringreaders_mask)
+    {
+    writer->printf("Ring readers (%d frames):   Hits      Drops  Backlog  Filter\n", CAN_RING_SIZE);
+    for (int i = 0; i < CAN_RING_MAXREADERS; i++)
+      {
+      canringreader* reader = m_ringreaders[i];
+      if (!reader) continue;
+      writer->printf("  %s %-16.16s %10" PRIu32 " %10" PRIu32 " %8" PRIu32 "  %s\n",
+        (reader->m_txfeedback) ? "TX" : "RX", reader->m_name, reader->m_hits, reader->m_drops,
+        reader->GetBacklog(), (reader->m_filter) ? reader->m_filter->Info().c_str() : "-");
+      }
+    }
+  }
+
 ////////////////////////////////////////////////////////////////////////
 // canbus - the definition of a CAN bus
 ////////////////////////////////////////////////////////////////////////
@@ -1343,8 +2712,11 @@ void canbus::ClearStatus()
 void canbus::AttachDBC(dbcfile *dbcfile)
   {
   if (m_dbcfile) DetachDBC();
+  // Compile before publishing, so the RX path never decodes from
+  // partially built plans:
+  dbcfile->LockFile();
+  dbcfile->Compile();
   m_dbcfile = dbcfile;
-  m_dbcfile->LockFile();
   }
 
 bool canbus::AttachDBC(const char *name)
@@ -1354,8 +2726,9 @@ bool canbus::AttachDBC(const char *name)
   dbcfile *dbcfile = MyDBC.Find(name);
   if (dbcfile == NULL) return false;
 
+  dbcfile->LockFile();
+  dbcfile->Compile();
   m_dbcfile = dbcfile;
-  m_dbcfile->LockFile();
   return true;
   }
 
@@ -39,11 +39,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include <stdint.h>
+#include <atomic>
 #include <functional>
 #include <list>
+#include <vector>
 #include "pcp.h"
 #include <esp_err.h>
+#include "ovms.h"
 #include "ovms_events.h"
 
 ////////////////////////////////////////////////////////////////////////
@@ -212,6 +216,26 @@ typedef struct
 
 typedef std::list<CAN_filter_t*> CAN_filter_list_t;
 
+// Compiled filter ranges (per bus key, sorted & merged):
+typedef struct
+  {
+  uint32_t id_from;
+  uint32_t id_to;
+  } CAN_filter_range_t;
+
+typedef std::vector<CAN_filter_range_t, ExtRamAllocator<CAN_filter_range_t>> CAN_filter_range_list_t;
+
+#define CAN_FILTER_BUSKEYS      (CAN_MAXBUSES+1)  // 0 = frame without origin
+#define CAN_FILTER_STDWORDS     (0x800/32)        // Standard ID bitmap size per bus key
+
+// Compiled lookup structures, replaced as a whole on filter changes:
+typedef struct
+  {
+  CAN_filter_range_list_t ranges[CAN_FILTER_BUSKEYS];
+  uint32_t* stdbitmap;                          // [buskey][CAN_FILTER_STDWORDS], NULL = none
+  uint32_t busmask;                             // Bus keys with explicit bus filters
+  } CAN_filter_compiled_t;
+
 class canfilter
   {
   public:
@@ -223,6 +247,8 @@ class canfilter
     bool AddFilter(uint8_t bus=0, uint32_t id_from=0, uint32_t id_to=UINT32_MAX);
     bool AddFilter(const char* filterstring);
     bool RemoveFilter(uint8_t bus=0, uint32_t id_from=0, uint32_t id_to=UINT32_MAX);
+    void BeginUpdate();
+    void EndUpdate();
 
   public:
     bool IsFiltered(const CAN_frame_t* p_frame);
@@ -234,7 +260,81 @@ class canfilter
       }
 
   protected:
+    void Compile();
+    void Retire(CAN_filter_compiled_t* compiled);
+    static void FreeCompiled(CAN_filter_compiled_t* compiled);
+
+  protected:
+    // IsFiltered() may run on the CAN task while the filter list is changed,
+    //  so the compiled lookup is published by a single pointer, and replaced
+    //  lookups are only freed once no IsFiltered() is in progress.
     CAN_filter_list_t m_filters;
+    std::atomic<CAN_filter_compiled_t*> m_compiled; // NULL = no filters (match all)
+    std::atomic_int m_readers;                    // IsFiltered() calls in progress
+    std::vector<CAN_filter_compiled_t*> m_retired; // Replaced lookups pending release
+    int m_updating;                               // BeginUpdate() nesting, defers Compile()
+
+  friend class candispatch;
+  };
+
+////////////////////////////////////////////////////////////////////////
+// CAN frame dispatch table
+// Maps bus & ID of a frame to the set of subscribers (callbacks and
+// listeners) that registered with an ID filter, so delivering a frame
+// only costs work for the subscribers interested in it.
+// Standard IDs use a two level table (per 32 ID block: a mask for the
+// whole block plus optional per ID masks), extended IDs a hash set.
+// Extended ID ranges too large to expand are checked sequentially.
+////////////////////////////////////////////////////////////////////////
+
+#define CAN_DISPATCH_SLOTS      32                // Max number of subscribers with ID filter
+#define CAN_DISPATCH_BUSKEYS    (CAN_MAXBUSES+1)  // 0 = frame without origin
+#define CAN_DISPATCH_STDBLOCKS  (0x800/32)
+#define CAN_DISPATCH_EXPAND     256               // Max ext ID range size to expand into hash set
+
+typedef uint32_t CAN_dispatch_mask_t;
+
+class candispatch : public ExternalRamAllocated
+  {
+  public:
+    candispatch();
+    ~candispatch();
+
+  public:
+    void Add(int slot, const canfilter* filter);
+    CAN_dispatch_mask_t Lookup(const CAN_frame_t* frame) const;
+
+  private:
+    void AddRange(uint8_t buskey, uint32_t id_from, uint32_t id_to, CAN_dispatch_mask_t bit);
+    void AddStd(uint8_t buskey, uint32_t id_from, uint32_t id_to, CAN_dispatch_mask_t bit);
+    void AddExt(uint32_t key, CAN_dispatch_mask_t bit);
+    void ResizeExt(uint32_t newsize);
+
+  private:
+    typedef struct
+      {
+      CAN_dispatch_mask_t all;                    // Subscribers for all IDs of the block
+      CAN_dispatch_mask_t* ids;                   // Per ID subscribers, NULL = none
+      } stdblock_t;
+    typedef struct
+      {
+      uint32_t key;                               // buskey<<29 | ID, 0 = free
+      CAN_dispatch_mask_t mask;
+      } extentry_t;
+    typedef struct
+      {
+      uint8_t buskey;
+      uint32_t id_from;
+      uint32_t id_to;
+      CAN_dispatch_mask_t mask;
+      } extrange_t;
+
+    stdblock_t* m_std;                            // [buskey][block], NULL = none
+    extentry_t* m_ext;                            // Open addressing hash set
+    uint32_t m_extsize;
+    uint32_t m_extused;
+    std::vector<extrange_t, ExtRamAllocator<extrange_t>> m_extranges;
+    CAN_dispatch_mask_t m_fallback;               // Subscribers not indexed (out of memory)
   };
 
 ////////////////////////////////////////////////////////////////////////
@@ -351,24 +451,130 @@ class canbus : public pcp, public InternalRamAllocated
 // can - the CAN system controller
 ////////////////////////////////////////////////////////////////////////
 
-typedef std::map<QueueHandle_t, bool> CanListenerMap_t;
+class CanListenerEntry
+  {
+  public:
+    CanListenerEntry(bool txfeedback, canfilter* filter)
+      {
+      m_txfeedback = txfeedback;
+      m_filter = filter;
+      m_slot = -1;
+      m_hits = 0;
+      m_drops = 0;
+      }
+    ~CanListenerEntry()
+      {
+      if (m_filter) delete m_filter;
+      }
+  public:
+    bool m_txfeedback;
+    canfilter* m_filter;                  // ID filter, NULL = all frames
+    int m_slot;                           // Dispatch table slot, -1 = unfiltered
+    uint32_t m_hits;                      // Frames delivered
+    uint32_t m_drops;                     // Frames dropped due to queue full
+  };
+typedef std::map<QueueHandle_t, CanListenerEntry*> CanListenerMap_t;
 
+////////////////////////////////////////////////////////////////////////
+// CAN frame ring
+// Alternative to listener queues: frames for ring readers are stored
+// once in a shared ring by the CAN task, tagged with the set of readers
+// they are addressed to. Readers keep their own read cursor (sequence
+// number) and drain their frames in batches. A reader falling behind
+// by more than the ring size loses the overwritten slots (drops).
+////////////////////////////////////////////////////////////////////////
+
+#define CAN_RING_SIZE           256               // Frames, power of 2
+#define CAN_RING_MAXREADERS     8
+
+typedef struct
+  {
+  std::atomic<uint32_t> seq;                      // Sequence number of the frame stored
+  uint32_t readers;                               // Readers the frame is addressed to
+  CAN_frame_t frame;
+  } CAN_ring_slot_t;
+
+class canringreader : public InternalRamAllocated
+  {
+  public:
+    canringreader(const char* name, bool txfeedback, canfilter* filter);
+    ~canringreader();
+
+  public:
+    int Read(CAN_frame_t* frames, int maxframes, TickType_t maxwait);
+    uint32_t GetBacklog();
+
+  public:
+    const char* m_name;
+    bool m_txfeedback;
+    canfilter* m_filter;                  // ID filter, NULL = all frames
+    int m_slot;                           // Dispatch table slot, -1 = unfiltered
+    int m_index;                          // Reader index (bit in CAN_ring_slot_t.readers)
+    uint32_t m_cursor;                    // Next sequence number to read
+    SemaphoreHandle_t m_signal;           // Given by the CAN task on new frames
+    uint32_t m_hits;                      // Frames delivered
+    uint32_t m_drops;                     // Ring slots overwritten before being read
+  };
 
 class CanFrameCallbackEntry
   {
   public:
-    CanFrameCallbackEntry(const char* caller, CanFrameCallback callback)
+    CanFrameCallbackEntry(const char* caller, CanFrameCallback callback, canfilter* filter=NULL)
       {
       m_caller = caller;
       m_callback = callback;
+      m_filter = filter;
+      m_slot = -1;
+      m_hits = 0;
+      m_time = 0;
+      }
+    ~CanFrameCallbackEntry()
+      {
+      if (m_filter) delete m_filter;
       }
-    ~CanFrameCallbackEntry() {}
   public:
     const char *m_caller;
     CanFrameCallback m_callback;
+    canfilter* m_filter;                  // ID filter, NULL = all frames
+    int m_slot;                           // Dispatch table slot, -1 = unfiltered
+    uint32_t m_hits;                      // Callback invocations
+    uint64_t m_time;                      // Callback execution time [us]
   };
 typedef std::list<CanFrameCallbackEntry*> CanFrameCallbackList_t;
 
+////////////////////////////////////////////////////////////////////////
+// CAN subscriber snapshot
+// Frame delivery works on an immutable copy of the subscriber lists and
+// the dispatch table, taken (reference counted) under the subscriber lock
+// per batch. Callbacks and listener notifications run without the lock,
+// so they may (de)register subscribers. (De)registrations publish a new
+// snapshot, replaced snapshots are freed by the last delivery using them.
+////////////////////////////////////////////////////////////////////////
+
+class cansubscribers : public InternalRamAllocated
+  {
+  public:
+    cansubscribers();
+    ~cansubscribers();
+
+  public:
+    CAN_dispatch_mask_t Lookup(const CAN_frame_t* frame) const
+      {
+      return (m_dispatch) ? m_dispatch->Lookup(frame) : 0;
+      }
+
+  public:
+    int m_refs;                           // Deliveries using the snapshot (+1 while current)
+    std::vector<CanFrameCallbackEntry*> m_rxcallbacks;
+    std::vector<CanFrameCallbackEntry*> m_txcallbacks;
+    std::vector<std::pair<QueueHandle_t, CanListenerEntry*>> m_listeners;
+    canringreader* m_ringreaders[CAN_RING_MAXREADERS];
+    uint32_t m_ringreaders_mask;
+    candispatch* m_dispatch;              // NULL = no filters
+  };
+
+#define CAN_RX_BATCH            16                // Max messages processed per CAN task wakeup
+
 class can : public InternalRamAllocated
   {
   public:
@@ -377,23 +583,55 @@ class can : public InternalRamAllocated
 
   private:
     static void CAN_rxtask(void *pvParameters);
+    void ProcessMessage(CAN_queue_msg_t* msg);
 
   public:
     void IncomingFrame(CAN_frame_t* p_frame);
+    void IncomingFrames(CAN_frame_t* frames, int count);
+
+  public:
+    void UpdateMetrics();
+    void OutputRxStats(OvmsWriter* writer);
+    void Ticker10(std::string event, void* data);
 
   public:
     QueueHandle_t m_rxqueue;
 
   public:
-    void RegisterListener(QueueHandle_t queue, bool txfeedback=false);
+    void RegisterListener(QueueHandle_t queue, bool txfeedback=false, const char* filter=NULL);
     void DeregisterListener(QueueHandle_t queue);
     void NotifyListeners(const CAN_frame_t* frame, bool tx);
 
+  private:
+    void NotifyListeners(cansubscribers* subscribers, const CAN_frame_t* frame, bool tx);
+
   public:
-    void RegisterCallback(const char* caller, CanFrameCallback callback, bool txfeedback=false);
-    void RegisterCallbackFront(const char* caller, CanFrameCallback callback, bool txfeedback=false);
+    canringreader* RegisterRingReader(const char* name, bool txfeedback=false, const char* filter=NULL);
+    void DeregisterRingReader(canringreader* reader);
+
+  private:
+    void NotifyRingReaders(cansubscribers* subscribers, const CAN_frame_t* frame, bool tx, CAN_dispatch_mask_t mask);
+
+  public:
+    void RegisterCallback(const char* caller, CanFrameCallback callback, bool txfeedback=false, const char* filter=NULL);
+    void RegisterCallbackFront(const char* caller, CanFrameCallback callback, bool txfeedback=false, const char* filter=NULL);
     void DeregisterCallback(const char* caller);
+    void SetCallbackFilter(const char* caller, const char* filter);
     int ExecuteCallbacks(const CAN_frame_t* frame, bool tx, bool success);
+    void OutputSubscribers(OvmsWriter* writer);
+
+  private:
+    int ExecuteCallbacks(cansubscribers* subscribers, const CAN_frame_t* frame, bool tx, bool success);
+
+  private:
+    canfilter* CreateFilter(const char* filter);
+    int AllocDispatchSlot(canfilter* filter);
+    void FreeDispatchSlot(int slot);
+    void PublishSubscribers();
+    void SyncSubscribers();
+    void FreeRetired();
+    cansubscribers* AcquireSubscribers();
+    void ReleaseSubscribers(cansubscribers* subscribers);
 
   public:
     uint32_t AddLogger(canlog* logger, int filterc=0, const char* const* filterv=NULL, OvmsWriter* writer=NULL);
@@ -411,6 +649,7 @@ class can : public InternalRamAllocated
 
   public:
     void LogFrame(canbus* bus, CAN_log_type_t type, const CAN_frame_t* frame);
+    void LogFrames(CAN_log_type_t type, const CAN_frame_t* frames, int count);
     void LogStatus(canbus* bus, CAN_log_type_t type, const CAN_status_t* status);
     void LogInfo(canbus* bus, CAN_log_type_t type, const char* text);
 
@@ -432,9 +671,40 @@ class can : public InternalRamAllocated
   private:
     canbus* m_buslist[CAN_MAXBUSES];
     CanListenerMap_t m_listeners;
+    CAN_ring_slot_t* m_ring;                // Shared frame ring, allocated on first ring reader
+    std::atomic<uint32_t> m_ring_head;      // Next sequence number to write
+    canringreader* volatile m_ringreaders[CAN_RING_MAXREADERS];
+    volatile uint32_t m_ringreaders_mask;   // Registered ring readers
     CanFrameCallbackList_t m_rxcallbacks;
     CanFrameCallbackList_t m_txcallbacks;
+    CAN_dispatch_mask_t m_dispatch_slots;   // Allocated dispatch slots
+    cansubscribers* m_subscribers;          // Current snapshot, NULL = none yet
+    std::list<cansubscribers*> m_subscribers_retired; // Replaced snapshots still in use
+    std::vector<TaskHandle_t> m_delivering; // Tasks holding a snapshot
+    CanFrameCallbackList_t m_retired_callbacks; // Removed subscribers, freed when
+    std::list<CanListenerEntry*> m_retired_listeners; // … no replaced snapshot
+    std::list<canringreader*> m_retired_ringreaders;  // … is in use anymore
+    OvmsRecMutex m_subscriber_mutex;        // Protects subscriber lists & snapshots
     TaskHandle_t m_rxtask;            // Task to handle reception
+
+    // RX task statistics (totals, deltas are published as metrics),
+    //  written by the CAN task, 64 bit totals are read under a spinlock:
+    uint32_t m_rx_queue_max;          // RX queue depth high water mark
+    uint32_t m_rx_wakeups;            // CAN task wakeups
+    uint32_t m_rx_msgs;               // Messages processed
+    uint64_t m_rx_frames;             // Frames received
+    uint64_t m_rx_time;               // Total processing time [us]
+    uint64_t m_rx_time_callbacks;     // … thereof frame callbacks [us]
+    uint64_t m_rx_time_log;           // … thereof logging [us]
+    uint64_t m_rx_time_listeners;     // … thereof listener notification [us]
+    struct
+      {
+      int64_t time;
+      uint32_t wakeups, msgs;
+      uint64_t frames, busy, callbacks, log, listeners;
+      } m_rx_last;                    // Totals at last metrics update
+
+  friend class canringreader;
   };
 
 extern can MyCan;
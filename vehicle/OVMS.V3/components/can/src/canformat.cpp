@@ -100,6 +100,21 @@ std::string canformat::getheader(struct timeval *time)
   return std::string("");
   }
 
+std::string canformat::getfooter()
+  {
+  return std::string("");
+  }
+
+/**
+ * getflush: return buffered output that is due for writing
+ *  Called periodically by the logger task for formats that collect records
+ *  into blocks, so a block does not linger while no messages arrive.
+ */
+std::string canformat::getflush()
+  {
+  return std::string("");
+  }
+
 size_t canformat::put(CAN_log_message_t* message, uint8_t *buffer, size_t len, bool* hasmore, canlogconnection* clc)
   {
   return 0;
@@ -132,7 +147,7 @@ size_t canformat::Serve(uint8_t *buffer, size_t len, canlogconnection* clc)
       len = 0;
       }
 
-    if (msg.frame.origin != NULL)
+    if ((msg.frame.origin != NULL) && (msg.type <= CAN_LogFrame_TX_Fail))
       {
       switch (m_servemode)
         {
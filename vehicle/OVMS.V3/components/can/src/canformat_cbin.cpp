@@ -0,0 +1,626 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Module:        CAN dump compact binary format
+;    Date:          17th October 2026
+;
+;    (C) 2026       OVMS developers
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include "ovms_log.h"
+static const char *TAG = "canformat-cbin";
+
+#include "esp_timer.h"
+#include "canlog.h"
+#include "canformat_cbin.h"
+
+#define CBIN_KIND_OTHER       7
+#define CBIN_TAG_DELTA        0x08
+
+class OvmsCanFormatCBINInit
+  {
+  public: OvmsCanFormatCBINInit();
+} MyOvmsCanFormatCBINInit  __attribute__ ((init_priority (4505)));
+
+OvmsCanFormatCBINInit::OvmsCanFormatCBINInit()
+  {
+  ESP_LOGI(TAG, "Registering CAN Format: CBIN (4505)");
+
+  MyCanFormatFactory.RegisterCanFormat<canformat_cbin>("cbin");
+  }
+
+static inline uint8_t* cbin_put_varint(uint8_t* p, uint32_t value)
+  {
+  while (value >= 0x80)
+    {
+    *p++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+    }
+  *p++ = value;
+  return p;
+  }
+
+// Returns bytes used, 0 = incomplete, -1 = invalid
+static inline int cbin_get_varint(const uint8_t* p, size_t len, uint32_t* value)
+  {
+  uint32_t v = 0;
+  for (int i = 0; i < 5; i++)
+    {
+    if (i >= len) return 0;
+    v |= (uint32_t)(p[i] & 0x7f) << (7*i);
+    if ((p[i] & 0x80) == 0)
+      {
+      *value = v;
+      return i+1;
+      }
+    }
+  return -1;
+  }
+
+static inline uint8_t* cbin_put_le(uint8_t* p, uint64_t value, int bytes)
+  {
+  for (int i = 0; i < bytes; i++)
+    {
+    *p++ = value & 0xff;
+    value >>= 8;
+    }
+  return p;
+  }
+
+static inline uint64_t cbin_get_le(const uint8_t* p, int bytes)
+  {
+  uint64_t value = 0;
+  for (int i = bytes-1; i >= 0; i--)
+    value = (value << 8) | p[i];
+  return value;
+  }
+
+static inline uint64_t cbin_time(const struct timeval* tv)
+  {
+  return (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  }
+
+canformat_cbin::canformat_cbin(const char *type)
+  : canformat(type)
+  {
+  ResetDict();
+  m_block_count = 0;
+  m_block_time = 0;
+  m_block_opened = 0;
+  m_last_time = 0;
+  m_offset = CBIN_HEADER_SIZE;
+  m_dec_remaining = 0;
+  m_dec_time = 0;
+  m_dec_done = false;
+  }
+
+canformat_cbin::~canformat_cbin()
+  {
+  }
+
+void canformat_cbin::ResetDict()
+  {
+  m_dict_size = 0;
+  memset(m_dict_hash, 0, sizeof(m_dict_hash));
+  }
+
+int canformat_cbin::FindKey(uint64_t key)
+  {
+  uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 56);
+  for (int i = 0; i < sizeof(m_dict_hash); i++, slot = (slot+1) % sizeof(m_dict_hash))
+    {
+    uint8_t idx = m_dict_hash[slot];
+    if (idx == 0) return -1;
+    if (m_dict[idx-1].key == key) return idx-1;
+    }
+  return -1;
+  }
+
+int canformat_cbin::AddKey(uint64_t key)
+  {
+  if (m_dict_size >= CBIN_DICT_SIZE) return -1;
+  int idx = m_dict_size++;
+  m_dict[idx].key = key;
+  m_dict[idx].dlc = 0xff;
+  uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 56);
+  while (m_dict_hash[slot] != 0)
+    slot = (slot+1) % sizeof(m_dict_hash);
+  m_dict_hash[slot] = idx+1;
+  return idx;
+  }
+
+std::string canformat_cbin::FlushBlock()
+  {
+  if (m_block_count == 0) return std::string("");
+
+  uint8_t hdr[CBIN_BLOCKHDR_SIZE];
+  memcpy(hdr, "CBLK", 4);
+  cbin_put_le(hdr+4, m_block.size(), 2);
+  cbin_put_le(hdr+6, m_block_count, 2);
+  cbin_put_le(hdr+8, m_block_time, 8);
+
+  std::string result((char*)hdr, sizeof(hdr));
+  result.append(m_block);
+  m_offset += result.size();
+
+  m_block.clear();
+  m_block_count = 0;
+  ResetDict();
+  return result;
+  }
+
+std::string canformat_cbin::get(CAN_log_message_t* message)
+  {
+  uint8_t rec[CBIN_RECORD_MAXLEN];
+  uint8_t* p = rec;
+  uint64_t time = cbin_time(&message->timestamp);
+  uint8_t bus = (message->origin) ? message->origin->m_busnumber+1 : 0;
+  uint8_t kind;
+  size_t maxlen, textlen = 0;
+
+  switch (message->type)
+    {
+    case CAN_LogFrame_RX:         kind = 0; break;
+    case CAN_LogFrame_TX:         kind = 1; break;
+    case CAN_LogFrame_TX_Queue:   kind = 2; break;
+    case CAN_LogFrame_TX_Fail:    kind = 3; break;
+    case CAN_LogStatus_Error:
+    case CAN_LogStatus_Statistics:
+    case CAN_LogInfo_Comment:
+    case CAN_LogInfo_Config:
+    case CAN_LogInfo_Event:
+    case CAN_LogInfo_Metric:
+      kind = CBIN_KIND_OTHER;
+      break;
+    default:
+      return std::string("");
+    }
+
+  uint64_t key = 0;
+  int idx = -1;
+  if (kind != CBIN_KIND_OTHER)
+    {
+    key = ((uint64_t)bus << 32)
+      | ((uint32_t)message->frame.FIR.B.FF << 31)
+      | ((uint32_t)message->frame.FIR.B.RTR << 30)
+      | (message->frame.MsgID & 0x1fffffff);
+    maxlen = 1+5+2+5+1+8;
+    }
+  else if (message->type <= CAN_LogStatus_Statistics)
+    {
+    maxlen = 1+5+1+1+sizeof(CAN_status_t);
+    }
+  else
+    {
+    textlen = (message->text) ? strnlen(message->text, CBIN_TEXT_MAXLEN) : 0;
+    maxlen = 1+5+1+2+textlen;
+    }
+
+  OvmsMutexLock lock(&m_mutex);
+  std::string result;
+
+  if (kind != CBIN_KIND_OTHER)
+    idx = FindKey(key);
+
+  // Close the current block if this record does not fit or the block is due:
+  int64_t now = esp_timer_get_time();
+  if (m_block_count > 0 &&
+      (time < m_last_time ||
+       time - m_block_time > CBIN_BLOCK_MAXTIME ||
+       now - m_block_opened > CBIN_BLOCK_MAXTIME ||
+       m_block.size() + maxlen > CBIN_BLOCK_SIZE ||
+       m_block_count == 0xffff ||
+       (kind != CBIN_KIND_OTHER && idx < 0 && m_dict_size >= CBIN_DICT_SIZE)))
+    {
+    result = FlushBlock();
+    idx = -1;
+    }
+
+  if (m_block_count == 0)
+    {
+    m_block_time = m_last_time = time;
+    m_block_opened = now;
+    if (m_index.empty() || time >= m_index.back().time + CBIN_INDEX_INTERVAL)
+      m_index.push_back({ time, m_offset });
+    }
+
+  uint8_t* tag = p++;
+  p = cbin_put_varint(p, time - m_last_time);
+
+  if (kind != CBIN_KIND_OTHER)
+    {
+    uint8_t dlc = MIN(message->frame.FIR.B.DLC, 8);
+    *tag = kind | (dlc << 4);
+    if (idx < 0)
+      {
+      idx = AddKey(key);
+      p = cbin_put_varint(p, idx);
+      *p++ = bus;
+      p = cbin_put_le(p, key, 4);
+      }
+    else
+      {
+      p = cbin_put_varint(p, idx);
+      }
+
+    // Delta encode the payload against the last frame of this key if that saves space:
+    dict_entry_t& entry = m_dict[idx];
+    const uint8_t* data = message->frame.data.u8;
+    uint8_t mask = 0, changed = 0;
+    if (entry.dlc == dlc && dlc > 0)
+      {
+      for (int k = 0; k < dlc; k++)
+        {
+        if (data[k] != entry.data[k])
+          {
+          mask |= 1 << k;
+          changed++;
+          }
+        }
+      }
+    if (entry.dlc == dlc && 1+changed < dlc)
+      {
+      *tag |= CBIN_TAG_DELTA;
+      *p++ = mask;
+      for (int k = 0; k < dlc; k++)
+        {
+        if (mask & (1 << k)) *p++ = data[k];
+        }
+      }
+    else
+      {
+      memcpy(p, data, dlc);
+      p += dlc;
+      }
+    entry.dlc = dlc;
+    memcpy(entry.data, data, dlc);
+    }
+  else if (message->type <= CAN_LogStatus_Statistics)
+    {
+    *tag = kind | (message->type << 4);
+    *p++ = bus;
+    *p++ = sizeof(CAN_status_t);
+    memcpy(p, &message->status, sizeof(CAN_status_t));
+    p += sizeof(CAN_status_t);
+    }
+  else
+    {
+    *tag = kind | (message->type << 4);
+    *p++ = bus;
+    p = cbin_put_varint(p, textlen);
+    memcpy(p, message->text, textlen);
+    p += textlen;
+    }
+
+  m_block.append((char*)rec, p-rec);
+  m_block_count++;
+  m_last_time = time;
+
+  return result;
+  }
+
+std::string canformat_cbin::getheader(struct timeval *time)
+  {
+  OvmsMutexLock lock(&m_mutex);
+
+  // A new file: reset the encoder
+  m_block.clear();
+  m_block_count = 0;
+  m_index.clear();
+  ResetDict();
+
+  uint8_t hdr[CBIN_HEADER_SIZE];
+  memset(hdr, 0, sizeof(hdr));
+  memcpy(hdr, "OVMSCBIN", 8);
+  hdr[8] = 1; // version
+  m_offset = CBIN_HEADER_SIZE;
+
+  return std::string((char*)hdr, sizeof(hdr));
+  }
+
+/**
+ * getflush: close the current block if its first record is older than
+ *  CBIN_BLOCK_MAXTIME, so a block does not linger in RAM while the bus is
+ *  quiet. Polled by the logger task while its queue is idle.
+ */
+std::string canformat_cbin::getflush()
+  {
+  OvmsMutexLock lock(&m_mutex);
+  if (m_block_count > 0 && esp_timer_get_time() - m_block_opened > CBIN_BLOCK_MAXTIME)
+    return FlushBlock();
+  return std::string("");
+  }
+
+std::string canformat_cbin::getfooter()
+  {
+  OvmsMutexLock lock(&m_mutex);
+
+  std::string result = FlushBlock();
+  uint32_t indexoffset = m_offset;
+  uint8_t buf[CBIN_FOOTER_SIZE];
+
+  memcpy(buf, "CIDX", 4);
+  cbin_put_le(buf+4, m_index.size(), 4);
+  result.append((char*)buf, 8);
+  for (const index_entry_t& entry : m_index)
+    {
+    cbin_put_le(buf, entry.time, 8);
+    cbin_put_le(buf+8, entry.offset, 4);
+    result.append((char*)buf, CBIN_INDEXENTRY_SIZE);
+    }
+
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, "CEND", 4);
+  cbin_put_le(buf+4, indexoffset, 4);
+  cbin_put_le(buf+8, m_index.size(), 4);
+  result.append((char*)buf, CBIN_FOOTER_SIZE);
+
+  ESP_LOGD(TAG, "Footer: %u index entries at offset %u", (unsigned)m_index.size(), indexoffset);
+  m_offset += result.size();
+  m_index.clear();
+  return result;
+  }
+
+int canformat_cbin::DecodeRecord(CAN_log_message_t* message, const uint8_t* data, size_t len)
+  {
+  const uint8_t* p = data;
+  const uint8_t* end = data + len;
+  uint32_t dt;
+  int n;
+
+  if (len < 1) return 0;
+  uint8_t tag = *p++;
+  uint8_t kind = tag & 0x07;
+  if ((n = cbin_get_varint(p, end-p, &dt)) <= 0) return n;
+  p += n;
+  uint64_t time = m_dec_time + dt;
+  uint8_t bus;
+
+  if (kind <= 3)
+    {
+    uint32_t idx;
+    uint64_t key;
+    uint8_t dlc = tag >> 4;
+    uint8_t payload[8];
+    if (dlc > 8) return -1;
+    if ((n = cbin_get_varint(p, end-p, &idx)) <= 0) return n;
+    p += n;
+    if (idx > m_dict_size || idx >= CBIN_DICT_SIZE) return -1;
+    if (idx == m_dict_size)
+      {
+      if (end-p < 5) return 0;
+      key = ((uint64_t)p[0] << 32) | cbin_get_le(p+1, 4);
+      p += 5;
+      }
+    else
+      {
+      key = m_dict[idx].key;
+      }
+    if (tag & CBIN_TAG_DELTA)
+      {
+      if (idx == m_dict_size || m_dict[idx].dlc != dlc) return -1;
+      if (end-p < 1) return 0;
+      uint8_t mask = *p++;
+      if (mask >> dlc) return -1;
+      memcpy(payload, m_dict[idx].data, 8);
+      for (int k = 0; k < dlc; k++)
+        {
+        if (mask & (1 << k))
+          {
+          if (p >= end) return 0;
+          payload[k] = *p++;
+          }
+        }
+      }
+    else
+      {
+      if (end-p < dlc) return 0;
+      memcpy(payload, p, dlc);
+      p += dlc;
+      }
+
+    // Record complete, update the decoder state:
+    if (idx == m_dict_size) AddKey(key);
+    m_dict[idx].dlc = dlc;
+    memcpy(m_dict[idx].data, payload, dlc);
+
+    static const CAN_log_type_t types[] = { CAN_LogFrame_RX, CAN_LogFrame_TX, CAN_LogFrame_TX_Queue, CAN_LogFrame_TX_Fail };
+    bus = key >> 32;
+    message->type = types[kind];
+    message->frame.origin = (bus) ? MyCan.GetBus(bus-1) : NULL;
+    message->frame.FIR.U = 0;
+    message->frame.FIR.B.FF = (key & 0x80000000) ? CAN_frame_ext : CAN_frame_std;
+    message->frame.FIR.B.RTR = (key & 0x40000000) ? CAN_RTR : CAN_no_RTR;
+    message->frame.FIR.B.DLC = dlc;
+    message->frame.MsgID = key & 0x1fffffff;
+    memcpy(message->frame.data.u8, payload, dlc);
+    }
+  else if (kind == CBIN_KIND_OTHER)
+    {
+    CAN_log_type_t type = (CAN_log_type_t)(tag >> 4);
+    if (end-p < 1) return 0;
+    bus = *p++;
+    if (type == CAN_LogStatus_Error || type == CAN_LogStatus_Statistics)
+      {
+      if (end-p < 1) return 0;
+      uint8_t size = *p++;
+      if (end-p < size) return 0;
+      memset(&message->status, 0, sizeof(CAN_status_t));
+      memcpy(&message->status, p, MIN(size, sizeof(CAN_status_t)));
+      p += size;
+      message->origin = (bus) ? MyCan.GetBus(bus-1) : NULL;
+      // Status records need a bus to be formatted:
+      message->type = (message->origin) ? type : CAN_LogNone;
+      }
+    else if (type >= CAN_LogInfo_Comment && type <= CAN_LogInfo_Metric)
+      {
+      uint32_t textlen;
+      if ((n = cbin_get_varint(p, end-p, &textlen)) <= 0) return n;
+      p += n;
+      if (textlen > CBIN_TEXT_MAXLEN) return -1;
+      if (end-p < textlen) return 0;
+      m_dec_text.assign((const char*)p, textlen);
+      p += textlen;
+      message->type = type;
+      message->origin = (bus) ? MyCan.GetBus(bus-1) : NULL;
+      message->text = (char*)m_dec_text.c_str();
+      }
+    else
+      return -1;
+    }
+  else
+    return -1;
+
+  m_dec_time = time;
+  message->timestamp.tv_sec = time / 1000000;
+  message->timestamp.tv_usec = time % 1000000;
+  return p - data;
+  }
+
+size_t canformat_cbin::put(CAN_log_message_t* message, uint8_t *buffer, size_t len, bool* hasmore, canlogconnection* clc)
+  {
+  if (IsServeDiscarding()) return len;  // Quick return if discarding
+
+  size_t consumed = Stuff(buffer,len);  // Stuff m_buf with as much as possible
+  uint8_t* b = m_dec_scratch;
+
+  OvmsMutexLock lock(&m_mutex);
+  while (!m_dec_done)
+    {
+    size_t avail = m_buf.Peek(sizeof(m_dec_scratch), b);
+
+    if (m_dec_remaining == 0)
+      {
+      // Expect a file header, block header or index:
+      if (avail < 4) return consumed;
+      if (memcmp(b, "CBLK", 4) == 0 || memcmp(b, "OVMS", 4) == 0)
+        {
+        if (avail < CBIN_BLOCKHDR_SIZE) return consumed;
+        if (b[0] == 'C')
+          {
+          m_dec_remaining = cbin_get_le(b+6, 2);
+          m_dec_time = cbin_get_le(b+8, 8);
+          ResetDict();
+          m_buf.Pop(CBIN_BLOCKHDR_SIZE, b);
+          continue;
+          }
+        else if (memcmp(b, "OVMSCBIN", 8) == 0)
+          {
+          m_buf.Pop(CBIN_HEADER_SIZE, b);
+          continue;
+          }
+        }
+      else if (memcmp(b, "CIDX", 4) == 0 || memcmp(b, "CEND", 4) == 0)
+        {
+        // End of the record stream:
+        m_dec_done = true;
+        break;
+        }
+      m_buf.Pop(); // Resync
+      continue;
+      }
+
+    int used = DecodeRecord(message, b, avail);
+    if (used == 0 && avail < sizeof(m_dec_scratch))
+      return consumed; // Incomplete, wait for more data
+    if (used <= 0)
+      {
+      ESP_LOGD(TAG, "Invalid record, resyncing");
+      m_dec_remaining = 0;
+      m_buf.Pop();
+      continue;
+      }
+    m_buf.Pop(used, b);
+    m_dec_remaining--;
+    if (message->type != CAN_LogNone)
+      {
+      *hasmore = true;  // Call us again to see if we have more records to process
+      return consumed;
+      }
+    }
+
+  m_buf.EmptyAll();
+  return consumed;
+  }
+
+/**
+ * Seek: position a cbin file at the last block starting at or before the given
+ *  time, using the block index if the file has one. Returns false if the file
+ *  is not in cbin format.
+ */
+bool canformat_cbin::Seek(FILE* file, const struct timeval* time)
+  {
+  uint64_t target = cbin_time(time);
+  uint8_t buf[CBIN_BLOCKHDR_SIZE];
+
+  if (fseek(file, 0, SEEK_SET) != 0 ||
+      fread(buf, 1, CBIN_HEADER_SIZE, file) != CBIN_HEADER_SIZE ||
+      memcmp(buf, "OVMSCBIN", 8) != 0)
+    return false;
+
+  long pos = CBIN_HEADER_SIZE;
+  if (fseek(file, -CBIN_FOOTER_SIZE, SEEK_END) == 0 &&
+      fread(buf, 1, CBIN_FOOTER_SIZE, file) == CBIN_FOOTER_SIZE &&
+      memcmp(buf, "CEND", 4) == 0)
+    {
+    long end = ftell(file);
+    uint32_t indexoffset = cbin_get_le(buf+4, 4);
+    uint32_t count = cbin_get_le(buf+8, 4);
+    if ((uint64_t)indexoffset + 8 + (uint64_t)count*CBIN_INDEXENTRY_SIZE + CBIN_FOOTER_SIZE == end)
+      {
+      // Binary search for the first entry after the target time:
+      auto read_entry = [&](uint32_t i, uint64_t* etime, uint32_t* eoffset)
+        {
+        if (fseek(file, indexoffset + 8 + i*CBIN_INDEXENTRY_SIZE, SEEK_SET) != 0 ||
+            fread(buf, 1, CBIN_INDEXENTRY_SIZE, file) != CBIN_INDEXENTRY_SIZE)
+          return false;
+        *etime = cbin_get_le(buf, 8);
+        *eoffset = cbin_get_le(buf+8, 4);
+        return true;
+        };
+      uint32_t lo = 0, hi = count, eoffset;
+      uint64_t etime;
+      while (lo < hi)
+        {
+        uint32_t mid = lo + (hi-lo)/2;
+        if (!read_entry(mid, &etime, &eoffset)) break;
+        if (etime <= target)
+          lo = mid+1;
+        else
+          hi = mid;
+        }
+      if (lo > 0 && read_entry(lo-1, &etime, &eoffset))
+        pos = eoffset;
+      }
+    }
+
+  // Walk the block headers up to the target time:
+  long best = pos;
+  while (fseek(file, pos, SEEK_SET) == 0 &&
+         fread(buf, 1, CBIN_BLOCKHDR_SIZE, file) == CBIN_BLOCKHDR_SIZE &&
+         memcmp(buf, "CBLK", 4) == 0)
+    {
+    if (cbin_get_le(buf+8, 8) > target) break;
+    best = pos;
+    pos += CBIN_BLOCKHDR_SIZE + cbin_get_le(buf+4, 2);
+    }
+
+  return (fseek(file, best, SEEK_SET) == 0);
+  }
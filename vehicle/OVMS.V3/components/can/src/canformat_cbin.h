@@ -0,0 +1,124 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Module:        CAN dump compact binary format
+;    Date:          17th October 2026
+;
+;    (C) 2026       OVMS developers
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#ifndef __CANFORMAT_CBIN_H__
+#define __CANFORMAT_CBIN_H__
+
+#include <stdio.h>
+#include <vector>
+#include "canformat.h"
+#include "ovms.h"
+#include "ovms_mutex.h"
+
+// Compact binary CAN log format "cbin"
+//
+// File:    header, blocks, [index, footer]
+// Header:  "OVMSCBIN" u8 version, u8 flags, u16 reserved, u32 reserved
+// Block:   "CBLK" u16 size, u16 count, u64 base time [us], <size> bytes of records
+// Record:  u8 tag, varint time delta [us] (to previous record / block base),
+//          frames:   varint key index (== dict size: new key follows: u8 bus, u32 id | ext<<31),
+//                    payload: DLC bytes, or if delta coded: u8 change mask + changed bytes
+//          others:   u8 bus, status: u8 size + CAN_status_t, info: varint length + text
+//          tag bits 0-2: 0=RX 1=TX 2=TX queue 3=TX fail 7=other, bit 3: delta coded,
+//          bits 4-7: DLC (frames) or CAN_log_type_t (others)
+// Index:   "CIDX" u32 count, count * (u64 time, u32 offset)
+// Footer:  "CEND" u32 index offset, u32 count, u32 reserved
+//
+// Key dictionary & payload deltas are reset per block, so every block can be
+// decoded on its own. Blocks are closed at CBIN_BLOCK_SIZE or after
+// CBIN_BLOCK_MAXTIME, by record time span as well as by the age of the block
+// (checked on each record and on the logger's idle flush poll). The index (written on close) has one entry per
+// CBIN_INDEX_INTERVAL, without it (power loss) Seek() scans the block headers.
+
+#define CBIN_HEADER_SIZE      16
+#define CBIN_BLOCKHDR_SIZE    16
+#define CBIN_FOOTER_SIZE      16
+#define CBIN_INDEXENTRY_SIZE  12
+#define CBIN_BLOCK_SIZE       4096                  // Max block payload size
+#define CBIN_BLOCK_MAXTIME    1000000               // Max block time span [us]
+#define CBIN_INDEX_INTERVAL   1000000               // Min time between index entries [us]
+#define CBIN_DICT_SIZE        128                   // Max keys per block
+#define CBIN_TEXT_MAXLEN      512                   // Max info text length
+#define CBIN_RECORD_MAXLEN    (1+5+1+2+CBIN_TEXT_MAXLEN)
+
+class canformat_cbin : public canformat
+  {
+  public:
+    canformat_cbin(const char* type);
+    virtual ~canformat_cbin();
+
+  public:
+    virtual std::string get(CAN_log_message_t* message);
+    virtual std::string getheader(struct timeval *time);
+    virtual std::string getfooter();
+    virtual std::string getflush();
+    virtual size_t put(CAN_log_message_t* message, uint8_t *buffer, size_t len, bool* hasmore, canlogconnection* clc=NULL);
+
+  public:
+    static bool Seek(FILE* file, const struct timeval* time);
+
+  protected:
+    typedef struct
+      {
+      uint64_t key;                                 // bus<<32 | ext<<31 | rtr<<30 | id
+      uint8_t dlc;                                  // 0xff = no payload yet
+      uint8_t data[8];
+      } dict_entry_t;
+    typedef struct
+      {
+      uint64_t time;
+      uint32_t offset;
+      } index_entry_t;
+
+    void ResetDict();
+    int FindKey(uint64_t key);
+    int AddKey(uint64_t key);
+    std::string FlushBlock();
+    int DecodeRecord(CAN_log_message_t* message, const uint8_t* data, size_t len);
+
+  protected:
+    OvmsMutex m_mutex;
+    // Key dictionary (encoder & decoder):
+    dict_entry_t m_dict[CBIN_DICT_SIZE];
+    int m_dict_size;
+    uint8_t m_dict_hash[CBIN_DICT_SIZE*2];          // Key hash slots: dict index + 1
+    // Encoder:
+    std::string m_block;                            // Current block records
+    uint16_t m_block_count;
+    uint64_t m_block_time;                          // Block base time [us]
+    int64_t m_block_opened;                         // esp_timer time of first block record [us]
+    uint64_t m_last_time;                           // Time of last record [us]
+    uint32_t m_offset;                              // File offset of current block
+    std::vector<index_entry_t, ExtRamAllocator<index_entry_t>> m_index;
+    // Decoder:
+    uint16_t m_dec_remaining;                       // Records left in current block
+    uint64_t m_dec_time;                            // Time of last record [us]
+    bool m_dec_done;                                // Index/footer reached
+    std::string m_dec_text;                         // Info text storage
+    uint8_t m_dec_scratch[CBIN_RECORD_MAXLEN];
+  };
+
+#endif // __CANFORMAT_CBIN_H__
@@ -178,6 +178,19 @@ size_t canformat_crtd::put(CAN_log_message_t* message, uint8_t *buffer, size_t l
     // We look for something like
     // 1524311386.811100 1R11 100 01 02 03
     if (!isdigit(b[0])) return consumed;    // Discard invalid line
+    char *t;
+    message->timestamp.tv_sec = strtol(b,&t,10);
+    if (*t == '.')
+      {
+      long usec = 0;
+      int digits = 0;
+      for (t++; isdigit(*t); t++)
+        {
+        if (digits++ < 6) usec = usec*10 + (*t - '0');
+        }
+      for (; digits < 6; digits++) usec *= 10;
+      message->timestamp.tv_usec = usec;
+      }
     for (;((*b != 0)&&(*b != ' '));b++) {}
     if (*b == 0) return consumed;           // Discard invalid line
     b++;
@@ -420,7 +420,11 @@ void canlog::RxTask(void *context)
   CAN_log_message_t msg;
   while (1)
     {
-    if (xQueueReceive(me->m_queue, &msg, (portTickType)portMAX_DELAY) == pdTRUE)
+    if (xQueueReceive(me->m_queue, &msg, pdMS_TO_TICKS(CANLOG_FLUSH_INTERVAL)) != pdTRUE)
+      {
+      me->OutputFlush();
+      }
+    else
       {
       switch (msg.type)
         {
@@ -529,6 +533,31 @@ void canlog::OutputMsg(CAN_log_message_t& msg)
     }
 
   std::string result = m_formatter->get(&msg);
+  OutputResult(msg, result);
+  }
+
+/**
+ * OutputFlush: pass buffered formatter output on to the connections
+ *  when the queue is idle (see canformat::getflush())
+ */
+void canlog::OutputFlush()
+  {
+  if (m_formatter == NULL || !m_isopen)
+    return;
+
+  std::string result = m_formatter->getflush();
+  if (result.length()>0)
+    {
+    CAN_log_message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CAN_LogInfo_Comment;
+    gettimeofday(&msg.timestamp, NULL);
+    OutputResult(msg, result);
+    }
+  }
+
+void canlog::OutputResult(CAN_log_message_t& msg, std::string& result)
+  {
   if (result.length()>0)
     {
     OvmsRecMutexLock lock(&m_cmmutex);
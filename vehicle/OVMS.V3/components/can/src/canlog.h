@@ -97,6 +97,8 @@ class canlogconnection: public InternalRamAllocated
     uint32_t       m_filtercount;
   };
 
+#define CANLOG_FLUSH_INTERVAL  500           // Formatter flush poll interval while idle [ms]
+
 class canlog : public InternalRamAllocated
   {
   public:
@@ -120,6 +122,10 @@ class canlog : public InternalRamAllocated
     virtual bool IsOpen();
     virtual std::string GetInfo();
     virtual void OutputMsg(CAN_log_message_t& msg);
+    virtual void OutputFlush();
+
+  protected:
+    void OutputResult(CAN_log_message_t& msg, std::string& result);
 
   public:
     virtual void SetFilter(canfilter* filter);
@@ -34,6 +34,8 @@ static const char *TAG = "canlog-vfs";
 #include "ovms_config.h"
 #include "ovms_peripherals.h"
 #include "ovms_vfs.h"
+#include "canformat_cbin.h"
+#include "esp_timer.h"
 
 void can_log_vfs_start(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
@@ -57,6 +59,109 @@ void can_log_vfs_start(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
     }
   }
 
+/**
+ * can log convert: convert a log file between any two formats supporting
+ *  input & output, optionally starting at a given time (seconds since epoch).
+ *  cbin input is positioned directly using the block index.
+ */
+void can_log_vfs_convert(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  if (MyConfig.ProtectedPath(argv[2]) || MyConfig.ProtectedPath(argv[3]))
+    {
+    writer->puts("Error: protected path");
+    return;
+    }
+
+  struct timeval start = { 0, 0 };
+  if (argc > 4)
+    {
+    double t = atof(argv[4]);
+    start.tv_sec = (long)t;
+    start.tv_usec = (long)((t - start.tv_sec) * 1000000);
+    }
+
+  canformat* from = MyCanFormatFactory.NewFormat(argv[0]);
+  canformat* to = MyCanFormatFactory.NewFormat(argv[1]);
+  FILE* in = NULL;
+  FILE* out = NULL;
+  if (from == NULL || to == NULL)
+    {
+    writer->puts("Error: unknown format");
+    }
+  else if ((in = fopen(argv[2], "r")) == NULL)
+    {
+    writer->printf("Error: Could not open %s\n", argv[2]);
+    }
+  else if ((out = fopen(argv[3], "w")) == NULL)
+    {
+    writer->printf("Error: Could not write to %s\n", argv[3]);
+    }
+  else
+    {
+    if (argc > 4 && strcmp(argv[0], "cbin") == 0 && !canformat_cbin::Seek(in, &start))
+      {
+      writer->puts("Warning: not a cbin file, cannot seek");
+      fseek(in, 0, SEEK_SET);
+      }
+
+    int64_t started = esp_timer_get_time();
+    uint32_t converted = 0, skipped = 0;
+    size_t insize = 0, outsize = 0;
+    from->SetServeMode(canformat::Simulate);
+
+    std::string result = to->getheader(argc > 4 ? &start : NULL);
+    fwrite(result.c_str(), result.length(), 1, out);
+    outsize += result.length();
+
+    uint8_t buf[256];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), in)) > 0)
+      {
+      insize += len;
+      uint8_t* b = buf;
+      bool hasmore = false;
+      while (len > 0 || hasmore)
+        {
+        CAN_log_message_t msg;
+        memset(&msg,0,sizeof(msg));
+        hasmore = false;
+        size_t used = from->put(&msg, b, len, &hasmore);
+        b += used;
+        len -= used;
+        if (msg.type == CAN_LogNone && msg.origin != NULL)
+          msg.type = CAN_LogFrame_RX; // Formats without message types
+        if (msg.type != CAN_LogNone)
+          {
+          if (timercmp(&msg.timestamp, &start, <))
+            skipped++;
+          else
+            {
+            result = to->get(&msg);
+            fwrite(result.c_str(), result.length(), 1, out);
+            outsize += result.length();
+            converted++;
+            }
+          }
+        if (used == 0 && !hasmore)
+          break;
+        }
+      }
+
+    result = to->getfooter();
+    fwrite(result.c_str(), result.length(), 1, out);
+    outsize += result.length();
+
+    int64_t elapsed = esp_timer_get_time() - started;
+    writer->printf("Converted %u messages (%u skipped), %u -> %u bytes in %.1f sec\n",
+      converted, skipped, (unsigned)insize, (unsigned)outsize, (double)elapsed / 1000000);
+    }
+
+  if (in) fclose(in);
+  if (out) fclose(out);
+  if (from) delete from;
+  if (to) delete to;
+  }
+
 class OvmsCanLogVFSInit
   {
   public: OvmsCanLogVFSInit();
@@ -84,6 +189,9 @@ OvmsCanLogVFSInit::OvmsCanLogVFSInit()
           "Example: 2:2a0-37f",
           1, 9, true, vfs_file_validate);
         }
+      cmd_can_log->RegisterCommand("convert", "Convert CAN log file format", can_log_vfs_convert,
+        "<fromformat> <toformat> <infile> <outfile> [<starttime>]\n"
+        "<starttime>: seconds since epoch, i.e. 1524311386.5", 4, 5);
       }
     }
   }
@@ -204,8 +312,15 @@ void canlog_vfs::Close()
       m_path.c_str(), GetStats().c_str());
 
     OvmsRecMutexLock lock(&m_cmmutex);
+    std::string footer = m_formatter->getfooter();
     for (conn_map_t::iterator it=m_connmap.begin(); it!=m_connmap.end(); ++it)
       {
+      canlog_vfs_conn * clc = static_cast<canlog_vfs_conn *>(it->second);
+      if (footer.length()>0 && clc->m_file)
+        {
+        fwrite(footer.c_str(),footer.length(),1,clc->m_file);
+        clc->m_file_size += footer.length();
+        }
       delete it->second;
       }
     m_connmap.clear();
@@ -142,7 +142,6 @@ CANopenWorker* CANopen::Start(canbus* bus)
     m_rxqueue = xQueueCreate(20, sizeof(CAN_frame_t));
     xTaskCreatePinnedToCore(CANopenRxTask, "OVMS COrx",
       CONFIG_OVMS_COMP_CANOPEN_RX_STACK, (void*)this, 15, &m_rxtask, CORE(0));
-    MyCan.RegisterListener(m_rxqueue);
     }
 
   // start worker:
@@ -152,6 +151,7 @@ CANopenWorker* CANopen::Start(canbus* bus)
       {
       m_worker[i] = new CANopenWorker(bus);
       m_workercnt++;
+      UpdateListener();
       ESP_LOGI(TAG, "Worker started on %s", bus->GetName());
       MyEvents.SignalEvent("canopen.worker.start", (void*) m_worker[i]);
       return m_worker[i];
@@ -162,6 +162,26 @@ CANopenWorker* CANopen::Start(canbus* bus)
   }
 
 
+/**
+ * UpdateListener: (re-)register the CAN listener for the worker buses
+ *  Only EMCY (0x081-0x0FF), SDO response (0x581-0x5FF) and NMT heartbeat
+ *  (0x701-0x77F) frames are processed by the workers & channels.
+ */
+void CANopen::UpdateListener()
+  {
+  std::string filter;
+  for (int i=0; i < CAN_INTERFACE_CNT; i++)
+    {
+    if (m_worker[i])
+      {
+      int busno = m_worker[i]->m_bus->m_busnumber + 1;
+      filter.append(string_format("%d:081-0ff %d:581-5ff %d:701-77f ", busno, busno, busno));
+      }
+    }
+  MyCan.RegisterListener(m_rxqueue, false, filter.c_str());
+  }
+
+
 /**
  * Stop: stop CANopenWorker for a CAN bus
  *    - fails if the worker still has clients
@@ -191,6 +211,10 @@ bool CANopen::Stop(canbus* bus)
         m_rxqueue = NULL;
         m_rxtask = NULL;
         }
+      else
+        {
+        UpdateListener();
+        }
 
       return true; // stopped
       }
@@ -377,6 +401,7 @@ const std::string CANopen::GetResultString(const CANopenResult_t result)
     case COR_ERR_Timeout:               name = "Timeout"; break;
     case COR_ERR_SDO_Access:            name = "SDO access failed"; break;
     case COR_ERR_SDO_SegMismatch:       name = "SDO segment mismatch"; break;
+    case COR_ERR_SDO_BlockCRC:          name = "SDO block CRC mismatch"; break;
 
     case COR_ERR_DeviceOffline:         name = "Device offline"; break;
     case COR_ERR_UnknownDevice:         name = "Unknown device"; break;
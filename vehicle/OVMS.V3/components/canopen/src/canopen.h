@@ -34,8 +34,11 @@
 #include "ovms_config.h"
 #include "ovms_metrics.h"
 #include "ovms_command.h"
+#include "ovms_mutex.h"
 
 #define CAN_INTERFACE_CNT         4
+#define CANOPEN_MAX_CHANNELS      8           // max concurrent jobs per worker
+#define CANOPEN_SDO_BLKSIZE       32          // SDO block upload: segments per block (1…127)
 
 #define CANopen_GeneralError      0x08000000  // check for device specific error details
 #define CANopen_BusCollision      0xffffffff  // another master is active / non-CANopen frame received
@@ -57,6 +60,7 @@ typedef enum __attribute__ ((__packed__))
   COR_ERR_Timeout,
   COR_ERR_SDO_Access,
   COR_ERR_SDO_SegMismatch,
+  COR_ERR_SDO_BlockCRC,
   
   // General purpose application level:
   COR_ERR_DeviceOffline = 0x80,
@@ -107,6 +111,18 @@ typedef struct CANopenNodeMetrics
 
 typedef std::map<uint8_t, CANopenNodeMetrics*> CANopenNodeMetricsMap;
 
+typedef struct CANopenNodeStats
+  {
+  uint32_t              jobcnt;         // jobs processed
+  uint32_t              errcnt;         // jobs failed
+  uint32_t              sdo_bytes;      // SDO payload bytes transferred
+  uint64_t              sdo_time;       // SDO job execution time [us]
+  uint32_t              blockcnt;       // SDO block transfers done
+  bool                  noblock;        // node does not support SDO block transfers
+  } CANopenNodeStats_t;
+
+typedef std::map<uint8_t, CANopenNodeStats> CANopenNodeStatsMap;
+
 class CANopenAsyncClient;
 
 
@@ -163,6 +179,7 @@ struct __attribute__ ((__packed__)) CANopenJob
       size_t                xfersize;       // byte count sent / received
       size_t                contsize;       // content size of SDO (if indicated by slave)
       uint32_t              error;          // CANopen general error code
+      bool                  block;          // use block transfer (if supported by the node)
       } sdo;
     };
   
@@ -205,21 +222,91 @@ typedef union __attribute__ ((__packed__))
     uint8_t     subindex;       // SDO register sub index
     uint32_t    data;           // abort reason / error code (little endian)
     } ctl;
+  struct __attribute__ ((__packed__))
+    {
+    uint8_t     control;        // protocol request / response
+    uint8_t     seqno;          // block ack: last sequence number received
+    uint8_t     blksize;        // block ack: number of segments per block
+    uint8_t     unused[5];
+    } blk;
+  struct __attribute__ ((__packed__))
+    {
+    uint8_t     control;        // protocol request / response
+    uint16_t    crc;            // block end: CRC of the data (little endian)
+    uint8_t     unused[5];
+    } blkend;
   } CANopenFrame_t;
 
 
+typedef std::forward_list<CANopenAsyncClient*> CANopenClientList;
+
+class CANopenWorker;
+
+/**
+ * A CANopenChannel executes the jobs of a CANopenWorker for a subset of
+ * the node IDs (nodeid modulo channel count) in its own task.
+ * 
+ * Jobs for different nodes thereby run concurrently, while the jobs
+ * for one node are still executed one at a time in submission order.
+ * Broadcast NMT jobs (nodeid 0, always on channel 0) lock all channels,
+ * so they are serialized against the jobs of every channel.
+ */
+class CANopenChannel final
+  {
+  public:
+    CANopenChannel(CANopenWorker* worker, int index);
+    ~CANopenChannel();
+  
+  public:
+    void JobTask();
+    bool IncomingFrame(CAN_frame_t* frame);
+    CANopenResult_t SubmitJob(CANopenJob& job, TickType_t maxqueuewait=0);
+  
+  protected:
+    CANopenResult_t ProcessSendNMTJob();
+    CANopenResult_t ProcessReceiveHBJob();
+    CANopenResult_t ProcessReadSDOJob();
+    CANopenResult_t ProcessWriteSDOJob();
+    CANopenResult_t ProcessBlockUpload();
+    CANopenResult_t ProcessBlockDownload();
+  
+  private:
+    void SendSDORequest(TickType_t maxqueuewait=0);
+    void AbortSDORequest(uint32_t reason);
+    CANopenResult_t ExecuteSDORequest();
+    bool ReceiveResponse(TickType_t maxwait);
+    CANopenResult_t CheckBlockResponse(uint8_t mask, uint8_t control, const char* stage);
+
+  public:
+    CANopenWorker*        m_worker;
+    canbus*               m_bus;
+    int                   m_index;
+    
+    char                  m_taskname[16];   // "OVMS COw<index> canX"
+    TaskHandle_t          m_jobtask;        // channel task
+    QueueHandle_t         m_jobqueue;       // job rx queue
+    QueueHandle_t         m_rxqueue;        // response frame queue
+    
+    CANopenJob            m_job;            // job currently processed
+    bool                  m_blockxfer;      // job done by SDO block transfer
+    OvmsMutex             m_busy;           // held while processing a job
+
+  private:
+    CANopenFrame_t        m_request;
+    CANopenFrame_t        m_response;
+  };
+
+
 /**
  * A CANopenWorker processes CANopenJobs on a specific bus.
  * 
  * CANopenClients create and submit Jobs to be processed to a CANopenWorker.
- * After finish/abort, the Worker sends the Job to the clients done queue.
+ * The Worker passes each Job on to the channel serving the node addressed.
+ * After finish/abort, the channel sends the Job to the clients done queue.
  * 
  * A CANopenWorker also monitors the bus for emergency and heartbeat
  * messages, and translates these into events and metrics updates.
  */
-
-typedef std::forward_list<CANopenAsyncClient*> CANopenClientList;
-
 class CANopenWorker final
   {
   public:
@@ -227,7 +314,6 @@ class CANopenWorker final
     ~CANopenWorker();
   
   public:
-    void JobTask();
     void IncomingFrame(CAN_frame_t* frame);
     void Open(CANopenAsyncClient* client);
     void Close(CANopenAsyncClient* client);
@@ -237,26 +323,18 @@ class CANopenWorker final
   
   public:
     CANopenResult_t SubmitJob(CANopenJob& job, TickType_t maxqueuewait=0);
-  
-  protected:
-    CANopenResult_t ProcessSendNMTJob();
-    CANopenResult_t ProcessReceiveHBJob();
-    CANopenResult_t ProcessReadSDOJob();
-    CANopenResult_t ProcessWriteSDOJob();
-  
-  private:
-    void SendSDORequest();
-    void AbortSDORequest(uint32_t reason);
-    CANopenResult_t ExecuteSDORequest();
+    CANopenChannel* GetChannel(uint8_t nodeid);
+    void JobDone(const CANopenJob& job, uint32_t time_us, bool block);
+    bool GetBlockSupport(uint8_t nodeid);
+    void SetBlockSupport(uint8_t nodeid, bool supported);
 
   public:
     canbus*               m_bus;            // max one worker per bus
     int                   m_clientcnt;
     CANopenClientList     m_clients;
     
-    char                  m_taskname[12];   // "COwrk canX"
-    TaskHandle_t          m_jobtask;        // worker task
-    QueueHandle_t         m_jobqueue;       // job rx queue
+    CANopenChannel*       m_channel[CANOPEN_MAX_CHANNELS];
+    int                   m_channelcnt;
     
     uint32_t              m_nmt_rxcnt;
     uint32_t              m_emcy_rxcnt;
@@ -264,13 +342,9 @@ class CANopenWorker final
     uint32_t              m_jobcnt_timeout;
     uint32_t              m_jobcnt_error;
     
-    CANopenJob            m_job;            // job currently processed
-    
     CANopenNodeMetricsMap m_nodemetrics;    // map: nodeid → node metrics
-
-  private:
-    CANopenFrame_t        m_request;
-    CANopenFrame_t        m_response;
+    CANopenNodeStatsMap   m_nodestats;      // map: nodeid → job statistics
+    OvmsMutex             m_stats_mutex;    // job statistics concurrency protection
   };
 
 
@@ -315,9 +389,9 @@ class CANopenAsyncClient
     void InitReceiveHB(CANopenJob& job, uint8_t nodeid, CANopenNMTState_t* statebuf=NULL,
       int recv_timeout_ms=1000, int max_tries=1);
     void InitReadSDO(CANopenJob& job, uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-      int resp_timeout_ms=100, int max_tries=3);
+      int resp_timeout_ms=100, int max_tries=3, bool block=false);
     void InitWriteSDO(CANopenJob& job, uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-      int resp_timeout_ms=100, int max_tries=3);
+      int resp_timeout_ms=100, int max_tries=3, bool block=false);
   
   public:
     // Main API:
@@ -326,9 +400,9 @@ class CANopenAsyncClient
     CANopenResult_t ReceiveHB(uint8_t nodeid, CANopenNMTState_t* statebuf=NULL,
       int recv_timeout_ms=1000, int max_tries=1);
     CANopenResult_t ReadSDO(uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-      int resp_timeout_ms=100, int max_tries=3);
+      int resp_timeout_ms=100, int max_tries=3, bool block=false);
     CANopenResult_t WriteSDO(uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-      int resp_timeout_ms=100, int max_tries=3);
+      int resp_timeout_ms=100, int max_tries=3, bool block=false);
   
   public:
     CANopenWorker*        m_worker;
@@ -362,9 +436,9 @@ class CANopenClient : public CANopenAsyncClient
     CANopenResult_t ReceiveHB(CANopenJob& job, uint8_t nodeid, CANopenNMTState_t* statebuf=NULL,
       int recv_timeout_ms=1000, int max_tries=1);
     CANopenResult_t ReadSDO(CANopenJob& job, uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-      int resp_timeout_ms=100, int max_tries=3);
+      int resp_timeout_ms=100, int max_tries=3, bool block=false);
     CANopenResult_t WriteSDO(CANopenJob& job, uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-      int resp_timeout_ms=100, int max_tries=3);
+      int resp_timeout_ms=100, int max_tries=3, bool block=false);
   
   public:
     SemaphoreHandle_t m_mutex;              // thread mutex
@@ -390,6 +464,9 @@ class CANopen final
     CANopenWorker* GetWorker(canbus* bus);
     void StatusReport(int verbosity, OvmsWriter* writer);
 
+  private:
+    void UpdateListener();
+
   public:
     static const std::string GetJobName(const CANopenJob_t jobtype);
     static const std::string GetJobName(const CANopenJob& job);
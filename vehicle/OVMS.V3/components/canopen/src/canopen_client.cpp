@@ -166,7 +166,7 @@ void CANopenAsyncClient::InitReceiveHB(CANopenJob& job,
  */
 void CANopenAsyncClient::InitReadSDO(CANopenJob& job,
     uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-    int resp_timeout_ms /*=50*/, int max_tries /*=3*/)
+    int resp_timeout_ms /*=50*/, int max_tries /*=3*/, bool block /*=false*/)
   {
   memset(&job, 0, sizeof(job));
   
@@ -176,6 +176,7 @@ void CANopenAsyncClient::InitReadSDO(CANopenJob& job,
   job.sdo.subindex = subindex;
   job.sdo.buf = buf;
   job.sdo.bufsize = bufsize;
+  job.sdo.block = block;
   
   job.txid = 0x600 + nodeid;
   job.rxid = 0x580 + nodeid;
@@ -189,7 +190,7 @@ void CANopenAsyncClient::InitReadSDO(CANopenJob& job,
  */
 void CANopenAsyncClient::InitWriteSDO(CANopenJob& job,
     uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-    int resp_timeout_ms /*=50*/, int max_tries /*=3*/)
+    int resp_timeout_ms /*=50*/, int max_tries /*=3*/, bool block /*=false*/)
   {
   memset(&job, 0, sizeof(job));
   
@@ -199,6 +200,7 @@ void CANopenAsyncClient::InitWriteSDO(CANopenJob& job,
   job.sdo.subindex = subindex;
   job.sdo.buf = buf;
   job.sdo.bufsize = bufsize;
+  job.sdo.block = block;
   
   job.txid = 0x600 + nodeid;
   job.rxid = 0x580 + nodeid;
@@ -255,6 +257,7 @@ CANopenResult_t CANopenAsyncClient::ReceiveHB(
  *   - remaining buffer space will be zeroed
  *   - on result COR_ERR_BufferTooSmall, the buffer has been filled up to bufsize
  *   - on abort, the CANopen error code can be retrieved from job.sdo.error
+ *   - with block=true, SDO block transfer is used if supported by the node (faster for large objects)
  * 
  * Note: result interpretation is up to caller (check device object dictionary for data types & sizes).
  *   As CANopen is little endian as ESP32, we don't need to check lengths on numerical results,
@@ -262,10 +265,10 @@ CANopenResult_t CANopenAsyncClient::ReceiveHB(
  */
 CANopenResult_t CANopenAsyncClient::ReadSDO(
     uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-    int resp_timeout_ms /*=50*/, int max_tries /*=3*/)
+    int resp_timeout_ms /*=50*/, int max_tries /*=3*/, bool block /*=false*/)
   {
   CANopenJob job;
-  InitReadSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries);
+  InitReadSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries, block);
   return SubmitJob(job);
   }
 
@@ -277,6 +280,7 @@ CANopenResult_t CANopenAsyncClient::ReadSDO(
  *   - … or 4 bytes from buf if bufsize is 0 (use for integer SDOs of unknown type)
  *   - returns data length sent in job.sdo.xfersize
  *   - on abort, the CANopen error code can be retrieved from job.sdo.error
+ *   - with block=true, SDO block transfer is used if supported by the node (faster for large objects)
  * 
  * Note: the caller needs to know data type & size of the SDO register (check device object dictionary).
  *   As CANopen servers normally are intelligent, anything from int8_t to uint32_t can simply be
@@ -284,10 +288,10 @@ CANopenResult_t CANopenAsyncClient::ReadSDO(
  */
 CANopenResult_t CANopenAsyncClient::WriteSDO(
     uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-    int resp_timeout_ms /*=50*/, int max_tries /*=3*/)
+    int resp_timeout_ms /*=50*/, int max_tries /*=3*/, bool block /*=false*/)
   {
   CANopenJob job;
-  InitWriteSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries);
+  InitWriteSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries, block);
   return SubmitJob(job);
   }
 
@@ -390,6 +394,7 @@ CANopenResult_t CANopenClient::ReceiveHB(CANopenJob& job,
  *   - remaining buffer space will be zeroed
  *   - on result COR_ERR_BufferTooSmall, the buffer has been filled up to bufsize
  *   - on abort, the CANopen error code can be retrieved from job.sdo.error
+ *   - with block=true, SDO block transfer is used if supported by the node (faster for large objects)
  * 
  * Note: result interpretation is up to caller (check device object dictionary for data types & sizes).
  *   As CANopen is little endian as ESP32, we don't need to check lengths on numerical results,
@@ -397,9 +402,9 @@ CANopenResult_t CANopenClient::ReceiveHB(CANopenJob& job,
  */
 CANopenResult_t CANopenClient::ReadSDO(CANopenJob& job,
     uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-    int resp_timeout_ms /*=50*/, int max_tries /*=3*/)
+    int resp_timeout_ms /*=50*/, int max_tries /*=3*/, bool block /*=false*/)
   {
-  InitReadSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries);
+  InitReadSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries, block);
   return ExecuteJob(job);
   }
 
@@ -411,6 +416,7 @@ CANopenResult_t CANopenClient::ReadSDO(CANopenJob& job,
  *   - … or 4 bytes from buf if bufsize is 0 (use for integer SDOs of unknown type)
  *   - returns data length sent in job.sdo.xfersize
  *   - on abort, the CANopen error code can be retrieved from job.sdo.error
+ *   - with block=true, SDO block transfer is used if supported by the node (faster for large objects)
  * 
  * Note: the caller needs to know data type & size of the SDO register (check device object dictionary).
  *   As CANopen servers normally are intelligent, anything from int8_t to uint32_t can simply be
@@ -418,9 +424,9 @@ CANopenResult_t CANopenClient::ReadSDO(CANopenJob& job,
  */
 CANopenResult_t CANopenClient::WriteSDO(CANopenJob& job,
     uint8_t nodeid, uint16_t index, uint8_t subindex, uint8_t* buf, size_t bufsize,
-    int resp_timeout_ms /*=50*/, int max_tries /*=3*/)
+    int resp_timeout_ms /*=50*/, int max_tries /*=3*/, bool block /*=false*/)
   {
-  InitWriteSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries);
+  InitWriteSDO(job, nodeid, index, subindex, buf, bufsize, resp_timeout_ms, max_tries, block);
   return ExecuteJob(job);
   }
 
@@ -26,6 +26,7 @@
 #include "ovms_log.h"
 static const char *TAG = "canopen";
 
+#include "esp_timer.h"
 #include "ovms_metrics.h"
 #include "metrics_standard.h"
 #include "ovms_events.h"
@@ -55,21 +56,61 @@ static const char *TAG = "canopen";
 #define SDO_SegmentUnusedMask       0b00001110
 #define SDO_SegmentEnd              0b00000001
 
+// SDO block transfer commands:
+
+#define SDO_BlockUploadRequest      0b10100000
+#define SDO_BlockUploadResponse     0b11000000
+#define SDO_BlockDownloadRequest    0b11000000
+#define SDO_BlockDownloadResponse   0b10100000
+
+#define SDO_BlockCRC                0b00000100
+#define SDO_BlockSizeIndicated      0b00000010
+#define SDO_BlockUnusedMask         0b00011100
+
+#define SDO_BlockSubCmdMask         0b00000011
+#define SDO_BlockInit               0b00000000
+#define SDO_BlockEnd                0b00000001
+#define SDO_BlockAck                0b00000010
+#define SDO_BlockStart              0b00000011
+
+#define SDO_BlockSegmentLast        0b10000000
+#define SDO_BlockSeqnoMask          0b01111111
+
 // SDO abort reasons:
 
 #define SDO_Abort_SegMismatch       0x05030000
 #define SDO_Abort_Timeout           0x05040000
+#define SDO_Abort_BadCommand        0x05040001
+#define SDO_Abort_BlockSize         0x05040002
+#define SDO_Abort_SeqNo             0x05040003
+#define SDO_Abort_CRC               0x05040004
 #define SDO_Abort_OutOfMemory       0x05040005
 
 
-static void CANopenWorkerJobTask(void *pvParameters);
+static void CANopenChannelJobTask(void *pvParameters);
+
+
+/**
+ * CANopenCRC16: CRC-16-CCITT (polynomial 0x1021, init 0) as used by SDO block transfers
+ */
+static uint16_t CANopenCRC16(uint16_t crc, const uint8_t* data, size_t len)
+  {
+  while (len--)
+    {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  return crc;
+  }
 
 
 /**
  * A CANopenWorker processes CANopenJobs on a specific bus.
  * 
  * CANopenClients create and submit Jobs to be processed to a CANopenWorker.
- * After finish/abort, the Worker sends the Job to the clients done queue.
+ * The Worker passes each Job on to the channel serving the node addressed.
+ * After finish/abort, the channel sends the Job to the clients done queue.
  * 
  * A CANopenWorker also monitors the bus for emergency and heartbeat
  * messages, and translates these into events and metrics updates.
@@ -88,22 +129,19 @@ CANopenWorker::CANopenWorker(canbus* bus)
   m_jobcnt_timeout = 0;
   m_jobcnt_error = 0;
   
-  m_jobqueue = xQueueCreate(20, sizeof(CANopenJob));
-  snprintf(m_taskname, sizeof(m_taskname), "OVMS COwrk %s", bus->GetName());
-  xTaskCreatePinnedToCore(CANopenWorkerJobTask, m_taskname,
-    CONFIG_OVMS_COMP_CANOPEN_WRK_STACK, (void*)this, 15, &m_jobtask, CORE(0));
-  
-  memset(&m_job, 0, sizeof(m_job));
-  m_job.type = COJT_None;
-  
-  memset(&m_request, 0, sizeof(m_request));
-  memset(&m_response, 0, sizeof(m_response));
+  m_channelcnt = CONFIG_OVMS_COMP_CANOPEN_WRK_CHANNELS;
+  if (m_channelcnt < 1)
+    m_channelcnt = 1;
+  else if (m_channelcnt > CANOPEN_MAX_CHANNELS)
+    m_channelcnt = CANOPEN_MAX_CHANNELS;
+  for (int i = 0; i < CANOPEN_MAX_CHANNELS; i++)
+    m_channel[i] = (i < m_channelcnt) ? new CANopenChannel(this, i) : NULL;
   }
 
 CANopenWorker::~CANopenWorker()
   {
-  vQueueDelete(m_jobqueue);
-  vTaskDelete(m_jobtask);
+  for (int i = 0; i < m_channelcnt; i++)
+    delete m_channel[i];
   }
 
 
@@ -132,9 +170,24 @@ bool CANopenWorker::IsClient(CANopenAsyncClient* client)
 
 void CANopenWorker::StatusReport(int verbosity, OvmsWriter* writer)
   {
+  int waiting = 0, busy = 0;
+  for (int i = 0; i < m_channelcnt; i++)
+    {
+    waiting += uxQueueMessagesWaiting(m_channel[i]->m_jobqueue);
+    if (m_channel[i]->m_job.type != COJT_None)
+      busy++;
+    }
+  
+  // get a consistent copy of the statistics:
+  m_stats_mutex.Lock();
+  uint32_t jobcnt = m_jobcnt, jobcnt_timeout = m_jobcnt_timeout, jobcnt_error = m_jobcnt_error;
+  CANopenNodeStatsMap nodestats = m_nodestats;
+  m_stats_mutex.Unlock();
+  
   writer->printf(
     "  %s:\n"
     "    Active clients: %d\n"
+    "    Channels      : %d (%d busy)\n"
     "    Jobs waiting  : %d\n"
     "    Jobs processed: %" PRId32 "\n"
     "    - timeouts    : %" PRId32 "\n"
@@ -143,12 +196,37 @@ void CANopenWorker::StatusReport(int verbosity, OvmsWriter* writer)
     "    EMCY received : %" PRId32 "\n"
     , m_bus->GetName()
     , m_clientcnt
-    , (int)uxQueueMessagesWaiting(m_jobqueue)
-    , m_jobcnt
-    , m_jobcnt_timeout
-    , m_jobcnt_error
+    , m_channelcnt
+    , busy
+    , waiting
+    , jobcnt
+    , jobcnt_timeout
+    , jobcnt_error
     , m_nmt_rxcnt
     , m_emcy_rxcnt);
+  
+  if (nodestats.empty())
+    return;
+  
+  writer->printf("    SDO transfers :   Jobs Errors     Bytes   Time/ms  Rate/B/s  Block\n");
+  for (auto it = nodestats.begin(); it != nodestats.end(); ++it)
+    {
+    const CANopenNodeStats& ns = it->second;
+    uint32_t rate = ns.sdo_time ? (uint64_t)ns.sdo_bytes * 1000000 / ns.sdo_time : 0;
+    char block[12];
+    if (ns.noblock)
+      strcpy(block, "n/a");
+    else
+      snprintf(block, sizeof(block), "%" PRIu32, ns.blockcnt);
+    writer->printf("    - node %3d    : %6" PRIu32 " %6" PRIu32 " %9" PRIu32 " %9" PRIu32 " %9" PRIu32 "  %s\n"
+      , it->first
+      , ns.jobcnt
+      , ns.errcnt
+      , ns.sdo_bytes
+      , (uint32_t)(ns.sdo_time / 1000)
+      , rate
+      , block);
+    }
   }
 
 
@@ -185,9 +263,180 @@ CANopenNodeMetrics *CANopenWorker::GetNodeMetrics(uint8_t nodeid)
 
 
 /**
- * SubmitJob: post a new job to the JobTask queue
+ * GetChannel: get the channel processing the jobs for a nodeid
+ *  All jobs for a node are processed by the same channel, so they
+ *  are executed in submission order.
+ */
+CANopenChannel* CANopenWorker::GetChannel(uint8_t nodeid)
+  {
+  return m_channel[nodeid % m_channelcnt];
+  }
+
+
+/**
+ * SubmitJob: post a new job to the JobTask queue of the node's channel
  */
 CANopenResult_t CANopenWorker::SubmitJob(CANopenJob& job, TickType_t maxqueuewait /*=0*/)
+  {
+  uint8_t nodeid;
+  switch (job.type)
+    {
+    case COJT_SendNMT:    nodeid = job.nmt.nodeid; break;
+    case COJT_ReceiveHB:  nodeid = job.hb.nodeid; break;
+    case COJT_ReadSDO:
+    case COJT_WriteSDO:   nodeid = job.sdo.nodeid; break;
+    default:              nodeid = 0; break;
+    }
+  return GetChannel(nodeid)->SubmitJob(job, maxqueuewait);
+  }
+
+
+/**
+ * JobDone: update job statistics
+ */
+void CANopenWorker::JobDone(const CANopenJob& job, uint32_t time_us, bool block)
+  {
+  OvmsMutexLock lock(&m_stats_mutex);
+  
+  m_jobcnt++;
+  if (job.result == COR_ERR_Timeout)
+    m_jobcnt_timeout++;
+  else if (job.result != COR_OK)
+    m_jobcnt_error++;
+  
+  if (job.type != COJT_ReadSDO && job.type != COJT_WriteSDO)
+    return;
+  
+  CANopenNodeStats& ns = m_nodestats[job.sdo.nodeid];
+  ns.jobcnt++;
+  if (job.result != COR_OK)
+    ns.errcnt++;
+  ns.sdo_bytes += job.sdo.xfersize;
+  ns.sdo_time += time_us;
+  if (block)
+    ns.blockcnt++;
+  }
+
+
+/**
+ * GetBlockSupport / SetBlockSupport: SDO block transfer support of a node
+ *  Nodes are assumed to support block transfers until they reject one, or ignore
+ *  one but answer the following expedited/segmented request.
+ */
+bool CANopenWorker::GetBlockSupport(uint8_t nodeid)
+  {
+  OvmsMutexLock lock(&m_stats_mutex);
+  auto it = m_nodestats.find(nodeid);
+  return (it == m_nodestats.end() || !it->second.noblock);
+  }
+
+void CANopenWorker::SetBlockSupport(uint8_t nodeid, bool supported)
+  {
+  OvmsMutexLock lock(&m_stats_mutex);
+  m_nodestats[nodeid].noblock = !supported;
+  }
+
+
+/**
+ * IncomingFrame: process EMCY and Heartbeat messages, forward job frames to channels
+ */
+void CANopenWorker::IncomingFrame(CAN_frame_t* p_frame)
+  {
+  // Message matching a current job?
+  for (int i = 0; i < m_channelcnt; i++)
+    m_channel[i]->IncomingFrame(p_frame);
+  
+  
+  // EMCY (Emergency) message?
+  if (p_frame->MsgID > 0x080 && p_frame->MsgID < 0x100 && p_frame->FIR.B.DLC == 8)
+    {
+    m_emcy_rxcnt++;
+    
+    CANopenEMCYEvent ev;
+    ev.origin = p_frame->origin;
+    ev.nodeid = p_frame->MsgID - 0x080;
+    ev.code = p_frame->data.u8[0] | (p_frame->data.u8[1] << 8);
+    ev.type = p_frame->data.u8[2];
+    memcpy(ev.data, p_frame->data.u8+3, 5);
+    
+    CANopenNodeMetrics *nm = GetNodeMetrics(ev.nodeid);
+    
+    // Note: logging is very expensive if file logging to SD card is enabled (→ issue #107).
+    //  Workaround: level down to verbose (should be info):
+    ESP_LOGV(TAG, "%s node %d emergency: code=0x%04x type=0x%02x data: %02x %02x %02x %02x %02x",
+      m_bus->GetName(), ev.nodeid, ev.code, ev.type, ev.data[0], ev.data[1], ev.data[2], ev.data[3], ev.data[4]);
+    MyEvents.SignalEvent("canopen.node.emcy", &ev, sizeof(ev));
+    nm->m_emcy_code->SetValue(ev.code);
+    nm->m_emcy_type->SetValue(ev.type);
+    }
+  
+  // NMT (Heartbeat/State) message?
+  else if (p_frame->MsgID > 0x700 && p_frame->MsgID < 0x780 && p_frame->FIR.B.DLC == 1)
+    {
+    m_nmt_rxcnt++;
+    
+    CANopenNMTEvent ev;
+    ev.origin = p_frame->origin;
+    ev.nodeid = p_frame->MsgID - 0x700;
+    ev.state = (CANopenNMTState_t) p_frame->data.u8[0];
+    
+    CANopenNodeMetrics *nm = GetNodeMetrics(ev.nodeid);
+    
+    std::string newstate = CANopen::GetStateName(ev.state);
+    if (nm->m_state->AsString() != newstate)
+      {
+      // Note: logging is very expensive if file logging to SD card is enabled (→ issue #107).
+      //  Workaround: level down to verbose (should be info):
+      ESP_LOGV(TAG, "%s node %d new state: %s", m_bus->GetName(), ev.nodeid, newstate.c_str());
+      MyEvents.SignalEvent("canopen.node.state", &ev, sizeof(ev));
+      nm->m_state->SetValue(newstate);
+      }
+    else
+      {
+      nm->m_state->SetStale(false);
+      }
+    }
+  
+  } // IncomingFrame()
+
+
+/**
+ * A CANopenChannel executes the jobs for a subset of the nodes of a worker
+ *  in its own task, so jobs for nodes of different channels run concurrently.
+ */
+
+CANopenChannel::CANopenChannel(CANopenWorker* worker, int index)
+  {
+  m_worker = worker;
+  m_bus = worker->m_bus;
+  m_index = index;
+  
+  memset(&m_job, 0, sizeof(m_job));
+  m_job.type = COJT_None;
+  m_blockxfer = false;
+  
+  memset(&m_request, 0, sizeof(m_request));
+  memset(&m_response, 0, sizeof(m_response));
+  
+  m_jobqueue = xQueueCreate(20, sizeof(CANopenJob));
+  m_rxqueue = xQueueCreate(CANOPEN_SDO_BLKSIZE+2, sizeof(CANopenFrame_t));
+  snprintf(m_taskname, sizeof(m_taskname), "OVMS COw%d %s", index, m_bus->GetName());
+  xTaskCreatePinnedToCore(CANopenChannelJobTask, m_taskname,
+    CONFIG_OVMS_COMP_CANOPEN_WRK_STACK, (void*)this, 15, &m_jobtask, CORE(0));
+  }
+
+CANopenChannel::~CANopenChannel()
+  {
+  vTaskDelete(m_jobtask);
+  vQueueDelete(m_jobqueue);
+  vQueueDelete(m_rxqueue);
+  }
+
+
+/**
+ * SubmitJob: post a new job to the JobTask queue
+ */
+CANopenResult_t CANopenChannel::SubmitJob(CANopenJob& job, TickType_t maxqueuewait /*=0*/)
   {
   if (xQueueSend(m_jobqueue, &job, maxqueuewait) != pdTRUE)
     job.result = COR_ERR_QueueFull;
@@ -197,17 +446,40 @@ CANopenResult_t CANopenWorker::SubmitJob(CANopenJob& job, TickType_t maxqueuewai
   }
 
 
+/**
+ * IncomingFrame: forward frame to the job task if it matches the current job
+ *  Returns true if the frame has been taken.
+ */
+bool CANopenChannel::IncomingFrame(CAN_frame_t* p_frame)
+  {
+  if (m_job.type == COJT_None || p_frame->MsgID != m_job.rxid)
+    return false;
+  
+  // copy payload:
+  CANopenFrame_t frame;
+  int i;
+  for (i=0; i < p_frame->FIR.B.DLC && i < 8; i++)
+    frame.byte[i] = p_frame->data.u8[i];
+  for (; i < 8; i++)
+    frame.byte[i] = 0;
+  
+  // pass to job task, drop if the task is not responding:
+  xQueueSend(m_rxqueue, &frame, 0);
+  return true;
+  }
+
+
 /**
  * JobTask: process CANopenJobs, send results back to clients
  */
 
-static void CANopenWorkerJobTask(void *pvParameters)
+static void CANopenChannelJobTask(void *pvParameters)
   {
-  CANopenWorker *me = (CANopenWorker*)pvParameters;
+  CANopenChannel *me = (CANopenChannel*)pvParameters;
   me->JobTask();
   }
 
-void CANopenWorker::JobTask()
+void CANopenChannel::JobTask()
   {
   while(1)
     {
@@ -215,12 +487,29 @@ void CANopenWorker::JobTask()
     if (xQueueReceive(m_jobqueue, &m_job, (portTickType)portMAX_DELAY) == pdTRUE)
       {
         // check client:
-        if (!IsClient(m_job.client))
+        if (!m_worker->IsClient(m_job.client))
           {
           ESP_LOGW(TAG, "Job dropped: Client vanished");
+          m_job.type = COJT_None;
           continue;
           }
         
+        // lock the channel; a broadcast affects all nodes, so it locks all
+        // channels (in index order; only channel 0 takes more than one lock):
+        int lockfirst = m_index, locklast = m_index;
+        if (m_job.type == COJT_SendNMT && m_job.nmt.nodeid == 0)
+          {
+          lockfirst = 0;
+          locklast = m_worker->m_channelcnt - 1;
+          }
+        for (int i = lockfirst; i <= locklast; i++)
+          m_worker->m_channel[i]->m_busy.Lock();
+        
+        // discard responses to previous jobs:
+        xQueueReset(m_rxqueue);
+        m_blockxfer = false;
+        int64_t starttime = esp_timer_get_time();
+        
         // process job:
         switch (m_job.type)
           {
@@ -252,8 +541,13 @@ void CANopenWorker::JobTask()
             m_job.result = COR_ERR_UnknownJobType;
           }
         
+        uint32_t jobtime = esp_timer_get_time() - starttime;
+        
+        for (int i = locklast; i >= lockfirst; i--)
+          m_worker->m_channel[i]->m_busy.Unlock();
+        
         // return job to client if still valid:
-        if (!IsClient(m_job.client))
+        if (!m_worker->IsClient(m_job.client))
           {
           ESP_LOGW(TAG, "Job result lost: Client vanished");
           }
@@ -264,11 +558,7 @@ void CANopenWorker::JobTask()
           }
         
         // statistics:
-        m_jobcnt++;
-        if (m_job.result == COR_ERR_Timeout)
-          m_jobcnt_timeout++;
-        else if (m_job.result != COR_OK)
-          m_jobcnt_error++;
+        m_worker->JobDone(m_job, jobtime, m_blockxfer);
         
         m_job.type = COJT_None;
       }
@@ -277,76 +567,12 @@ void CANopenWorker::JobTask()
 
 
 /**
- * IncomingFrame: process EMCY and Heartbeat messages, forward job frames to job task
+ * ReceiveResponse: wait for the next frame from IncomingFrame()
  */
-void CANopenWorker::IncomingFrame(CAN_frame_t* p_frame)
+bool CANopenChannel::ReceiveResponse(TickType_t maxwait)
   {
-  // Message matching our current job?
-  if (m_job.type != COJT_None && p_frame->MsgID == m_job.rxid)
-    {
-    // copy payload into m_response:
-    int i;
-    for (i=0; i < p_frame->FIR.B.DLC; i++)
-      m_response.byte[i] = p_frame->data.u8[i];
-    for (; i < 8; i++)
-      m_response.byte[i] = 0;
-    
-    // signal job task:
-    xTaskNotifyGive(m_jobtask);
-    }
-  
-  
-  // EMCY (Emergency) message?
-  if (p_frame->MsgID > 0x080 && p_frame->MsgID < 0x100 && p_frame->FIR.B.DLC == 8)
-    {
-    m_emcy_rxcnt++;
-    
-    CANopenEMCYEvent ev;
-    ev.origin = p_frame->origin;
-    ev.nodeid = p_frame->MsgID - 0x080;
-    ev.code = p_frame->data.u8[0] | (p_frame->data.u8[1] << 8);
-    ev.type = p_frame->data.u8[2];
-    memcpy(ev.data, p_frame->data.u8+3, 5);
-    
-    CANopenNodeMetrics *nm = GetNodeMetrics(ev.nodeid);
-    
-    // Note: logging is very expensive if file logging to SD card is enabled (→ issue #107).
-    //  Workaround: level down to verbose (should be info):
-    ESP_LOGV(TAG, "%s node %d emergency: code=0x%04x type=0x%02x data: %02x %02x %02x %02x %02x",
-      m_bus->GetName(), ev.nodeid, ev.code, ev.type, ev.data[0], ev.data[1], ev.data[2], ev.data[3], ev.data[4]);
-    MyEvents.SignalEvent("canopen.node.emcy", &ev, sizeof(ev));
-    nm->m_emcy_code->SetValue(ev.code);
-    nm->m_emcy_type->SetValue(ev.type);
-    }
-  
-  // NMT (Heartbeat/State) message?
-  else if (p_frame->MsgID > 0x700 && p_frame->MsgID < 0x780 && p_frame->FIR.B.DLC == 1)
-    {
-    m_nmt_rxcnt++;
-    
-    CANopenNMTEvent ev;
-    ev.origin = p_frame->origin;
-    ev.nodeid = p_frame->MsgID - 0x700;
-    ev.state = (CANopenNMTState_t) p_frame->data.u8[0];
-    
-    CANopenNodeMetrics *nm = GetNodeMetrics(ev.nodeid);
-    
-    std::string newstate = CANopen::GetStateName(ev.state);
-    if (nm->m_state->AsString() != newstate)
-      {
-      // Note: logging is very expensive if file logging to SD card is enabled (→ issue #107).
-      //  Workaround: level down to verbose (should be info):
-      ESP_LOGV(TAG, "%s node %d new state: %s", m_bus->GetName(), ev.nodeid, newstate.c_str());
-      MyEvents.SignalEvent("canopen.node.state", &ev, sizeof(ev));
-      nm->m_state->SetValue(newstate);
-      }
-    else
-      {
-      nm->m_state->SetStale(false);
-      }
-    }
-  
-  } // IncomingFrame()
+  return (xQueueReceive(m_rxqueue, &m_response, maxwait) == pdTRUE);
+  }
 
 
 /**
@@ -359,7 +585,7 @@ void CANopenWorker::IncomingFrame(CAN_frame_t* p_frame)
  *  even though the state has in fact changed -- there's no way to know
  *  if the node doesn't tell.
  */
-CANopenResult_t CANopenWorker::ProcessSendNMTJob()
+CANopenResult_t CANopenChannel::ProcessSendNMTJob()
   {
   // check bus:
   if (m_bus->m_mode != CAN_MODE_ACTIVE)
@@ -386,14 +612,15 @@ CANopenResult_t CANopenWorker::ProcessSendNMTJob()
     {
     // send request:
     m_job.trycnt++;
+    xQueueReset(m_rxqueue);
     txframe.Write();
     
     // immediate return?
     if (m_job.rxid == 0)
       return COR_OK;
     
-    // wait for response signal from IncomingFrame():
-    if (ulTaskNotifyTake(pdTRUE, maxwait))
+    // wait for response from IncomingFrame():
+    if (ReceiveResponse(maxwait))
       {
       // expected response for command?
       if ( (m_job.nmt.command == CONC_Start      && m_response.hb.state >= 5)
@@ -421,7 +648,7 @@ CANopenResult_t CANopenWorker::ProcessSendNMTJob()
  * Use this to read the current state or synchronize to the heartbeat.
  * Note: heartbeats are optional in CANopen.
  */
-CANopenResult_t CANopenWorker::ProcessReceiveHBJob()
+CANopenResult_t CANopenChannel::ProcessReceiveHBJob()
   {
   // check parameters:
   if (m_job.hb.nodeid < 1 || m_job.hb.nodeid > 127)
@@ -433,8 +660,8 @@ CANopenResult_t CANopenWorker::ProcessReceiveHBJob()
     {
     m_job.trycnt++;
     
-    // wait for receive signal from IncomingFrame():
-    if (ulTaskNotifyTake(pdTRUE, maxwait))
+    // wait for heartbeat from IncomingFrame():
+    if (ReceiveResponse(maxwait))
       {
       // return state received:
       m_job.hb.state = (CANopenNMTState_t) m_response.hb.state;
@@ -455,8 +682,10 @@ CANopenResult_t CANopenWorker::ProcessReceiveHBJob()
 
 /**
  * SendSDORequest: asynchronous tx of prepared CANopen SDO request
+ *  Block transfers send bursts of frames, these need to wait for
+ *  TX queue space (maxqueuewait) instead of dropping frames.
  */
-void CANopenWorker::SendSDORequest()
+void CANopenChannel::SendSDORequest(TickType_t maxqueuewait /*=0*/)
   {
   // init tx frame:
   CAN_frame_t txframe;
@@ -470,34 +699,34 @@ void CANopenWorker::SendSDORequest()
   memcpy(txframe.data.u8, m_request.byte, 8);
   
   // send:
-  txframe.Write();
+  txframe.Write(NULL, maxqueuewait);
   }
 
 
 /**
  * AbortSDORequest: send SDO abort command
  */
-void CANopenWorker::AbortSDORequest(uint32_t reason)
+void CANopenChannel::AbortSDORequest(uint32_t reason)
   {
   // backup request:
-  uint8_t control = m_request.ctl.control;
-  uint32_t data = m_request.ctl.data;
+  CANopenFrame_t request = m_request;
   
   // send abort:
   m_request.ctl.control = SDO_Abort;
+  m_request.ctl.index = m_job.sdo.index;
+  m_request.ctl.subindex = m_job.sdo.subindex;
   m_request.ctl.data = reason;
   SendSDORequest();
   
   // restore request:
-  m_request.ctl.control = control;
-  m_request.ctl.data = data;
+  m_request = request;
   }
 
 
 /**
  * ExecuteSDORequest: send SDO request and wait for response
  */
-CANopenResult_t CANopenWorker::ExecuteSDORequest()
+CANopenResult_t CANopenChannel::ExecuteSDORequest()
   {
   TickType_t maxwait = pdMS_TO_TICKS(m_job.timeout_ms);
   m_job.trycnt = 0;
@@ -506,10 +735,11 @@ CANopenResult_t CANopenWorker::ExecuteSDORequest()
     {
     // send request:
     m_job.trycnt++;
+    xQueueReset(m_rxqueue);
     SendSDORequest();
 
     // wait for reply:
-    if (ulTaskNotifyTake(pdTRUE, maxwait))
+    if (ReceiveResponse(maxwait))
       return COR_OK;
 
     // timeout:
@@ -530,12 +760,14 @@ CANopenResult_t CANopenWorker::ExecuteSDORequest()
  *   - remaining buffer space will be zeroed
  *   - on result COR_ERR_BufferTooSmall, the buffer has been filled up to m_job.sdo.bufsize
  *   - on abort, the CANopen error code will be written into m_job.sdo.error
+ *   - if m_job.sdo.block is set, a block upload is tried first, falling back to the
+ *     expedited/segmented protocol if the node rejects or ignores the block request
  * 
  * Note: result interpretation is up to caller (check device object dictionary for data types & sizes).
  *   As CANopen is little endian as ESP32, we don't need to check lengths on numerical results,
  *   i.e. anything from int8_t to uint32_t can simply be read into a uint32_t buffer.
  */
-CANopenResult_t CANopenWorker::ProcessReadSDOJob()
+CANopenResult_t CANopenChannel::ProcessReadSDOJob()
   {
   // check for CAN write access:
   if (m_bus->m_mode != CAN_MODE_ACTIVE)
@@ -554,6 +786,31 @@ CANopenResult_t CANopenWorker::ProcessReadSDOJob()
   uint8_t *buf = m_job.sdo.buf;
   m_job.sdo.xfersize = 0;
   
+  // try block transfer:
+  bool blocktimeout = false;
+  if (m_job.sdo.block && m_worker->GetBlockSupport(m_job.sdo.nodeid))
+    {
+    CANopenResult_t res = ProcessBlockUpload();
+    if (m_blockxfer)
+      return res;
+    if (res == COR_ERR_SDO_Access && m_job.sdo.error == SDO_Abort_BadCommand)
+      {
+      ESP_LOGD(TAG, "ReadSDO #%d: node does not support block transfers", m_job.sdo.nodeid);
+      m_worker->SetBlockSupport(m_job.sdo.nodeid, false);
+      }
+    else if (res == COR_ERR_Timeout)
+      {
+      // some nodes ignore the block request instead of aborting it:
+      ESP_LOGD(TAG, "ReadSDO #%d: no response to block upload, trying segmented", m_job.sdo.nodeid);
+      blocktimeout = true;
+      }
+    else
+      {
+      return res;
+      }
+    m_job.sdo.error = 0;
+    }
+  
   // request upload:
   memset(&m_request, 0, sizeof(m_request));
   m_request.exp.index = m_job.sdo.index;
@@ -564,6 +821,12 @@ CANopenResult_t CANopenWorker::ProcessReadSDOJob()
     m_job.sdo.error = SDO_Abort_Timeout;
     return COR_ERR_Timeout;
     }
+  if (blocktimeout)
+    {
+    // node is alive, it just ignores block requests:
+    ESP_LOGD(TAG, "ReadSDO #%d: node does not support block transfers", m_job.sdo.nodeid);
+    m_worker->SetBlockSupport(m_job.sdo.nodeid, false);
+    }
 
   // check response:
   if ((m_response.exp.control & SDO_CommandMask) != SDO_InitUploadResponse
@@ -661,12 +924,15 @@ CANopenResult_t CANopenWorker::ProcessReadSDOJob()
  *   - … or 4 bytes from m_job.sdo.buf if bufsize is 0 (use for integer SDOs of unknown type)
  *   - returns data length sent in m_job.sdo.xfersize
  *   - on abort, the CANopen error code will be written into m_job.sdo.error
+ *   - if m_job.sdo.block is set, data exceeding the expedited size is sent by block download
+ *     if the node supports this, else by segmented download (also if the node ignores
+ *     the block request)
  * 
  * Note: the caller needs to know data type & size of the SDO register (check device object dictionary).
  *   As CANopen servers normally are intelligent, anything from int8_t to uint32_t can simply be
  *   sent as a uint32_t with bufsize=0, the server will know how to convert it.
  */
-CANopenResult_t CANopenWorker::ProcessWriteSDOJob()
+CANopenResult_t CANopenChannel::ProcessWriteSDOJob()
   {
   // check for CAN write access:
   if (m_bus->m_mode != CAN_MODE_ACTIVE)
@@ -684,6 +950,31 @@ CANopenResult_t CANopenWorker::ProcessWriteSDOJob()
   uint8_t *buf = m_job.sdo.buf;
   m_job.sdo.xfersize = 0;
   
+  // try block transfer:
+  bool blocktimeout = false;
+  if (m_job.sdo.block && m_job.sdo.bufsize > 4 && m_worker->GetBlockSupport(m_job.sdo.nodeid))
+    {
+    CANopenResult_t res = ProcessBlockDownload();
+    if (m_blockxfer)
+      return res;
+    if (res == COR_ERR_SDO_Access && m_job.sdo.error == SDO_Abort_BadCommand)
+      {
+      ESP_LOGD(TAG, "WriteSDO #%d: node does not support block transfers", m_job.sdo.nodeid);
+      m_worker->SetBlockSupport(m_job.sdo.nodeid, false);
+      }
+    else if (res == COR_ERR_Timeout)
+      {
+      // some nodes ignore the block request instead of aborting it:
+      ESP_LOGD(TAG, "WriteSDO #%d: no response to block download, trying segmented", m_job.sdo.nodeid);
+      blocktimeout = true;
+      }
+    else
+      {
+      return res;
+      }
+    m_job.sdo.error = 0;
+    }
+  
   // request download:
   memset(&m_request, 0, sizeof(m_request));
   m_request.exp.index = m_job.sdo.index;
@@ -713,6 +1004,12 @@ CANopenResult_t CANopenWorker::ProcessWriteSDOJob()
     m_job.sdo.error = SDO_Abort_Timeout;
     return COR_ERR_Timeout;
     }
+  if (blocktimeout)
+    {
+    // node is alive, it just ignores block requests:
+    ESP_LOGD(TAG, "WriteSDO #%d: node does not support block transfers", m_job.sdo.nodeid);
+    m_worker->SetBlockSupport(m_job.sdo.nodeid, false);
+    }
 
   // check response:
   if ((m_response.exp.control & SDO_CommandMask) != SDO_InitDownloadResponse
@@ -777,3 +1074,284 @@ CANopenResult_t CANopenWorker::ProcessWriteSDOJob()
   }
 
 
+/**
+ * CheckBlockResponse: check block transfer response for the expected command
+ *  On mismatch, sets m_job.sdo.error to the abort reason received or sent.
+ */
+CANopenResult_t CANopenChannel::CheckBlockResponse(uint8_t mask, uint8_t control, const char* stage)
+  {
+  if ((m_response.ctl.control & mask) == control)
+    return COR_OK;
+  
+  if (m_response.ctl.control == SDO_Abort)
+    {
+    m_job.sdo.error = m_response.ctl.data;
+    }
+  else
+    {
+    AbortSDORequest(SDO_Abort_BadCommand);
+    m_job.sdo.error = SDO_Abort_BadCommand;
+    }
+  ESP_LOGD(TAG, "%s #%d 0x%04x.%02x: %s failed, CANopen error code 0x%08" PRIx32,
+    (m_job.type == COJT_ReadSDO) ? "ReadSDO" : "WriteSDO",
+    m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, stage, m_job.sdo.error);
+  return COR_ERR_SDO_Access;
+  }
+
+
+/**
+ * ProcessBlockUpload: read SDO by block transfer (CiA 301 block upload)
+ *   - same result semantics as ProcessReadSDOJob()
+ *   - the server sends up to CANOPEN_SDO_BLKSIZE segments per block without
+ *     waiting for responses, the client confirms each block
+ *   - the size of the last segment is only known after the end frame, so each
+ *     segment is held back until the next one has been received
+ */
+CANopenResult_t CANopenChannel::ProcessBlockUpload()
+  {
+  CANopenResult_t res;
+  TickType_t maxwait = pdMS_TO_TICKS(m_job.timeout_ms);
+  uint8_t segment[7];
+  bool pending = false, last = false, overflow = false;
+  uint8_t seqno, ackseq = 0;
+  uint16_t crc = 0;
+  int n;
+  
+  // initiate upload:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.exp.control = SDO_BlockUploadRequest | SDO_BlockCRC | SDO_BlockInit;
+  m_request.exp.index = m_job.sdo.index;
+  m_request.exp.subindex = m_job.sdo.subindex;
+  m_request.exp.data[0] = CANOPEN_SDO_BLKSIZE;
+  m_request.exp.data[1] = 0;  // protocol switch threshold: no switch
+  if (ExecuteSDORequest() != COR_OK)
+    {
+    m_job.sdo.error = SDO_Abort_Timeout;
+    return COR_ERR_Timeout;
+    }
+  
+  // check response:
+  if ((m_response.exp.control & (SDO_CommandMask|SDO_BlockEnd)) != (SDO_BlockUploadResponse|SDO_BlockInit)
+    || m_response.exp.index != m_request.exp.index
+    || m_response.exp.subindex != m_request.exp.subindex)
+    {
+    if ((m_response.exp.control & SDO_CommandMask) == SDO_Abort)
+      m_job.sdo.error = m_response.ctl.data;
+    else
+      m_job.sdo.error = CANopen_BusCollision;
+    ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: InitBlockUpload failed, CANopen error code 0x%08" PRIx32,
+      m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.error);
+    return COR_ERR_SDO_Access;
+    }
+  
+  m_blockxfer = true;
+  bool usecrc = (m_response.exp.control & SDO_BlockCRC);
+  if (m_response.exp.control & SDO_BlockSizeIndicated)
+    m_job.sdo.contsize = m_response.ctl.data;
+  else
+    m_job.sdo.contsize = 0; // unknown size
+  
+  // start upload:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.blk.control = SDO_BlockUploadRequest | SDO_BlockStart;
+  SendSDORequest();
+  
+  // receive blocks:
+  while (!last)
+    {
+    if (!ReceiveResponse(maxwait))
+      {
+      AbortSDORequest(SDO_Abort_Timeout);
+      m_job.sdo.error = SDO_Abort_Timeout;
+      return COR_ERR_Timeout;
+      }
+    if (m_response.ctl.control == SDO_Abort)
+      {
+      m_job.sdo.error = m_response.ctl.data;
+      ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: BlockUpload aborted, CANopen error code 0x%08" PRIx32,
+        m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.error);
+      return COR_ERR_SDO_Access;
+      }
+    
+    seqno = m_response.byte[0] & SDO_BlockSeqnoMask;
+    if (seqno == ackseq + 1)
+      {
+      // in sequence: store previous segment, hold back this one:
+      if (pending)
+        {
+        crc = CANopenCRC16(crc, segment, 7);
+        for (n = 0; n < 7 && m_job.sdo.xfersize < m_job.sdo.bufsize; n++)
+          m_job.sdo.buf[m_job.sdo.xfersize++] = segment[n];
+        if (n < 7)
+          {
+          ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: buffer too small, readlen=%d",
+            m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.xfersize);
+          AbortSDORequest(SDO_Abort_OutOfMemory);
+          m_job.sdo.error = SDO_Abort_OutOfMemory;
+          return COR_ERR_BufferTooSmall;
+          }
+        }
+      memcpy(segment, &m_response.byte[1], 7);
+      pending = true;
+      ackseq = seqno;
+      last = (m_response.byte[0] & SDO_BlockSegmentLast);
+      }
+    
+    // end of block? confirm segments received in sequence:
+    if (last || seqno >= CANOPEN_SDO_BLKSIZE || (m_response.byte[0] & SDO_BlockSegmentLast))
+      {
+      memset(&m_request, 0, sizeof(m_request));
+      m_request.blk.control = SDO_BlockUploadRequest | SDO_BlockAck;
+      m_request.blk.seqno = ackseq;
+      m_request.blk.blksize = CANOPEN_SDO_BLKSIZE;
+      SendSDORequest();
+      ackseq = 0;
+      }
+    }
+  
+  // receive end:
+  if (!ReceiveResponse(maxwait))
+    {
+    AbortSDORequest(SDO_Abort_Timeout);
+    m_job.sdo.error = SDO_Abort_Timeout;
+    return COR_ERR_Timeout;
+    }
+  if ((res = CheckBlockResponse(SDO_CommandMask|SDO_BlockSubCmdMask, SDO_BlockUploadResponse|SDO_BlockEnd, "EndBlockUpload")) != COR_OK)
+    return res;
+  
+  // store last segment:
+  int len = 7 - ((m_response.blkend.control & SDO_BlockUnusedMask) >> 2);
+  crc = CANopenCRC16(crc, segment, len);
+  for (n = 0; n < len && m_job.sdo.xfersize < m_job.sdo.bufsize; n++)
+    m_job.sdo.buf[m_job.sdo.xfersize++] = segment[n];
+  overflow = (n < len);
+  
+  // check CRC:
+  if (usecrc && crc != m_response.blkend.crc)
+    {
+    ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: CRC mismatch, readlen=%d",
+      m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.xfersize);
+    AbortSDORequest(SDO_Abort_CRC);
+    m_job.sdo.error = SDO_Abort_CRC;
+    return COR_ERR_SDO_BlockCRC;
+    }
+  
+  // confirm end:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.blk.control = SDO_BlockUploadRequest | SDO_BlockEnd;
+  SendSDORequest();
+  
+  if (overflow)
+    {
+    ESP_LOGD(TAG, "ReadSDO #%d 0x%04x.%02x: buffer too small, readlen=%d",
+      m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.xfersize);
+    m_job.sdo.error = SDO_Abort_OutOfMemory;
+    return COR_ERR_BufferTooSmall;
+    }
+  
+  return COR_OK;
+  }
+
+
+/**
+ * ProcessBlockDownload: write SDO by block transfer (CiA 301 block download)
+ *   - same result semantics as ProcessWriteSDOJob()
+ *   - sends blocks of up to the number of segments requested by the server,
+ *     resends from the first segment not acknowledged
+ */
+CANopenResult_t CANopenChannel::ProcessBlockDownload()
+  {
+  CANopenResult_t res;
+  TickType_t maxwait = pdMS_TO_TICKS(m_job.timeout_ms);
+  const uint8_t *buf = m_job.sdo.buf;
+  size_t size = m_job.sdo.bufsize, pos;
+  uint8_t seqno, ackseq, blksize;
+  int n;
+  
+  // initiate download:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.exp.control = SDO_BlockDownloadRequest | SDO_BlockCRC | SDO_BlockSizeIndicated | SDO_BlockInit;
+  m_request.exp.index = m_job.sdo.index;
+  m_request.exp.subindex = m_job.sdo.subindex;
+  m_request.ctl.data = size;
+  if (ExecuteSDORequest() != COR_OK)
+    {
+    m_job.sdo.error = SDO_Abort_Timeout;
+    return COR_ERR_Timeout;
+    }
+  
+  // check response:
+  if ((m_response.exp.control & (SDO_CommandMask|SDO_BlockSubCmdMask)) != (SDO_BlockDownloadResponse|SDO_BlockInit)
+    || m_response.exp.index != m_request.exp.index
+    || m_response.exp.subindex != m_request.exp.subindex)
+    {
+    if ((m_response.exp.control & SDO_CommandMask) == SDO_Abort)
+      m_job.sdo.error = m_response.ctl.data;
+    else
+      m_job.sdo.error = CANopen_BusCollision;
+    ESP_LOGD(TAG, "WriteSDO #%d 0x%04x.%02x: InitBlockDownload failed, CANopen error code 0x%08" PRIx32,
+      m_job.sdo.nodeid, m_job.sdo.index, m_job.sdo.subindex, m_job.sdo.error);
+    return COR_ERR_SDO_Access;
+    }
+  
+  m_blockxfer = true;
+  uint16_t crc = (m_response.exp.control & SDO_BlockCRC) ? CANopenCRC16(0, buf, size) : 0;
+  blksize = m_response.exp.data[0];
+  
+  // send blocks:
+  while (m_job.sdo.xfersize < size)
+    {
+    if (blksize < 1 || blksize > 127)
+      {
+      AbortSDORequest(SDO_Abort_BlockSize);
+      m_job.sdo.error = SDO_Abort_BlockSize;
+      return COR_ERR_SDO_Access;
+      }
+    
+    xQueueReset(m_rxqueue);
+    pos = m_job.sdo.xfersize;
+    for (seqno = 1; seqno <= blksize && pos < size; seqno++)
+      {
+      memset(&m_request, 0, sizeof(m_request));
+      for (n = 0; n < 7 && pos < size; n++)
+        m_request.seg.data[n] = buf[pos++];
+      m_request.seg.control = seqno | ((pos == size) ? SDO_BlockSegmentLast : 0);
+      SendSDORequest(maxwait);
+      }
+    
+    // wait for confirmation:
+    if (!ReceiveResponse(maxwait))
+      {
+      AbortSDORequest(SDO_Abort_Timeout);
+      m_job.sdo.error = SDO_Abort_Timeout;
+      return COR_ERR_Timeout;
+      }
+    if ((res = CheckBlockResponse(SDO_CommandMask|SDO_BlockSubCmdMask, SDO_BlockDownloadResponse|SDO_BlockAck, "BlockDownload")) != COR_OK)
+      return res;
+    ackseq = m_response.blk.seqno;
+    if (ackseq >= seqno)
+      {
+      AbortSDORequest(SDO_Abort_SeqNo);
+      m_job.sdo.error = SDO_Abort_SeqNo;
+      return COR_ERR_SDO_Access;
+      }
+    m_job.sdo.xfersize += 7 * ackseq;
+    if (m_job.sdo.xfersize > size)
+      m_job.sdo.xfersize = size;
+    blksize = m_response.blk.blksize;
+    }
+  
+  // end download:
+  memset(&m_request, 0, sizeof(m_request));
+  m_request.blkend.control = SDO_BlockDownloadRequest | (((7 - size % 7) % 7) << 2) | SDO_BlockEnd;
+  m_request.blkend.crc = crc;
+  xQueueReset(m_rxqueue);
+  SendSDORequest();
+  if (!ReceiveResponse(maxwait))
+    {
+    AbortSDORequest(SDO_Abort_Timeout);
+    m_job.sdo.error = SDO_Abort_Timeout;
+    return COR_ERR_Timeout;
+    }
+  return CheckBlockResponse(SDO_CommandMask|SDO_BlockSubCmdMask, SDO_BlockDownloadResponse|SDO_BlockEnd, "EndBlockDownload");
+  }
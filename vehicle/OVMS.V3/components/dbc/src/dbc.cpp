@@ -105,6 +105,20 @@ dbc_extract_bits_big_endian(const uint8_t *candata, unsigned int bpos, unsigned
   return val;
   }
 
+static void
+dbc_store_signal(const dbcSignal* sig, dbcMetric* m, const dbcNumber& value)
+  {
+  if (!sig->HasValues())
+    m->SetValue(value, sig->GetMetricUnit());
+  else
+    {
+    // Metric has an 'enum' .. assign the matching value.
+    uint32_t val = value.GetUnsignedInteger();
+    if (sig->HasValue(val))
+      m->SetValue(sig->GetValue(val));
+    }
+  }
+
 uint32_t dbcMessageIdFromString(const char* id)
   {
   uint32_t msgid = 0;
@@ -1239,15 +1253,7 @@ void dbcMessage::DecodeSignal(const uint8_t* msg, uint8_t size, OvmsWriter* writ
         if (!writer)
           {
           // Store to metric.
-          if (!sig->HasValues())
-            m->SetValue(muxval.second, sig->GetMetricUnit());
-          else
-            {
-            // Metric has an 'enum' .. assign the matching value.
-            uint32_t val = muxval.second.GetUnsignedInteger();
-            if (sig->HasValue(val))
-              m->SetValue(sig->GetValue(val));
-            }
+          dbc_store_signal(sig, m, muxval.second);
           }
         else
           {
@@ -1632,6 +1638,7 @@ void dbcMessageTable::WriteSummary(dbcOutputCallback callback, void* param) cons
 dbcfile::dbcfile()
   {
   m_locks = 0;
+  m_compiled = false;
   }
 
 dbcfile::~dbcfile()
@@ -1648,6 +1655,7 @@ void dbcfile::FreeAllocations()
   m_values.EmptyContent();
   m_messages.EmptyContent();
   m_comments.EmptyContent();
+  FreePlans();
   }
 
 bool dbcfile::LoadFile(const char* name, const char* path, FILE* fd)
@@ -1760,6 +1768,8 @@ std::string dbcfile::Status() const
   ss << ", ";
   ss << m_locks;
   ss << " lock(s)";
+  if (m_compiled)
+    ss << ", compiled";
 
   return ss.str();
   }
@@ -1794,6 +1804,23 @@ bool dbcfile::IsLocked() const
   return (m_locks > 0);
   }
 
+/**
+ * Lock/Unlock: serialize access to the message table and the decoder plans.
+ *  Decoding runs on the CAN/poller tasks, editing on the command task: hold
+ *  the lock while modifying messages/signals and for the following
+ *  Recompile(). The lock is recursive, Compile(), Recompile() and
+ *  DecodeSignal() take it themselves.
+ */
+void dbcfile::Lock() const
+  {
+  m_mutex.Lock();
+  }
+
+void dbcfile::Unlock() const
+  {
+  m_mutex.Unlock();
+  }
+
 /** Decode a DBC Signal.
  * @param format Frame format (std/ext)
  * @param msg_id Message identifier
@@ -1803,8 +1830,282 @@ bool dbcfile::IsLocked() const
  */
 void dbcfile::DecodeSignal(CAN_frame_format_t format, uint32_t msg_id, const uint8_t* msg, uint8_t size, OvmsWriter* writer) const
   {
+  OvmsRecMutexLock lock(&m_mutex);
+  if (m_compiled && writer == nullptr)
+    {
+    // Fast path: use the precompiled plans
+    const dbcMessagePlan_t* plan = FindPlan(format, msg_id);
+    if (plan == NULL)
+      return;
+    const dbcSignalPlan_t* plans = &m_plan_signals[plan->first];
+    dbcFrameWords_t words;
+    LoadFrameWords(&words, msg, size);
+    for (int i = 0; i < plan->count; i++)
+      {
+      dbcMetric* m = plans[i].signal->GetMetric();
+      if (m == NULL)
+        continue;
+      dbcNumber value;
+      if (plans[i].flags & DBC_PLAN_SWITCH)
+        {
+        if (!DecodePlanMux(plans, i, &words, &value, 0))
+          continue;
+        }
+      else
+        {
+        value = DecodePlan(&plans[i], &words);
+        }
+      dbc_store_signal(plans[i].signal, m, value);
+      }
+    return;
+    }
+
   // Find the default signal
   dbcMessage* dbcmsg = m_messages.FindMessage(format, msg_id);
   if (dbcmsg)
     dbcmsg->DecodeSignal(msg, size, writer);
   }
+
+// Precompiled decoder plans
+//
+// Compile() flattens the message table into arrays of per signal extraction
+// plans (shift/mask on a 64 bit frame word, precomputed scaling flags) and
+// builds a dense dispatch table for standard IDs plus a sorted table for
+// extended IDs, so the CAN RX path does neither map lookups nor bit loops.
+// Plans reference the message & signal objects, they need to be rebuilt
+// (Recompile) if the message table gets modified. Compile() runs locked, and
+// editors hold the lock for the modification and the Recompile(), so
+// decoding never sees freed objects or partially built plans.
+
+#define DBC_PLAN_MAXDEPTH 8
+
+void dbcfile::Compile(bool force)
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  if (m_compiled && !force)
+    return;
+  FreePlans();
+
+  size_t nsignals = 0;
+  for (auto& e : m_messages.m_entrymap)
+    nsignals += e.second->m_signals.size();
+  if (nsignals > UINT16_MAX || m_messages.m_entrymap.size() > UINT16_MAX-1)
+    {
+    ESP_LOGW(TAG, "%s: too many signals to compile, using generic decoder", m_name.c_str());
+    return;
+    }
+  m_plan_signals.reserve(nsignals);
+  m_plan_messages.reserve(m_messages.m_entrymap.size());
+
+  for (auto& e : m_messages.m_entrymap)
+    {
+    dbcMessage* msg = e.second;
+    dbcMessagePlan_t mp;
+    mp.message = msg;
+    mp.first = m_plan_signals.size();
+    mp.count = msg->m_signals.size();
+    mp.multiplexed = false;
+
+    for (dbcSignal* sig : msg->m_signals)
+      {
+      dbcSignalPlan_t sp;
+      int start = sig->GetStartBit();
+      int size = sig->GetSignalSize();
+      sp.signal = sig;
+      sp.factor = sig->GetFactor();
+      sp.offset = sig->GetOffset();
+      sp.size = size;
+      sp.minsize = MIN((start+size+7) / 8, 255);
+      sp.shift = 0;
+      sp.flags = 0;
+      sp.muxsource = -1;
+      sp.mask = (size >= 64) ? UINT64_MAX : ((1ULL << size) - 1);
+
+      if (sig->GetByteOrder() == DBC_BYTEORDER_BIG_ENDIAN)
+        {
+        // Motorola: start bit is the MSB, the signal runs down into the following bytes
+        int msb = (7 - start/8) * 8 + (start % 8);
+        int lsb = msb - (size-1);
+        sp.flags |= DBC_PLAN_BIGENDIAN;
+        if (start < 0 || start > 63 || size < 1 || size > 64 || lsb < 0)
+          sp.flags |= DBC_PLAN_GENERIC;
+        else
+          sp.shift = lsb;
+        }
+      else
+        {
+        if (start < 0 || size < 1 || start+size > 64)
+          sp.flags |= DBC_PLAN_GENERIC;
+        else
+          sp.shift = start;
+        }
+
+      if (sig->GetValueType() == DBC_VALUETYPE_SIGNED)
+        sp.flags |= DBC_PLAN_SIGNED;
+      if (!(sp.factor == (uint32_t)1))
+        sp.flags |= DBC_PLAN_FACTOR;
+      if (!(sp.offset == (uint32_t)0))
+        sp.flags |= DBC_PLAN_OFFSET;
+      if (sig->IsMultiplexSwitch())
+        {
+        sp.flags |= DBC_PLAN_SWITCH;
+        mp.multiplexed = true;
+        }
+
+      m_plan_signals.push_back(sp);
+      }
+
+    // Resolve multiplex sources to plan indexes:
+    if (mp.multiplexed)
+      {
+      dbcSignal* defmux = msg->GetMultiplexorSignal();
+      dbcSignalPlan_t* plans = &m_plan_signals[mp.first];
+      for (int i = 0; i < mp.count; i++)
+        {
+        if (!(plans[i].flags & DBC_PLAN_SWITCH))
+          continue;
+        dbcSignal* src = plans[i].signal->GetMultiplexSource();
+        if (src == NULL)
+          src = defmux;
+        for (int j = 0; j < mp.count; j++)
+          {
+          if (plans[j].signal == src)
+            {
+            plans[i].muxsource = j;
+            break;
+            }
+          }
+        }
+      }
+
+    // Add to dispatch tables:
+    uint32_t id = e.first;
+    uint16_t index = m_plan_messages.size();
+    m_plan_messages.push_back(mp);
+    if (id <= 0x7FF)
+      {
+      if (m_plan_std.size() <= id)
+        m_plan_std.resize(id+1, 0);
+      m_plan_std[id] = index + 1;
+      }
+    else
+      {
+      // entry map is ordered by ID, so this stays sorted:
+      m_plan_ext.push_back(std::make_pair(id, index));
+      }
+    }
+
+  m_compiled = true;
+  ESP_LOGD(TAG, "%s: compiled %d messages, %d signals",
+    m_name.c_str(), (int)m_plan_messages.size(), (int)m_plan_signals.size());
+  }
+
+void dbcfile::Recompile()
+  {
+  OvmsRecMutexLock lock(&m_mutex);
+  if (m_compiled)
+    Compile(true);
+  }
+
+void dbcfile::FreePlans()
+  {
+  m_compiled = false;
+  std::vector<dbcSignalPlan_t>().swap(m_plan_signals);
+  std::vector<dbcMessagePlan_t>().swap(m_plan_messages);
+  std::vector<uint16_t>().swap(m_plan_std);
+  std::vector< std::pair<uint32_t,uint16_t> >().swap(m_plan_ext);
+  }
+
+bool dbcfile::IsCompiled() const
+  {
+  return m_compiled;
+  }
+
+const dbcMessagePlan_t* dbcfile::FindPlan(CAN_frame_format_t format, uint32_t msg_id) const
+  {
+  if (format == CAN_frame_ext)
+    msg_id |= 0x80000000;
+  else
+    msg_id &= 0x7FFFFFFF;
+
+  if (msg_id < m_plan_std.size())
+    {
+    uint16_t index = m_plan_std[msg_id];
+    return (index) ? &m_plan_messages[index-1] : NULL;
+    }
+
+  auto it = std::lower_bound(m_plan_ext.begin(), m_plan_ext.end(), msg_id,
+    [](const std::pair<uint32_t,uint16_t>& e, uint32_t id) { return e.first < id; });
+  if (it != m_plan_ext.end() && it->first == msg_id)
+    return &m_plan_messages[it->second];
+  return NULL;
+  }
+
+const dbcSignalPlan_t* dbcfile::GetSignalPlans(const dbcMessagePlan_t* plan) const
+  {
+  return &m_plan_signals[plan->first];
+  }
+
+void dbcfile::LoadFrameWords(dbcFrameWords_t* words, const uint8_t* msg, uint8_t size)
+  {
+  uint8_t data[8] = { 0 };
+  memcpy(data, msg, MIN(size, 8));
+  uint64_t le = 0;
+  for (int i = 7; i >= 0; i--)
+    le = (le << 8) | data[i];
+  words->data = msg;
+  words->le = le;
+  words->be = __builtin_bswap64(le);
+  words->size = size;
+  }
+
+dbcNumber dbcfile::DecodePlan(const dbcSignalPlan_t* sp, const dbcFrameWords_t* words)
+  {
+  if (sp->flags & DBC_PLAN_GENERIC)
+    return sp->signal->Decode(words->data, words->size);
+
+  if (words->size == 0)
+    return sp->offset;
+  if (sp->minsize > words->size)
+    return dbcNumber(); // empty value.
+
+  uint64_t val = (sp->flags & DBC_PLAN_BIGENDIAN) ? words->be : words->le;
+  val = (val >> sp->shift) & sp->mask;
+
+  dbcNumber result;
+  if (!(sp->flags & DBC_PLAN_SIGNED))
+    result.Cast((uint32_t)val, DBC_NUMBER_INTEGER_UNSIGNED);
+  else
+    {
+    int32_t signed_val = sign_extend<uint32_t, int32_t>((uint32_t)val, sp->size-1);
+    result.Cast(static_cast<uint32_t>(signed_val), DBC_NUMBER_INTEGER_SIGNED);
+    }
+
+  if (sp->flags & DBC_PLAN_FACTOR)
+    result = (result * sp->factor);
+  if (sp->flags & DBC_PLAN_OFFSET)
+    result = (result + sp->offset);
+
+  return result;
+  }
+
+/** Decode a multiplexed signal plan.
+ * @return true if the signal is active (all multiplex sources match)
+ */
+bool dbcfile::DecodePlanMux(const dbcSignalPlan_t* plans, int index, const dbcFrameWords_t* words,
+                            dbcNumber* value, int depth)
+  {
+  const dbcSignalPlan_t* sp = &plans[index];
+  if (sp->flags & DBC_PLAN_SWITCH)
+    {
+    if (sp->muxsource < 0 || depth >= DBC_PLAN_MAXDEPTH)
+      return false;
+    dbcNumber muxval;
+    if (!DecodePlanMux(plans, sp->muxsource, words, &muxval, depth+1))
+      return false;
+    if (!sp->signal->IsMultiplexSwitchvalue(muxval.GetUnsignedInteger()))
+      return false;
+    }
+  *value = DecodePlan(sp, words);
+  return true;
+  }
@@ -34,11 +34,13 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
 #include <functional>
 #include <iostream>
 #include "dbc_number.h"
 #include "can.h"
 #include "ovms_metrics.h"
+#include "ovms_mutex.h"
 
 #define DBC_MAX_LINELENGTH 2048
 
@@ -459,6 +461,44 @@ class dbcMessageTable
     dbcMessageEntry_t m_entrymap;
   };
 
+// Precompiled decoder plans (see dbcfile::Compile)
+
+#define DBC_PLAN_BIGENDIAN    0x01    // Motorola byte order
+#define DBC_PLAN_SIGNED       0x02    // Signed value type
+#define DBC_PLAN_FACTOR       0x04    // Factor != 1
+#define DBC_PLAN_OFFSET       0x08    // Offset != 0
+#define DBC_PLAN_SWITCH       0x10    // Multiplexed, needs active multiplex source
+#define DBC_PLAN_GENERIC      0x20    // Not representable, use dbcSignal::Decode()
+
+struct dbcFrameWords_t
+  {
+  const uint8_t* data;                // Frame data
+  uint64_t le;                        // Frame data as little endian word
+  uint64_t be;                        // Frame data as big endian word
+  uint8_t size;                       // Frame data length
+  };
+
+struct dbcSignalPlan_t
+  {
+  dbcSignal* signal;
+  uint64_t mask;                      // Value mask (after shift)
+  dbcNumber factor;
+  dbcNumber offset;
+  uint8_t shift;                      // Signal LSB position in frame word
+  uint8_t size;                       // Signal size in bits
+  uint8_t minsize;                    // Min frame data length needed
+  uint8_t flags;                      // DBC_PLAN_*
+  int16_t muxsource;                  // Plan index of multiplex source, -1 = none
+  };
+
+struct dbcMessagePlan_t
+  {
+  dbcMessage* message;
+  uint16_t first;                     // First signal plan index
+  uint16_t count;                     // Number of signal plans
+  bool multiplexed;
+  };
+
 class dbcfile
   {
   public:
@@ -482,8 +522,25 @@ class dbcfile
     void LockFile();
     void UnlockFile();
     bool IsLocked() const;
+    void Lock() const;
+    void Unlock() const;
 
     void DecodeSignal(CAN_frame_format_t format, uint32_t msg_id, const uint8_t* msg, uint8_t size, OvmsWriter* writer = nullptr) const;
+
+  public:
+    void Compile(bool force=false);
+    void Recompile();
+    void FreePlans();
+    bool IsCompiled() const;
+    const dbcMessagePlan_t* FindPlan(CAN_frame_format_t format, uint32_t msg_id) const;
+    const dbcSignalPlan_t* GetSignalPlans(const dbcMessagePlan_t* plan) const;
+    static void LoadFrameWords(dbcFrameWords_t* words, const uint8_t* msg, uint8_t size);
+    static dbcNumber DecodePlan(const dbcSignalPlan_t* sp, const dbcFrameWords_t* words);
+
+  private:
+    static bool DecodePlanMux(const dbcSignalPlan_t* plans, int index, const dbcFrameWords_t* words,
+                              dbcNumber* value, int depth);
+
   public:
     std::string m_name;
     std::string m_path;
@@ -498,6 +555,24 @@ class dbcfile
   private:
     dbcMessage* m_lastmsg;
     int m_locks;
+    mutable OvmsRecMutex m_mutex;
+
+  private:
+    bool m_compiled;
+    std::vector<dbcSignalPlan_t> m_plan_signals;
+    std::vector<dbcMessagePlan_t> m_plan_messages;
+    std::vector<uint16_t> m_plan_std;   // Standard ID → message plan index + 1 (0 = none)
+    std::vector< std::pair<uint32_t,uint16_t> > m_plan_ext; // Sorted extended ID → plan index
+  };
+
+class dbcfileLock
+  {
+  public:
+    dbcfileLock(const dbcfile* dbcfile) : m_dbcfile(dbcfile) { m_dbcfile->Lock(); }
+    ~dbcfileLock() { m_dbcfile->Unlock(); }
+
+  protected:
+    const dbcfile* m_dbcfile;
   };
 
 #endif //#ifndef __DBC_H__
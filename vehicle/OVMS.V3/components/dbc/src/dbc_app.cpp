@@ -42,6 +42,8 @@ static const char *TAG = "dbc-app";
 #include "ovms_config.h"
 #include "ovms_events.h"
 #include "ovms_vfs.h"
+#include "canformat_crtd.h"
+#include "esp_timer.h"
 
 dbc MyDBC __attribute__ ((init_priority (4520)));
 
@@ -125,6 +127,17 @@ static int dbc_load_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, con
   return -1;
   }
 
+static int dbc_test_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv, bool complete)
+  {
+  if (argc == 1)
+    return MyDBC.ExpandComplete(writer, argv[0], complete) ? argc : -1;
+  if (argc == 2)
+    return vfs_expand(writer, argv[1], complete, false, true) ? argc : -1;
+  if (argc == 3)
+    return argc;
+  return -1;
+  }
+
 void dbc_unload(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   if (MyDBC.Unload(argv[0]))
@@ -364,8 +377,10 @@ void dbc_message_clear(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   MyDBC.m_selected->m_messages.EmptyContent();
+  MyDBC.m_selected->Recompile();
   writer->puts("DBC: Message table cleared");
   }
 
@@ -376,6 +391,7 @@ void dbc_message_add(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int ar
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   if (MyDBC.m_selected->m_messages.FindMessage(msgid))
@@ -389,6 +405,7 @@ void dbc_message_add(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int ar
   msg->SetSize(atoi(argv[2]));
   msg->SetTransmitterNode(argv[3]);
   MyDBC.m_selected->m_messages.AddMessage(msgid,msg);
+  MyDBC.m_selected->Recompile();
   writer->printf("DBC: Added message %s\n",argv[0]);
   }
 
@@ -399,12 +416,14 @@ void dbc_message_remove(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
   if (msg != NULL)
     {
     MyDBC.m_selected->m_messages.RemoveMessage(msg->GetID(),true);
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Message %s removed\n",argv[0]);
     }
   else
@@ -420,6 +439,7 @@ void dbc_message_set_mux(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, in
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
@@ -432,6 +452,7 @@ void dbc_message_set_mux(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, in
   if (argc == 1)
     {
     msg->SetMultiplexorSignal(NULL);
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Cleared mux for %s\n",argv[0]);
     return;
     }
@@ -444,6 +465,7 @@ void dbc_message_set_mux(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, in
     }
 
   msg->SetMultiplexorSignal(signal);
+  MyDBC.m_selected->Recompile();
   writer->printf("DBC: Set mux for message %s to %s\n",argv[0],argv[1]);
   }
 
@@ -454,6 +476,7 @@ void dbc_signal_clear(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
@@ -466,6 +489,7 @@ void dbc_signal_clear(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
     {
     msg->RemoveAllSignals(true);
     msg->SetMultiplexorSignal(NULL);
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Cleared all signals for %s\n",argv[0]);
     }
   }
@@ -477,6 +501,7 @@ void dbc_signal_add(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int arg
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
@@ -505,6 +530,7 @@ void dbc_signal_add(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int arg
   signal->SetUnit(argv[10]);
   signal->AddReceiver(argv[11]);
   msg->AddSignal(signal);
+  MyDBC.m_selected->Recompile();
   writer->printf("DBC: Added signal %s on message %s\n",argv[1],argv[0]);
   }
 
@@ -515,6 +541,7 @@ void dbc_signal_remove(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
@@ -533,6 +560,7 @@ void dbc_signal_remove(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
   else
     {
     msg->RemoveSignal(signal, true);
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Removed signal %s on message %s\n",argv[1],argv[0]);
     }
   }
@@ -544,6 +572,7 @@ void dbc_signal_set_mux(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
@@ -563,11 +592,13 @@ void dbc_signal_set_mux(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
   if (argc > 2)
     {
     signal->SetMultiplexed(atoi(argv[2]));
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Set mux %s for signal %s on message %s\n",argv[2],argv[1],argv[0]);
     }
   else
     {
     signal->ClearMultiplexed();
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Cleared mux for signal %s on message %s\n",argv[1],argv[0]);
     }
   }
@@ -579,6 +610,7 @@ void dbc_signal_set_mux_ext(int verbosity, OvmsWriter* writer, OvmsCommand* cmd,
     writer->puts("Error: No DBC selected");
     return;
     }
+  dbcfileLock lock(MyDBC.m_selected);
 
   uint32_t msgid = dbcMessageIdFromString(argv[0]);
   dbcMessage* msg = MyDBC.m_selected->m_messages.FindMessage(msgid);
@@ -628,15 +660,140 @@ void dbc_signal_set_mux_ext(int verbosity, OvmsWriter* writer, OvmsCommand* cmd,
           }
         }
     }
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Set mux %s for signal %s on message %s\n",argv[2],argv[1],argv[0]);
     }
   else
     {
     signal->ClearMultiplexed();
+    MyDBC.m_selected->Recompile();
     writer->printf("DBC: Cleared mux for signal %s on message %s\n",argv[1],argv[0]);
     }
   }
 
+void dbc_test(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  dbcfile* dbc = MyDBC.Find(argv[0]);
+  if (dbc == NULL)
+    {
+    writer->printf("Error: Could not find dbc file %s\n",argv[0]);
+    return;
+    }
+  if (MyConfig.ProtectedPath(argv[1]))
+    {
+    writer->puts("Error: protected path");
+    return;
+    }
+  int loops = (argc > 2) ? atoi(argv[2]) : 10;
+  if (loops < 1) loops = 1;
+
+  // Read received frames from the CRTD trace:
+  FILE* f = fopen(argv[1], "r");
+  if (f == NULL)
+    {
+    writer->printf("Error: Could not open %s\n",argv[1]);
+    return;
+    }
+  std::vector<CAN_frame_t, ExtRamAllocator<CAN_frame_t>> frames;
+  canformat_crtd crtd("crtd");
+  uint8_t buf[256];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+    uint8_t* b = buf;
+    bool hasmore = false;
+    while (len > 0 || hasmore)
+      {
+      CAN_log_message_t msg;
+      memset(&msg,0,sizeof(msg));
+      hasmore = false;
+      size_t used = crtd.put(&msg, b, len, &hasmore);
+      b += used;
+      len -= used;
+      if (msg.type == CAN_LogFrame_RX)
+        frames.push_back(msg.frame);
+      if (used == 0 && !hasmore)
+        break;
+      }
+    }
+  fclose(f);
+  if (frames.empty())
+    {
+    writer->puts("Error: No received frames found in trace");
+    return;
+    }
+
+  dbc->LockFile();
+  dbcfileLock lock(dbc);
+  dbc->Compile();
+
+  // Verify the compiled decoder against the generic one:
+  uint32_t matched = 0, signals = 0, mismatches = 0;
+  dbcFrameWords_t words;
+  for (const CAN_frame_t& frame : frames)
+    {
+    const dbcMessagePlan_t* plan = dbc->FindPlan(frame.FIR.B.FF, frame.MsgID);
+    if (plan == NULL) continue;
+    matched++;
+    const dbcSignalPlan_t* sp = dbc->GetSignalPlans(plan);
+    dbcfile::LoadFrameWords(&words, frame.data.u8, frame.FIR.B.DLC);
+    for (int i = 0; i < plan->count; i++)
+      {
+      dbcNumber v1 = sp[i].signal->Decode(frame.data.u8, frame.FIR.B.DLC);
+      dbcNumber v2 = dbcfile::DecodePlan(&sp[i], &words);
+      signals++;
+      if (v1.IsDefined() != v2.IsDefined() || v1.GetDouble() != v2.GetDouble())
+        {
+        if (mismatches++ < 5)
+          writer->printf("Mismatch: %s: %g != %g\n",
+            sp[i].signal->GetName().c_str(), v1.GetDouble(), v2.GetDouble());
+        }
+      }
+    }
+
+  // Generic decoder: message map lookup & bitwise extraction
+  double sum1 = 0;
+  int64_t started = esp_timer_get_time();
+  for (int loop = 0; loop < loops; loop++)
+    {
+    for (const CAN_frame_t& frame : frames)
+      {
+      dbcMessage* msg = dbc->m_messages.FindMessage(frame.FIR.B.FF, frame.MsgID);
+      if (msg == NULL) continue;
+      for (dbcSignal* sig : msg->m_signals)
+        sum1 += sig->Decode(frame.data.u8, frame.FIR.B.DLC).GetDouble();
+      }
+    }
+  int64_t elapsed1 = esp_timer_get_time() - started;
+
+  // Compiled decoder: ID dispatch table & shift/mask plans
+  double sum2 = 0;
+  started = esp_timer_get_time();
+  for (int loop = 0; loop < loops; loop++)
+    {
+    for (const CAN_frame_t& frame : frames)
+      {
+      const dbcMessagePlan_t* plan = dbc->FindPlan(frame.FIR.B.FF, frame.MsgID);
+      if (plan == NULL) continue;
+      const dbcSignalPlan_t* sp = dbc->GetSignalPlans(plan);
+      dbcfile::LoadFrameWords(&words, frame.data.u8, frame.FIR.B.DLC);
+      for (int i = 0; i < plan->count; i++)
+        sum2 += dbcfile::DecodePlan(&sp[i], &words).GetDouble();
+      }
+    }
+  int64_t elapsed2 = esp_timer_get_time() - started;
+
+  dbc->UnlockFile();
+  if (sum1 != sum2)
+    mismatches++;
+
+  uint32_t total = frames.size() * loops;
+  writer->printf("Trace: %u frames, %u matching DBC messages, %u signals/pass, %u mismatches\n",
+    (unsigned)frames.size(), matched, signals, mismatches);
+  writer->printf("Generic:  %" PRId64 " us, %.2f us/frame\n", elapsed1, (double)elapsed1 / total);
+  writer->printf("Compiled: %" PRId64 " us, %.2f us/frame\n", elapsed2, (double)elapsed2 / total);
+  }
+
 dbc::dbc()
   {
   ESP_LOGI(TAG, "Initialising DBC (4520)");
@@ -677,6 +834,13 @@ dbc::dbc()
   cmd_clear->RegisterCommand("message", "Clear all messages for selected DBC file", dbc_message_clear);
   cmd_clear->RegisterCommand("signal", "Clear all signals for selected DBC file", dbc_signal_clear, "<id>", 1, 1);
 
+  OvmsCommand* cmd_test = MyCommandApp.RegisterCommand("test","Test framework");
+  cmd_test->RegisterCommand("dbc", "Test DBC decoding of a CRTD trace", dbc_test,
+    "<name> <crtdfile> [<loops>]\n"
+    "Decodes all signals of the received frames in the trace using the generic\n"
+    "and the compiled decoder, counts differing values and reports the timings.\n"
+    "<loops> defaults to 10.", 2, 3, true, dbc_test_validate);
+
   MyConfig.RegisterParam("dbc", "DBC Configuration", true, true);
   // Our instances:
   //   'autodirs': Space separated list of directories to auto load DBC files from
@@ -173,7 +173,8 @@ obd2ecu::obd2ecu(const char* name, canbus* can)
 
   xTaskCreatePinnedToCore(OBD2ECU_task, "OVMS OBDII ECU", 6144, (void*)this, 5, &m_task, CORE(1));
 
-  MyCan.RegisterCallback(GetName(), std::bind(&obd2ecu::ECURxCallback, this, _1, _2));
+  MyCan.RegisterCallback(GetName(), std::bind(&obd2ecu::ECURxCallback, this, _1, _2), false,
+    std::to_string(m_can->m_busnumber+1).c_str());
   NotifyStartup();
   }
 
@@ -43,6 +43,7 @@ OvmsBuffer::OvmsBuffer(size_t size, void* userdata)
   m_tail = 0;
   m_size = size;
   m_used = 0;
+  m_scanned = 0;
   m_userdata = userdata;
   }
 
@@ -71,6 +72,7 @@ void OvmsBuffer::EmptyAll()
   m_head = 0;
   m_tail = 0;
   m_used = 0;
+  m_scanned = 0;
   }
 
 bool OvmsBuffer::Push(uint8_t byte)
@@ -88,13 +90,14 @@ bool OvmsBuffer::Push(uint8_t *byte, size_t count)
   {
   if ((m_size-m_used)<count) return false;
 
+  // Copy in up to two segments: head to end of buffer, then from start
+  size_t first = m_size - m_head;
+  if (first > count) first = count;
+  memcpy(m_buffer+m_head, byte, first);
+  memcpy(m_buffer, byte+first, count-first);
+  m_head += count;
+  if (m_head >= m_size) m_head -= m_size;
   m_used += count;
-  for (size_t k=0;k<count;k++)
-    {
-    // ESP_LOGI(TAG, "Push() %02x at %d",byte[k],m_head);
-    m_buffer[m_head++] = byte[k];
-    if (m_head >= m_size) m_head=0;
-    }
 
   return true;
   }
@@ -106,21 +109,15 @@ uint8_t OvmsBuffer::Pop()
   m_used--;
   uint8_t result = m_buffer[m_tail++];
   if (m_tail >= m_size) m_tail=0;
+  if (m_scanned > 0) m_scanned--;
 
   return result;
   }
 
 size_t OvmsBuffer::Pop(size_t count, uint8_t *dest)
   {
-  size_t done = 0;
-
-  while ((m_used>0)&&(done < count))
-    {
-    m_used--;
-    dest[done++] = m_buffer[m_tail++];
-    if (m_tail >= m_size) m_tail=0;
-    }
-
+  size_t done = Peek(count, dest);
+  Consume(done);
   return done;
   }
 
@@ -133,16 +130,54 @@ uint8_t OvmsBuffer::Peek()
 
 size_t OvmsBuffer::Peek(size_t count, uint8_t *dest)
   {
-  size_t done = 0;
+  if (count > m_used) count = m_used;
 
-  size_t tail = m_tail;
-  while ((done<m_used)&&(done<count))
-    {
-    dest[done++] = m_buffer[tail++];
-    if (tail >= m_size) tail=0;
-    }
+  size_t first = m_size - m_tail;
+  if (first > count) first = count;
+  memcpy(dest, m_buffer+m_tail, first);
+  memcpy(dest+first, m_buffer, count-first);
 
-  return done;
+  return count;
+  }
+
+/**
+ * ReadSpan: get the contiguous readable part at the tail.
+ *  The data stays in the buffer until released by Consume().
+ */
+size_t OvmsBuffer::ReadSpan(uint8_t **data)
+  {
+  *data = m_buffer+m_tail;
+  size_t span = m_size - m_tail;
+  return (span < m_used) ? span : m_used;
+  }
+
+void OvmsBuffer::Consume(size_t count)
+  {
+  if (count > m_used) count = m_used;
+  m_tail += count;
+  if (m_tail >= m_size) m_tail -= m_size;
+  m_used -= count;
+  m_scanned = (m_scanned > count) ? m_scanned - count : 0;
+  }
+
+/**
+ * WriteSpan: get the contiguous free part at the head.
+ *  Data written there becomes readable by Commit().
+ */
+size_t OvmsBuffer::WriteSpan(uint8_t **data)
+  {
+  *data = m_buffer+m_head;
+  size_t span = m_size - m_head;
+  size_t free = m_size - m_used;
+  return (span < free) ? span : free;
+  }
+
+void OvmsBuffer::Commit(size_t count)
+  {
+  if (count > m_size - m_used) count = m_size - m_used;
+  m_head += count;
+  if (m_head >= m_size) m_head -= m_size;
+  m_used += count;
   }
 
 void OvmsBuffer::Diagnostics()
@@ -154,24 +189,27 @@ void OvmsBuffer::Diagnostics()
 
 int OvmsBuffer::HasLine()
   {
-  size_t tail = m_tail;
-
   if (m_used==0) return -1;
 
-  // ESP_LOGI(TAG, "HasLine() with tail at %d (%d used)",m_tail,m_used);
-  for (size_t done=0;done<m_used;done++)
+  // Continue the scan where the last call stopped, in up to two segments:
+  while (m_scanned < m_used)
     {
-    // ESP_LOGI(TAG, "HasLine() at tail %d is %02x (%d done)",tail,m_buffer[tail],done);
-    if ((m_buffer[tail]=='\r')||(m_buffer[tail]=='\n'))
+    size_t pos = m_tail + m_scanned;
+    if (pos >= m_size) pos -= m_size;
+    size_t len = m_size - pos;
+    if (len > m_used - m_scanned) len = m_used - m_scanned;
+    const uint8_t* p = m_buffer+pos;
+    for (size_t k=0;k<len;k++)
       {
-      // ESP_LOGI(TAG, "HasLine() found a CR/LF at tail %d (done=%d)",tail,done);
-      return done;
+      if ((p[k]=='\r')||(p[k]=='\n'))
+        {
+        m_scanned += k;
+        return m_scanned;
+        }
       }
-    tail++;
-    if (tail >= m_size) tail=0;
+    m_scanned += len;
     }
 
-  // ESP_LOGI(TAG, "HasLine() didnt find a CR/LF");
   return -1;
   }
 
@@ -180,13 +218,14 @@ std::string OvmsBuffer::ReadLine()
   int hl = HasLine();
   if (hl<0) return std::string("");
 
-  uint8_t result[hl+1];
-  Pop(hl, result);
+  std::string result;
+  result.resize(hl);
+  Pop(hl, (uint8_t*)&result[0]);
 
   if (Peek() == '\r') Pop();
   if (Peek() == '\n') Pop();
 
-  return std::string((char*)result,hl);
+  return result;
   }
 
 int OvmsBuffer::PollSocket(int sock, long timeoutms)
@@ -207,23 +246,30 @@ int OvmsBuffer::PollSocket(int sock, long timeoutms)
   // ESP_LOGI(TAG, "Polling Socket select result %d",result);
   if (result <= 0) return -1;
 
-  // We have some data ready to read
-  size_t avail = FreeSpace();
+  // We have some data ready to read, read it directly into the ring:
+  uint8_t *buf;
+  size_t avail = WriteSpan(&buf);
   if (avail==0) return 0;
-  // ESP_LOGI(TAG,"Polling Socket allocating %d bytes",avail);
-  uint8_t *buf = new uint8_t[avail];
-  size_t n = read(sock, buf, avail);
+  int n = read(sock, buf, avail);
   // ESP_LOGI(TAG,"Polling Socket read %d bytes",n);
-  // MyCommandApp.HexDump(TAG, "PollSocket", (const char*)buf, n);
   if (n == 0)
     {
     n = -1;
     }
   else if (n > 0)
     {
-    Push(buf,n);
+    Commit(n);
+    if (((size_t)n == avail) && ((avail = WriteSpan(&buf)) > 0))
+      {
+      // Wrapped, fetch what is already available into the start of the ring:
+      int n2 = recv(sock, buf, avail, MSG_DONTWAIT);
+      if (n2 > 0)
+        {
+        Commit(n2);
+        n += n2;
+        }
+      }
     }
-  delete [] buf;
   return n;
   }
 
@@ -55,6 +55,12 @@ class OvmsBuffer
     size_t Peek(size_t count, uint8_t *dest);
     void Diagnostics();
 
+  public: // Zero copy access to the contiguous parts of the ring
+    size_t ReadSpan(uint8_t **data);
+    void Consume(size_t count);
+    size_t WriteSpan(uint8_t **data);
+    void Commit(size_t count);
+
   public:
     int HasLine();
     std::string ReadLine();
@@ -71,6 +77,7 @@ class OvmsBuffer
     int m_tail;
     size_t m_size;
     size_t m_used;
+    size_t m_scanned;             // Bytes from tail known to contain no CR/LF
   };
 
 #endif //#ifndef __OVMS_BUFFER_H__
@@ -32,8 +32,13 @@
 static const char *TAG = "gsm-mux";
 
 #include <string.h>
+#include "freertos/FreeRTOS.h"
 #include "gsmmux.h"
 #include "ovms_cellular.h"
+#include "esp_timer.h"
+
+// Serializes TX statistics updates from tx() callers & the modem RX task:
+static portMUX_TYPE gsmmux_txstats_spinlock = portMUX_INITIALIZER_UNLOCKED;
 
 #define GSM_CR         0x02
 #define GSM_EA         0x01
@@ -127,10 +132,32 @@ GsmMuxChannel::GsmMuxChannel(GsmMux* mux, int channel, size_t buffersize)
   m_state = ChanClosed;
   m_mux = mux;
   m_channel = channel;
+  m_txbuf = new uint8_t[GSM_MUX_TXBUF_INITIAL];
+  m_txbufsize = GSM_MUX_TXBUF_INITIAL;
   }
 
 GsmMuxChannel::~GsmMuxChannel()
   {
+  delete [] m_txbuf;
+  }
+
+/**
+ * GetTxBuffer: get the channel TX frame buffer with at least the given size.
+ *  The buffer is kept for the channel lifetime and only grows, so frames
+ *  are normally built without allocation. Call with m_txmutex held.
+ */
+uint8_t* GsmMuxChannel::GetTxBuffer(size_t size)
+  {
+  if (size > m_txbufsize)
+    {
+    delete [] m_txbuf;
+    m_txbufsize = (size + 127) & ~127;
+    m_txbuf = new uint8_t[m_txbufsize];
+    portENTER_CRITICAL(&gsmmux_txstats_spinlock);
+    m_mux->m_txbufgrow++;
+    portEXIT_CRITICAL(&gsmmux_txstats_spinlock);
+    }
+  return m_txbuf;
   }
 
 void GsmMuxChannel::ProcessFrame(uint8_t* frame, size_t length, size_t iframepos)
@@ -158,8 +185,9 @@ void GsmMuxChannel::ProcessFrame(uint8_t* frame, size_t length, size_t iframepos
       // GSM_UIH alone set for CGNSSINFO response
       if (frame[1] == (GSM_UIH + GSM_PF) || frame[1] == GSM_UIH )  
         {
-        for (size_t k=iframepos;k<length;k++)
-          m_buffer.Push(frame[k]);
+        size_t len = length-iframepos;
+        if (len > m_buffer.FreeSpace()) len = m_buffer.FreeSpace();
+        m_buffer.Push(frame+iframepos, len);
         m_mux->m_modem->IncomingMuxData(this);
         }
       break;
@@ -186,6 +214,14 @@ GsmMux::GsmMux(modem* m, int channelcount, size_t maxframesize)
   m_lastgoodrxframe = 0;
   m_rxframecount = 0;
   m_txframecount = 0;
+  m_rxbytes = 0;
+  m_txbytes = 0;
+  m_rxskipped = 0;
+  m_rxtime = 0;
+  m_rxtime_max = 0;
+  m_txtime = 0;
+  m_txtime_max = 0;
+  m_txbufgrow = 0;
   }
 
 GsmMux::~GsmMux()
@@ -201,28 +237,44 @@ void GsmMux::Startup()
   m_lastgoodrxframe = 0;
   m_rxframecount = 0;
   m_txframecount = 0;
+  m_rxbytes = 0;
+  m_txbytes = 0;
+  m_rxskipped = 0;
+  m_rxtime = 0;
+  m_rxtime_max = 0;
+  m_txtime = 0;
+  m_txtime_max = 0;
+  m_txbufgrow = 0;
+  m_channelmutex.Lock();
   m_channels.insert(m_channels.end(),new GsmMuxChannel(this,0,8));
   for (int k=1; k<=m_channelcount; k++)
     {
     m_channels.insert(m_channels.end(),
       new GsmMuxChannel(this,k,CONFIG_OVMS_HW_CELLULAR_MODEM_MUXCHANNEL_SIZE));
     }
+  m_channelmutex.Unlock();
   StartChannel(0);
   m_state = DlciOpening;
   }
 
 void GsmMux::Shutdown()
   {
+  m_channelmutex.Lock();
   if (m_channels.size() > 0)
     {
     ESP_LOGI(TAG, "Stop MUX");
     for (int k=0; k<m_channels.size(); k++)
       {
       GsmMuxChannel* chan = m_channels[k];
-      if (chan) delete chan;
+      if (!chan) continue;
+      // Wait for a tx() in progress on the channel to finish:
+      chan->m_txmutex.Lock();
+      chan->m_txmutex.Unlock();
+      delete chan;
       }
     m_channels.clear();
     }
+  m_channelmutex.Unlock();
   m_state = DlciClosed;
   m_framepos = 0;
   m_frameipos = 0;
@@ -233,6 +285,14 @@ void GsmMux::Shutdown()
   m_lastgoodrxframe = 0;
   m_rxframecount = 0;
   m_txframecount = 0;
+  m_rxbytes = 0;
+  m_txbytes = 0;
+  m_rxskipped = 0;
+  m_rxtime = 0;
+  m_rxtime_max = 0;
+  m_txtime = 0;
+  m_txtime_max = 0;
+  m_txbufgrow = 0;
   }
 
 void GsmMux::StartChannel(int channel)
@@ -275,54 +335,104 @@ uint32_t GsmMux::GoodFrameAge()
 
 void GsmMux::Process(OvmsBuffer* buf)
   {
-  while (buf->UsedSpace()>0)
+  int64_t started = esp_timer_get_time();
+  uint8_t* data;
+  size_t len;
+  while ((len = buf->ReadSpan(&data)) > 0)
     {
-    if (m_framepos == m_framesize)
+    m_rxbytes += len;
+    ProcessSpan(data, len);
+    buf->Consume(len);
+    }
+  uint32_t elapsed = esp_timer_get_time() - started;
+  m_rxtime += elapsed;
+  if (elapsed > m_rxtime_max) m_rxtime_max = elapsed;
+  }
+
+void GsmMux::ResetFrame()
+  {
+  m_framepos = 0;
+  m_frameipos = 0;
+  m_framelen = 0;
+  m_framemorelen = false;
+  }
+
+/**
+ * ProcessSpan: frame parser working on a contiguous span of received data.
+ *  Frame starts are located with memchr(), the header is parsed byte wise,
+ *  the frame body (information field, FCS & EOF) is copied in one block.
+ */
+size_t GsmMux::ProcessSpan(const uint8_t* data, size_t len)
+  {
+  const uint8_t* p = data;
+  const uint8_t* end = data + len;
+
+  while (p < end)
+    {
+    if (m_framepos == 0)
       {
-      // Overflow frame
-      ESP_LOGW(TAG, "Frame overflow (%d bytes)",m_framesize);
-      MyCommandApp.HexDump(TAG, "Frame head", (const char*)m_frame, 8*16);
-      m_framepos = 0;
-      m_framelen = 0;
-      m_framemorelen = false;
-      m_framingerrors++;
+      // Skip to start of frame
+      const uint8_t* sof = (const uint8_t*)memchr(p, GSM0_SOF, end-p);
+      if (sof == NULL)
+        {
+        m_rxskipped += end-p;
+        break;
+        }
+      m_rxskipped += sof-p;
+      m_frame[m_framepos++] = GSM0_SOF;
+      p = sof+1;
       continue;
       }
-    uint8_t b = buf->Pop();
-    if ((m_framepos == 0)&&(b != GSM0_SOF))
-      {
-      continue; // Skip to start of frame
-      }
-    if ((m_framepos == 1)&&(b == GSM0_SOF)) continue; // We found end of previous frame, so just skip it
-    // ESP_LOGI(TAG, "Got %02x at %d (length sofar = %d)",b,m_framepos,m_framelen);
-    m_frame[m_framepos++] = b;
-    if (m_framepos == 4)
+
+    if ((m_framepos < 4) || (m_framemorelen))
       {
-      // First byte of length field
-      m_framemorelen = !(b & GSM_EA);
-      m_framelen = (b>>1);
-      if (!m_framemorelen)
+      // Header: address, control, length
+      uint8_t b = *p++;
+      if ((m_framepos == 1)&&(b == GSM0_SOF)) continue; // We found end of previous frame, so just skip it
+      m_frame[m_framepos++] = b;
+      if (m_framepos == 4)
         {
-        m_framelen += (m_framepos+2);
-        m_frameipos = m_framepos;
+        // First byte of length field
+        m_framemorelen = !(b & GSM_EA);
+        m_framelen = (b>>1);
+        if (!m_framemorelen)
+          {
+          m_framelen += (m_framepos+2);
+          m_frameipos = m_framepos;
+          }
+        else
+          {
+          m_framelen += (m_framepos+3);
+          m_frameipos = m_framepos+1;
+          }
         }
-      else
+      else if ((m_framepos == 5)&&(m_framemorelen))
         {
-        m_framelen += (m_framepos+3);
-        m_frameipos = m_framepos+1;
+        // Second byte of length field
+        m_framelen += (b<<7);
+        m_framemorelen = false;
         }
-      // ESP_LOGI(TAG, "Frame length (first byte) = %d",m_framelen);
-      }
-    if ((m_framepos == 5)&&(m_framemorelen))
-      {
-      // Second byte of length field
-      m_framelen += (b<<7);
-      m_framemorelen = false;
-      // ESP_LOGI(TAG, "Frame length (second byte) = %d",m_framelen);
+      if ((m_framepos >= 4)&&(!m_framemorelen)&&(m_framelen > m_framesize))
+        {
+        // Overflow frame
+        ESP_LOGW(TAG, "Frame overflow (%d bytes)",m_framelen);
+        MyCommandApp.HexDump(TAG, "Frame head", (const char*)m_frame, m_framepos);
+        ResetFrame();
+        m_framingerrors++;
+        }
+      continue;
       }
+
+    // Body: copy as much as available in one block
+    size_t need = m_framelen - m_framepos;
+    size_t take = ((size_t)(end-p) < need) ? (size_t)(end-p) : need;
+    memcpy(m_frame+m_framepos, p, take);
+    m_framepos += take;
+    p += take;
+
     if (m_framepos == m_framelen)
       {
-      if (b == GSM0_SOF)
+      if (m_frame[m_framelen-1] == GSM0_SOF)
         {
         // We have a complete frame...
         ProcessFrame();
@@ -335,13 +445,13 @@ void GsmMux::Process(OvmsBuffer* buf)
           channel, m_frame[1], m_frame[2], m_frame[m_framelen-2], m_framelen);
         MyCommandApp.HexDump(TAG, "Frame dump", (const char*)m_frame, m_framelen);
         // find next frame:
-        m_framepos = 0;
-        m_framelen = 0;
-        m_framemorelen = false;
+        ResetFrame();
         m_framingerrors++;
         }
       }
     }
+
+  return p - data;
   }
 
 void GsmMux::ProcessFrame()
@@ -355,15 +465,12 @@ void GsmMux::ProcessFrame()
   if (fcs != m_frame[m_framelen-2])
     {
     ESP_LOGW(TAG, "FCS mismatch (%02x != %02x)",fcs,m_frame[m_framelen-2]);
-    m_framepos = 0;
-    m_frameipos = 0;
-    m_framelen = 0;
+    ResetFrame();
     m_framingerrors++;
-    m_framemorelen = false;
     return;
     }
 
-  GsmMuxChannel* chan = m_channels[channel];
+  GsmMuxChannel* chan = (channel < m_channels.size()) ? m_channels[channel] : NULL;
   if (chan)
     {
     m_lastgoodrxframe = monotonictime;
@@ -375,22 +482,41 @@ void GsmMux::ProcessFrame()
     ESP_LOGW(TAG, "Incoming message for unrecognised channel #%d",channel);
     }
 
-  m_framepos = 0;
-  m_frameipos = 0;
-  m_framelen = 0;
-  m_framemorelen = false;
+  ResetFrame();
   }
 
 void GsmMux::txfcs(uint8_t* data, size_t size, size_t ipos)
   {
   data[size-2] = 0xFF - gsm_fcs_add_block(FCS_INIT, data+1, ipos-1);
   m_modem->tx(data,size);
+  portENTER_CRITICAL(&gsmmux_txstats_spinlock);
   m_txframecount++;
+  m_txbytes += size;
+  portEXIT_CRITICAL(&gsmmux_txstats_spinlock);
   }
 
+/**
+ * tx: send data as a UIH frame on a channel
+ *  May be called from other tasks (e.g. PPP/lwIP) concurrently to a
+ *  Shutdown(). The channel is looked up and its TX lock taken under
+ *  m_channelmutex, Shutdown() deletes channels only after taking their
+ *  TX locks, so the channel stays valid until the frame has been sent.
+ */
 size_t GsmMux::tx(int channel, uint8_t* data, ssize_t size)
   {
-  uint8_t* buf = new uint8_t[size+7];
+  int64_t started = esp_timer_get_time();
+  m_channelmutex.Lock();
+  GsmMuxChannel* chan = (channel < m_channels.size()) ? m_channels[channel] : NULL;
+  if (chan == NULL)
+    {
+    m_channelmutex.Unlock();
+    ESP_LOGW(TAG, "Transmit on unrecognised channel #%d", channel);
+    return 0;
+    }
+  chan->m_txmutex.Lock();
+  m_channelmutex.Unlock();
+
+  uint8_t* buf = chan->GetTxBuffer(size+7);
   size_t ipos;
   int len;
 
@@ -412,15 +538,17 @@ size_t GsmMux::tx(int channel, uint8_t* data, ssize_t size)
     buf[4] = (uint8_t)len; // Length: upper 7 bits
     ipos = 5;
     }
-  for (size_t k=0; k<size; k++)
-    {
-    buf[ipos+k] = data[k];
-    }
+  memcpy(buf+ipos, data, size);
   buf[ipos+size] = 0; // For FCS
   buf[ipos+size+1] = GSM0_SOF;
   txfcs(buf,ipos+size+2,ipos);
-  delete [] buf;
+  chan->m_txmutex.Unlock();
 
+  uint32_t elapsed = esp_timer_get_time() - started;
+  portENTER_CRITICAL(&gsmmux_txstats_spinlock);
+  m_txtime += elapsed;
+  if (elapsed > m_txtime_max) m_txtime_max = elapsed;
+  portEXIT_CRITICAL(&gsmmux_txstats_spinlock);
   return size;
   }
 
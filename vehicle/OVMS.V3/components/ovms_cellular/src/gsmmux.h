@@ -35,6 +35,9 @@
 #include <unistd.h>
 #include "ovms.h"
 #include "ovms_buffer.h"
+#include "ovms_mutex.h"
+
+#define GSM_MUX_TXBUF_INITIAL   (128+7)   // Initial channel TX frame buffer size, grows on demand
 
 class modem; // Forward declared
 class GsmMux; // Forward declared
@@ -56,12 +59,16 @@ class GsmMuxChannel : public InternalRamAllocated
 
   public:
     void ProcessFrame(uint8_t* frame, size_t length, size_t iframepos);
+    uint8_t* GetTxBuffer(size_t size);
 
   public:
     GsmMuxChannelState m_state;
     GsmMux* m_mux;
     int m_channel;
     OvmsBuffer m_buffer;
+    OvmsMutex m_txmutex;                // Protects the TX frame buffer
+    uint8_t* m_txbuf;
+    size_t m_txbufsize;
   };
 
 class GsmMux : public InternalRamAllocated
@@ -85,6 +92,8 @@ class GsmMux : public InternalRamAllocated
 
   protected:
     void txfcs(uint8_t* data, size_t size, size_t ipos = 4);
+    size_t ProcessSpan(const uint8_t* data, size_t len);
+    void ResetFrame();
 
   public:
     enum GsmMuxState
@@ -99,10 +108,20 @@ class GsmMux : public InternalRamAllocated
     GsmMuxState m_state;
     int m_channelcount;
     int m_openchannels;
+    // Statistics: RX counters are updated by the modem RX task only,
+    //  TX counters by any tx() caller, under a spinlock:
     uint32_t m_framingerrors;
     uint32_t m_lastgoodrxframe;
     uint32_t m_rxframecount;
     uint32_t m_txframecount;
+    uint64_t m_rxbytes;                 // Bytes received (incl. framing)
+    uint64_t m_txbytes;                 // Bytes transmitted (incl. framing)
+    uint32_t m_rxskipped;               // Bytes skipped outside of frames
+    uint64_t m_rxtime;                  // Time spent in Process() [us]
+    uint32_t m_rxtime_max;              // Max time of a Process() call [us]
+    uint64_t m_txtime;                  // Time spent in tx() [us]
+    uint32_t m_txtime_max;              // Max time of a tx() call [us]
+    uint32_t m_txbufgrow;               // TX frame buffer (re)allocations
 
   public:
     modem* m_modem;
@@ -113,6 +132,7 @@ class GsmMux : public InternalRamAllocated
     size_t m_framelen;
     bool m_framemorelen;
     std::vector<GsmMuxChannel*> m_channels;
+    OvmsMutex m_channelmutex;           // Protects m_channels against tx() from other tasks
   };
 
 #endif //#ifndef __GSM_MUX__
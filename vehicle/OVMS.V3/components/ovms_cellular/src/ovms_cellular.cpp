@@ -43,6 +43,7 @@ static const char *TAG = "cellular";
 #include "ovms_events.h"
 #include "ovms_notify.h"
 #include "ovms_boot.h"
+#include "esp_timer.h"
 #include "ovms_config.h"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -480,6 +481,14 @@ void modem::SupportSummary(OvmsWriter* writer, bool debug /*=FALSE*/)
       writer->printf("    RX frames: %" PRId32 "\n", m_mux->m_rxframecount);
       writer->printf("    TX frames: %" PRId32 "\n", m_mux->m_txframecount);
       writer->printf("    Last RX frame: %" PRId32 " sec(s) ago\n", m_mux->GoodFrameAge());
+      writer->printf("    RX: %" PRIu64 " bytes (%" PRIu32 " skipped), %.1f us/frame, max %" PRIu32 " us/call\n",
+        m_mux->m_rxbytes, m_mux->m_rxskipped,
+        m_mux->m_rxframecount ? (double)m_mux->m_rxtime / m_mux->m_rxframecount : 0.0,
+        m_mux->m_rxtime_max);
+      writer->printf("    TX: %" PRIu64 " bytes, %.1f us/frame, max %" PRIu32 " us, %" PRIu32 " buffer allocs\n",
+        m_mux->m_txbytes,
+        m_mux->m_txframecount ? (double)m_mux->m_txtime / m_mux->m_txframecount : 0.0,
+        m_mux->m_txtime_max, m_mux->m_txbufgrow);
       }
     }
   else
@@ -1634,11 +1643,12 @@ void modem::IncomingMuxData(GsmMuxChannel* channel)
     {
     if (m_state1 == NetMode)
       {
-      uint8_t buf[32];
+      uint8_t* data;
       size_t n;
-      while ((m_ppp != NULL)&&(n = channel->m_buffer.Pop(sizeof(buf),buf)) > 0)
+      while ((m_ppp != NULL)&&(n = channel->m_buffer.ReadSpan(&data)) > 0)
         {
-        m_ppp->IncomingData(buf,n);
+        m_ppp->IncomingData(data,n);
+        channel->m_buffer.Consume(n);
         }
       }
     else
@@ -2018,6 +2028,96 @@ void cellular_drivers(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
 ////////////////////////////////////////////////////////////////////////////////
 // Development assistance functions
 
+/**
+ * test buffer: feed modem traffic through an OvmsBuffer in UART sized chunks,
+ *  parsing lines like modem::StandardIncomingHandler()
+ */
+void cellular_test_buffer(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  std::vector<uint8_t, ExtRamAllocator<uint8_t>> traffic;
+  size_t chunk = (argc > 1) ? atoi(argv[1]) : 64;
+  if (chunk < 1) chunk = 1;
+  if (argc > 0 && strcmp(argv[0], "-") != 0)
+    {
+    // Recorded modem traffic:
+    if (MyConfig.ProtectedPath(argv[0]))
+      {
+      writer->puts("Error: protected path");
+      return;
+      }
+    FILE* f = fopen(argv[0], "r");
+    if (f == NULL)
+      {
+      writer->printf("Error: Could not open %s\n", argv[0]);
+      return;
+      }
+    uint8_t buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      traffic.insert(traffic.end(), buf, buf+n);
+    fclose(f);
+    }
+  else
+    {
+    // Synthetic traffic: AT responses, long operator lists and NMEA bursts
+    std::string t;
+    std::string cops = "+COPS: ";
+    for (int k=0;k<20;k++)
+      cops += "(2,\"Operator " + std::to_string(k) + "\",\"OP" + std::to_string(k) + "\",\"262" + std::to_string(10+k) + "\",7),";
+    cops += ",(0-4),(0-2)";
+    for (int k=0;k<50;k++)
+      {
+      t += "\r\n+CREG: 1,5\r\n\r\nOK\r\n";
+      t += "\r\n+CSQ: 21,99\r\n\r\nOK\r\n";
+      t += "\r\n" + cops + "\r\n\r\nOK\r\n";
+      for (int i=0;i<5;i++)
+        {
+        t += "$GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+        t += "$GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n";
+        t += "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n";
+        }
+      t += "\r\n+CGNSSINFO: 2,09,05,00,4807.038,N,01131.000,E,230394,123519.0,545.4,0.0,84.4,0.9,0.8,0.5\r\n";
+      }
+    traffic.assign(t.begin(), t.end());
+    }
+  if (traffic.empty())
+    {
+    writer->puts("Error: no traffic");
+    return;
+    }
+
+  size_t bufsize = CONFIG_OVMS_HW_CELLULAR_MODEM_BUFFER_SIZE;
+  uint32_t lines = 0, overflows = 0;
+  size_t linebytes = 0;
+  OvmsBuffer* buf = new OvmsBuffer(bufsize);
+  int64_t started = esp_timer_get_time();
+  for (size_t pos = 0; pos < traffic.size(); pos += chunk)
+    {
+    size_t len = std::min(chunk, traffic.size()-pos);
+    if (!buf->Push(traffic.data()+pos, len))
+      {
+      buf->EmptyAll();
+      overflows++;
+      continue;
+      }
+    while (buf->HasLine() >= 0)
+      {
+      std::string line = buf->ReadLine();
+      if (line.length() == 0) continue;
+      lines++;
+      linebytes += line.length();
+      }
+    }
+  int64_t elapsed = esp_timer_get_time() - started;
+  delete buf;
+
+  writer->printf("Traffic:    %u bytes, %u byte chunks, %u byte buffer\n",
+    (unsigned)traffic.size(), (unsigned)chunk, (unsigned)bufsize);
+  writer->printf("Lines:      %" PRIu32 " (%u bytes), %" PRIu32 " overflows\n",
+    lines, (unsigned)linebytes, overflows);
+  writer->printf("Time:       %" PRId64 " us, %.2f us/KB\n", elapsed, (double)elapsed * 1024 / traffic.size());
+  }
+
 void modem::DevelopmentHexDump(const char* prefix, const char* data, size_t length, size_t colsize /*=16*/)
   {
   char* buffer = NULL;
@@ -2067,6 +2167,11 @@ CellularModemInit::CellularModemInit()
   cmd_gps->RegisterCommand("start", "Start GPS/GNSS", modem_gps_start);
   cmd_gps->RegisterCommand("stop", "Stop GPS/GNSS", modem_gps_stop);
 
+  OvmsCommand* cmd_test = MyCommandApp.RegisterCommand("test","Test framework");
+  cmd_test->RegisterCommand("buffer","Test OvmsBuffer line parsing performance",cellular_test_buffer,
+    "[<trafficfile>|-] [<chunksize>]\n"
+    "Without a file, synthetic AT & NMEA traffic is used", 0, 2);
+
   MyConfig.RegisterParam("modem", "Modem Configuration", true, true);
   // Our instances:
   //   'driver': Driver to use (default: auto)
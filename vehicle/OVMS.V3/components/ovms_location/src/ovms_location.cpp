@@ -39,13 +39,25 @@ static const char *TAG = "location";
 #include "ovms_command.h"
 #include "vehicle.h"
 #include "metrics_standard.h"
+#include "ovms_vfs.h"
 #include <math.h>
+#include <inttypes.h>
+#include <algorithm>
+#include "esp_timer.h"
 
 const char *LOCATIONS_PARAM = "locations";
 #define LOCATION_DEFRADIUS 100
 
 #define LOCATION_R 6371
 #define LOCATION_TO_RAD (3.1415926536 / 180)
+#define LOCATION_M_PER_DEG (LOCATION_R * 1000 * LOCATION_TO_RAD)
+
+// Leave hysteresis: a location is left beyond radius + 10% (min 10 m):
+#define LOCATION_LEAVE_RADIUS(r) ((r) + std::max((r) / 10, 10))
+
+// Grid index cell size [°] and max cells per location:
+#define LOCATION_GRID_SIZE 0.05
+#define LOCATION_GRID_MAXCELLS 16
 
 // Calculate haversine distance in meters
 double OvmsLocationDistance(double th1, double ph1, double th2, double ph2)
@@ -132,58 +144,106 @@ ActionList::iterator ActionList::erase(iterator pos)
 OvmsLocation::OvmsLocation(const std::string& name)
   {
   m_name = name;
+  m_latitude = 0;
+  m_longitude = 0;
+  m_radius = LOCATION_DEFRADIUS;
   m_inlocation = false;
+  m_box_lat = 0;
+  m_box_lon = 0;
   }
 
 OvmsLocation::~OvmsLocation()
   {
   }
 
-bool OvmsLocation::IsInLocation(float latitude, float longitude)
+/**
+ * CheckPosition: check if the position is within the location
+ *  - a bounding box check avoids the haversine distance for most locations
+ *  - while in the location, the leave radius applies (hysteresis)
+ *  - distances: counter for the distance calculations done
+ */
+bool OvmsLocation::CheckPosition(float latitude, float longitude, uint32_t* distances)
   {
-  // This should check if we are in the location
+  if (fabsf(latitude - m_latitude) > m_box_lat || fabsf(longitude - m_longitude) > m_box_lon)
+    return false;
+  (*distances)++;
   double dist = OvmsLocationDistance((double)latitude,(double)longitude,(double)m_latitude,(double)m_longitude);
-  std::string event;
-
   // ESP_LOGI(TAG, "Location %s is %0.1fm distant",m_name.c_str(),dist);
+  return (fabs(dist) <= (m_inlocation ? LOCATION_LEAVE_RADIUS(m_radius) : m_radius));
+  }
 
-  if (fabs(dist) <= m_radius)
+void OvmsLocation::SetInLocation(bool inside)
+  {
+  if (inside == m_inlocation)
+    return;
+  m_inlocation = inside;
+  StandardMetrics.ms_v_pos_location->SetValue(inside ? m_name : std::string(""));
+  if (StandardMetrics.ms_v_env_on->AsBool())
     {
-    // We are in the location
-    if (!m_inlocation)
-      {
-      m_inlocation = true;
-      StandardMetrics.ms_v_pos_location->SetValue(m_name);
-      if (StandardMetrics.ms_v_env_on->AsBool())
-        {
-        event = std::string("location.enter.");
-        event.append(m_name);
-        MyEvents.SignalEvent(event.c_str(), (void*)m_name.c_str(), m_name.size()+1);
-        }
-      for (ActionList::iterator it = m_actions.begin(); it != m_actions.end(); ++it)
-        (*it)->Execute(true);
-      }
+    std::string event = inside ? "location.enter." : "location.leave.";
+    event.append(m_name);
+    MyEvents.SignalEvent(event.c_str(), (void*)m_name.c_str(), m_name.size()+1);
     }
+  for (ActionList::iterator it = m_actions.begin(); it != m_actions.end(); ++it)
+    (*it)->Execute(inside);
+  }
+
+/**
+ * UpdateBox: calculate the bounding box of the leave radius
+ */
+void OvmsLocation::UpdateBox()
+  {
+  float r = LOCATION_LEAVE_RADIUS(m_radius) * 1.01 + 1;
+  m_box_lat = r / LOCATION_M_PER_DEG;
+  // Use the latitude farthest from the equator for the longitude extent:
+  float c = cosf((fabsf(m_latitude) + m_box_lat) * LOCATION_TO_RAD);
+  if (c < 0.01)
+    m_box_lon = 360;
   else
+    m_box_lon = m_box_lat / c;
+  if (fabsf(m_longitude) + m_box_lon > 180)
+    m_box_lon = 360;
+  }
+
+void OvmsLocationIndex::Clear()
+  {
+  m_grid.clear();
+  m_large.clear();
+  }
+
+void OvmsLocationIndex::Build(const std::vector<OvmsLocation*>& locations)
+  {
+  Clear();
+  for (OvmsLocation* loc : locations)
     {
-    // We are out of the location
-    if (m_inlocation)
+    if (loc->m_box_lon >= 360)
       {
-      m_inlocation = false;
-      StandardMetrics.ms_v_pos_location->SetValue("");
-      if (StandardMetrics.ms_v_env_on->AsBool())
-        {
-        event = std::string("location.leave.");
-        event.append(m_name);
-        MyEvents.SignalEvent(event.c_str(), (void*)m_name.c_str(), m_name.size()+1);
-        }
-      for (ActionList::iterator it = m_actions.begin(); it != m_actions.end(); ++it)
-        (*it)->Execute(false);
+      m_large.push_back(loc);
+      continue;
+      }
+    int lat0 = floorf((loc->m_latitude - loc->m_box_lat + 90) / LOCATION_GRID_SIZE);
+    int lat1 = floorf((loc->m_latitude + loc->m_box_lat + 90) / LOCATION_GRID_SIZE);
+    int lon0 = floorf((loc->m_longitude - loc->m_box_lon + 180) / LOCATION_GRID_SIZE);
+    int lon1 = floorf((loc->m_longitude + loc->m_box_lon + 180) / LOCATION_GRID_SIZE);
+    if ((lat1 - lat0 + 1) * (lon1 - lon0 + 1) > LOCATION_GRID_MAXCELLS)
+      {
+      m_large.push_back(loc);
+      continue;
       }
+    for (int lat = lat0; lat <= lat1; lat++)
+      for (int lon = lon0; lon <= lon1; lon++)
+        m_grid[((uint32_t)lat << 16) | (uint32_t)lon].push_back(loc);
     }
+  }
 
-  // Return current status
-  return m_inlocation;
+void OvmsLocationIndex::Candidates(float latitude, float longitude, std::vector<OvmsLocation*>& result) const
+  {
+  int lat = floorf((latitude + 90) / LOCATION_GRID_SIZE);
+  int lon = floorf((longitude + 180) / LOCATION_GRID_SIZE);
+  auto k = m_grid.find(((uint32_t)lat << 16) | (uint32_t)lon);
+  if (k != m_grid.end())
+    result.insert(result.end(), k->second.begin(), k->second.end());
+  result.insert(result.end(), m_large.begin(), m_large.end());
   }
 
 bool OvmsLocation::Parse(const std::string& value)
@@ -528,6 +588,140 @@ void location_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int ar
     writer->puts("");
   else
     writer->puts("No active locations");
+
+  if (MyLocations.m_stat_fixes)
+    {
+    writer->printf("Index: %u grid cells, %u unindexed; per position: %.1f candidates, %.1f distance checks\n",
+      (unsigned)MyLocations.m_index.GetCellCount(), (unsigned)MyLocations.m_index.GetLargeCount(),
+      (float)MyLocations.m_stat_candidates / MyLocations.m_stat_fixes,
+      (float)MyLocations.m_stat_distances / MyLocations.m_stat_fixes);
+    }
+  }
+
+void location_test(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int count = (argc > 0) ? atoi(argv[0]) : 1000;
+  if (count <= 0) count = 1000;
+  float clat = MyLocations.m_latitude, clon = MyLocations.m_longitude;
+  if (clat == 0 && clon == 0)
+    {
+    clat = 52.52;
+    clon = 13.40;
+    }
+
+  // Random locations within ±0.5° of the center, radius 50…500 m:
+  uint32_t seed = 4711;
+  auto rnd = [&seed]() -> float
+    {
+    seed = seed * 1103515245 + 12345;
+    return (float)((seed >> 8) & 0xffff) / 65536.0f;
+    };
+  std::vector<OvmsLocation*> locations;
+  locations.reserve(count);
+  for (int i = 0; i < count; i++)
+    {
+    OvmsLocation* loc = new OvmsLocation("");
+    loc->m_latitude = clat + rnd() - 0.5f;
+    loc->m_longitude = clon + rnd() - 0.5f;
+    loc->m_radius = 50 + rnd() * 450;
+    loc->UpdateBox();
+    locations.push_back(loc);
+    }
+
+  // Track:
+  std::vector<std::pair<float,float>> track;
+  if (argc > 1)
+    {
+    if (MyConfig.ProtectedPath(argv[1]))
+      {
+      writer->puts("Error: protected path");
+      for (OvmsLocation* loc : locations) delete loc;
+      return;
+      }
+    FILE* f = fopen(argv[1], "r");
+    if (!f)
+      {
+      writer->printf("Error: can't open '%s'\n", argv[1]);
+      for (OvmsLocation* loc : locations) delete loc;
+      return;
+      }
+    char line[100];
+    float lat, lon;
+    while (fgets(line, sizeof(line), f))
+      {
+      if (sscanf(line, "%f , %f", &lat, &lon) == 2)
+        track.push_back(std::make_pair(lat, lon));
+      }
+    fclose(f);
+    }
+  else
+    {
+    // Random walk, ~20 m steps:
+    float lat = clat, lon = clon;
+    for (int i = 0; i < 5000; i++)
+      {
+      lat += (rnd() - 0.5f) * 0.0004f;
+      lon += (rnd() - 0.5f) * 0.0004f;
+      track.push_back(std::make_pair(lat, lon));
+      }
+    }
+
+  // Full scan:
+  uint32_t hits_scan = 0;
+  uint64_t start = esp_timer_get_time();
+  for (auto& pos : track)
+    {
+    for (OvmsLocation* loc : locations)
+      {
+      if (fabs(OvmsLocationDistance(pos.first, pos.second, loc->m_latitude, loc->m_longitude)) <= loc->m_radius)
+        hits_scan++;
+      }
+    }
+  uint64_t time_scan = esp_timer_get_time() - start;
+
+  // Index:
+  OvmsLocationIndex index;
+  start = esp_timer_get_time();
+  index.Build(locations);
+  uint64_t time_build = esp_timer_get_time() - start;
+
+  uint32_t hits_index = 0, candidates = 0, distances = 0;
+  std::vector<OvmsLocation*> result;
+  start = esp_timer_get_time();
+  for (auto& pos : track)
+    {
+    result.clear();
+    index.Candidates(pos.first, pos.second, result);
+    candidates += result.size();
+    for (OvmsLocation* loc : result)
+      {
+      if (loc->CheckPosition(pos.first, pos.second, &distances))
+        hits_index++;
+      }
+    }
+  uint64_t time_index = esp_timer_get_time() - start;
+
+  writer->printf("%d locations, %u positions, index: %u cells, %u unindexed, built in %" PRIu64 " us\n",
+    count, (unsigned)track.size(), (unsigned)index.GetCellCount(), (unsigned)index.GetLargeCount(), time_build);
+  if (!track.empty())
+    {
+    writer->printf("Full scan:  %10" PRIu64 " us = %8.1f us/position, %u hits\n",
+      time_scan, (double)time_scan / track.size(), hits_scan);
+    writer->printf("Index:      %10" PRIu64 " us = %8.1f us/position, %u hits, %.1f candidates & %.1f distances/position\n",
+      time_index, (double)time_index / track.size(), hits_index,
+      (double)candidates / track.size(), (double)distances / track.size());
+    }
+
+  for (OvmsLocation* loc : locations) delete loc;
+  }
+
+static int location_test_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv, bool complete)
+  {
+  if (argc == 1)
+    return argc;
+  if (argc == 2)
+    return vfs_expand(writer, argv[1], complete, false, true) ? argc : -1;
+  return -1;
   }
 
 int location_validate(OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv, bool complete)
@@ -705,6 +899,9 @@ OvmsLocations::OvmsLocations()
   m_valet_distance = 0;
   m_valet_invalid = true;
   m_valet_last_alarm = 0;
+  m_stat_fixes = 0;
+  m_stat_candidates = 0;
+  m_stat_distances = 0;
 
   // Register our commands
   OvmsCommand* cmd_location = MyCommandApp.RegisterCommand("location","LOCATION framework", location_status, "", 0, 0, false);
@@ -744,6 +941,13 @@ OvmsLocations::OvmsLocations()
   rm_leave_homelink->RegisterCommand("3","Remove Homelink 3 signal",location_homelink);
   cmd_rm_leave->RegisterCommand("notify","Remove text notification",location_notify,"[<text>]", 0, INT_MAX);
 
+  OvmsCommand* cmd_test = MyCommandApp.RegisterCommand("test","Test framework");
+  cmd_test->RegisterCommand("location","Test location index performance",location_test,
+    "[<count> [<trackfile>]]\n"
+    "Checks a GPS track against <count> (default 1000) random locations around the current position\n"
+    "by full scan and by spatial index. <trackfile>: text file with '<latitude>,<longitude>' lines,\n"
+    "default is a random track through the location area.", 0, 2, true, location_test_validate);
+
   // Register our parameters
   MyConfig.RegisterParam(LOCATIONS_PARAM, "Geo Locations", true, true);
 
@@ -863,6 +1067,8 @@ void OvmsLocations::ReloadMap()
   OvmsConfigParam* p = MyConfig.CachedParam(LOCATIONS_PARAM);
   if (p == NULL) return;
 
+  OvmsRecMutexLock lock(&m_locations_lock);
+
   // Forward search, updating existing locations
   for (ConfigParamMap::iterator it=p->m_map.begin(); it!=p->m_map.end(); ++it)
     {
@@ -888,6 +1094,7 @@ void OvmsLocations::ReloadMap()
     else
       {
       // ESP_LOGI(TAG, "Location %s is at %f,%f (%d)", name.c_str(), loc->m_latitude, loc->m_longitude, loc->m_radius);
+      loc->UpdateBox();
       }
     }
 
@@ -908,6 +1115,18 @@ void OvmsLocations::ReloadMap()
       }
     }
 
+  // Rebuild the spatial index & active location list:
+  std::vector<OvmsLocation*> locations;
+  locations.reserve(m_locations.size());
+  m_inside.clear();
+  for (LocationMap::iterator it=m_locations.begin(); it!=m_locations.end(); ++it)
+    {
+    locations.push_back(it->second);
+    if (it->second->m_inlocation)
+      m_inside.push_back(it->second);
+    }
+  m_index.Build(locations);
+
   if (m_gpsgood) UpdateLocations();
   }
 
@@ -915,10 +1134,35 @@ void OvmsLocations::UpdateLocations()
   {
   if ((m_latitude == 0) && (m_longitude == 0)) return;
 
-  for (LocationMap::iterator it=m_locations.begin(); it!=m_locations.end(); ++it)
+  OvmsRecMutexLock lock(&m_locations_lock);
+
+  // Check active locations for leaving first, so an entered location
+  // will be the final v.p.location value:
+  for (auto it = m_inside.begin(); it != m_inside.end(); )
     {
-    it->second->IsInLocation(m_latitude,m_longitude);
+    OvmsLocation* loc = *it;
+    if (loc->CheckPosition(m_latitude, m_longitude, &m_stat_distances))
+      {
+      ++it;
+      continue;
+      }
+    it = m_inside.erase(it);
+    loc->SetInLocation(false);
     }
+
+  // Only locations with a bounding box covering the position can be entered:
+  m_candidates.clear();
+  m_index.Candidates(m_latitude, m_longitude, m_candidates);
+  for (OvmsLocation* loc : m_candidates)
+    {
+    if (loc->m_inlocation || !loc->CheckPosition(m_latitude, m_longitude, &m_stat_distances))
+      continue;
+    m_inside.push_back(loc);
+    loc->SetInLocation(true);
+    }
+
+  m_stat_fixes++;
+  m_stat_candidates += m_candidates.size();
   }
 
 void OvmsLocations::CheckTheft()
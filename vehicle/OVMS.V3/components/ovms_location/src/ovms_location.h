@@ -31,9 +31,12 @@
 #ifndef __LOCATION_H__
 #define __LOCATION_H__
 
+#include <vector>
+#include <unordered_map>
 #include "ovms_metrics.h"
 #include "ovms_utils.h"
 #include "ovms_command.h"
+#include "ovms_mutex.h"
 
 enum LocationAction {
   INVALID = 0,
@@ -70,7 +73,9 @@ class OvmsLocation
     ~OvmsLocation();
 
   public:
-    bool IsInLocation(float latitude, float longitude);
+    bool CheckPosition(float latitude, float longitude, uint32_t* distances);
+    void SetInLocation(bool inside);
+    void UpdateBox();
     bool Parse(const std::string& value);
     void Store(std::string& buf);
     void Render(std::string& buf);
@@ -82,11 +87,33 @@ class OvmsLocation
     float m_longitude;
     int m_radius;
     bool m_inlocation;
+    float m_box_lat;            // Bounding box half height [°], covers the leave radius
+    float m_box_lon;            // Bounding box half width [°], 360 = no longitude check
     ActionList m_actions;
   };
 
 typedef NameMap<OvmsLocation*> LocationMap;
 
+/**
+ * OvmsLocationIndex: grid index of location bounding boxes
+ *  - a location is listed in every grid cell its bounding box overlaps,
+ *    locations covering too many cells (or the poles / the date line)
+ *    are checked on every position
+ */
+class OvmsLocationIndex
+  {
+  public:
+    void Build(const std::vector<OvmsLocation*>& locations);
+    void Clear();
+    void Candidates(float latitude, float longitude, std::vector<OvmsLocation*>& result) const;
+    size_t GetCellCount() const { return m_grid.size(); }
+    size_t GetLargeCount() const { return m_large.size(); }
+
+  protected:
+    std::unordered_map<uint32_t, std::vector<OvmsLocation*>> m_grid;
+    std::vector<OvmsLocation*> m_large;
+  };
+
 class OvmsLocations
   {
   public:
@@ -118,6 +145,13 @@ class OvmsLocations
     OvmsRecMutex m_valet_lock;
 
     LocationMap m_locations;
+    OvmsLocationIndex m_index;
+    std::vector<OvmsLocation*> m_inside;      // Locations with m_inlocation set
+    std::vector<OvmsLocation*> m_candidates;  // UpdateLocations() buffer
+    OvmsRecMutex m_locations_lock;
+    uint32_t m_stat_fixes;
+    uint32_t m_stat_candidates;
+    uint32_t m_stat_distances;
 
   public:
     void ReloadMap();
@@ -37,7 +37,10 @@ static const char *TAG = "script";
 #include <string.h>
 #include <stdio.h>
 #include <dirent.h>
+#include <ctype.h>
+#include <functional>
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
 #include "ovms_malloc.h"
 #include "ovms_module.h"
 #include "ovms_script.h"
@@ -80,6 +83,17 @@ static void script_meminfo(int verbosity, OvmsWriter* writer, OvmsCommand* cmd,
 
 OvmsScripts MyScripts __attribute__ ((init_priority (1600)));
 
+static void script_stats(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  if (argc > 0)
+    {
+    MyScripts.ResetStats();
+    writer->puts("Script statistics reset");
+    }
+  else
+    MyScripts.OutputStats(writer);
+  }
+
 static void script_ovms(int verbosity, OvmsWriter* writer,
   const char* spath, FILE* sf, bool secure=false)
   {
@@ -205,6 +219,87 @@ void OvmsScripts::AllScripts(std::string path)
     }
   }
 
+#define EVENTINDEX_STORE   0x01
+#define EVENTINDEX_SD      0x02
+
+static std::string eventindex_key(const char* name)
+  {
+  // FAT is case insensitive, so are the event directory names:
+  std::string key(name);
+  for (auto& c : key)
+    c = tolower((unsigned char)c);
+  return key;
+  }
+
+/**
+ * RebuildEventIndex: scan the event script root directories once and remember
+ *  which events have a script directory, so EventScript() does not need to
+ *  probe the file system for every event signalled.
+ */
+void OvmsScripts::RebuildEventIndex()
+  {
+  DIR *dir;
+  struct dirent *dp;
+  struct
+    {
+    const char* path;
+    uint8_t bit;
+    } roots[] =
+    {
+    { "/store/events", EVENTINDEX_STORE },
+#ifdef CONFIG_OVMS_DEV_SDCARDSCRIPTS
+    { "/sd/events", EVENTINDEX_SD },
+#endif // #ifdef CONFIG_OVMS_DEV_SDCARDSCRIPTS
+    };
+
+  // Set the valid flag first, so an invalidation during the scan is not lost:
+  m_eventindex_valid = true;
+  eventindex_t index;
+
+  for (auto& root : roots)
+    {
+    if ((dir = opendir(root.path)) == NULL)
+      continue;
+    while ((dp = readdir(dir)) != NULL)
+      {
+      if (dp->d_name[0] == '.')
+        continue;
+      if (dp->d_type != DT_DIR && dp->d_type != DT_UNKNOWN)
+        continue;
+      index[eventindex_key(dp->d_name)] |= root.bit;
+      }
+    closedir(dir);
+    }
+
+  m_eventindex_mutex.Lock();
+  m_eventindex.swap(index);
+  m_eventindex_mutex.Unlock();
+
+  // Measure what a directory probe for an event without scripts costs,
+  //  used to estimate the time saved by the index:
+  int64_t t0 = esp_timer_get_time();
+  dir = opendir("/store/events/.noscripts");
+  if (dir) closedir(dir);
+  m_dirscan_us = esp_timer_get_time() - t0;
+
+  m_stat_rebuilds++;
+  ESP_LOGD(TAG, "Event script index rebuilt: %u events with scripts, probe cost %u us",
+    m_eventindex.size(), m_dirscan_us);
+  }
+
+void OvmsScripts::EventListener(std::string event, void* data)
+  {
+  if (event == "system.vfs.file.changed")
+    {
+    const char* path = (const char*) data;
+    if (!path) return;
+    if (strncmp(path, "/store/events", 13) != 0 && strncmp(path, "/sd/events", 10) != 0)
+      return;
+    }
+  // sd.mounted, sd.unmounted, ticker.60 (safety net for writers not signalling changes)
+  InvalidateEventIndex();
+  }
+
 void OvmsScripts::EventScript(std::string event, void* data)
   {
   std::string path;
@@ -213,29 +308,97 @@ void OvmsScripts::EventScript(std::string event, void* data)
   MyDuktape.EventScript(event, data);
 #endif // #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
 
+  // lookup event in script directory index:
+  int64_t t0 = esp_timer_get_time();
+  if (!m_eventindex_valid)
+    RebuildEventIndex();
+  auto it = m_eventindex.find(eventindex_key(event.c_str()));
+  uint8_t roots = (it != m_eventindex.end()) ? it->second : 0;
+  m_stat_lookup_us += esp_timer_get_time() - t0;
+  m_stat_events++;
+  if (roots == 0)
+    return;
+  m_stat_scanned++;
+
 #ifdef CONFIG_OVMS_DEV_SDCARDSCRIPTS
   // run event scripts on external storage:
-  path=std::string("/sd/events/");
-  path.append(event);
-  AllScripts(path);
+  if (roots & EVENTINDEX_SD)
+    {
+    path=std::string("/sd/events/");
+    path.append(event);
+    AllScripts(path);
+    }
 #endif // #ifdef CONFIG_OVMS_DEV_SDCARDSCRIPTS
 
   // run event scripts on internal storage:
-  path=std::string("/store/events/");
-  path.append(event);
-  AllScripts(path);
+  if (roots & EVENTINDEX_STORE)
+    {
+    path=std::string("/store/events/");
+    path.append(event);
+    AllScripts(path);
+    }
+  }
+
+void OvmsScripts::ResetStats()
+  {
+  m_stat_events = 0;
+  m_stat_scanned = 0;
+  m_stat_rebuilds = 0;
+  m_stat_lookup_us = 0;
+  m_stat_since = monotonictime;
+  }
+
+void OvmsScripts::OutputStats(OvmsWriter* writer)
+  {
+  uint32_t secs = monotonictime - m_stat_since;
+#ifdef CONFIG_OVMS_DEV_SDCARDSCRIPTS
+  int nroots = 2;
+#else
+  int nroots = 1;
+#endif
+  uint32_t skipped = m_stat_events - m_stat_scanned;
+  bool valid = m_eventindex_valid;
+  eventindex_t index;
+  m_eventindex_mutex.Lock();
+  index = m_eventindex;
+  m_eventindex_mutex.Unlock();
+  writer->printf("Event script index:  %s, %u events with scripts\n",
+    valid ? "valid" : "invalid", index.size());
+  if (valid && !index.empty())
+    {
+    for (auto& e : index)
+      writer->printf("  %s%s%s\n", e.first.c_str(),
+        (e.second & EVENTINDEX_STORE) ? " [store]" : "",
+        (e.second & EVENTINDEX_SD) ? " [sd]" : "");
+    }
+  writer->printf("Statistics for %u seconds:\n", secs);
+  writer->printf("  Events checked:    %u (%.1f/s)\n", m_stat_events,
+    secs ? (float)m_stat_events / secs : 0.0f);
+  writer->printf("  Events scanned:    %u\n", m_stat_scanned);
+  writer->printf("  Dir scans skipped: %u\n", skipped * nroots);
+  writer->printf("  Index rebuilds:    %u\n", m_stat_rebuilds);
+  writer->printf("  Avg lookup time:   %.1f us\n",
+    m_stat_events ? (float)m_stat_lookup_us / m_stat_events : 0.0f);
+  writer->printf("  Dir probe cost:    %u us\n", m_dirscan_us);
+  writer->printf("  Est. time saved:   %.1f ms\n",
+    (float)skipped * nroots * m_dirscan_us / 1000);
   }
 
 OvmsScripts::OvmsScripts()
   {
   ESP_LOGI(TAG, "Initialising SCRIPTS (1600)");
 
+  m_eventindex_valid = false;
+  m_dirscan_us = 0;
+  ResetStats();
+
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_NONE
   ESP_LOGI(TAG, "No javascript engines enabled (command scripting only)");
 #endif //#ifdef CONFIG_OVMS_SC_JAVASCRIPT_NONE
 
   OvmsCommand* cmd_script = MyCommandApp.RegisterCommand("script","SCRIPT framework");
   cmd_script->RegisterCommand("run","Run a script",script_run,"<path>",1,1,true, vfs_file_validate);
+  cmd_script->RegisterCommand("stats","Show/reset event script statistics",script_stats,"[reset]",0,1);
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
   cmd_script->RegisterCommand("reload","Reload javascript framework",script_reload);
   cmd_script->RegisterCommand("eval","Eval some javascript code",script_eval,"<code>",1,1);
@@ -243,6 +406,14 @@ OvmsScripts::OvmsScripts()
   cmd_script->RegisterCommand("meminfo","Show heap memory status",script_meminfo);
 #endif // #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
   MyCommandApp.RegisterCommand(".","Run a script",script_run,"<path>",1,1, true, vfs_file_validate);
+
+  #undef bind  // Kludgy, but works
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyEvents.RegisterEvent(TAG, "system.vfs.file.changed", std::bind(&OvmsScripts::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "sd.mounted", std::bind(&OvmsScripts::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "sd.unmounted", std::bind(&OvmsScripts::EventListener, this, _1, _2));
+  MyEvents.RegisterEvent(TAG, "ticker.60", std::bind(&OvmsScripts::EventListener, this, _1, _2));
   }
 
 OvmsScripts::~OvmsScripts()
@@ -31,8 +31,11 @@
 #ifndef __SCRIPT_H__
 #define __SCRIPT_H__
 
+#include <string>
+#include <unordered_map>
 #include "ovms_command.h"
 #include "ovms_utils.h"
+#include "ovms_mutex.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -51,6 +54,30 @@ class OvmsScripts
   public:
     void EventScript(std::string event, void* data);
     void AllScripts(std::string path);
+
+  public:
+    void InvalidateEventIndex() { m_eventindex_valid = false; }
+    void OutputStats(OvmsWriter* writer);
+    void ResetStats();
+
+  protected:
+    void RebuildEventIndex();
+    void EventListener(std::string event, void* data);
+
+  protected:
+    // Event script directory index: lower case event name → storage bits
+    //  Written by the events task only, m_eventindex_mutex guards the
+    //  replacement against readers on other tasks (OutputStats).
+    typedef std::unordered_map<std::string, uint8_t> eventindex_t;
+    eventindex_t m_eventindex;
+    volatile bool m_eventindex_valid;
+    OvmsMutex m_eventindex_mutex;
+    uint32_t m_stat_events;           // Events checked for scripts
+    uint32_t m_stat_scanned;          // Events with script directories (scanned)
+    uint32_t m_stat_rebuilds;         // Index rebuilds
+    uint32_t m_stat_since;            // monotonictime of stats reset
+    uint64_t m_stat_lookup_us;        // Total index lookup time
+    uint32_t m_dirscan_us;            // Measured cost of a directory scan without scripts
   };
 
 extern OvmsScripts MyScripts;
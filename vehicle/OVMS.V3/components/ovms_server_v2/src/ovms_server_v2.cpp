@@ -46,6 +46,7 @@ static const char *TAG = "ovms-server-v2";
 #include "esp_system.h"
 #include "ovms_utils.h"
 #include "ovms_boot.h"
+#include "esp_timer.h"
 #if CONFIG_MG_ENABLE_SSL
 #include "ovms_tls.h"
 #endif
@@ -311,6 +312,7 @@ void OvmsServerV2::ProcessServerMsg()
       // Generate, and store, the digest for future use
       std::string modpass = MyConfig.GetParamValue("password","module");
       hmac_md5((uint8_t*) token, OVMS_PROTOCOL_V2_TOKENSIZE, (uint8_t*)modpass.c_str(), modpass.length(), m_pdigest);
+      PrimeParanoidCrypto();
       }
 
     m_pending_notify_info = true;
@@ -355,15 +357,9 @@ void OvmsServerV2::ProcessServerMsg()
     uint8_t *d = new uint8_t[line.length()-6];
     len = base64decode(line.c_str()+7,d+1);
 
-    RC4_CTX1* pm_crypto1 = new RC4_CTX1;
-    RC4_CTX2* pm_crypto2 = new RC4_CTX2;
-    RC4_setup(pm_crypto1, pm_crypto2, m_pdigest, OVMS_MD5_SIZE);
-    for (int k=0;k<1024;k++)
-      {
-      uint8_t zero = 0;
-      RC4_crypt(pm_crypto1, pm_crypto2, &zero, 1);
-      }
-    RC4_crypt(pm_crypto1, pm_crypto2, d, len);
+    RC4_CTX1 pm_crypto1 = m_pcrypto1;
+    RC4_CTX2 pm_crypto2 = m_pcrypto2;
+    RC4_crypt(&pm_crypto1, &pm_crypto2, d, len);
 
     line.erase(5);
     line = std::string("MP-0 ");
@@ -371,8 +367,6 @@ void OvmsServerV2::ProcessServerMsg()
     line.append((char*)d);
     len = line.length();
 
-    delete pm_crypto1;
-    delete pm_crypto2;
     delete[] d;
     ESP_LOGI(TAG, "Decoded Paranoid Msg: %s",line.c_str());
     }
@@ -763,9 +757,19 @@ bool OvmsServerV2::Transmit(const std::string& message)
     return false;
 
   int len = message.length();
-  char* s = new char[(len*2)+4];
-  memcpy(s,message.c_str(),len);
   ESP_LOGI(TAG, "Send %s",message.c_str());
+  int64_t started = esp_timer_get_time();
+
+  // Scratch buffer layout: s = message (paranoid: re-encoded message),
+  //  d = paranoid payload, buf = base64 encoded result
+  size_t slen = (len*2)+4;
+  size_t buflen = ((slen+2)/3)*4+3;
+  uint8_t* txbuf = GetTxBuffer(slen + len + buflen);
+  char* s = (char*)txbuf;
+  uint8_t* d = txbuf + slen;
+  char* buf = (char*)d + len;
+  memcpy(s,message.c_str(),len);
+  s[len] = 0;
 
   if ((m_ptoken_ready)&&
       (s[5] != 'E')&&
@@ -777,42 +781,68 @@ bool OvmsServerV2::Transmit(const std::string& message)
     // We must convert the message to a paranoid one...
     // The message is of the form MP-0 X...
     // Where X is the code and ... is the (optional) data
-    char code[2]; code[0] = s[5]; code[1] = 0;
-    uint8_t* d = new uint8_t[len-6];
+    char code = s[5];
     memcpy(d,s+6,len-6);
 
-    // Paranoid encrypt the message part of the transaction
-    RC4_CTX1* pm_crypto1 = new RC4_CTX1;
-    RC4_CTX2* pm_crypto2 = new RC4_CTX2;
-    RC4_setup(pm_crypto1, pm_crypto2, m_pdigest, OVMS_MD5_SIZE);
-    for (int k=0;k<1024;k++)
-      {
-      uint8_t zero = 0;
-      RC4_crypt(pm_crypto1, pm_crypto2, &zero, 1);
-      }
-    RC4_crypt(pm_crypto1, pm_crypto2, d, len-6);
+    // Paranoid encrypt the message part of the transaction,
+    // using a copy of the primed paranoid RC4 state:
+    RC4_CTX1 pm_crypto1 = m_pcrypto1;
+    RC4_CTX2 pm_crypto2 = m_pcrypto2;
+    RC4_crypt(&pm_crypto1, &pm_crypto2, d, len-6);
 
-    strcpy(s,"MP-0 EM");
-    strcat(s,code);
-    base64encode(d, len-6, (uint8_t*)s+8);
+    memcpy(s,"MP-0 EM",7);
+    s[7] = code;
+    len = base64encode(d, len-6, (uint8_t*)s+8) - s;
     // The messdage is now in paranoid mode...
-    delete[] d;
-    delete pm_crypto1;
-    delete pm_crypto2;
+    m_stat_tx_paranoid++;
     }
 
+  m_stat_tx_bytes += len;
   RC4_crypt(&m_crypto_tx1, &m_crypto_tx2, (uint8_t*)s, len);
 
-  char* buf = new char[(len*2)+4];
-  base64encode((uint8_t*)s, len, (uint8_t*)buf);
-  strcat(buf,"\r\n");
-  mg_send(m_mgconn, buf, strlen(buf));
+  char* end = base64encode((uint8_t*)s, len, (uint8_t*)buf);
+  memcpy(end,"\r\n",3);
+  size_t sendlen = end+2-buf;
+  m_stat_tx_time += esp_timer_get_time() - started;
+  m_stat_tx_wire += sendlen;
+  m_stat_tx_msgs++;
 
-  delete [] buf;
-  delete [] s;
+  mg_send(m_mgconn, buf, sendlen);
   return true;
   }
 
+/**
+ * PrimeParanoidCrypto: set up the paranoid mode RC4 state for the current
+ *  m_pdigest, including the initial 1024 byte keystream discard. Every
+ *  paranoid message is en/decrypted with a fresh copy of this state.
+ */
+void OvmsServerV2::PrimeParanoidCrypto()
+  {
+  RC4_setup(&m_pcrypto1, &m_pcrypto2, m_pdigest, OVMS_MD5_SIZE);
+  uint8_t zero[64];
+  for (int k=0;k<1024/sizeof(zero);k++)
+    {
+    memset(zero, 0, sizeof(zero));
+    RC4_crypt(&m_pcrypto1, &m_pcrypto2, zero, sizeof(zero));
+    }
+  }
+
+/**
+ * GetTxBuffer: get the transmit scratch buffer with at least the given size.
+ *  The buffer only grows, so steady state transmissions do not allocate.
+ */
+uint8_t* OvmsServerV2::GetTxBuffer(size_t size)
+  {
+  if (size > m_txbuf_size)
+    {
+    if (m_txbuf) delete [] m_txbuf;
+    m_txbuf_size = (size + 255) & ~255;
+    m_txbuf = new uint8_t[m_txbuf_size];
+    m_stat_tx_bufgrow++;
+    }
+  return m_txbuf;
+  }
+
 void OvmsServerV2::SetStatus(const char* status, bool fault, State newstate)
   {
   if (fault)
@@ -2138,6 +2168,14 @@ OvmsServerV2::OvmsServerV2(const char* name)
     }
 
   m_buffer = new OvmsBuffer(1024);
+  m_txbuf = NULL;
+  m_txbuf_size = 0;
+  m_stat_tx_msgs = 0;
+  m_stat_tx_paranoid = 0;
+  m_stat_tx_bytes = 0;
+  m_stat_tx_wire = 0;
+  m_stat_tx_time = 0;
+  m_stat_tx_bufgrow = 0;
   SetStatus("Server has been started", false, WaitNetwork);
   m_now_stat = false;
   m_now_gen = false;
@@ -2220,6 +2258,11 @@ OvmsServerV2::~OvmsServerV2()
     delete m_buffer;
     m_buffer = NULL;
     }
+  if (m_txbuf)
+    {
+    delete [] m_txbuf;
+    m_txbuf = NULL;
+    }
   MyEvents.SignalEvent("server.v2.stopped", NULL);
   }
 
@@ -2304,6 +2347,23 @@ void ovmsv2_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc
     }
   }
 
+void ovmsv2_stats(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  if (MyOvmsServerV2 == NULL)
+    {
+    writer->puts("OVMS v2 server has not been started");
+    return;
+    }
+
+  OvmsServerV2* v2 = MyOvmsServerV2;
+  writer->printf("Messages sent:    %" PRIu32 " (%" PRIu32 " paranoid)\n", v2->m_stat_tx_msgs, v2->m_stat_tx_paranoid);
+  writer->printf("Bytes:            %" PRIu64 " plain, %" PRIu64 " encoded\n", v2->m_stat_tx_bytes, v2->m_stat_tx_wire);
+  writer->printf("Encoding time:    %" PRIu64 " us", v2->m_stat_tx_time);
+  if (v2->m_stat_tx_msgs)
+    writer->printf(", %.1f us/msg", (double)v2->m_stat_tx_time / v2->m_stat_tx_msgs);
+  writer->printf("\nBuffer allocs:    %" PRIu32 "\n", v2->m_stat_tx_bufgrow);
+  }
+
 void ovmsv2_update(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   if (MyOvmsServerV2 == NULL)
@@ -2330,6 +2390,7 @@ OvmsServerV2Init::OvmsServerV2Init()
   cmd_v2->RegisterCommand("start","Start an OVMS V2 Server Connection",ovmsv2_start);
   cmd_v2->RegisterCommand("stop","Stop an OVMS V2 Server Connection",ovmsv2_stop);
   cmd_v2->RegisterCommand("status","Show OVMS V2 Server connection status",ovmsv2_status);
+  cmd_v2->RegisterCommand("stats","Show OVMS V2 Server transmission statistics",ovmsv2_stats);
 
   OvmsCommand* cmd_update = cmd_v2->RegisterCommand("update", "Request OVMS V2 Server data update", ovmsv2_update);
   cmd_update->RegisterCommand("all", "Transmit all metrics covered by v2 protocol", ovmsv2_update);
@@ -65,6 +65,8 @@ class OvmsServerV2 : public OvmsServer
     void ProcessServerMsg();
     void ProcessCommand(const char* payload);
     bool Transmit(const std::string& message);
+    void PrimeParanoidCrypto();
+    uint8_t* GetTxBuffer(size_t size);
 
   protected:
     void TransmitMsgStat(bool always = false);
@@ -138,6 +140,19 @@ class OvmsServerV2 : public OvmsServer
     uint8_t m_pdigest[OVMS_MD5_SIZE];
     std::string m_ptoken;
     bool m_ptoken_ready;
+    RC4_CTX1 m_pcrypto1;                  // Paranoid mode RC4 state after the initial discard,
+    RC4_CTX2 m_pcrypto2;                  //  cloned for every message
+
+    uint8_t* m_txbuf;                     // Transmit scratch buffer (encryption & base64)
+    size_t m_txbuf_size;
+
+  public:
+    uint32_t m_stat_tx_msgs;
+    uint32_t m_stat_tx_paranoid;
+    uint64_t m_stat_tx_bytes;             // Plain message bytes
+    uint64_t m_stat_tx_wire;              // Encoded bytes sent
+    uint64_t m_stat_tx_time;              // Encoding time [us]
+    uint32_t m_stat_tx_bufgrow;           // Scratch buffer (re)allocations
 
     bool m_now_stat;
     bool m_now_gen;
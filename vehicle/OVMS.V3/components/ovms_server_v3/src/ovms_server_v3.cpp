@@ -38,6 +38,7 @@ static const char *TAG = "ovms-server-v3";
 #include "ovms_command.h"
 #include "ovms_metrics.h"
 #include "metrics_standard.h"
+#include "ovms_utils.h"
 #if CONFIG_MG_ENABLE_SSL
 #include "ovms_tls.h"
 #endif
@@ -46,6 +47,22 @@ OvmsServerV3 *MyOvmsServerV3 = NULL;
 size_t MyOvmsServerV3Modifier = 0;
 size_t MyOvmsServerV3Reader = 0;
 
+/**
+ * mqtt_publish_size: MQTT PUBLISH packet size for QoS 0
+ *  (fixed header + remaining length + topic length + topic + payload)
+ */
+static uint32_t mqtt_publish_size(size_t topiclen, size_t payloadlen)
+  {
+  uint32_t len = 2 + topiclen + payloadlen;
+  uint32_t size = 1 + len;
+  do
+    {
+    size++;
+    len >>= 7;
+    } while (len > 0);
+  return size;
+  }
+
 bool OvmsServerV3ReaderCallback(OvmsNotifyType* type, OvmsNotifyEntry* entry)
   {
   if (MyOvmsServerV3)
@@ -192,6 +209,7 @@ OvmsServerV3::OvmsServerV3(const char* name)
     MyOvmsServerV3Modifier = MyMetrics.RegisterModifier();
     ESP_LOGI(TAG, "OVMS Server V3 registered metric modifier is #%d",MyOvmsServerV3Modifier);
     }
+  m_metrics_changes.Init(MyOvmsServerV3Modifier);
 
   SetStatus("Server has been started", false, WaitNetwork);
   m_connretry = 0;
@@ -210,6 +228,13 @@ OvmsServerV3::OvmsServerV3(const char* name)
   m_updatetime_sendall = 0;
   m_updatetime_keepalive = 29*60;
   m_legacy_event_topic = true;
+  m_metrics_batch = false;
+  m_metrics_batch_size = MQTT_METRICS_BATCH_SIZE;
+  m_metrics_batch_count = 0;
+  m_metrics_batch_single = 0;
+  memset(&m_metrics_stats, 0, sizeof(m_metrics_stats));
+  memset(&m_metrics_stats_mark, 0, sizeof(m_metrics_stats_mark));
+  memset(&m_metrics_stats_last, 0, sizeof(m_metrics_stats_last));
   m_notify_info_pending = false;
   m_notify_error_pending = false;
   m_notify_alert_pending = false;
@@ -273,6 +298,9 @@ void OvmsServerV3::TransmitAllMetrics()
   if (!m_mgconn)
     return;
 
+  // Skip logged changes, changes from here on will be logged again:
+  m_metrics_changes.Sync();
+
   OvmsMetric* metric = MyMetrics.m_first;
   while (metric != NULL)
     {
@@ -283,6 +311,7 @@ void OvmsServerV3::TransmitAllMetrics()
       }
     metric = metric->m_next;
     }
+  FlushMetricsBatch();
   }
 
 void OvmsServerV3::TransmitModifiedMetrics()
@@ -291,15 +320,12 @@ void OvmsServerV3::TransmitModifiedMetrics()
   if (!m_mgconn)
     return;
 
-  OvmsMetric* metric = MyMetrics.m_first;
-  while (metric != NULL)
+  OvmsMetric* metric;
+  while ((metric = m_metrics_changes.Next()) != NULL)
     {
-    if (metric->IsModifiedAndClear(MyOvmsServerV3Modifier))
-      {
-      TransmitMetric(metric);
-      }
-    metric = metric->m_next;
+    TransmitMetric(metric);
     }
+  FlushMetricsBatch();
   }
 
 void OvmsServerV3::TransmitMetric(OvmsMetric* metric)
@@ -314,12 +340,69 @@ void OvmsServerV3::TransmitMetric(OvmsMetric* metric)
   topic.append(mqtt_topic(metric_name));
 
   std::string val = metric->AsString();
+  uint32_t size = mqtt_publish_size(topic.length(), val.length());
+
+  if (m_metrics_batch)
+    {
+    // Collect into the batch, flush first if it would exceed the size limit:
+    std::string member("\"");
+    member.append(json_encode(metric_name));
+    member.append("\":\"");
+    member.append(json_encode(val));
+    member.append("\"");
+    if (m_metrics_batch_count > 0 &&
+        m_metrics_batch_buf.length() + member.length() + 2 > (size_t)m_metrics_batch_size)
+      {
+      FlushMetricsBatch();
+      }
+    m_metrics_batch_buf.append(m_metrics_batch_count ? "," : "{");
+    m_metrics_batch_buf.append(member);
+    m_metrics_batch_count++;
+    m_metrics_batch_single += size;
+    ESP_LOGV(TAG,"Batch metric %s=%s",metric_name.c_str(),val.c_str());
+    return;
+    }
 
   mg_mqtt_publish(m_mgconn, topic.c_str(), m_msgid++,
     MG_MQTT_QOS(0) | MG_MQTT_RETAIN, val.c_str(), val.length());
+  m_metrics_stats.packets++;
+  m_metrics_stats.bytes += size;
+  m_metrics_stats.metrics++;
   ESP_LOGD(TAG,"Tx metric %s=%s",topic.c_str(),val.c_str());
   }
 
+/**
+ * FlushMetricsBatch: publish collected metrics as a single JSON object
+ *  on <prefix>/metrics (not retained, as it only holds the changes)
+ */
+void OvmsServerV3::FlushMetricsBatch()
+  {
+  if (m_metrics_batch_count == 0)
+    return;
+
+  m_metrics_batch_buf.append("}");
+
+  std::string topic(m_topic_prefix);
+  topic.append("metrics");
+  uint32_t size = mqtt_publish_size(topic.length(), m_metrics_batch_buf.length());
+
+  mg_mqtt_publish(m_mgconn, topic.c_str(), m_msgid++,
+    MG_MQTT_QOS(0), m_metrics_batch_buf.data(), m_metrics_batch_buf.length());
+  ESP_LOGD(TAG,"Tx metrics batch: %d metrics, %u bytes",
+    m_metrics_batch_count, (unsigned)m_metrics_batch_buf.length());
+
+  m_metrics_stats.packets++;
+  m_metrics_stats.bytes += size;
+  m_metrics_stats.metrics += m_metrics_batch_count;
+  m_metrics_stats.packets_saved += m_metrics_batch_count - 1;
+  if (m_metrics_batch_single > size)
+    m_metrics_stats.bytes_saved += m_metrics_batch_single - size;
+
+  m_metrics_batch_buf.clear();
+  m_metrics_batch_count = 0;
+  m_metrics_batch_single = 0;
+  }
+
 int OvmsServerV3::TransmitNotificationInfo(OvmsNotifyEntry* entry)
   {
   std::string topic(m_topic_prefix);
@@ -850,6 +933,10 @@ void OvmsServerV3::ConfigChanged(OvmsConfigParam* param)
   m_updatetime_sendall = MyConfig.GetParamValueInt("server.v3", "updatetime.sendall", 0);
   m_updatetime_keepalive = MyConfig.GetParamValueInt("server.v3", "updatetime.keepalive", 29*60);
   m_legacy_event_topic = MyConfig.GetParamValueBool("server.v3", "events.legacy_topic", true);
+  m_metrics_batch = MyConfig.GetParamValueBool("server.v3", "metrics.batch", false);
+  m_metrics_batch_size = MyConfig.GetParamValueInt("server.v3", "metrics.batch.size", MQTT_METRICS_BATCH_SIZE);
+  if (m_metrics_batch_size < MQTT_METRICS_BATCH_MINSIZE)
+    m_metrics_batch_size = MQTT_METRICS_BATCH_MINSIZE;
   m_metrics_filter.LoadFilters(MyConfig.GetParamValue("server.v3", "metrics.include"),
                                MyConfig.GetParamValue("server.v3", "metrics.exclude"));
   }
@@ -1006,6 +1093,16 @@ void OvmsServerV3::RequestUpdate(bool txall)
 void OvmsServerV3::Ticker60(std::string event, void* data)
   {
   CountClients();
+
+  // The server task counts on while we read, so take the difference of the
+  // totals instead of resetting them:
+  OvmsServerV3MetricsStats totals = m_metrics_stats;
+  m_metrics_stats_last.packets = totals.packets - m_metrics_stats_mark.packets;
+  m_metrics_stats_last.bytes = totals.bytes - m_metrics_stats_mark.bytes;
+  m_metrics_stats_last.metrics = totals.metrics - m_metrics_stats_mark.metrics;
+  m_metrics_stats_last.packets_saved = totals.packets_saved - m_metrics_stats_mark.packets_saved;
+  m_metrics_stats_last.bytes_saved = totals.bytes_saved - m_metrics_stats_mark.bytes_saved;
+  m_metrics_stats_mark = totals;
   }
 
 void OvmsServerV3::SetPowerMode(PowerMode powermode)
@@ -1086,6 +1183,17 @@ void ovmsv3_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc
         break;
       }
     writer->printf("       %s\n",MyOvmsServerV3->m_status.c_str());
+
+    const OvmsServerV3MetricsStats& st = MyOvmsServerV3->m_metrics_stats_last;
+    if (MyOvmsServerV3->m_metrics_batch)
+      writer->printf("\nMetrics: batched, max %d bytes per packet\n", MyOvmsServerV3->m_metrics_batch_size);
+    else
+      writer->puts("\nMetrics: one retained topic per metric");
+    writer->printf("  Last minute: %u metrics in %u packets, %u bytes\n",
+      st.metrics, st.packets, st.bytes);
+    if (MyOvmsServerV3->m_metrics_batch)
+      writer->printf("  Saved:       %u packets, %u bytes\n",
+        st.packets_saved, st.bytes_saved);
     }
   }
 
@@ -1140,12 +1248,12 @@ void OvmsServerV3Init::AutoInit()
     MyOvmsServerV3 = new OvmsServerV3("oscv3");
   }
 
-void OvmsServerV3Init::EventListener(std::string event, void* data)
+void OvmsServerV3Init::EventListener(const char* event, void* data)
   {
-  if (event.compare(0,7,"ticker.") == 0) return; // Skip ticker.* events
-  if (event.compare(0,6,"clock.") == 0) return; // Skip clock.* events
-  if (event.compare("system.event") == 0) return; // Skip event
-  if (event.compare("system.wifi.scan.done") == 0) return; // Skip event
+  if (strncmp(event,"ticker.",7) == 0) return; // Skip ticker.* events
+  if (strncmp(event,"clock.",6) == 0) return; // Skip clock.* events
+  if (strcmp(event,"system.event") == 0) return; // Skip event
+  if (strcmp(event,"system.wifi.scan.done") == 0) return; // Skip event
 
   if (MyOvmsServerV3)
     {
@@ -45,6 +45,18 @@ typedef std::map<std::string, uint32_t> OvmsServerV3ClientMap;
 
 #define MQTT_CONN_NTOPICS 2
 
+#define MQTT_METRICS_BATCH_SIZE     2048    // Default max payload size of a metrics batch
+#define MQTT_METRICS_BATCH_MINSIZE  256
+
+typedef struct
+  {
+  uint32_t packets;                         // MQTT packets sent for metrics
+  uint32_t bytes;                           // … total MQTT packet size
+  uint32_t metrics;                         // Metric values sent
+  uint32_t packets_saved;                   // Packets saved by batching
+  uint32_t bytes_saved;                     // Bytes saved by batching
+  } OvmsServerV3MetricsStats;
+
 class OvmsServerV3 : public OvmsServer
   {
   public:
@@ -110,6 +122,8 @@ class OvmsServerV3 : public OvmsServer
     int m_updatetime_sendall;
     int m_updatetime_keepalive;
     bool m_legacy_event_topic;
+    bool m_metrics_batch;
+    int m_metrics_batch_size;
 
     bool m_connection_available;
     bool m_notify_info_pending;
@@ -127,6 +141,7 @@ class OvmsServerV3 : public OvmsServer
     void Disconnect();
     void TransmitAllMetrics();
     void TransmitModifiedMetrics();
+    void FlushMetricsBatch();
     int TransmitNotificationInfo(OvmsNotifyEntry* entry);
     int TransmitNotificationError(OvmsNotifyEntry* entry);
     int TransmitNotificationAlert(OvmsNotifyEntry* entry);
@@ -147,6 +162,16 @@ class OvmsServerV3 : public OvmsServer
     void TransmitMetric(OvmsMetric* metric);
 
     IdIncludeExcludeFilter m_metrics_filter;
+    OvmsMetricChanges m_metrics_changes;
+
+    std::string m_metrics_batch_buf;        // JSON object members collected for the batch
+    int m_metrics_batch_count;              // … number of metrics in batch
+    uint32_t m_metrics_batch_single;        // … packet bytes needed if sent one by one
+
+  public:
+    OvmsServerV3MetricsStats m_metrics_stats;       // Totals, only counted up by the server task
+    OvmsServerV3MetricsStats m_metrics_stats_mark;  // Totals at last minute tick
+    OvmsServerV3MetricsStats m_metrics_stats_last;  // Last full minute
   };
 
 class OvmsServerV3Init
@@ -156,7 +181,7 @@ class OvmsServerV3Init
     void AutoInit();
 
   public:
-    void EventListener(std::string event, void* data);
+    void EventListener(const char* event, void* data);
   };
 
 extern OvmsServerV3Init MyOvmsServerV3Init;
@@ -37,7 +37,6 @@ static const char *TAG = "webcommand";
 #include <stdarg.h>
 #include <string.h>
 #include "buffered_shell.h"
-#include "log_buffers.h"
 #include "ovms_webserver.h"
 #include "ovms_script.h"
 #include "ovms_module.h"
@@ -266,8 +265,3 @@ ssize_t HttpCommandStream::write(const void *buf, size_t nbyte)
   return nbyte;
 }
 
-void HttpCommandStream::Log(LogBuffers* message)
-{
-  // writing could block, logging is done via the websocket stream
-  message->release();
-}
@@ -50,7 +50,6 @@
 #include "ovms_shell.h"
 #include "ovms_netmanager.h"
 #include "ovms_utils.h"
-#include "log_buffers.h"
 
 // The setup wizard currently is tailored to be used with a WiFi enabled module:
 #ifdef CONFIG_OVMS_COMP_WIFI
@@ -366,7 +365,7 @@ enum WebSocketTxJobType
   WSTX_MetricsUpdate,         // payload: -
   WSTX_Config,                // payload: config (todo)
   WSTX_Notify,                // payload: notification
-  WSTX_LogBuffers,            // payload: logbuffers
+  WSTX_LogRing,               // payload: -
   WSTX_UnitMetricUpdate,      // payload: -
   WSTX_UnitPrefsUpdate,       // payload: -
 };
@@ -379,7 +378,6 @@ struct WebSocketTxJob
     char*                     event;
     OvmsConfigParam*          config;
     OvmsNotifyEntry*          notification;
-    LogBuffers*               logbuffers;
   };
 
   void clear(size_t client);
@@ -406,6 +404,7 @@ class WebSocketHandler : public MgHandler, public OvmsWriter
     void InitTx();
     void ContinueTx();
     void ProcessTxJob();
+    bool IsMetricsCursorValid() { return m_last_gen == MyMetrics.GetSlotGeneration(); }
     int HandleEvent(int ev, void* p);
     void HandleIncomingMsg(std::string msg);
 
@@ -420,11 +419,12 @@ class WebSocketHandler : public MgHandler, public OvmsWriter
 
   // OvmsWriter:
   public:
-    void Log(LogBuffers* message);
+    void LogNotify();
 
   public:
     size_t                    m_slot = 0;
     size_t                    m_modifier = 0;         // "our" metrics modifier
+    OvmsMetricChanges         m_metrics_changes;      // "our" metrics change log reader
     size_t                    m_reader = 0;           // "our" notification reader id
     QueueHandle_t             m_jobqueue = NULL;
     uint32_t                  m_jobqueue_overflow_status = 0;
@@ -435,9 +435,12 @@ class WebSocketHandler : public MgHandler, public OvmsWriter
     int                       m_sent = 0;
     int                       m_ack = 0;
     int                       m_last = 0;             // last entry sent up
+    uint32_t                  m_last_gen = 0;         // metrics slot generation for m_last
     std::set<std::string>     m_subscriptions;
     bool                      m_units_subscribed;
     bool                      m_units_prefs_subscribed;
+    OvmsLogReader             m_logreader;            // "our" log ring cursor
+    char*                     m_logline = NULL;       // log ring record buffer
 };
 
 struct WebSocketSlot
@@ -480,7 +483,6 @@ class HttpCommandStream : public OvmsShell, public MgHandler
     int puts(const char* s);
     int printf(const char* fmt, ...) __attribute__ ((format (printf, 2, 3)));
     ssize_t write(const void *buf, size_t nbyte);
-    void Log(LogBuffers* message);
 };
 
 
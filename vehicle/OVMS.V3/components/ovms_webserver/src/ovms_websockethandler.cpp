@@ -75,10 +75,13 @@ WebSocketHandler::WebSocketHandler(mg_connection* nc, size_t slot, size_t modifi
   m_units_subscribed = false;
   m_units_prefs_subscribed = false;
 
-  MyMetrics.InitialiseSlot(m_slot);
-  MyUnitConfig.InitialiseSlot(m_slot);
+  MyMetrics.InitialiseSlot(m_modifier);
+  MyUnitConfig.InitialiseSlot(m_modifier);
+  m_metrics_changes.Init(m_modifier);
   
   // Register as logging console:
+  m_logline = (char*) ExternalRamMalloc(LOGRING_MAX_LINE);
+  MyCommandApp.GetLogRing()->Attach(&m_logreader);
   SetMonitoring(true);
   MyCommandApp.RegisterConsole(this);
 }
@@ -91,6 +94,8 @@ WebSocketHandler::~WebSocketHandler()
       ClearTxJob(m_job);
     vQueueDelete(m_jobqueue);
   }
+  if (m_logline)
+    free(m_logline);
 }
 
 
@@ -119,34 +124,78 @@ void WebSocketHandler::ProcessTxJob()
     }
     
     case WSTX_MetricsAll:
-    case WSTX_MetricsUpdate:
     {
-      // Note: this loops over the metrics by index, keeping the last checked position
-      //  in m_last. It will not detect new metrics added between polls if they are
-      //  inserted before m_last, so new metrics may not be sent until first changed.
-      //  The Metrics set normally is static, so this should be no problem.
+      // Note: this loops over the metrics registry by slot, keeping the next slot
+      //  to check in m_last. New metrics are normally added at the end, so will be
+      //  included. If a new metric reused a free slot (generation change), we need
+      //  to restart to make sure it's sent.
       
-      // find start:
-      int i;
-      OvmsMetric* m;
-      for (i=0, m=MyMetrics.m_first; i < m_last && m != NULL; m=m->m_next, i++);
+      // restart on generation change:
+      if (!IsMetricsCursorValid()) {
+        m_last = 0;
+        m_last_gen = MyMetrics.GetSlotGeneration();
+      }
       
       // build msg:
-      if (m) {
+      int i = 0;
+      if (m_last < MyMetrics.GetSlotCount()) {
         std::string msg;
         msg.reserve(2*XFER_CHUNK_SIZE+128);
         msg = "{\"metrics\":{";
-        for (i=0; m && msg.size() < XFER_CHUNK_SIZE; m=m->m_next) {
-          ++m_last;
-          if (m->IsModifiedAndClear(m_modifier) || m_job.type == WSTX_MetricsAll) {
-            if (i) msg += ',';
-            msg += '\"';
-            msg += m->m_name;
-            msg += "\":";
-            msg += m->AsJSON();
-            i++;
-          }
+        for (; m_last < MyMetrics.GetSlotCount() && msg.size() < XFER_CHUNK_SIZE; m_last++) {
+          OvmsMetric* m = MyMetrics.GetSlot(m_last);
+          if (!m) continue;
+          m->ClearModified(m_modifier);
+          if (i) msg += ',';
+          msg += '\"';
+          msg += m->m_name;
+          msg += "\":";
+          msg += m->AsJSON();
+          i++;
+        }
+
+        // send msg:
+        if (i) {
+          msg += "}}";
+          ESP_EARLY_LOGV(TAG, "WebSocket msg: %s", msg.c_str());
+          mg_send_websocket_frame(m_nc, WEBSOCKET_OP_TEXT, msg.data(), msg.size());
+          m_sent += i;
+        }
+      }
+
+      // done?
+      if (m_last >= MyMetrics.GetSlotCount() && IsMetricsCursorValid() && m_ack == m_sent) {
+        if (m_sent)
+          ESP_EARLY_LOGV(TAG, "WebSocketHandler[%p]: ProcessTxJob type=%d done, sent=%d metrics", m_nc, m_job.type, m_sent);
+        ClearTxJob(m_job);
+      }
+      
+      break;
+    }
+
+    case WSTX_MetricsUpdate:
+    {
+      // Note: this only visits the metrics logged as changed for our modifier.
+      //  m_last is set when the change log has been drained, so continuous
+      //  changes cannot keep the job alive.
+      
+      OvmsMetric* m = NULL;
+      if (!m_last) {
+        // build msg:
+        int i = 0;
+        std::string msg;
+        msg.reserve(2*XFER_CHUNK_SIZE+128);
+        msg = "{\"metrics\":{";
+        while (msg.size() < XFER_CHUNK_SIZE && (m = m_metrics_changes.Next()) != NULL) {
+          if (i) msg += ',';
+          msg += '\"';
+          msg += m->m_name;
+          msg += "\":";
+          msg += m->AsJSON();
+          i++;
         }
+        if (!m)
+          m_last = 1;
 
         // send msg:
         if (i) {
@@ -158,7 +207,7 @@ void WebSocketHandler::ProcessTxJob()
       }
 
       // done?
-      if (!m && m_ack == m_sent) {
+      if (m_last && m_ack == m_sent) {
         if (m_sent)
           ESP_EARLY_LOGV(TAG, "WebSocketHandler[%p]: ProcessTxJob type=%d done, sent=%d metrics", m_nc, m_job.type, m_sent);
         ClearTxJob(m_job);
@@ -169,26 +218,25 @@ void WebSocketHandler::ProcessTxJob()
 
     case WSTX_UnitMetricUpdate:
     {
-      // Note: this loops over the metrics by index, keeping the last checked position
-      //  in m_last. It will not detect new metrics added between polls if they are
-      //  inserted before m_last, so new metrics may not be sent until first changed.
-      //  The Metrics set normally is static, so this should be no problem.
+      // Note: this loops over the metrics registry by slot, keeping the next slot
+      //  to check in m_last, restarting on slot generation changes (see above).
 
       ESP_EARLY_LOGD(TAG, "WebSocketHandler[%p/%d]: ProcessTxJob MetricsUnitUpdate, last=%d sent=%d ack=%d", m_nc, m_modifier, m_last, m_sent, m_ack);
-      // find start:
-      int i;
-      OvmsMetric* m;
-      for (i=0, m=MyMetrics.m_first; i < m_last && m != NULL; m=m->m_next, i++);
-      ESP_EARLY_LOGD(TAG, "WebSocketHandler[%p/%d]: ProcessTxJob MetricsUnitUpdate, i=%d", m_nc, m_modifier, i);
-      if (m) { // Bypass this if we are on the 'just sent' leg.
+      if (!IsMetricsCursorValid()) {
+        m_last = 0;
+        m_last_gen = MyMetrics.GetSlotGeneration();
+      }
+      int i = 0;
+      if (m_last < MyMetrics.GetSlotCount()) { // Bypass this if we are on the 'just sent' leg.
         // build msg:
         std::string msg;
         msg.reserve(2*XFER_CHUNK_SIZE+128);
         msg = "{\"units\":{\"metrics\":{";
 
         // Cache the user mappings for each group.
-        for (i=0; m && msg.size() < XFER_CHUNK_SIZE; m=m->m_next) {
-          ++m_last;
+        for (; m_last < MyMetrics.GetSlotCount() && msg.size() < XFER_CHUNK_SIZE; m_last++) {
+          OvmsMetric* m = MyMetrics.GetSlot(m_last);
+          if (!m) continue;
           bool send = m->IsUnitSendAndClear(m_modifier);
           if (send) {
             if (i)
@@ -224,7 +272,7 @@ void WebSocketHandler::ProcessTxJob()
       }
 
       // done?
-      if (!m && m_ack == m_sent) {
+      if (m_last >= MyMetrics.GetSlotCount() && IsMetricsCursorValid() && m_ack == m_sent) {
         if (m_sent)
           ESP_EARLY_LOGD(TAG, "WebSocketHandler[%p/%d]: ProcessTxJob MetricsUnitsUpdate done, sent=%d metrics", m_nc, m_modifier, m_sent);
         ClearTxJob(m_job);
@@ -336,24 +384,32 @@ void WebSocketHandler::ProcessTxJob()
       break;
     }
     
-    case WSTX_LogBuffers:
+    case WSTX_LogRing:
     {
-      // Note: this sender loops over the buffered lines by index (kept in m_sent)
+      // Note: this sender reads the log ring by our own cursor, one line per frame.
+      //  The signal is reset on the first call, so records committed while
+      //  this job runs will at worst cause another (short) job.
       // Single log lines may be longer than our nominal XFER_CHUNK_SIZE, but that is
       // very rarely the case, so we shouldn't need to additionally chunk them.
-      LogBuffers* lb = m_job.logbuffers;
-
-      // find next line:
-      int i;
-      LogBuffers::iterator it;
-      for (i=0, it=lb->begin(); i < m_sent && it != lb->end(); it++, i++);
+      if (m_sent == 0)
+        m_logreader.m_pending = false;
       
-      if (it != lb->end()) {
+      int len = MyCommandApp.GetLogRing()->Read(&m_logreader, m_logline, LOGRING_MAX_LINE);
+      if (m_logreader.m_dropped) {
+        // report records lost by ring overruns like the consoles do:
+        char msg[64];
+        int msglen = snprintf(msg, sizeof(msg), "{\"log\":\"[%" PRIu32 " log messages lost]\\n\"}",
+          m_logreader.m_dropped);
+        m_logreader.m_dropped = 0;
+        mg_send_websocket_frame(m_nc, WEBSOCKET_OP_TEXT, msg, msglen);
+        m_sent++;
+      }
+      if (len > 0) {
         // encode & send:
         std::string msg;
-        msg.reserve(strlen(*it)+128);
+        msg.reserve(len+128);
         msg = "{\"log\":\"";
-        msg += json_encode(stripesc(*it));
+        msg += json_encode(stripesc(m_logline));
         msg += "\"}";
         mg_send_websocket_frame(m_nc, WEBSOCKET_OP_TEXT, msg.data(), msg.size());
         m_sent++;
@@ -398,10 +454,6 @@ void WebSocketTxJob::clear(size_t client)
         if (mt) mt->MarkRead(slot.reader, notification);
       }
       break;
-    case WSTX_LogBuffers:
-      if (logbuffers)
-        logbuffers->release();
-      break;
     default:
       break;
   }
@@ -437,6 +489,7 @@ bool WebSocketHandler::GetNextTxJob()
   if (xQueueReceive(m_jobqueue, &m_job, 0) == pdTRUE) {
     // init new job state:
     m_sent = m_ack = m_last = 0;
+    m_last_gen = MyMetrics.GetSlotGeneration();
     return true;
   } else {
     return false;
@@ -547,13 +600,16 @@ void WebSocketHandler::HandleIncomingMsg(std::string msg)
  * OvmsWriter interface
  */
 
-void WebSocketHandler::Log(LogBuffers* message)
+void WebSocketHandler::LogNotify()
 {
+  // signal new log ring records, unless a job is already pending:
+  if (!m_logline || m_logreader.m_pending.exchange(true))
+    return;
   WebSocketTxJob job;
-  job.type = WSTX_LogBuffers;
-  job.logbuffers = message;
+  job.type = WSTX_LogRing;
+  job.event = NULL;
   if (!AddTxJob(job))
-    message->release();
+    m_logreader.m_pending = false;
 }
 
 
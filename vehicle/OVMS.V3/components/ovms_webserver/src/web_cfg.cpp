@@ -54,6 +54,10 @@ static const char *TAG = "webserver";
 #include "pushover.h"
 #endif
 
+#ifdef CONFIG_OVMS_COMP_SERVER_V3
+#include "ovms_server_v3.h"
+#endif
+
 #define _attr(text) (c.encode_html(text).c_str())
 #define _html(text) (c.encode_html(text).c_str())
 
@@ -1564,7 +1568,8 @@ void OvmsWebServer::HandleCfgServerV3(PageEntry_t& p, PageContext_t& c)
   std::string error;
   std::string server, user, password, port, topic_prefix;
   std::string updatetime_connected, updatetime_idle, updatetime_on, updatetime_charging, updatetime_awake, updatetime_sendall, updatetime_keepalive;
-  bool tls, legacy_event_topic;
+  std::string metrics_batch_size;
+  bool tls, legacy_event_topic, metrics_batch;
 
   if (c.method == "POST") {
     // process form submission:
@@ -1582,6 +1587,8 @@ void OvmsWebServer::HandleCfgServerV3(PageEntry_t& p, PageContext_t& c)
     updatetime_awake = c.getvar("updatetime_awake");
     updatetime_sendall = c.getvar("updatetime_sendall");
     updatetime_keepalive = c.getvar("updatetime_keepalive");
+    metrics_batch = (c.getvar("metrics_batch") == "yes");
+    metrics_batch_size = c.getvar("metrics_batch_size");
 
     // validate:
     if (port != "") {
@@ -1625,6 +1632,12 @@ void OvmsWebServer::HandleCfgServerV3(PageEntry_t& p, PageContext_t& c)
         error += "<li data-input=\"updatetime_keepalive\">Update interval (keepalive) must be at least 1 second</li>";
       }
     }
+    if (metrics_batch_size != "") {
+      if (atoi(metrics_batch_size.c_str()) < MQTT_METRICS_BATCH_MINSIZE) {
+        error += "<li data-input=\"metrics_batch_size\">Batch size must be at least "
+          STR(MQTT_METRICS_BATCH_MINSIZE) " bytes</li>";
+      }
+    }
 
     if (error == "") {
       // success:
@@ -1658,6 +1671,11 @@ void OvmsWebServer::HandleCfgServerV3(PageEntry_t& p, PageContext_t& c)
         MyConfig.DeleteInstance("server.v3", "updatetime.keepalive");
       else
         MyConfig.SetParamValue("server.v3", "updatetime.keepalive", updatetime_keepalive);
+      MyConfig.SetParamValueBool("server.v3", "metrics.batch", metrics_batch);
+      if (metrics_batch_size == "")
+        MyConfig.DeleteInstance("server.v3", "metrics.batch.size");
+      else
+        MyConfig.SetParamValue("server.v3", "metrics.batch.size", metrics_batch_size);
 
       c.head(200);
       c.alert("success", "<p class=\"lead\">Server V3 (MQTT) connection configured.</p>");
@@ -1687,6 +1705,8 @@ void OvmsWebServer::HandleCfgServerV3(PageEntry_t& p, PageContext_t& c)
     updatetime_awake = MyConfig.GetParamValue("server.v3", "updatetime.awake");
     updatetime_sendall = MyConfig.GetParamValue("server.v3", "updatetime.sendall");
     updatetime_keepalive = MyConfig.GetParamValue("server.v3", "updatetime.keepalive");
+    metrics_batch = MyConfig.GetParamValueBool("server.v3", "metrics.batch", false);
+    metrics_batch_size = MyConfig.GetParamValue("server.v3", "metrics.batch.size");
 
     // generate form:
     c.head(200);
@@ -1740,6 +1760,15 @@ void OvmsWebServer::HandleCfgServerV3(PageEntry_t& p, PageContext_t& c)
 	  "appearing in the log."
 	  "</span>");
 
+  c.fieldset_start("Metrics");
+  c.input_checkbox("Batch metric updates", "metrics_batch", metrics_batch,
+    "<p>Send modified metrics collected as a single JSON object on <i>&lt;prefix&gt;</i>/metrics "
+    "instead of one retained topic per metric. This reduces the MQTT packet overhead, "
+    "but clients need to support the batch topic.</p>");
+  c.input_text("Batch size", "metrics_batch_size", metrics_batch_size.c_str(),
+    "optional, max payload bytes per packet, default: " STR(MQTT_METRICS_BATCH_SIZE));
+  c.fieldset_end();
+
   c.hr();
   c.input_button("default", "Save");
   c.form_end();
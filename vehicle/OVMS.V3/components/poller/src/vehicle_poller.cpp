@@ -32,6 +32,7 @@
 static const char *TAG = "vehicle-poll";
 
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
 #include <ovms_command.h>
 #include <ovms_script.h>
@@ -88,6 +89,7 @@ OvmsPoller::OvmsPoller(canbus* can, uint8_t can_number, OvmsPollers *parent,
   m_poll_repeat_count = 0;
   m_poll_sent_last = 0;
   m_poll_between_success = 0;
+  m_poll_assemble = false;
   }
 
 /** Handle incoming frame.
@@ -150,6 +152,28 @@ bool OvmsPoller::Incoming(CAN_frame_t &frame, bool success)
   return false;
   }
 
+/**
+ * IsResponseFrame: check if a frame matches the current response window
+ *  This is a lock free pre-check of the Incoming() ID filter, called in the
+ *  CAN task context. The window is set up before the request is sent, so
+ *  responses will match.
+ */
+bool OvmsPoller::IsResponseFrame(const CAN_frame_t &frame) const
+  {
+  if (frame.origin == nullptr)
+    return false;
+  if (frame.origin == m_poll_vwtp.bus && frame.MsgID == m_poll_vwtp.rxid)
+    return true;
+  if (frame.origin != m_poll.bus || m_poll.moduleid_high == 0)
+    return false;
+  uint32_t msgid;
+  if (m_poll.protocol == ISOTP_EXTADR)
+    msgid = frame.MsgID << 8 | frame.data.u8[0];
+  else
+    msgid = frame.MsgID;
+  return (msgid >= m_poll.moduleid_low && msgid <= m_poll.moduleid_high);
+  }
+
 OvmsPoller::~OvmsPoller()
   {
   }
@@ -173,6 +197,33 @@ void OvmsPoller::IncomingPollTxCallback(const OvmsPoller::poll_job_t &job, bool
   m_polls.IncomingTxReply(job, success);
   }
 
+/**
+ * IncomingPollPacket: forward a response frame payload for m_poll
+ *  Called by the protocol receivers under lock of m_poll_mutex.
+ *  Passes the frame payload on to the poll series, and if response assembly
+ *  is enabled, collects it and passes on the complete response after the
+ *  last frame.
+ */
+void OvmsPoller::IncomingPollPacket(uint8_t* data, uint16_t length)
+  {
+  m_polls.IncomingPacket(m_poll, data, length);
+
+  if (!m_poll_assemble)
+    return;
+  if (m_poll.mlframe == 0)
+    m_poll_response.Begin(length + m_poll.mlremain);
+  m_poll_response.Append(data, length);
+  if (m_poll.mlremain == 0)
+    {
+    if (m_poll_response.IsValid())
+      m_polls.IncomingResponse(m_poll, m_poll_response);
+    else
+      ESP_LOGW(TAG, "[%" PRIu8 "]IncomingPollPacket: response %02" PRIX16 "(%" PRIX16 ") too large, discarded",
+               m_poll.bus_no, m_poll.type, m_poll.pid);
+    m_poll_response.Clear();
+    }
+  }
+
 bool OvmsPoller::Ready() const
   {
   return m_parent->Ready();
@@ -279,6 +330,24 @@ void OvmsPoller::PollSetTimeBetweenSuccess(uint16_t time_between_ms)
   m_poll_between_success = pdMS_TO_TICKS(time_between_ms);
   }
 
+/**
+ * PollSetResponseAssembly: enable/disable collecting complete responses
+ *
+ *  With response assembly enabled, the poller collects the payload of each
+ *  (multi frame) response in a contiguous buffer and passes the complete
+ *  response to IncomingResponse() / IncomingPollResponse() once it has been
+ *  received. The per frame IncomingPollReply() calls are not affected.
+ *
+ *  @param enable
+ *    true = collect responses, default/init = false
+ */
+void OvmsPoller::PollSetResponseAssembly(bool enable)
+  {
+  m_poll_assemble = enable;
+  if (!enable)
+    m_poll_response.Clear();
+  }
+
 void OvmsPoller::ResetThrottle()
   {
   // Main Timer reset throttling counter,
@@ -804,6 +873,7 @@ const char *OvmsPoller::PollerCommand(OvmsPollCommand src, bool brief)
     case OvmsPollCommand::ResponseSep: return brief ? "RspSp" : "RespSep";
     case OvmsPollCommand::Keepalive:   return brief ? "KpAlv" : "Keepalive";
     case OvmsPollCommand::SuccessSep:  return brief ? "SucSp" : "SuccSep";
+    case OvmsPollCommand::Assemble:    return brief ? "Asmbl" : "Assemble";
     case OvmsPollCommand::Shutdown:    return brief ? "Shtdn" : "Shutdown";
     case OvmsPollCommand::ResetTimer:  return brief ? "RstTm" : "ResetTimer";
     }
@@ -816,6 +886,7 @@ OvmsPollers::OvmsPollers()
     m_poll_fc_septime(25),
     m_poll_ch_keepalive(60),
     m_poll_between_success(0),
+    m_poll_assemble(false),
     m_poll_last(0),
     m_pollqueue(nullptr), m_polltask(nullptr),
     m_timer_poller(nullptr),
@@ -827,7 +898,12 @@ OvmsPollers::OvmsPollers()
     m_paused(false),
     m_user_paused(false),
     m_trace(trace_Off),
-    m_filtered(false)
+    m_filtered(false),
+    m_framerx_active(false),
+    m_rx_poll(0),
+    m_rx_vehicle(0),
+    m_rx_discarded(0),
+    m_rx_buses(0)
 
   {
   ESP_LOGI(TAG, "Initialising Poller (7000)");
@@ -1050,7 +1126,9 @@ esp_err_t OvmsPollers::RegisterCanBus(int busno, CAN_mode_t mode, CAN_speed_t sp
   bus = info.can;
   info.auto_poweroff = autoPower;
   info.can->SetPowerMode(On);
-  return info.can->Start(mode,speed,dbcfile);
+  esp_err_t res = info.can->Start(mode,speed,dbcfile);
+  UpdateRxFilter();
+  return res;
   }
 
 void OvmsPollers::PowerDownCanBus(int busno)
@@ -1063,6 +1141,7 @@ void OvmsPollers::PowerDownCanBus(int busno)
 void OvmsPollers::Ticker1(std::string event, void* data)
   {
   PollerResetThrottle();
+  UpdateRxFilter();
   }
 
 void OvmsPollers::EventSystemShuttingDown(std::string event, void* data)
@@ -1165,16 +1244,99 @@ void OvmsPollers::PollerTxCallback(const CAN_frame_t* frame, bool success)
  */
 void OvmsPollers::PollerRxCallback(const CAN_frame_t* frame, bool success)
   {
+  if (m_shut_down)
+    return;
+
+  // Poll responses are always needed:
+  for (int i = 0; i < VEHICLE_MAXBUSSES; ++i)
+    {
+    OvmsPoller* poller = m_pollers[i];
+    if (poller && poller->IsResponseFrame(*frame))
+      {
+      m_rx_poll++;
+      Queue_PollerFrame(*frame, success, false);
+      return;
+      }
+    }
+
+  // Other frames only if the vehicle or the DBC decoder will process them:
+  if (!IsVehicleFrame(frame))
+    {
+    m_rx_discarded++;
+    return;
+    }
   if (m_filtered)
     {
     OvmsMutexLock lock(&m_filter_mutex, 0); // Don't block! (ever)
     // If not locked, just let it through.
     if (lock.IsLocked() && !m_filter.IsFiltered(frame))
+      {
+      m_rx_discarded++;
       return;
+      }
     }
+  m_rx_vehicle++;
   Queue_PollerFrame(*frame, success, false);
   }
 
+/**
+ * IsVehicleFrame: check if a frame is from a bus the vehicle registered
+ *  (and a FrameRx callback is active), or from a bus with a DBC attached
+ */
+bool OvmsPollers::IsVehicleFrame(const CAN_frame_t* frame)
+  {
+  canbus* bus = frame->origin;
+  if (bus == nullptr)
+    return false;
+  if (bus->GetDBC() != nullptr)
+    return true;
+  if (!m_framerx_active)
+    return false;
+  for (int i = 0; i < VEHICLE_MAXBUSSES; ++i)
+    {
+    if (m_canbusses[i].can == bus)
+      return true;
+    }
+  return false;
+  }
+
+/**
+ * UpdateRxFilter: restrict the RX callback to the buses IsVehicleFrame() and
+ *  the pollers can accept frames from (registered buses & buses with a DBC
+ *  attached), so the CAN task does not call it for other buses at all.
+ *  DBC attachments are not signalled, so Ticker1 checks for changes.
+ */
+void OvmsPollers::UpdateRxFilter()
+  {
+  if (m_shut_down)
+    return;
+  uint32_t buses = 0;
+  for (int i = 0; i < VEHICLE_MAXBUSSES; ++i)
+    {
+    if (m_canbusses[i].can)
+      buses |= (1 << m_canbusses[i].can->m_busnumber);
+    }
+  for (int i = 0; i < CAN_MAXBUSES; ++i)
+    {
+    canbus* bus = MyCan.GetBus(i);
+    if (bus && bus->GetDBC())
+      buses |= (1 << i);
+    }
+  if (buses == m_rx_buses)
+    return;
+  m_rx_buses = buses;
+  std::string filter;
+  for (int i = 0; i < CAN_MAXBUSES; ++i)
+    {
+    if (buses & (1 << i))
+      {
+      filter.append(filter.empty() ? "" : " ");
+      filter.append(1, '1'+i);
+      }
+    }
+  MyCan.SetCallbackFilter(TAG, filter.c_str());
+  }
+
 void OvmsPollers::ClearFilters()
   {
   m_filtered = false;
@@ -1615,6 +1777,18 @@ void OvmsPollers::PollerTask()
                 }
               }
             break;
+          case OvmsPoller::OvmsPollCommand::Assemble:
+            if ((entry.entry_Command.parameter != 0) != m_poll_assemble)
+              {
+              m_poll_assemble = (entry.entry_Command.parameter != 0);
+              OvmsRecMutexLock lock(&m_poller_mutex);
+              for (int i = 0 ; i < VEHICLE_MAXBUSSES; ++i)
+                {
+                if (m_pollers[i])
+                  m_pollers[i]->PollSetResponseAssembly(m_poll_assemble);
+                }
+              }
+            break;
           case OvmsPoller::OvmsPollCommand::ResetTimer:
             break;//triggered above
           }
@@ -1695,6 +1869,7 @@ OvmsPoller *OvmsPollers::GetPoller(canbus *can, bool force)
     newpoller->m_poll_sequence_max = m_poll_sequence_max;
     newpoller->m_poll_fc_septime = m_poll_fc_septime;
     newpoller->m_poll_ch_keepalive = m_poll_ch_keepalive;
+    newpoller->m_poll_assemble = m_poll_assemble;
     m_pollers[gap] = newpoller;
     }
 
@@ -1981,6 +2156,8 @@ void OvmsPollers::PollerStatus(int verbosity, OvmsWriter* writer)
     auto waiting = uxQueueMessagesWaiting(m_pollqueue);
     writer->printf("Poll Queue Length: %d\n", waiting);
     }
+  writer->printf("RX Frames: %" PRIu32 " poll responses, %" PRIu32 " vehicle, %" PRIu32 " discarded\n",
+    m_rx_poll, m_rx_vehicle, m_rx_discarded);
 
   if (IsPaused() || IsUserPaused())
     writer->printf("OBD polling is Paused %s%s\n", IsPaused() ? "[system]":"", IsUserPaused() ? "[user]" : "");
@@ -2489,6 +2666,16 @@ void OvmsPoller::PollSeriesList::RestartPoll(OvmsPoller::ResetMode mode)
     }
   }
 
+// Process a complete response.
+void OvmsPoller::PollSeriesList::IncomingResponse(const OvmsPoller::poll_job_t& job, const OvmsPollResponse& response)
+  {
+  if ((m_iter != nullptr) && (m_iter->series != nullptr))
+    {
+    IFTRACE(Poller) ESP_LOGD(TAG, "Poll List:[%s] IncomingResponse TYPE:%x PID: %03x LEN: %d", m_iter->name.c_str(), job.type, job.pid, response.size());
+    m_iter->series->IncomingResponse(job, response);
+    }
+  }
+
 // Process an incoming packet.
 void OvmsPoller::PollSeriesList::IncomingPacket(const OvmsPoller::poll_job_t& job, uint8_t* data, uint8_t length)
   {
@@ -2658,6 +2845,12 @@ void OvmsPoller::PollSeriesEntry::IncomingTxReply(const OvmsPoller::poll_job_t&
   // ignore
   }
 
+/// Process a complete response
+void OvmsPoller::PollSeriesEntry::IncomingResponse(const OvmsPoller::poll_job_t& job, const OvmsPollResponse& response)
+  {
+  // ignore
+  }
+
 bool OvmsPoller::PollSeriesEntry::Ready() const
   {
   return true;
@@ -2780,6 +2973,13 @@ void OvmsPoller::StandardVehiclePollSeries::IncomingPacket(const OvmsPoller::pol
    m_signal->IncomingPollReply(job, data, length);
  }
 
+// Process a complete response.
+void OvmsPoller::StandardVehiclePollSeries::IncomingResponse(const OvmsPoller::poll_job_t& job, const OvmsPollResponse& response)
+ {
+ if (m_signal)
+   m_signal->IncomingPollResponse(job, response);
+ }
+
 // Process An Error. 
 void OvmsPoller::StandardVehiclePollSeries::IncomingError(const OvmsPoller::poll_job_t& job, uint16_t code)
  {
@@ -3152,3 +3352,71 @@ OvmsPoller::SeriesStatus OvmsPoller::OnceOffPoll::FinishRun()
 void OvmsPoller::OnceOffPoll::Removing()
   {
   }
+
+// OvmsPollResponse class
+
+OvmsPollResponse::OvmsPollResponse()
+  : m_data(nullptr), m_size(0), m_capacity(0), m_overflow(false)
+  {
+  }
+
+OvmsPollResponse::~OvmsPollResponse()
+  {
+  if (m_data)
+    free(m_data);
+  }
+
+/**
+ * Reserve: make sure the buffer can hold length bytes
+ *  The buffer only grows (in steps of 64 bytes), it's kept for the next response.
+ */
+bool OvmsPollResponse::Reserve(uint16_t length)
+  {
+  if (length <= m_capacity)
+    return true;
+  if (length > POLL_RESPONSE_MAXSIZE)
+    return false;
+  uint16_t capacity = (length + 63) & ~63;
+  uint8_t* data = (uint8_t*) ExternalRamRealloc(m_data, capacity);
+  if (!data)
+    return false;
+  m_data = data;
+  m_capacity = capacity;
+  return true;
+  }
+
+/**
+ * Begin: start collecting a new response
+ *  @param length
+ *    Expected payload length (from the first frame)
+ */
+void OvmsPollResponse::Begin(uint16_t length)
+  {
+  m_size = 0;
+  m_overflow = !Reserve(length);
+  }
+
+/**
+ * Append: add the payload of the next response frame
+ */
+void OvmsPollResponse::Append(const uint8_t* data, uint16_t length)
+  {
+  if (m_overflow || length == 0)
+    return;
+  if (m_size + length > POLL_RESPONSE_MAXSIZE || !Reserve(m_size + length))
+    {
+    m_overflow = true;
+    return;
+    }
+  memcpy(m_data + m_size, data, length);
+  m_size += length;
+  }
+
+/**
+ * Clear: discard the payload, the buffer is kept
+ */
+void OvmsPollResponse::Clear()
+  {
+  m_size = 0;
+  m_overflow = false;
+  }
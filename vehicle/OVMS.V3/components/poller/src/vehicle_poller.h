@@ -25,6 +25,7 @@
 #define __VEHICLE_POLLER_H__
 
 #include "vehicle_common.h"
+#include "ovms_utils.h"
 
 #include <cstdint>
 #include <memory>
@@ -107,6 +108,65 @@ typedef struct
   uint32_t                lastused;         // Timestamp of last channel access
   } vwtp_channel_t;
 
+// Maximum response payload size (ISO-TP / VWTP first frame length is 12 bit):
+#define POLL_RESPONSE_MAXSIZE           4095
+
+/**
+ * OvmsPollResponse: contiguous poll response payload
+ *  Each bus poller owns one of these. If response assembly is enabled, the
+ *  payload of a (multi frame) response is collected in it, the buffer is sized
+ *  from the first frame length and kept for the next response, so it only
+ *  grows up to the largest response seen on the bus.
+ *
+ *  The typed getters read big endian values at a byte offset into the
+ *  payload and return false if the value is not completely within the payload.
+ */
+class OvmsPollResponse
+  {
+  public:
+    OvmsPollResponse();
+    ~OvmsPollResponse();
+
+  public:
+    void Begin(uint16_t length);
+    void Append(const uint8_t* data, uint16_t length);
+    void Clear();
+    bool IsValid() const { return !m_overflow; }
+
+  public:
+    const uint8_t* data() const { return m_data; }
+    uint16_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    bool GetUint8(uint16_t offset, uint8_t &value) const
+      { return get_uint_bytes_be<1, uint8_t>(m_data, offset, m_size, value); }
+    bool GetUint16(uint16_t offset, uint16_t &value) const
+      { return get_uint_bytes_be<2, uint16_t>(m_data, offset, m_size, value); }
+    bool GetUint24(uint16_t offset, uint32_t &value) const
+      { return get_uint_bytes_be<3, uint32_t>(m_data, offset, m_size, value); }
+    bool GetUint32(uint16_t offset, uint32_t &value) const
+      { return get_uint_bytes_be<4, uint32_t>(m_data, offset, m_size, value); }
+    bool GetInt8(uint16_t offset, int8_t &value) const
+      { return get_int_bytes_be<1, int8_t>(m_data, offset, m_size, value); }
+    bool GetInt16(uint16_t offset, int16_t &value) const
+      { return get_int_bytes_be<2, int16_t>(m_data, offset, m_size, value); }
+    bool GetInt24(uint16_t offset, int32_t &value) const
+      { return get_int_bytes_be<3, int32_t>(m_data, offset, m_size, value); }
+    bool GetInt32(uint16_t offset, int32_t &value) const
+      { return get_int_bytes_be<4, int32_t>(m_data, offset, m_size, value); }
+    bool GetBytes(uint16_t offset, uint16_t length, std::string &value) const
+      { return offset + length <= m_size && get_buff_string(m_data, m_size, offset, length, value); }
+
+  protected:
+    bool Reserve(uint16_t length);
+
+  protected:
+    uint8_t*          m_data;                 // Payload buffer
+    uint16_t          m_size;                 // Payload length
+    uint16_t          m_capacity;             // Buffer size
+    bool              m_overflow;             // Payload exceeded max size / memory
+  };
+
 class OvmsPollers;
 
 class OvmsPoller : public InternalRamAllocated {
@@ -176,6 +236,7 @@ class OvmsPoller : public InternalRamAllocated {
         virtual ~VehicleSignal() { }
         // Signals for vehicle
         virtual void IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length);
+        virtual void IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response) { }
         virtual void IncomingPollError(const OvmsPoller::poll_job_t &job, uint16_t code);
         virtual void IncomingPollTxCallback(const OvmsPoller::poll_job_t &job, bool success);
         virtual bool Ready() const = 0;
@@ -217,6 +278,8 @@ class OvmsPoller : public InternalRamAllocated {
         virtual OvmsPoller::OvmsNextPollResult NextPollEntry(poll_pid_t &entry, uint8_t mybus, uint32_t pollticker, uint8_t pollstate) = 0;
         /// Process an incoming packet.
         virtual void IncomingPacket(const OvmsPoller::poll_job_t& job, uint8_t* data, uint8_t length) = 0;
+        /// Process a complete response (only if response assembly is enabled)
+        virtual void IncomingResponse(const OvmsPoller::poll_job_t& job, const OvmsPollResponse& response);
         /// Process An Error
         virtual void IncomingError(const OvmsPoller::poll_job_t& job, uint16_t code) = 0;
 
@@ -293,6 +356,9 @@ class OvmsPoller : public InternalRamAllocated {
         /// Process an incoming packet.
         void IncomingPacket(const OvmsPoller::poll_job_t& job, uint8_t* data, uint8_t length);
 
+        /// Process a complete response.
+        void IncomingResponse(const OvmsPoller::poll_job_t& job, const OvmsPollResponse& response);
+
         /// Process An Error
         void IncomingError(const OvmsPoller::poll_job_t& job, uint16_t code);
 
@@ -378,6 +444,9 @@ class OvmsPoller : public InternalRamAllocated {
         // Process an incoming packet.
         void IncomingPacket(const OvmsPoller::poll_job_t& job, uint8_t* data, uint8_t length) override;
 
+        // Process a complete response.
+        void IncomingResponse(const OvmsPoller::poll_job_t& job, const OvmsPollResponse& response) override;
+
         // Process An Error
         void IncomingError(const OvmsPoller::poll_job_t& job, uint16_t code) override;
 
@@ -557,6 +626,8 @@ class OvmsPoller : public InternalRamAllocated {
     uint8_t           m_poll_fc_septime;      // Flow control separation time for multi frame responses
     uint16_t          m_poll_ch_keepalive;    // Seconds to keep an inactive channel (e.g. VWTP) alive (default: 60)
     uint16_t          m_poll_between_success;
+    bool              m_poll_assemble;        // Collect responses in m_poll_response
+    OvmsPollResponse  m_poll_response;        // Response assembly buffer
     bool              m_poll_ticked;
     bool              m_poll_run_finished;
 
@@ -576,6 +647,7 @@ class OvmsPoller : public InternalRamAllocated {
       m_polls.IncomingError(job, code);
       }
     void IncomingPollTxCallback(const OvmsPoller::poll_job_t &job, bool success);
+    void IncomingPollPacket(uint8_t* data, uint16_t length);
 
     bool Ready() const;
   private:
@@ -606,6 +678,7 @@ class OvmsPoller : public InternalRamAllocated {
     void PollerNextTick(poller_source_t source);
 
     bool Incoming(CAN_frame_t &frame, bool success);
+    bool IsResponseFrame(const CAN_frame_t &frame) const;
     void Outgoing(const CAN_frame_t &frame, bool success);
 
     // Check for throttling.
@@ -627,6 +700,7 @@ class OvmsPoller : public InternalRamAllocated {
       ResponseSep,
       Keepalive,
       SuccessSep,
+      Assemble,
       Shutdown,
       ResetTimer
       };
@@ -680,6 +754,7 @@ class OvmsPoller : public InternalRamAllocated {
     void PollSetResponseSeparationTime(uint8_t septime);
     void PollSetChannelKeepalive(uint16_t keepalive_seconds);
     void PollSetTimeBetweenSuccess(uint16_t time_between_ms);
+    void PollSetResponseAssembly(bool enable);
 
     // TODO - Work out how to make sure these are protected. Reduce/eliminate mutex time.
     void PollSetPidList(uint8_t defaultbus, const poll_pid_t* plist, VehicleSignal *signal);
@@ -719,6 +794,7 @@ class OvmsPollers : public InternalRamAllocated {
     uint8_t           m_poll_fc_septime;      // Flow control separation time for multi frame responses
     uint16_t          m_poll_ch_keepalive;    // Seconds to keep an inactive channel (e.g. VWTP) alive (default: 60)
     uint16_t          m_poll_between_success;
+    bool              m_poll_assemble;        // Response assembly enabled
     uint32_t          m_poll_last;
 
     _Alignas(32 / CHAR_BIT)
@@ -742,6 +818,11 @@ class OvmsPollers : public InternalRamAllocated {
     OvmsMutex         m_filter_mutex;
     canfilter         m_filter;
     bool              m_filtered;
+    bool              m_framerx_active;       // FrameRx callbacks registered
+    uint32_t          m_rx_poll;              // RX frames queued as poll responses
+    uint32_t          m_rx_vehicle;           // RX frames queued for vehicle / DBC processing
+    uint32_t          m_rx_discarded;         // RX frames not queued
+    uint32_t          m_rx_buses;             // Buses the RX callback is filtered to, 0 = all
 
     void PollerTxCallback(const CAN_frame_t* frame, bool success);
     void PollerRxCallback(const CAN_frame_t* frame, bool success);
@@ -750,6 +831,8 @@ class OvmsPollers : public InternalRamAllocated {
     static void OvmsPollerTask(void *pvParameters);
 
     void Queue_PollerFrame(const CAN_frame_t &frame, bool success, bool istx);
+    bool IsVehicleFrame(const CAN_frame_t* frame);
+    void UpdateRxFilter();
 
     void Queue_Command(OvmsPoller::OvmsPollCommand cmd, uint16_t param = 0);
     static void vehicle_poller_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv);
@@ -870,11 +953,19 @@ class OvmsPollers : public InternalRamAllocated {
     void RegisterPollStateTicker(const std::string &name, PollCallback fn) { m_pollstateticker_callback.Register(name, fn);}
     void DeregisterPollStateTicker(const std::string &name) { m_pollstateticker_callback.Deregister(name);}
 
+    /** Register a callback for received frames.
+     *  Frames are passed on from buses registered via RegisterCanBus() and buses
+     *  with a DBC attached (subject to the vehicle filters), plus poll responses.
+     */
     void RegisterFrameRx(const std::string &name, FrameCallback fn) {
       m_framerx_callback.Register(name, fn);
+      m_framerx_active = m_framerx_callback.HasCallbacks();
       CheckStartPollTask(true);
     }
-    void DeregisterFrameRx(const std::string &name) { m_framerx_callback.Deregister(name);}
+    void DeregisterFrameRx(const std::string &name) {
+      m_framerx_callback.Deregister(name);
+      m_framerx_active = m_framerx_callback.HasCallbacks();
+    }
   private:
     void PollRunFinished(canbus *bus)
       {
@@ -892,10 +983,10 @@ class OvmsPollers : public InternalRamAllocated {
           cb(bus, nullptr);
           });
       }
-    void PollerFrameRx(CAN_frame_t &frame)
+    void PollerFrameRx(const CAN_frame_t &frame)
       {
       m_framerx_callback.Call(
-        [frame](const std::string &name, FrameCallback cb)
+        [&frame](const std::string &name, const FrameCallback &cb)
           {
           cb(frame);
           });
@@ -954,6 +1045,10 @@ class OvmsPollers : public InternalRamAllocated {
       {
       Queue_Command(OvmsPoller::OvmsPollCommand::SuccessSep, time_between_ms);
       }
+    void PollSetResponseAssembly(bool enable)
+      {
+      Queue_Command(OvmsPoller::OvmsPollCommand::Assemble, (int)enable);
+      }
     // signal poller
     void PollerResetThrottle();
 
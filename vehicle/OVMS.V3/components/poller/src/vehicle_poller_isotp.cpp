@@ -468,7 +468,7 @@ bool OvmsPoller::PollerISOTPReceive(CAN_frame_t* frame, uint32_t msgid)
       {
       OvmsRecMutexLock lock(&m_poll_mutex);
       m_poll.moduleid_rec = msgid;
-      m_polls.IncomingPacket(m_poll, response_data, response_datalen);
+      IncomingPollPacket(response_data, response_datalen);
       }
     }
   else
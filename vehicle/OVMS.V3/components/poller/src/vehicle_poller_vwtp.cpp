@@ -728,7 +728,7 @@ bool OvmsPoller::PollerVWTPReceive(CAN_frame_t* frame, uint32_t msgid)
             {
             OvmsRecMutexLock lock(&m_poll_mutex);
             m_poll.moduleid_rec = msgid;
-            m_polls.IncomingPacket(m_poll, response_data, response_datalen);
+            IncomingPollPacket(response_data, response_datalen);
             }
           }
         else
@@ -32,6 +32,9 @@
 static const char *TAG = "re";
 
 #include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <esp_timer.h>
 #include "retools.h"
 #include "dbc_app.h"
 #include "ovms.h"
@@ -110,30 +113,25 @@ static void RE_task(void *pvParameters)
 
 void re::Task()
   {
-  CAN_log_message_t message;
+  CAN_frame_t frames[RE_READ_BATCH];
 
   while(1)
     {
-    if (xQueueReceive(m_rxqueue, &message.frame, (portTickType)portMAX_DELAY)==pdTRUE)
+    int cnt = m_reader->Read(frames, RE_READ_BATCH, portMAX_DELAY);
+    if (cnt > 0 && MyRE != NULL) // Protect against MyRE not set (during init)
       {
-      if (MyRE != NULL) // Protect against MyRE not set (during init)
+      for (int i = 0; i < cnt; i++)
         {
         switch (m_mode)
           {
           case Analyse:
           case Discover:
-            if ((m_filter)&&(!m_filter->IsFiltered(&message.frame)))
-              {
-              // Frame is filtered, just drop it...
-              }
-            else
-              {
-              DoAnalyse(&message.frame);
-              }
+            // Frames have been filtered by the ring reader
+            DoAnalyse(&frames[i]);
             break;
           }
-        m_finished = monotonictime;
         }
+      m_finished = monotonictime;
       }
     }
   }
@@ -143,15 +141,17 @@ void re::DoAnalyse(CAN_frame_t* frame)
   char vbuf[256];
 
   OvmsRecMutexLock lock(&m_mutex);
-  std::string key = GetKey(frame);
-  auto k = m_rmap.find(key);
-  re_record_t* r;
-  if (m_rmap.size() == 0) m_started = monotonictime;
-  if (k == m_rmap.end())
-    {
-    r = k->second;
-    r = new re_record_t;
-    memset(r,0,sizeof(re_record_t));
+  uint64_t key = GetKey(frame);
+  int64_t now = esp_timer_get_time();
+  if (m_count == 0) m_started = monotonictime;
+  re_record_t* r = FindRecord(key, true);
+  if (r == NULL)
+    {
+    m_dropped++;
+    return;
+    }
+  if (r->rxcount == 0)
+    {
     r->attr.b.Changed = 1; // Mark the whole ID as changed
     r->attr.dc = 0xff;
     switch (MyRE->m_mode)
@@ -163,14 +163,12 @@ void re::DoAnalyse(CAN_frame_t* frame)
         r->attr.dd = 0xff;
         HighlightDump(vbuf, (const char*)frame->data.u8, frame->FIR.B.DLC, r->attr.dc, r->attr.dd);
         ESP_LOGV(TAG, "Discovered new %s%s%s %s",
-          re_green[0][0], key.c_str(), re_green[0][1], vbuf);
+          re_green[0][0], FormatKey(key).c_str(), re_green[0][1], vbuf);
         break;
       }
-    m_rmap[key] = r;
     }
   else
     {
-    r = k->second;
     switch (MyRE->m_mode)
       {
       case Analyse:
@@ -197,31 +195,111 @@ void re::DoAnalyse(CAN_frame_t* frame)
         if (found)
           {
           HighlightDump(vbuf, (const char*)frame->data.u8, frame->FIR.B.DLC, r->attr.dc, r->attr.dd);
-          ESP_LOGV(TAG, "Discovered change %s %s", k->first.c_str(), vbuf);
+          ESP_LOGV(TAG, "Discovered change %s %s", FormatKey(key).c_str(), vbuf);
           }
         break;
         }
       }
+
+    // Update inter-arrival time statistics (n = number of periods):
+    uint32_t period = now - r->rxtime;
+    uint32_t n = r->rxcount;
+    if (n == 1 || period < r->period_min) r->period_min = period;
+    if (period > r->period_max) r->period_max = period;
+    float delta = (float)period - r->period_mean;
+    r->period_mean += delta / n;
+    r->period_m2 += delta * ((float)period - r->period_mean);
     }
   memcpy(&r->last,frame,sizeof(CAN_frame_t));
+  r->rxtime = now;
   r->rxcount++;
   }
 
-std::string re::GetKey(CAN_frame_t* frame)
+/**
+ * FindRecord: lookup record by key in the hash table
+ *  create: true = insert new record if not found
+ *  Returns NULL if not found / table is full and cannot grow.
+ *  Note: creating records may move the table, invalidating record pointers.
+ */
+re_record_t* re::FindRecord(uint64_t key, bool create)
   {
-  std::string key;
-  if (frame->origin != NULL)
-    key = std::string(frame->origin->GetName());
-  else
-    key = std::string("can?");
-  key.append("/");
+  if (m_records == NULL)
+    return NULL;
 
-  char id[9];
-  if (frame->FIR.B.FF == CAN_frame_std)
-    sprintf(id,"%03" PRIx32,frame->MsgID);
-  else
-    sprintf(id,"%08" PRIx32,frame->MsgID);
-  key.append(id);
+  // Fibonacci hashing, linear probing:
+  uint32_t mask = m_capacity - 1;
+  uint32_t i = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+  while (m_records[i].key != 0)
+    {
+    if (m_records[i].key == key)
+      return &m_records[i];
+    i = (i + 1) & mask;
+    }
+  if (!create)
+    return NULL;
+
+  // New key: grow the table beyond the load limit. If that fails, continue
+  //  in the current table up to one free slot (terminating the probe loop).
+  if (m_count >= RE_TABLE_MAXLOAD(m_capacity))
+    {
+    if (!m_growfailed && GrowTable())
+      {
+      mask = m_capacity - 1;
+      i = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+      while (m_records[i].key != 0)
+        i = (i + 1) & mask;
+      }
+    else if (m_count >= m_capacity-1)
+      {
+      return NULL;
+      }
+    }
+
+  re_record_t* r = &m_records[i];
+  memset(r, 0, sizeof(re_record_t));
+  r->key = key;
+  m_count++;
+  return r;
+  }
+
+bool re::GrowTable()
+  {
+  uint32_t capacity = m_capacity * 2;
+  re_record_t* records = (re_record_t*) ExternalRamMalloc(capacity * sizeof(re_record_t));
+  if (records == NULL)
+    {
+    ESP_LOGE(TAG, "GrowTable: out of memory for %" PRIu32 " records, new IDs will be dropped when full", capacity);
+    m_growfailed = true;
+    return false;
+    }
+  memset(records, 0, capacity * sizeof(re_record_t));
+
+  re_record_t* old = m_records;
+  uint32_t oldcapacity = m_capacity;
+  m_records = records;
+  m_capacity = capacity;
+  uint32_t mask = m_capacity - 1;
+  for (uint32_t k = 0; k < oldcapacity; k++)
+    {
+    if (old[k].key == 0) continue;
+    uint32_t i = (uint32_t)((old[k].key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (m_records[i].key != 0)
+      i = (i + 1) & mask;
+    m_records[i] = old[k];
+    }
+  free(old);
+
+  ESP_LOGD(TAG, "GrowTable: %" PRIu32 " records, %" PRIu32 " used", m_capacity, m_count);
+  return true;
+  }
+
+uint64_t re::GetKey(CAN_frame_t* frame)
+  {
+  uint64_t key = RE_KEY_VALID | (frame->MsgID & RE_KEY_ID_MASK);
+  if (frame->origin != NULL)
+    key |= (uint64_t)(frame->origin->m_busnumber + 1) << RE_KEY_BUS_SHIFT;
+  if (frame->FIR.B.FF == CAN_frame_ext)
+    key |= RE_KEY_EXT;
 
   if (((m_obdii_std_min>0) &&
        (frame->FIR.B.FF == CAN_frame_std) &&
@@ -240,24 +318,13 @@ std::string re::GetKey(CAN_frame_t* frame)
       return key;
       }
     uint8_t mode = frame->data.u8[1];
-    char req[16];
-    if (mode > 0x4a)
-      {
-      sprintf(req,":O2Pm%d:%d",mode-0x40,((int)frame->data.u8[2]<<8)+frame->data.u8[3]);
-      }
-    else if (mode > 0x40)
-      {
-      sprintf(req,":O2Pm%d:%d",mode-0x40,(int)frame->data.u8[2]);
-      }
-    else if (mode > 0x0a)
-      {
-      sprintf(req,":O2Qm%d:%d",mode,((int)frame->data.u8[2]<<8)+frame->data.u8[3]);
-      }
+    uint32_t pid;
+    if (mode > 0x4a || (mode > 0x0a && mode <= 0x40))
+      pid = ((uint32_t)frame->data.u8[2]<<8) + frame->data.u8[3];
     else
-      {
-      sprintf(req,":O2Qm%d:%d",mode,(int)frame->data.u8[2]);
-      }
-    key.append(req);
+      pid = frame->data.u8[2];
+    key |= ((uint64_t)RE_MUX_OBD << RE_KEY_MUX_SHIFT)
+        | ((uint64_t)((mode << 16) | pid) << RE_KEY_MUXVAL_SHIFT);
     return key;
     }
 
@@ -274,9 +341,8 @@ std::string re::GetKey(CAN_frame_t* frame)
         dbcSignal* s = m->GetMultiplexorSignal();
         dbcNumber muxn = s->Decode(frame->data.u8, 8);
         uint32_t mux = muxn.GetUnsignedInteger();
-        char b[8];
-        sprintf(b,":%04" PRIx32,mux);
-        key.append(b);
+        key |= ((uint64_t)RE_MUX_DBC << RE_KEY_MUX_SHIFT)
+            | ((uint64_t)(mux & RE_KEY_MUXVAL_MASK) << RE_KEY_MUXVAL_SHIFT);
         }
       }
     }
@@ -284,6 +350,69 @@ std::string re::GetKey(CAN_frame_t* frame)
   return key;
   }
 
+std::string re::FormatKey(uint64_t key)
+  {
+  char buf[40];
+  char* s = buf;
+  int bus = (key >> RE_KEY_BUS_SHIFT) & 0x0f;
+  uint32_t id = key & RE_KEY_ID_MASK;
+  uint32_t muxval = (key >> RE_KEY_MUXVAL_SHIFT) & RE_KEY_MUXVAL_MASK;
+
+  if (bus)
+    s += sprintf(s, "can%d/", bus);
+  else
+    s += sprintf(s, "can?/");
+  if (key & RE_KEY_EXT)
+    s += sprintf(s, "%08" PRIx32, id);
+  else
+    s += sprintf(s, "%03" PRIx32, id);
+
+  switch ((key >> RE_KEY_MUX_SHIFT) & 0x03)
+    {
+    case RE_MUX_OBD:
+      {
+      int mode = muxval >> 16;
+      int pid = muxval & 0xffff;
+      if (mode > 0x40)
+        sprintf(s, ":O2Pm%d:%d", mode-0x40, pid);
+      else
+        sprintf(s, ":O2Qm%d:%d", mode, pid);
+      break;
+      }
+    case RE_MUX_DBC:
+      sprintf(s, ":%04" PRIx32, muxval);
+      break;
+    default:
+      break;
+    }
+
+  return std::string(buf);
+  }
+
+/**
+ * GetRecords: get records sorted by key string, optionally filtered by key substring
+ *  Note: caller needs to hold m_mutex while using the record pointers.
+ */
+re_record_list_t re::GetRecords(const char* filter /*=NULL*/)
+  {
+  re_record_list_t list;
+  list.reserve(m_count);
+  for (uint32_t k = 0; k < m_capacity; k++)
+    {
+    re_record_t* r = &m_records[k];
+    if (r->key == 0) continue;
+    std::string key = FormatKey(r->key);
+    if (filter == NULL || strstr(key.c_str(), filter) != NULL)
+      list.push_back(std::make_pair(key, r));
+    }
+  std::sort(list.begin(), list.end(),
+    [](const std::pair<std::string, re_record_t*>& a, const std::pair<std::string, re_record_t*>& b)
+      {
+      return a.first < b.first;
+      });
+  return list;
+  }
+
 re::re(const char* name, canfilter* filter)
   : pcp(name)
   {
@@ -295,19 +424,40 @@ re::re(const char* name, canfilter* filter)
   m_started = monotonictime;
   m_finished = monotonictime;
   m_mode = Analyse;
-  m_rxqueue = xQueueCreate(20,sizeof(CAN_frame_t));
-  xTaskCreatePinnedToCore(RE_task, "OVMS RE", 4096, (void*)this, 5, &m_task, CORE(1));
-  MyCan.RegisterListener(m_rxqueue, true);
+  m_capacity = 1 << RE_TABLE_MINBITS;
+  m_count = 0;
+  m_dropped = 0;
+  m_growfailed = false;
+  m_records = (re_record_t*) ExternalRamMalloc(m_capacity * sizeof(re_record_t));
+  if (m_records)
+    memset(m_records, 0, m_capacity * sizeof(re_record_t));
+  else
+    {
+    ESP_LOGE(TAG, "Out of memory for record table");
+    m_capacity = 0;
+    }
+  m_task = NULL;
+  // The ring reader applies the filter, so unwanted frames are not even stored:
+  m_reader = MyCan.RegisterRingReader("retools", true, (m_filter) ? m_filter->Info().c_str() : NULL);
+  if (m_reader)
+    xTaskCreatePinnedToCore(RE_task, "OVMS RE", 4096, (void*)this, 5, &m_task, CORE(1));
+  else
+    ESP_LOGE(TAG, "Cannot register CAN ring reader, RE tools not receiving");
   }
 
 re::~re()
   {
   OvmsRecMutexLock lock(&m_mutex);
-  MyCan.DeregisterListener(m_rxqueue);
+  if (m_task)
+    vTaskDelete(m_task);
+  MyCan.DeregisterRingReader(m_reader);
 
   Clear();
-  vQueueDelete(m_rxqueue);
-  vTaskDelete(m_task);
+  if (m_records)
+    {
+    free(m_records);
+    m_records = NULL;
+    }
   if (m_filter)
     {
     delete m_filter;
@@ -335,11 +485,11 @@ void re::SetPowerMode(PowerMode powermode)
 
 void re::Clear()
   {
-  for (re_record_map_t::iterator it=m_rmap.begin(); it!=m_rmap.end(); ++it)
-    {
-    delete it->second;
-    }
-  m_rmap.clear();
+  if (m_records)
+    memset(m_records, 0, m_capacity * sizeof(re_record_t));
+  m_count = 0;
+  m_dropped = 0;
+  m_growfailed = false;
   m_started = monotonictime;
   m_finished = monotonictime;
   }
@@ -354,6 +504,7 @@ void re_start(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, con
     if (argc>0)
       {
       filter = new canfilter();
+      filter->BeginUpdate();
       bool has_valid = false;
       for (int k=0;k<argc;k++)
         {
@@ -364,6 +515,7 @@ void re_start(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, con
           writer->printf("Invalid Filter: '%s'\n", argv[k]);
           }
         }
+      filter->EndUpdate();
       if (!has_valid)
         {
         writer->puts("No valid filters, not started");
@@ -409,6 +561,36 @@ void re_clear(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, con
   MyEvents.SignalEvent("retools.cleared.all", NULL);
   }
 
+static uint32_t re_period_ms(re_record_t* r, uint32_t tdiff)
+  {
+  // Measured average period if available, else estimate from the run time:
+  if (r->rxcount > 1)
+    return (uint32_t)(r->period_mean / 1000);
+  else
+    return tdiff / r->rxcount;
+  }
+
+static void re_list_header(OvmsWriter* writer)
+  {
+  writer->printf("%-20.20s %10s %6s %7s %7s %7s %s\n","key","records","ms","min","max","jitter","last");
+  }
+
+static void re_list_record(OvmsWriter* writer, const std::string& key, re_record_t* r, uint32_t tdiff, const char* vbuf)
+  {
+  if (r->rxcount > 1)
+    {
+    writer->printf("%-20s %10" PRId32 " %6" PRId32 " %7.1f %7.1f %7.1f %s\n",
+      key.c_str(), r->rxcount, re_period_ms(r, tdiff),
+      (float)r->period_min / 1000, (float)r->period_max / 1000,
+      sqrtf(r->period_m2 / (r->rxcount-1)) / 1000, vbuf);
+    }
+  else
+    {
+    writer->printf("%-20s %10" PRId32 " %6" PRId32 " %7s %7s %7s %s\n",
+      key.c_str(), r->rxcount, re_period_ms(r, tdiff), "-", "-", "-", vbuf);
+    }
+  }
+
 void re_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   if (!MyRE)
@@ -421,17 +603,14 @@ void re_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, cons
   if (tdiff == 0) tdiff = 1000;
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  writer->printf("%-20.20s %10s %6s %s\n","key","records","ms","last");
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  re_record_list_t list = MyRE->GetRecords((argc>0) ? argv[0] : NULL);
+  re_list_header(writer);
+  for (re_record_list_t::iterator it=list.begin(); it!=list.end(); ++it)
     {
-    if ((argc==0)||(strstr(it->first.c_str(),argv[0])))
-      {
-      char vbuf[48];
-      char *s = vbuf;
-      FormatHexDump(&s, (const char*)it->second->last.data.u8, it->second->last.FIR.B.DLC, 8);
-      writer->printf("%-20s %10" PRId32 " %6" PRId32 " %s\n",
-        it->first.c_str(),it->second->rxcount,(tdiff/it->second->rxcount),vbuf);
-      }
+    char vbuf[48];
+    char *s = vbuf;
+    FormatHexDump(&s, (const char*)it->second->last.data.u8, it->second->last.FIR.B.DLC, 8);
+    re_list_record(writer, it->first, it->second, tdiff, vbuf);
     }
   }
 
@@ -448,22 +627,20 @@ void re_stream_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int arg
   if (tdiff == 0) tdiff = 1000;
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
+  re_record_list_t list = MyRE->GetRecords((argc>0) ? argv[0] : NULL);
   writer->printf("[");
   int cnt = 0;
   char *ascii = NULL;
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  for (re_record_list_t::iterator it=list.begin(); it!=list.end(); ++it)
     {
-    if (argc == 0 || strstr(it->first.c_str(),argv[0]) != NULL)
-      {
-      HighlightDump(vbuf, (const char*)it->second->last.data.u8,
-        it->second->last.FIR.B.DLC, it->second->attr.dc, it->second->attr.dd, 1, &ascii);
-      writer->printf("%s[\"%s\",%" PRId32 ",%" PRId32 ",\"%s\",\"%s\"]\n",
-        cnt ? "," : "",
-        json_encode(it->first).c_str(), it->second->rxcount, (tdiff/it->second->rxcount),
-        json_encode(std::string(vbuf)).c_str(),
-        json_encode(std::string(ascii)).c_str());
-      cnt++;
-      }
+    HighlightDump(vbuf, (const char*)it->second->last.data.u8,
+      it->second->last.FIR.B.DLC, it->second->attr.dc, it->second->attr.dd, 1, &ascii);
+    writer->printf("%s[\"%s\",%" PRId32 ",%" PRId32 ",\"%s\",\"%s\"]\n",
+      cnt ? "," : "",
+      json_encode(it->first).c_str(), it->second->rxcount, re_period_ms(it->second, tdiff),
+      json_encode(std::string(vbuf)).c_str(),
+      json_encode(std::string(ascii)).c_str());
+    cnt++;
     }
   writer->puts("]");
   }
@@ -480,28 +657,25 @@ void re_dbc_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
   if (tdiff == 0) tdiff = 1000;
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  writer->printf("%-20.20s %10s %6s %s\n","key","records","ms","last");
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
-    {
-    if ((argc==0)||(strstr(it->first.c_str(),argv[0])))
+  re_record_list_t list = MyRE->GetRecords((argc>0) ? argv[0] : NULL);
+  re_list_header(writer);
+  for (re_record_list_t::iterator it=list.begin(); it!=list.end(); ++it)
+    {
+    char vbuf[48];
+    char *s = vbuf;
+    FormatHexDump(&s, (const char*)it->second->last.data.u8, it->second->last.FIR.B.DLC, 8);
+    re_list_record(writer, it->first, it->second, tdiff, vbuf);
+    re_record_t *re_record = it->second;
+    if (re_record->last.origin)
       {
-      char vbuf[48];
-      char *s = vbuf;
-      FormatHexDump(&s, (const char*)it->second->last.data.u8, it->second->last.FIR.B.DLC, 8);
-      writer->printf("%-20s %10" PRId32 " %6" PRId32 " %s\n",
-        it->first.c_str(),it->second->rxcount,(tdiff/it->second->rxcount),vbuf);
-      re_record_t *re_record = it->second;
-      if (re_record->last.origin)
+      dbcfile* dbc = re_record->last.origin->GetDBC();
+      if (dbc)
         {
-        dbcfile* dbc = re_record->last.origin->GetDBC();
-        if (dbc)
-          {
-          // We have a DBC attached.
-          dbc->DecodeSignal(
-              re_record->last.FIR.B.FF, re_record->last.MsgID,
-              re_record->last.data.u8, 8,
-              writer);
-          }
+        // We have a DBC attached.
+        dbc->DecodeSignal(
+            re_record->last.FIR.B.FF, re_record->last.MsgID,
+            re_record->last.data.u8, 8,
+            writer);
         }
       }
     }
@@ -531,17 +705,21 @@ void re_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, co
     }
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  writer->printf("Key Map: %d entries\n",MyRE->m_rmap.size());
-  if (MyRE->m_rmap.size() > 0)
+  writer->printf("Key Map: %" PRIu32 " entries (table size %" PRIu32 ", %u KB)\n",
+    MyRE->m_count, MyRE->m_capacity, (MyRE->m_capacity * sizeof(re_record_t) + 512) / 1024);
+  if (MyRE->m_dropped > 0)
+    writer->printf("         %" PRIu32 " frames dropped (out of memory)\n", MyRE->m_dropped);
+  if (MyRE->m_count > 0)
     {
     int nignored = 0;
     int nchanged = 0;
     int bchanged = 0;
     int ndiscovered = 0;
     int bdiscovered = 0;
-    for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+    for (uint32_t k=0; k<MyRE->m_capacity; k++)
       {
-      re_record_t *r = it->second;
+      re_record_t *r = &MyRE->m_records[k];
+      if (r->key == 0) continue;
       if (r->attr.b.Ignore) nignored++;
       if (r->attr.b.Changed) nchanged++;
       if (r->attr.b.Discovered) ndiscovered++;
@@ -610,10 +788,10 @@ void re_mode_discover(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
     }
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  for (uint32_t k=0; k<MyRE->m_capacity; k++)
     {
-    it->second->attr.b.Discovered = 0;
-    it->second->attr.dd = 0;
+    MyRE->m_records[k].attr.b.Discovered = 0;
+    MyRE->m_records[k].attr.dd = 0;
     }
 
   MyRE->m_mode = Discover;
@@ -630,10 +808,10 @@ void re_clear_changed(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int a
     }
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  for (uint32_t k=0; k<MyRE->m_capacity; k++)
     {
-    it->second->attr.b.Changed = 0;
-    it->second->attr.dc = 0;
+    MyRE->m_records[k].attr.b.Changed = 0;
+    MyRE->m_records[k].attr.dc = 0;
     }
 
   if (MyNotify.HasReader("stream", "retools.list"))
@@ -656,10 +834,10 @@ void re_clear_discovered(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, in
     }
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  for (uint32_t k=0; k<MyRE->m_capacity; k++)
     {
-    it->second->attr.b.Discovered = 0;
-    it->second->attr.dd = 0;
+    MyRE->m_records[k].attr.b.Discovered = 0;
+    MyRE->m_records[k].attr.dd = 0;
     }
 
   if (MyNotify.HasReader("stream", "retools.list"))
@@ -686,18 +864,15 @@ void re_list_changed(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int ar
   if (tdiff == 0) tdiff = 1000;
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  writer->printf("%-20.20s %10s %6s %s\n","key","records","ms","last");
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  re_record_list_t list = MyRE->GetRecords((argc>0) ? argv[0] : NULL);
+  re_list_header(writer);
+  for (re_record_list_t::iterator it=list.begin(); it!=list.end(); ++it)
     {
     if ((it->second->attr.b.Changed)||(it->second->attr.dc))
       {
       HighlightDump(vbuf, (const char*)it->second->last.data.u8,
         it->second->last.FIR.B.DLC, it->second->attr.dc, it->second->attr.dd);
-      if ((argc==0)||(strstr(it->first.c_str(),argv[0])))
-        {
-        writer->printf("%-20s %10" PRId32 " %6" PRId32 " %s\n",
-          it->first.c_str(),it->second->rxcount,(tdiff/it->second->rxcount),vbuf);
-        }
+      re_list_record(writer, it->first, it->second, tdiff, vbuf);
       }
     }
   }
@@ -715,19 +890,19 @@ void re_stream_changed(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
   if (tdiff == 0) tdiff = 1000;
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
+  re_record_list_t list = MyRE->GetRecords((argc>0) ? argv[0] : NULL);
   writer->printf("[");
   int cnt = 0;
   char *ascii = NULL;
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  for (re_record_list_t::iterator it=list.begin(); it!=list.end(); ++it)
     {
-    if ((it->second->attr.b.Changed || it->second->attr.dc) &&
-        (argc == 0 || strstr(it->first.c_str(),argv[0]) != NULL))
+    if (it->second->attr.b.Changed || it->second->attr.dc)
       {
       HighlightDump(vbuf, (const char*)it->second->last.data.u8,
         it->second->last.FIR.B.DLC, it->second->attr.dc, it->second->attr.dd, 1, &ascii);
       writer->printf("%s[\"%s\",%" PRId32 ",%" PRId32 ",\"%s\",\"%s\"]\n",
         cnt ? "," : "",
-        json_encode(it->first).c_str(), it->second->rxcount, (tdiff/it->second->rxcount),
+        json_encode(it->first).c_str(), it->second->rxcount, re_period_ms(it->second, tdiff),
         json_encode(std::string(vbuf)).c_str(),
         json_encode(std::string(ascii)).c_str());
       cnt++;
@@ -749,18 +924,15 @@ void re_list_discovered(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int
   if (tdiff == 0) tdiff = 1000;
 
   OvmsRecMutexLock lock(&MyRE->m_mutex);
-  writer->printf("%-20.20s %10s %6s %s\n","key","records","ms","last");
-  for (re_record_map_t::iterator it=MyRE->m_rmap.begin(); it!=MyRE->m_rmap.end(); ++it)
+  re_record_list_t list = MyRE->GetRecords((argc>0) ? argv[0] : NULL);
+  re_list_header(writer);
+  for (re_record_list_t::iterator it=list.begin(); it!=list.end(); ++it)
     {
     if ((it->second->attr.b.Discovered)||(it->second->attr.dd))
       {
       HighlightDump(vbuf, (const char*)it->second->last.data.u8,
         it->second->last.FIR.B.DLC, it->second->attr.dc, it->second->attr.dd);
-      if ((argc==0)||(strstr(it->first.c_str(),argv[0])))
-        {
-        writer->printf("%-20s %10" PRId32 " %6" PRId32 " %s\n",
-          it->first.c_str(),it->second->rxcount,(tdiff/it->second->rxcount),vbuf);
-        }
+      re_list_record(writer, it->first, it->second, tdiff, vbuf);
       }
     }
   }
@@ -35,7 +35,7 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include <string>
-#include <map>
+#include <vector>
 #include "can.h"
 #include "canformat.h"
 #include "dbc.h"
@@ -44,10 +44,33 @@
 #include "ovms_mutex.h"
 #include "ovms_netmanager.h"
 
+// Packed 64 bit record key: bus, frame format, message ID and OBD/DBC multiplexer
+#define RE_KEY_VALID          (1ULL << 63)      // Set for all keys, 0 = empty table slot
+#define RE_KEY_BUS_SHIFT      59                // 4 bits: 0 = no origin, 1 = can1, …
+#define RE_KEY_EXT            (1ULL << 58)      // Extended frame format
+#define RE_KEY_MUX_SHIFT      56                // 2 bits: multiplexer type (RE_MUX_*)
+#define RE_KEY_MUXVAL_SHIFT   32                // 24 bits: OBD mode<<16 | PID, or DBC mux value
+#define RE_KEY_MUXVAL_MASK    0xffffffULL
+#define RE_KEY_ID_MASK        0x1fffffffULL
+
+#define RE_MUX_NONE           0
+#define RE_MUX_OBD            1
+#define RE_MUX_DBC            2
+
+#define RE_READ_BATCH         16                // Frames fetched from the CAN ring per read
+#define RE_TABLE_MINBITS      8                 // Initial table size 256 records
+#define RE_TABLE_MAXLOAD(n)   ((n) / 4 * 3)     // Grow table beyond 75% load
+
 typedef struct
   {
+  uint64_t key;             // Packed key, 0 = empty slot
   CAN_frame_t last;
   uint32_t rxcount;
+  int64_t rxtime;           // Time of last reception [us]
+  uint32_t period_min;      // Inter-arrival time min/max [us]
+  uint32_t period_max;
+  float period_mean;        // Inter-arrival time mean [us]
+  float period_m2;          // … sum of squared deviations (Welford) for the jitter
   struct __attribute__((__packed__))
     {
     struct {
@@ -66,7 +89,7 @@ typedef struct
     } attr;
   } re_record_t;
 
-typedef std::map<std::string, re_record_t*> re_record_map_t;
+typedef std::vector<std::pair<std::string, re_record_t*>> re_record_list_t;
 
 enum REMode { Analyse, Discover };
 
@@ -82,20 +105,28 @@ class re : public pcp, public ExternalRamAllocated
   public:
     void Task();
     void Clear();
-    std::string GetKey(CAN_frame_t* frame);
+    uint64_t GetKey(CAN_frame_t* frame);
+    std::string FormatKey(uint64_t key);
+    re_record_list_t GetRecords(const char* filter = NULL);
 
   protected:
     void DoAnalyse(CAN_frame_t* frame);
+    re_record_t* FindRecord(uint64_t key, bool create);
+    bool GrowTable();
 
   protected:
     TaskHandle_t m_task;
-    QueueHandle_t m_rxqueue;
+    canringreader* m_reader;
 
   public:
     OvmsRecMutex m_mutex;
     canfilter* m_filter;
     REMode m_mode;
-    re_record_map_t m_rmap;
+    re_record_t* m_records;     // Open addressing hash table (linear probing) in external RAM
+    uint32_t m_capacity;        // Table size (power of 2)
+    uint32_t m_count;           // Records in use
+    uint32_t m_dropped;         // Frames dropped due to table allocation failure
+    bool m_growfailed;          // GrowTable() failed, don't retry until Clear()
     uint32_t m_obdii_std_min;
     uint32_t m_obdii_std_max;
     uint32_t m_obdii_ext_min;
@@ -111,6 +111,9 @@ OvmsVehicleFactory::OvmsVehicleFactory()
   cmd_bms->RegisterCommand("reset","Reset BMS statistics",bms_reset);
   cmd_bms->RegisterCommand("alerts","Show BMS alerts",bms_alerts);
 
+  OvmsCommand* cmd_test = MyCommandApp.RegisterCommand("test","Test framework");
+  cmd_test->RegisterCommand("bms","Test BMS cell statistics performance",bms_test,"[<loops>]",0,1);
+
   OvmsCommand* cmd_obdii = MyCommandApp.RegisterCommand("obdii", "OBDII framework");
   for (int k=1; k <= 4; k++)
     {
@@ -368,6 +371,8 @@ OvmsVehicle::OvmsVehicle()
   PollSetResponseSeparationTime(25);
   // channel keepalive default: 60 seconds
   PollSetChannelKeepalive(60);
+  // response assembly default: off
+  PollSetResponseAssembly(false);
 #endif
 
   m_bms_voltages = NULL;
@@ -411,6 +416,10 @@ OvmsVehicle::OvmsVehicle()
 
   m_bms_vlog_last = 0;
   m_bms_tlog_last = 0;
+  m_bms_vminmax_changed = true;
+  m_bms_vdev_changed = true;
+  m_bms_tminmax_changed = true;
+  m_bms_tdev_changed = true;
 
   m_minsoc = 0;
   m_minsoc_triggered = 0;
@@ -455,7 +464,7 @@ OvmsVehicle::OvmsVehicle()
   m_vqueue = xQueueCreate(CONFIG_OVMS_VEHICLE_CAN_RX_QUEUE_SIZE,sizeof(CAN_frame_t));
   xTaskCreatePinnedToCore(OvmsVehicleTask, "OVMS Vehicle Poll",
       CONFIG_OVMS_VEHICLE_RXTASK_STACK, (void*)this, 10, &m_vtask, CORE(1));
-  MyCan.RegisterListener(m_vqueue);
+  // The CAN listener is registered by RegisterCanBus(), filtered to the vehicle buses
   for (int idx = 0; idx < VEHICLE_MAXBUSSES; ++idx)
     m_autopoweroff[idx] = false;
 #endif
@@ -629,6 +638,12 @@ void OvmsVehicle::OvmsVehicleSignal::IncomingPollReply(const OvmsPoller::poll_jo
     m_parent->IncomingPollReply(job, data, length);
   }
 
+void OvmsVehicle::OvmsVehicleSignal::IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response)
+  {
+  if (Ready())
+    m_parent->IncomingPollResponse(job, response);
+  }
+
 void OvmsVehicle::OvmsVehicleSignal::IncomingPollError(const OvmsPoller::poll_job_t &job, uint16_t code)
   {
   if (Ready())
@@ -690,6 +705,16 @@ void OvmsVehicle::RegisterCanBus(int bus, CAN_mode_t mode, CAN_speed_t speed, db
     case 3: m_can3 = can; break;
     case 4: m_can4 = can; break;
     }
+#ifndef CONFIG_OVMS_COMP_POLLER
+  // Only frames from the vehicle buses are processed by SendIncomingFrame():
+  std::string filter;
+  for (canbus* vbus : { m_can1, m_can2, m_can3, m_can4 })
+    {
+    if (vbus)
+      filter.append(string_format("%d ", vbus->m_busnumber+1));
+    }
+  MyCan.RegisterListener(m_vqueue, false, filter.c_str());
+#endif
   }
 
 bool OvmsVehicle::PinCheck(const char* pin)
@@ -808,12 +833,12 @@ void OvmsVehicle::VehicleTicker1(std::string event, void* data)
     float volt = StandardMetrics.ms_v_bat_12v_voltage->AsFloat();
     // …against the maximum of default and measured reference voltage, so alerts will also
     //  be triggered if the measured ref follows a degrading battery:
-    float dref = MyConfig.GetParamValueFloat("vehicle", "12v.ref", 12.6);
+    float dref = m_cfg_12v_ref.Get();
     float vref = std::max(StandardMetrics.ms_v_bat_12v_voltage_ref->AsFloat(), dref);
 
     // Check for alert level:
     bool alert_on = StandardMetrics.ms_v_bat_12v_voltage_alert->AsBool();
-    float alert_threshold = MyConfig.GetParamValueFloat("vehicle", "12v.alert", 1.6);
+    float alert_threshold = m_cfg_12v_alert.Get();
     if (!alert_on && volt > 0 && vref > 0 && vref-volt > alert_threshold)
       {
       StandardMetrics.ms_v_bat_12v_voltage_alert->SetValue(true);
@@ -830,7 +855,7 @@ void OvmsVehicle::VehicleTicker1(std::string event, void* data)
     // Check for shutdown level:
     if (!m_12v_shutdown_ticker && !MyBoot.IsShuttingDown())
       {
-      float shutdown_threshold = MyConfig.GetParamValueFloat("vehicle", "12v.shutdown", 0);
+      float shutdown_threshold = m_cfg_12v_shutdown.Get();
       if (shutdown_threshold > 0 && volt > 0 && volt <= shutdown_threshold)
         {
         ++m_12v_low_ticker;
@@ -838,7 +863,7 @@ void OvmsVehicle::VehicleTicker1(std::string event, void* data)
           {
           MyEvents.SignalEvent("vehicle.alert.12v.low", NULL);
           }
-        int shutdown_delay = MyConfig.GetParamValueInt("vehicle", "12v.shutdown_delay", 2);
+        int shutdown_delay = m_cfg_12v_shutdown_delay.Get();
         if (m_12v_low_ticker > shutdown_delay)
           {
           MyEvents.SignalEvent("vehicle.alert.12v.shutdown", NULL);
@@ -868,7 +893,7 @@ void OvmsVehicle::VehicleTicker1(std::string event, void* data)
     {
     // Check MINSOC
     int soc = (int) ceil(StandardMetrics.ms_v_bat_soc->AsFloat());
-    m_minsoc = MyConfig.GetParamValueInt("vehicle", "minsoc", 0);
+    m_minsoc = m_cfg_minsoc.Get();
     if (m_minsoc <= 0)
       {
       m_minsoc_triggered = 0;
@@ -907,7 +932,7 @@ void OvmsVehicle::VehicleTicker1(std::string event, void* data)
     if (notify)
       {
       MyEvents.SignalEvent("vehicle.alert.tpms", NULL);
-      if (m_autonotifications && MyConfig.GetParamValueBool("vehicle", "tpms.alerts.enabled", true))
+      if (m_autonotifications && m_cfg_tpms_alerts.Get())
         NotifyTpmsAlerts();
       }
     }
@@ -1064,7 +1089,7 @@ void OvmsVehicle::NotifyAlarmStopped()
 void OvmsVehicle::Notify12vCritical()
   {
   float volt = StandardMetrics.ms_v_bat_12v_voltage->AsFloat();
-  float dref = MyConfig.GetParamValueFloat("vehicle", "12v.ref", 12.6);
+  float dref = m_cfg_12v_ref.Get();
   float vref = std::max(StandardMetrics.ms_v_bat_12v_voltage_ref->AsFloat(), dref);
 
   MyNotify.NotifyStringf("alert", "batt.12v.alert", "12V Battery critical: %.1fV (ref=%.1fV)", volt, vref);
@@ -1073,7 +1098,7 @@ void OvmsVehicle::Notify12vCritical()
 void OvmsVehicle::Notify12vRecovered()
   {
   float volt = StandardMetrics.ms_v_bat_12v_voltage->AsFloat();
-  float dref = MyConfig.GetParamValueFloat("vehicle", "12v.ref", 12.6);
+  float dref = m_cfg_12v_ref.Get();
   float vref = std::max(StandardMetrics.ms_v_bat_12v_voltage_ref->AsFloat(), dref);
 
   MyNotify.NotifyStringf("alert", "batt.12v.recovered", "12V Battery restored: %.1fV (ref=%.1fV)", volt, vref);
@@ -2575,6 +2600,20 @@ void OvmsVehicle::PollSetTimeBetweenSuccess(uint16_t time_between_ms)
   MyPollers.PollSetTimeBetweenSuccess(time_between_ms);
   }
 
+/**
+ * PollSetResponseAssembly: enable/disable delivery of complete poll responses
+ *  With response assembly enabled, each bus poller collects the response frames
+ *  in a preallocated contiguous buffer and calls IncomingPollResponse() once
+ *  per complete response. IncomingPollReply() is still called per frame.
+ *
+ *  @param enable
+ *    true = call IncomingPollResponse(), default/init = false
+ */
+void OvmsVehicle::PollSetResponseAssembly(bool enable)
+  {
+  MyPollers.PollSetResponseAssembly(enable);
+  }
+
 /**
  * IncomingPollReply: poll response handler (stub, override with vehicle implementation)
  *  This is called by PollerReceive() on each valid response frame for the current request.
@@ -2592,6 +2631,22 @@ void OvmsVehicle::IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t*
   {
   }
 
+/**
+ * IncomingPollResponse: complete poll response handler (stub, override with vehicle implementation)
+ *  This is called once per complete response for the current request, after the
+ *  last IncomingPollReply() call, if response assembly has been enabled by
+ *  PollSetResponseAssembly(true). The payload excludes the response type and PID.
+ *  The response buffer is reused by the poller, copy data you need to keep.
+ *
+ *  @param job
+ *    Status of the current Poll job
+ *  @param response
+ *    Complete payload, see OvmsPollResponse for the typed getters
+ */
+void OvmsVehicle::IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response)
+  {
+  }
+
 /**
  * IncomingPollError: Calls Vehicle poll response error handler
  *  This is called by PollerReceive() on reception of an OBD/UDS Negative Response Code (NRC),
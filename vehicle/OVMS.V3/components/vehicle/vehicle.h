@@ -290,6 +290,7 @@ class OvmsVehicle : public InternalRamAllocated
     void PollSetResponseSeparationTime(uint8_t septime);
     void PollSetChannelKeepalive(uint16_t keepalive_seconds);
     void PollSetTimeBetweenSuccess(uint16_t tick_between_ms);
+    void PollSetResponseAssembly(bool enable);
 #endif
 
     uint8_t GetBusNo(canbus* bus);
@@ -544,6 +545,7 @@ class OvmsVehicle : public InternalRamAllocated
       // Signals for vehicle.
 
       void IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length) override;
+      void IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response) override;
       void IncomingPollError(const OvmsPoller::poll_job_t &job, uint16_t code) override;
       void IncomingPollTxCallback(const OvmsPoller::poll_job_t &job, bool success) override;
 
@@ -559,6 +561,7 @@ class OvmsVehicle : public InternalRamAllocated
 
     // Polling Response
     virtual void IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length);
+    virtual void IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response);
     virtual void IncomingPollError(const OvmsPoller::poll_job_t &job, uint16_t code);
     virtual void IncomingPollTxCallback(const OvmsPoller::poll_job_t &job, bool success);
 #endif
@@ -603,6 +606,10 @@ class OvmsVehicle : public InternalRamAllocated
     std::vector<bool> m_bms_bitset_t;         // BMS tracking: true if corresponding temperature set
     int m_bms_bitset_cv;                      // BMS tracking: count of unique voltage values set
     int m_bms_bitset_ct;                      // BMS tracking: count of unique temperature values set
+    bool m_bms_vminmax_changed;               // BMS tracking: cell vmin/vmax changed since last publish
+    bool m_bms_vdev_changed;                  // BMS tracking: force vdevmax/valert publish (after reset)
+    bool m_bms_tminmax_changed;               // BMS tracking: cell tmin/tmax changed since last publish
+    bool m_bms_tdev_changed;                  // BMS tracking: force tdevmax/talert publish (after reset)
     int m_bms_readings_v;                     // Number of BMS voltage readings expected
     int m_bms_readingspermodule_v;            // Number of BMS voltage readings per module
     int m_bms_readings_t;                     // Number of BMS temperature readings expected
@@ -620,6 +627,24 @@ class OvmsVehicle : public InternalRamAllocated
     uint32_t m_bms_vlog_last;                 // Last log time for voltages
     uint32_t m_bms_tlog_last;                 // Last log time for temperatures
 
+  protected:
+    // Config handles for the ticker & BMS paths (defaults applied on read):
+    ConfigValue<float> m_cfg_12v_ref              { "vehicle", "12v.ref", 12.6 };
+    ConfigValue<float> m_cfg_12v_alert            { "vehicle", "12v.alert", 1.6 };
+    ConfigValue<float> m_cfg_12v_shutdown         { "vehicle", "12v.shutdown", 0 };
+    ConfigValue<int>   m_cfg_12v_shutdown_delay   { "vehicle", "12v.shutdown_delay", 2 };
+    ConfigValue<int>   m_cfg_minsoc               { "vehicle", "minsoc", 0 };
+    ConfigValue<bool>  m_cfg_tpms_alerts          { "vehicle", "tpms.alerts.enabled", true };
+    ConfigValue<float> m_cfg_bms_vmaxgrad         { "vehicle", "bms.dev.voltage.maxgrad" };
+    ConfigValue<float> m_cfg_bms_vmaxsddev        { "vehicle", "bms.dev.voltage.maxsddev" };
+    ConfigValue<float> m_cfg_bms_vwarn            { "vehicle", "bms.dev.voltage.warn" };
+    ConfigValue<float> m_cfg_bms_valert           { "vehicle", "bms.dev.voltage.alert" };
+    ConfigValue<float> m_cfg_bms_twarn            { "vehicle", "bms.dev.temp.warn" };
+    ConfigValue<float> m_cfg_bms_talert           { "vehicle", "bms.dev.temp.alert" };
+    ConfigValue<bool>  m_cfg_bms_alerts           { "vehicle", "bms.alerts.enabled", true };
+    ConfigValue<int>   m_cfg_bms_vlog_interval    { "vehicle", "bms.log.voltage.interval", 0 };
+    ConfigValue<int>   m_cfg_bms_tlog_interval    { "vehicle", "bms.log.temp.interval", 0 };
+
   protected:
     void BmsSetCellArrangementVoltage(int readings, int readingspermodule);
     void BmsSetCellArrangementTemperature(int readings, int readingspermodule);
@@ -737,6 +762,7 @@ class OvmsVehicleFactory
     static void bms_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv);
     static void bms_reset(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv);
     static void bms_alerts(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv);
+    static void bms_test(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv);
     static void obdii_request(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv);
 
     void EventSystemShuttingDown(std::string event, void* data);
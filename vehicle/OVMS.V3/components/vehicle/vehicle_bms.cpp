@@ -32,7 +32,9 @@
 static const char *TAG = "vehicle";
 
 #include <stdio.h>
+#include <math.h>
 #include <algorithm>
+#include "esp_timer.h"
 #include <ovms_command.h>
 #include <ovms_script.h>
 #include <ovms_metrics.h>
@@ -48,6 +50,88 @@ static const char *TAG = "vehicle";
 // Voltage stddev running average sample count:
 #define VSTDDEV_SMOOTHCNT         5
 
+/**
+ * BmsCellStats: single pass cell series statistics
+ *  - float accumulation on values shifted by the first cell value, so the
+ *    sums stay small and the variance doesn't suffer from cancellation
+ *  - the loop has no data dependent branches (min/max via fminf/fmaxf),
+ *    so the compiler can unroll / vectorise it
+ *  - the least squares gradient over the cell index is derived from the
+ *    index weighted sum, the index sums have closed forms
+ */
+typedef struct
+  {
+  float min;
+  float max;
+  float avg;
+  float stddev;
+  float grad;                 // avg gradient over the pack [value/pack]
+  } bms_cellstats_t;
+
+static void BmsCellStats(const float* values, int count, bms_cellstats_t* stats)
+  {
+  const float ref = values[0];
+  float sum = 0, sqrsum = 0, isum = 0;
+  float min = ref, max = ref;
+  for (int i = 0; i < count; i++)
+    {
+    float d = values[i] - ref;
+    sum += d;
+    sqrsum += d * d;
+    isum += (float)i * d;
+    min = fminf(min, values[i]);
+    max = fmaxf(max, values[i]);
+    }
+  float davg = sum / count;
+  stats->min = min;
+  stats->max = max;
+  stats->avg = ref + davg;
+  stats->stddev = sqrtf(LIMIT_MIN(sqrsum / count - davg * davg, 0));
+
+  // Gradient: sum((i-c)*(d[i]-davg)) / sum((i-c)^2) * count,
+  //  with c = count/2 - 0.5 (integer division, as before)
+  double n = count;
+  double c = (count / 2) - 0.5;
+  double si = n * (n - 1) / 2;                  // sum(i)
+  double sii = (n - 1) * n * (2 * n - 1) / 6;   // sum(i^2)
+  double sumn = isum - c * sum - davg * (si - n * c);
+  double sumd = sii - 2 * c * si + n * c * c;
+  stats->grad = (sumd > 0) ? (sumn / sumd) * n : 0;
+  }
+
+
+void OvmsVehicleFactory::bms_test(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int loops = (argc > 0) ? atoi(argv[0]) : 1000;
+  if (loops <= 0) loops = 1000;
+
+  const int packs[] = { 96, 192, 288 };
+  float* cells = new float[288];
+  uint32_t seed = 12345;
+
+  writer->printf("Cell statistics, %d series per pack size:\n", loops);
+  writer->puts("Cells  Time [us/series]  avg/stddev/grad");
+  for (int count : packs)
+    {
+    // Synthetic pack: 3.9 V, 10 mV gradient, ±5 mV noise
+    for (int i = 0; i < count; i++)
+      {
+      seed = seed * 1103515245 + 12345;
+      cells[i] = 3.9f + 0.01f * i / count + ((int)((seed >> 16) % 1000) - 500) * 0.00001f;
+      }
+
+    bms_cellstats_t res;
+    uint64_t start = esp_timer_get_time();
+    for (int k = 0; k < loops; k++)
+      BmsCellStats(cells, count, &res);
+    uint64_t time_res = esp_timer_get_time() - start;
+
+    writer->printf("%5d  %16.2f  %.4f/%.5f/%.4f\n", count,
+      (double)time_res / loops, res.avg, res.stddev, res.grad);
+    }
+
+  delete[] cells;
+  }
 
 void OvmsVehicle::BmsSetCellArrangementVoltage(int readings, int readingspermodule)
   {
@@ -285,54 +369,46 @@ void OvmsVehicle::BmsSetCellVoltage(int index, float value)
     {
     m_bms_vmins[index] = value;
     m_bms_vmaxs[index] = value;
+    m_bms_vminmax_changed = true;
     }
   else if (m_bms_vmins[index] > value)
+    {
     m_bms_vmins[index] = value;
+    m_bms_vminmax_changed = true;
+    }
   else if (m_bms_vmaxs[index] < value)
+    {
     m_bms_vmaxs[index] = value;
+    m_bms_vminmax_changed = true;
+    }
 
   if (m_bms_bitset_v[index] == false) m_bms_bitset_cv++;
   if (m_bms_bitset_cv == m_bms_readings_v)
     {
     // Series complete, all cell voltages acquired
-    float thr_maxgrad  = MyConfig.GetParamValueFloat("vehicle", "bms.dev.voltage.maxgrad",  m_bms_defthr_vmaxgrad);
-    float thr_maxsddev = MyConfig.GetParamValueFloat("vehicle", "bms.dev.voltage.maxsddev", m_bms_defthr_vmaxsddev);
-    float thr_warn     = MyConfig.GetParamValueFloat("vehicle", "bms.dev.voltage.warn",     m_bms_defthr_vwarn);
-    float thr_alert    = MyConfig.GetParamValueFloat("vehicle", "bms.dev.voltage.alert",    m_bms_defthr_valert);
-
-    // Get min, max, avg & standard deviation:
-    double sum=0, sqrsum=0, avg, stddev=0;
-    float min=0, max=0;
-    for (int i=0; i<m_bms_readings_v; i++)
-      {
-      sum += m_bms_voltages[i];
-      sqrsum += SQR(m_bms_voltages[i]);
-      if (min==0 || m_bms_voltages[i]<min)
-        min = m_bms_voltages[i];
-      if (max==0 || m_bms_voltages[i]>max)
-        max = m_bms_voltages[i];
-      }
-    avg = sum / m_bms_readings_v;
-    stddev = sqrt(LIMIT_MIN((sqrsum / m_bms_readings_v) - SQR(avg), 0));
+    float thr_maxgrad  = m_cfg_bms_vmaxgrad.Get(m_bms_defthr_vmaxgrad);
+    float thr_maxsddev = m_cfg_bms_vmaxsddev.Get(m_bms_defthr_vmaxsddev);
+    float thr_warn     = m_cfg_bms_vwarn.Get(m_bms_defthr_vwarn);
+    float thr_alert    = m_cfg_bms_valert.Get(m_bms_defthr_valert);
 
-    // Get gradient:
-    double sumn = 0, sumd = 0;
-    for (int i=0; i<m_bms_readings_v; i++)
-      {
-      sumn += (i - (m_bms_readings_v / 2 - 0.5)) * (m_bms_voltages[i] - avg);
-      sumd += SQR(i - (m_bms_readings_v / 2 - 0.5));
-      }
-    float grad = (sumn / sumd) * m_bms_readings_v;
+    // Get min, max, avg, standard deviation & gradient:
+    bms_cellstats_t stats;
+    BmsCellStats(m_bms_voltages, m_bms_readings_v, &stats);
+    float avg = stats.avg, stddev = stats.stddev, grad = stats.grad;
 
     // …publish to metrics:
-    StandardMetrics.ms_v_bat_pack_vmin->SetValue(min);
-    StandardMetrics.ms_v_bat_pack_vmax->SetValue(max);
+    StandardMetrics.ms_v_bat_pack_vmin->SetValue(stats.min);
+    StandardMetrics.ms_v_bat_pack_vmax->SetValue(stats.max);
     StandardMetrics.ms_v_bat_pack_vavg->SetValue(ROUNDPREC(avg, 5));
     StandardMetrics.ms_v_bat_pack_vstddev->SetValue(ROUNDPREC(stddev, 5));
     StandardMetrics.ms_v_bat_pack_vgrad->SetValue(ROUNDPREC(grad, 5));
     StandardMetrics.ms_v_bat_cell_voltage->SetElemValues(0, m_bms_readings_v, m_bms_voltages);
-    StandardMetrics.ms_v_bat_cell_vmin->SetElemValues(0, m_bms_readings_v, m_bms_vmins);
-    StandardMetrics.ms_v_bat_cell_vmax->SetElemValues(0, m_bms_readings_v, m_bms_vmaxs);
+    if (m_bms_vminmax_changed)
+      {
+      StandardMetrics.ms_v_bat_cell_vmin->SetElemValues(0, m_bms_readings_v, m_bms_vmins);
+      StandardMetrics.ms_v_bat_cell_vmax->SetElemValues(0, m_bms_readings_v, m_bms_vmaxs);
+      m_bms_vminmax_changed = false;
+      }
 
     // Voltages are very volatile and may respond to a load change within the sensor query loop.
     // To detect an inconsistent series, we check for a too high gradient and/or a too high
@@ -363,25 +439,37 @@ void OvmsVehicle::BmsSetCellVoltage(int index, float value)
     if (series_valid)
       {
       float dev;
+      float lim_warn = stddev + thr_warn, lim_alert = stddev + thr_alert;
+      bool devmax_changed = m_bms_vdev_changed, alerts_changed = m_bms_vdev_changed;
       for (int i=0; i<m_bms_readings_v; i++)
         {
-        dev = ROUNDPREC(m_bms_voltages[i] - avg, 5);
+        dev = roundf((m_bms_voltages[i] - avg) * 1e5f) / 1e5f;
         if (ABS(dev) > ABS(m_bms_vdevmaxs[i]))
+          {
           m_bms_vdevmaxs[i] = dev;
-        if (ABS(dev) >= stddev + thr_alert && m_bms_valerts[i] <= OvmsStatus::Warn)
+          devmax_changed = true;
+          }
+        if (ABS(dev) >= lim_alert && m_bms_valerts[i] <= OvmsStatus::Warn)
           {
           m_bms_valerts[i] = OvmsStatus::Alert;
           m_bms_valerts_new++; // trigger notification
+          alerts_changed = true;
           }
-        else if (ABS(dev) >= stddev + thr_warn && m_bms_valerts[i] < OvmsStatus::Warn)
+        else if (ABS(dev) >= lim_warn && m_bms_valerts[i] < OvmsStatus::Warn)
+          {
           m_bms_valerts[i] = OvmsStatus::Warn;
+          alerts_changed = true;
+          }
         }
 
       // Publish deviation maximums & alerts:
       if (stddev > StandardMetrics.ms_v_bat_pack_vstddev_max->AsFloat())
         StandardMetrics.ms_v_bat_pack_vstddev_max->SetValue(stddev);
-      StandardMetrics.ms_v_bat_cell_vdevmax->SetElemValues(0, m_bms_readings_v, m_bms_vdevmaxs);
-      StandardMetrics.ms_v_bat_cell_valert->SetElemValues(0, m_bms_readings_v, (short *)m_bms_valerts);
+      if (devmax_changed)
+        StandardMetrics.ms_v_bat_cell_vdevmax->SetElemValues(0, m_bms_readings_v, m_bms_vdevmaxs);
+      if (alerts_changed)
+        StandardMetrics.ms_v_bat_cell_valert->SetElemValues(0, m_bms_readings_v, (short *)m_bms_valerts);
+      m_bms_vdev_changed = false;
       }
 
     // complete:
@@ -407,64 +495,77 @@ void OvmsVehicle::BmsSetCellTemperature(int index, float value)
     {
     m_bms_tmins[index] = value;
     m_bms_tmaxs[index] = value;
+    m_bms_tminmax_changed = true;
     }
   else if (m_bms_tmins[index] > value)
+    {
     m_bms_tmins[index] = value;
+    m_bms_tminmax_changed = true;
+    }
   else if (m_bms_tmaxs[index] < value)
+    {
     m_bms_tmaxs[index] = value;
+    m_bms_tminmax_changed = true;
+    }
 
   if (m_bms_bitset_t[index] == false) m_bms_bitset_ct++;
   if (m_bms_bitset_ct == m_bms_readings_t)
     {
     // Series complete, all cell temperatures acquired
-    float thr_warn  = MyConfig.GetParamValueFloat("vehicle", "bms.dev.temp.warn", m_bms_defthr_twarn);
-    float thr_alert = MyConfig.GetParamValueFloat("vehicle", "bms.dev.temp.alert", m_bms_defthr_talert);
+    float thr_warn  = m_cfg_bms_twarn.Get(m_bms_defthr_twarn);
+    float thr_alert = m_cfg_bms_talert.Get(m_bms_defthr_talert);
 
     // get min, max, avg & standard deviation:
-    double sum=0, sqrsum=0, avg, stddev=0;
-    float min=0, max=0;
-    for (int i=0; i<m_bms_readings_t; i++)
-      {
-      sum += m_bms_temperatures[i];
-      sqrsum += SQR(m_bms_temperatures[i]);
-      if (min==0 || m_bms_temperatures[i]<min)
-        min = m_bms_temperatures[i];
-      if (max==0 || m_bms_temperatures[i]>max)
-        max = m_bms_temperatures[i];
-      }
-    avg = sum / m_bms_readings_t;
-    stddev = sqrt(LIMIT_MIN((sqrsum / m_bms_readings_t) - SQR(avg), 0));
+    bms_cellstats_t stats;
+    BmsCellStats(m_bms_temperatures, m_bms_readings_t, &stats);
+    float avg = stats.avg, stddev = stats.stddev;
 
     // check cell deviations:
     float dev;
+    float lim_warn = stddev + thr_warn, lim_alert = stddev + thr_alert;
+    bool devmax_changed = m_bms_tdev_changed, alerts_changed = m_bms_tdev_changed;
     for (int i=0; i<m_bms_readings_t; i++)
       {
-      dev = ROUNDPREC(m_bms_temperatures[i] - avg, 2);
+      dev = roundf((m_bms_temperatures[i] - avg) * 1e2f) / 1e2f;
       if (ABS(dev) > ABS(m_bms_tdevmaxs[i]))
+        {
         m_bms_tdevmaxs[i] = dev;
-      if (ABS(dev) >= stddev + thr_alert && m_bms_talerts[i] < OvmsStatus::Alert)
+        devmax_changed = true;
+        }
+      if (ABS(dev) >= lim_alert && m_bms_talerts[i] < OvmsStatus::Alert)
         {
         m_bms_talerts[i] = OvmsStatus::Alert;
         m_bms_talerts_new++; // trigger notification
+        alerts_changed = true;
         }
-      else if (ABS(dev) >= stddev + thr_warn && m_bms_valerts[i] < OvmsStatus::Warn)
+      else if (ABS(dev) >= lim_warn && m_bms_talerts[i] < OvmsStatus::Warn)
+        {
         m_bms_talerts[i] = OvmsStatus::Warn;
+        alerts_changed = true;
+        }
       }
+    m_bms_tdev_changed = false;
 
     // publish to metrics:
     avg = ROUNDPREC(avg, 2);
     stddev = ROUNDPREC(stddev, 2);
-    StandardMetrics.ms_v_bat_pack_tmin->SetValue(min);
-    StandardMetrics.ms_v_bat_pack_tmax->SetValue(max);
+    StandardMetrics.ms_v_bat_pack_tmin->SetValue(stats.min);
+    StandardMetrics.ms_v_bat_pack_tmax->SetValue(stats.max);
     StandardMetrics.ms_v_bat_pack_tavg->SetValue(avg);
     StandardMetrics.ms_v_bat_pack_tstddev->SetValue(stddev);
     if (stddev > StandardMetrics.ms_v_bat_pack_tstddev_max->AsFloat())
       StandardMetrics.ms_v_bat_pack_tstddev_max->SetValue(stddev);
     StandardMetrics.ms_v_bat_cell_temp->SetElemValues(0, m_bms_readings_t, m_bms_temperatures);
-    StandardMetrics.ms_v_bat_cell_tmin->SetElemValues(0, m_bms_readings_t, m_bms_tmins);
-    StandardMetrics.ms_v_bat_cell_tmax->SetElemValues(0, m_bms_readings_t, m_bms_tmaxs);
-    StandardMetrics.ms_v_bat_cell_tdevmax->SetElemValues(0, m_bms_readings_t, m_bms_tdevmaxs);
-    StandardMetrics.ms_v_bat_cell_talert->SetElemValues(0, m_bms_readings_t, (short *) m_bms_talerts);
+    if (m_bms_tminmax_changed)
+      {
+      StandardMetrics.ms_v_bat_cell_tmin->SetElemValues(0, m_bms_readings_t, m_bms_tmins);
+      StandardMetrics.ms_v_bat_cell_tmax->SetElemValues(0, m_bms_readings_t, m_bms_tmaxs);
+      m_bms_tminmax_changed = false;
+      }
+    if (devmax_changed)
+      StandardMetrics.ms_v_bat_cell_tdevmax->SetElemValues(0, m_bms_readings_t, m_bms_tdevmaxs);
+    if (alerts_changed)
+      StandardMetrics.ms_v_bat_cell_talert->SetElemValues(0, m_bms_readings_t, (short *) m_bms_talerts);
 
     // complete:
     m_bms_has_temperatures = true;
@@ -510,6 +611,8 @@ void OvmsVehicle::BmsResetCellVoltages(bool full /*=false*/)
     m_bms_valerts_new = 0;
     m_bms_vstddev_cnt = 0;
     m_bms_vstddev_avg = 0;
+    m_bms_vminmax_changed = true;
+    m_bms_vdev_changed = true;
     if (full) StandardMetrics.ms_v_bat_cell_voltage->ClearValue();
     StandardMetrics.ms_v_bat_cell_vmin->ClearValue();
     StandardMetrics.ms_v_bat_cell_vmax->ClearValue();
@@ -535,6 +638,8 @@ void OvmsVehicle::BmsResetCellTemperatures(bool full /*=false*/)
       m_bms_talerts[k] = OvmsStatus::OK;
       }
     m_bms_talerts_new = 0;
+    m_bms_tminmax_changed = true;
+    m_bms_tdev_changed = true;
     if (full) StandardMetrics.ms_v_bat_cell_temp->ClearValue();
     StandardMetrics.ms_v_bat_cell_tmin->ClearValue();
     StandardMetrics.ms_v_bat_cell_tmax->ClearValue();
@@ -846,14 +951,14 @@ void OvmsVehicle::BmsTicker()
     {
     ESP_LOGW(TAG, "BMS new alerts: %d voltages, %d temperatures", m_bms_valerts_new, m_bms_talerts_new);
     MyEvents.SignalEvent("vehicle.alert.bms", NULL);
-    if (m_autonotifications && MyConfig.GetParamValueBool("vehicle", "bms.alerts.enabled", true))
+    if (m_autonotifications && m_cfg_bms_alerts.Get())
       NotifyBmsAlerts();
     m_bms_valerts_new = 0;
     m_bms_talerts_new = 0;
     }
 
   // Log cell voltages:
-  int vlog_interval = MyConfig.GetParamValueInt("vehicle", "bms.log.voltage.interval", 0);
+  int vlog_interval = m_cfg_bms_vlog_interval.Get();
   if (vlog_interval > 0 && m_bms_vlog_last + vlog_interval < monotonictime &&
       StdMetrics.ms_v_bat_cell_voltage->LastModified() > m_bms_vlog_last)
     {
@@ -870,7 +975,7 @@ void OvmsVehicle::BmsTicker()
     }
 
   // Log cell temperatures:
-  int tlog_interval = MyConfig.GetParamValueInt("vehicle", "bms.log.temp.interval", 0);
+  int tlog_interval = m_cfg_bms_tlog_interval.Get();
   if (tlog_interval > 0 && m_bms_tlog_last + tlog_interval < monotonictime &&
       StdMetrics.ms_v_bat_cell_temp->LastModified() > m_bms_tlog_last)
     {
@@ -32,6 +32,7 @@
 static const char *TAG = "v-obdii";
 
 #include <stdio.h>
+#include <algorithm>
 #include "vehicle_obdii.h"
 
 static const OvmsPoller::poll_pid_t obdii_polls[]
@@ -52,9 +53,8 @@ OvmsVehicleOBDII::OvmsVehicleOBDII()
   {
   ESP_LOGI(TAG, "Generic OBDII vehicle module");
 
-  memset(m_vin,0,sizeof(m_vin));
-
   RegisterCanBus(1,CAN_MODE_ACTIVE,CAN_SPEED_500KBPS);
+  PollSetResponseAssembly(true);
   PollSetPidList(m_can1,obdii_polls);
   PollSetState(0);
   }
@@ -64,26 +64,25 @@ OvmsVehicleOBDII::~OvmsVehicleOBDII()
   ESP_LOGI(TAG, "Shutdown OBDII vehicle module");
   }
 
-void OvmsVehicleOBDII::IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length)
+void OvmsVehicleOBDII::IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response)
   {
-  int value1 = (int)data[0];
-  int value2 = ((int)data[0] << 8) + (int)data[1];
+  uint8_t value1;
+  uint16_t value2 = 0;
+  if (!response.GetUint8(0, value1))
+    return;
+  response.GetUint16(0, value2);
 
   switch (job.pid)
     {
     case 0x02:  // VIN (multi-line response)
-      // Data in the first frame starts with 0x01 for some (all?) vehicles
-      if (length > 1 && data[0] == 0x01)
-        {
-        ++data;
-        --length;
-        }
-      strncat(m_vin,(char*)data,length);
-      if (job.mlremain==0)
-        {
-        StandardMetrics.ms_v_vin->SetValue(m_vin);
-        m_vin[0] = 0;
-        }
+      {
+      // Data starts with 0x01 for some (all?) vehicles
+      uint16_t offset = (response.size() > 1 && value1 == 0x01) ? 1 : 0;
+      uint16_t length = std::min<uint16_t>(response.size() - offset, 17);
+      std::string vin;
+      if (response.GetBytes(offset, length, vin))
+        StandardMetrics.ms_v_vin->SetValue(vin);
+      }
       break;
     case 0x05:  // Engine coolant temperature
       StandardMetrics.ms_v_bat_temp->SetValue(value1 - 0x28);
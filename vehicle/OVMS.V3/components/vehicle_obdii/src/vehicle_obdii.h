@@ -42,10 +42,7 @@ class OvmsVehicleOBDII : public OvmsVehicle
     ~OvmsVehicleOBDII();
 
   protected:
-    void IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length) override;
-
-  protected:
-    char m_vin[18];
+    void IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response) override;
   };
 
 #endif //#ifndef __VEHICLE_OBDII_H__
@@ -28,147 +28,121 @@
 
 static const char *TAG = "v-vweup";
 
-bool PollReplyHelper::AddNewData(uint16_t pid, uint8_t *data, uint8_t length, uint16_t remain)
-{
-  // When I have a different PID as last time OR
-  // if I'm not waiting for more data from last time...
-  if (LastPid != pid || LastRemain == 0) {
-    // ...let's fill the data into the store from the beginning
-    Store.clear();
-  }
-  Store.append((char *)data, length);
-
-  LastPid = pid;
-  LastRemain = remain;
-
-  // TRUE when all data is here
-  // FALSE when we have to wait
-  return remain == 0;
-}
-
 std::string PollReplyHelper::GetHexString()
 {
   stringstream msg;
-  msg << "Store[0-" << (Store.size() - 1) << "] =";
+  msg << "Store[0-" << (Size() - 1) << "] =";
   msg << hex << setfill('0');
-  for (int i = 0; i < Store.size(); i++) {
+  for (int i = 0; i < Size(); i++) {
     msg << " ";
-    // Have to cast to int as uint8_t doesn't work!!
-    msg << uppercase << hex << setw(2) << static_cast<int>(Store[i]);
+    msg << uppercase << hex << setw(2) << static_cast<int>(Response->data()[i]);
   }
   return msg.str();
 }
 
+void PollReplyHelper::LogTooShort(const std::string &info, const char *getter, uint16_t bytesToSkip)
+{
+  ESP_LOGE(TAG, "%s: Data length=%u is too short for %s(skippedBytes=%u)",
+    info.c_str(), Size(), getter, bytesToSkip);
+}
+
 bool PollReplyHelper::FromUint8(const std::string &info, float &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (1 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromUint8(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  uint8_t res;
+  if (!Response || !Response->GetUint8(bytesToSkip, res)) {
+    LogTooShort(info, "FromUint8", bytesToSkip);
     value = NAN;
     return false;
   }
 
-  value = static_cast<float>((uint8_t)Store[0 + bytesToSkip]);
+  value = static_cast<float>(res);
   return true;
 }
 
 bool PollReplyHelper::FromUint8(const std::string &info, int &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (1 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromUint8(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  uint8_t res;
+  if (!Response || !Response->GetUint8(bytesToSkip, res)) {
+    LogTooShort(info, "FromUint8", bytesToSkip);
     return false;
   }
 
-  value = static_cast<int>((uint8_t)Store[0 + bytesToSkip]);
+  value = static_cast<int>(res);
   return true;
 }
 
 bool PollReplyHelper::FromUint16(const std::string &info, float &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (2 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromUint16(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  uint16_t res;
+  if (!Response || !Response->GetUint16(bytesToSkip, res)) {
+    LogTooShort(info, "FromUint16", bytesToSkip);
     value = NAN;
     return false;
   }
 
-  value = static_cast<float>((uint16_t)(
-            (Store[0 + bytesToSkip] << 8) +
-            ((uint16_t)Store[1 + bytesToSkip])));
+  value = static_cast<float>(res);
   return true;
 }
 
 bool PollReplyHelper::FromUint16(const std::string &info, int &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (2 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromUint16(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  uint16_t res;
+  if (!Response || !Response->GetUint16(bytesToSkip, res)) {
+    LogTooShort(info, "FromUint16", bytesToSkip);
     return false;
   }
 
-  value = static_cast<int>((uint16_t)(
-            (Store[0 + bytesToSkip] << 8) +
-            ((uint16_t)Store[1 + bytesToSkip])));
+  value = static_cast<int>(res);
   return true;
 }
 
 bool PollReplyHelper::FromUint24(const std::string &info, float &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (3 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromUint24(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  uint32_t res;
+  if (!Response || !Response->GetUint24(bytesToSkip, res)) {
+    LogTooShort(info, "FromUint24", bytesToSkip);
     value = NAN;
     return false;
   }
 
-  value = static_cast<float>((uint32_t)(
-            (Store[0 + bytesToSkip] << 16) +
-            (Store[1 + bytesToSkip] << 8) +
-            ((uint16_t)Store[2 + bytesToSkip])));
+  value = static_cast<float>(res);
   return true;
 }
 
 bool PollReplyHelper::FromInt32(const std::string &info, float &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (4 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromInt32(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  int32_t res;
+  if (!Response || !Response->GetInt32(bytesToSkip, res)) {
+    LogTooShort(info, "FromInt32", bytesToSkip);
     value = NAN;
     return false;
   }
 
-  value = static_cast<float>((int32_t)(
-            (Store[0 + bytesToSkip] << 24) +
-            (Store[1 + bytesToSkip] << 16) +
-            (Store[2 + bytesToSkip] << 8) +
-            ((uint16_t)Store[3 + bytesToSkip])));
+  value = static_cast<float>(res);
   return true;
 }
 
 bool PollReplyHelper::FromInt16(const std::string &info, float &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (2 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromInt16(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  int16_t res;
+  if (!Response || !Response->GetInt16(bytesToSkip, res)) {
+    LogTooShort(info, "FromInt16", bytesToSkip);
     value = NAN;
     return false;
   }
 
-  value = static_cast<float>((int16_t)(
-            (Store[0 + bytesToSkip] << 8) +
-            (Store[1 + bytesToSkip])));
+  value = static_cast<float>(res);
   return true;
 }
 
 bool PollReplyHelper::FromInt8(const std::string &info, int &value, uint16_t bytesToSkip /*= 0*/)
 {
-  if (Store.size() < (1 + bytesToSkip)) {
-    ESP_LOGE(TAG, "%s: Data length=%d is too short for FromInt8(skippedBytes=%u)",
-      info.c_str(), Store.size(), bytesToSkip);
+  int8_t res;
+  if (!Response || !Response->GetInt8(bytesToSkip, res)) {
+    LogTooShort(info, "FromInt8", bytesToSkip);
     return false;
   }
 
-  value = static_cast<int>((int8_t)Store[0 + bytesToSkip]);
+  value = static_cast<int>(res);
   return true;
 }
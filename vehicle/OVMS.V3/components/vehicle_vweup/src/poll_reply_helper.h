@@ -31,13 +31,19 @@
 #include <cfloat>
 #include <iomanip>
 #include <sstream>
+#include "vehicle_poller.h"
 
 using namespace std;
 
+/**
+ * PollReplyHelper: logging value accessors for a complete poll response
+ *  The response is only valid during the IncomingPollResponse() call
+ *  that passed it to SetResponse().
+ */
 class PollReplyHelper
 {
 public:
-  bool AddNewData(uint16_t pid, uint8_t *data, uint8_t length, uint16_t remain);
+  void SetResponse(const OvmsPollResponse &response) { Response = &response; }
   std::string GetHexString();
 
   bool FromUint8(const std::string &info, float &value, uint16_t bytesToSkip = 0);
@@ -50,9 +56,11 @@ public:
   bool FromInt8(const std::string &info, int &value, uint16_t bytesToSkip = 0);
 
 private:
-  string Store;
-  uint16_t LastPid = 0;
-  uint16_t LastRemain = 0;
+  uint16_t Size() const { return Response ? Response->size() : 0; }
+  void LogTooShort(const std::string &info, const char *getter, uint16_t bytesToSkip);
+
+private:
+  const OvmsPollResponse *Response = nullptr;
 };
 
 #endif //#ifndef __POLL_REPLY_HELPER_H__
@@ -784,7 +784,7 @@ void OvmsVehicleVWeUp::ResetTripCounters()
   StdMetrics.ms_v_bat_coulomb_used->SetValue(0);
 
   // Get trip start references as far as available:
-  //  (if we don't have them yet, IncomingPollReply() will set them ASAP)
+  //  (if we don't have them yet, IncomingPollResponse() will set them ASAP)
   if (IsOBDReady()) {
     m_soc_abs_start       = BatMgmtSoCAbs->AsFloat();
   }
@@ -837,7 +837,7 @@ void OvmsVehicleVWeUp::ResetChargeCounters()
   m_charge_kwh_grid = 0;
 
   // Get charge start reference as far as available:
-  //  (if we don't have it yet, IncomingPollReply() will set it ASAP)
+  //  (if we don't have it yet, IncomingPollResponse() will set it ASAP)
   if (IsOBDReady()) {
     m_soc_abs_start         = BatMgmtSoCAbs->AsFloat();
   }
@@ -1082,7 +1082,7 @@ int OvmsVehicleVWeUp::CalcChargeTime(float capacity, float max_pwr, int from_soc
 
 /**
  * UpdateChargeTimes: update all charge time predictions
- *  This is called by Ticker60() and by IncomingPollReply(), and on config changes
+ *  This is called by Ticker60() and by IncomingPollResponse(), and on config changes
 
  */
 void OvmsVehicleVWeUp::UpdateChargeTimes()
@@ -389,7 +389,7 @@ protected:
   }
   void PollerStateTicker(canbus *bus) override;
 
-  void IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length) override;
+  void IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response) override;
 
 protected:
   void UpdateChargePower(float power_kw);
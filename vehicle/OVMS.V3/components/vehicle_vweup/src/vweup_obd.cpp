@@ -273,6 +273,7 @@ void OvmsVehicleVWeUp::OBDInit()
     PollSetPidList(m_can1, NULL);
     PollSetThrottling(0);
     PollSetResponseSeparationTime(1);
+    PollSetResponseAssembly(true);
 
     if (StandardMetrics.ms_v_charge_inprogress->AsBool())
       PollSetState(VWEUP_CHARGING);
@@ -598,15 +599,13 @@ void OvmsVehicleVWeUp::PollerStateTicker(canbus *bus)
 }
 
 
-void OvmsVehicleVWeUp::IncomingPollReply(const OvmsPoller::poll_job_t &job, uint8_t* data, uint8_t length)
+void OvmsVehicleVWeUp::IncomingPollResponse(const OvmsPoller::poll_job_t &job, const OvmsPollResponse &response)
 {
   if (m_obd_state != OBDS_Run)
     return;
 
-  // If not all data is here: wait for the next call
-  if (!PollReply.AddNewData(job.pid, data, length, job.mlremain)) {
-    return;
-  }
+  // The poller has assembled all frames of the response:
+  PollReply.SetResponse(response);
 
   float value;
   int ivalue;
@@ -735,7 +734,7 @@ void OvmsVehicleVWeUp::IncomingPollReply(const OvmsPoller::poll_job_t &job, uint
             m_timermode_new != StdMetrics.ms_v_charge_timermode->AsBool() &&
             StdMetrics.ms_v_charge_inprogress->AsBool())
         {
-          ESP_LOGI(TAG, "IncomingPollReply: starting delayed charge timer mode update, new mode: %d", m_timermode_new);
+          ESP_LOGI(TAG, "IncomingPollResponse: starting delayed charge timer mode update, new mode: %d", m_timermode_new);
           m_timermode_ticker = 6;
           // Note: this ticker is additionally paused while another charge
           // ticker is running, so the delay adds to those.
@@ -1465,7 +1464,7 @@ void OvmsVehicleVWeUp::IncomingPollReply(const OvmsPoller::poll_job_t &job, uint
 #endif
 
     default:
-      VALUE_LOG(TAG, "IncomingPollReply: ECU %" PRIX32 "/%" PRIX32 " unhandled PID %02X %04X: %s",
+      VALUE_LOG(TAG, "IncomingPollResponse: ECU %" PRIX32 "/%" PRIX32 " unhandled PID %02X %04X: %s",
         job.moduleid_sent, job.moduleid_rec, job.type, job.pid, PollReply.GetHexString().c_str());
       break;
   }
@@ -1499,7 +1498,7 @@ void OvmsVehicleVWeUp::UpdateChargePower(float power_kw)
 /**
  * UpdateChargeCap: calculate normalized & absolute battery capacities during charge,
  *  update CAC & SOH accordingly after charge stop.
- *  Called by IncomingPollReply() after receiving SOCs & energy/coulomb counts.
+ *  Called by IncomingPollResponse() after receiving SOCs & energy/coulomb counts.
  */
 void OvmsVehicleVWeUp::UpdateChargeCap(bool charging)
 {
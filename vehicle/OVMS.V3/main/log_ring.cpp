@@ -0,0 +1,374 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Module:        Log record ring buffer
+;    Date:          17th October 2026
+;
+;    (C) 2026       OVMS developers
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "ovms_malloc.h"
+#include "log_ring.h"
+
+OvmsLogReader::OvmsLogReader()
+  : m_pending(false)
+  {
+  m_cursor = 0;
+  m_recno = 0;
+  m_dropped = 0;
+  m_resync = false;
+  m_stallpos = LOGRING_BUSY;
+  m_stallsince = 0;
+  }
+
+OvmsLogRing::OvmsLogRing()
+  : m_head(0), m_records(0), m_longrecords(0), m_truncated(0), m_overruns(0)
+  {
+  m_slot = NULL;
+  m_text = NULL;
+  m_slots = 0;
+  m_mask = 0;
+  }
+
+OvmsLogRing::~OvmsLogRing()
+  {
+  if (m_slot) free(m_slot);
+  if (m_text) free(m_text);
+  }
+
+/**
+ * Init: allocate the ring, slots are rounded down to a power of 2
+ */
+bool OvmsLogRing::Init(uint32_t slots)
+  {
+  if (m_text)
+    return true;
+  uint32_t n = 2*LOGRING_MAX_SLOTS;
+  while (n*2 <= slots)
+    n *= 2;
+  m_slot = (LogRingSlot*) ExternalRamCalloc(n, sizeof(LogRingSlot));
+  char* text = (char*) ExternalRamMalloc(n * LOGRING_SLOT_SIZE);
+  if (!m_slot || !text)
+    {
+    if (m_slot) free(m_slot);
+    if (text) free(text);
+    m_slot = NULL;
+    return false;
+    }
+  // Text is zeroed, as padding slots never get text written.
+  // Slot sequences are initialized as committed in the previous lap:
+  memset(text, 0, n * LOGRING_SLOT_SIZE);
+  for (uint32_t i = 0; i < n; i++)
+    m_slot[i].seq.store(i - n, std::memory_order_relaxed);
+  m_slots = n;
+  m_mask = n - 1;
+  std::atomic_thread_fence(std::memory_order_release);
+  m_text = text;
+  return true;
+  }
+
+/**
+ * Reserve: claim a contiguous run of slots, sets the position of the first slot
+ *  A run never wraps around the ring end, the slots skipped to avoid that are
+ *  committed as padding.
+ *  All slots claimed must have been committed in the previous lap, else the
+ *  reservation fails and the record is dropped (overrun). As a position can
+ *  only be committed by the producer owning it, the check cannot be invalidated
+ *  between the check and the head update.
+ */
+bool OvmsLogRing::Reserve(int nslots, uint32_t* p_pos, char** text)
+  {
+  uint32_t head = m_head.load(std::memory_order_acquire);
+  uint32_t pos, next;
+  do
+    {
+    pos = head;
+    uint32_t idx = pos & m_mask;
+    if (idx + nslots > m_slots)
+      pos += m_slots - idx;
+    next = pos + nslots;
+    for (uint32_t p = head; p != next; p++)
+      {
+      if (m_slot[p & m_mask].seq.load(std::memory_order_acquire) != p - m_slots)
+        {
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+        }
+      }
+    } while (!m_head.compare_exchange_weak(head, next,
+               std::memory_order_acq_rel, std::memory_order_acquire));
+
+  // Invalidate the slots before overwriting them:
+  for (uint32_t p = head; p != next; p++)
+    m_slot[p & m_mask].seq.store(LOGRING_BUSY, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (uint32_t p = head; p != pos; p++)
+    Commit(p, 1, 0, LOGRING_SKIP);
+
+  *text = m_text + (pos & m_mask) * LOGRING_SLOT_SIZE;
+  *p_pos = pos;
+  return true;
+  }
+
+/**
+ * Commit: publish a record, the first slot is released last
+ */
+void OvmsLogRing::Commit(uint32_t pos, int nslots, size_t len, uint8_t flags)
+  {
+  LogRingSlot* first = &m_slot[pos & m_mask];
+  if (flags & LOGRING_SKIP)
+    m_text[(pos & m_mask) * LOGRING_SLOT_SIZE] = 0;
+  first->recno = (flags & LOGRING_SKIP) ? 0 : m_records.fetch_add(1, std::memory_order_relaxed);
+  first->len = len;
+  first->nslots = nslots;
+  first->flags = flags;
+  for (int i = 1; i < nslots; i++)
+    {
+    LogRingSlot* cont = &m_slot[(pos+i) & m_mask];
+    cont->nslots = 0;
+    cont->flags = LOGRING_CONT;
+    cont->seq.store(pos+i, std::memory_order_release);
+    }
+  first->seq.store(pos, std::memory_order_release);
+  }
+
+/**
+ * Tidy: replace CR/LF except last by "|", but don't leave '|' at the end.
+ *  An ESC sequence to change color may be appended after the log text.
+ *  Returns the resulting text length.
+ */
+size_t OvmsLogRing::Tidy(char* text)
+  {
+  char* s;
+  for (s=text; *s; s++)
+    {
+    if (*s=='\r' || *s=='\n')
+      {
+      char *t = s;
+      if (*(s+1) == '\033')
+        ++s;
+      else if (*(s+1) != '\0')
+        {
+        *s = '|';
+        continue;
+        }
+      while (t > text && *(t-1) == '|')
+        --t;
+      while ((*t++ = *s++)) ;
+      return t - text - 1;
+      }
+    }
+  return s - text;
+  }
+
+/**
+ * VPrintf: format a log line into the ring
+ *  The line is formatted into a single slot first, only lines that do not fit
+ *  are formatted a second time into a run of slots.
+ */
+int OvmsLogRing::VPrintf(const char* fmt, va_list args)
+  {
+  char* text;
+  va_list args2;
+  uint32_t pos;
+  if (!Reserve(1, &pos, &text))
+    return 0;
+  va_copy(args2, args);
+  int len = vsnprintf(text, LOGRING_SLOT_SIZE, fmt, args);
+  if (len < 0)
+    {
+    Commit(pos, 1, 0, LOGRING_SKIP);
+    }
+  else if (len < LOGRING_SLOT_SIZE)
+    {
+    Commit(pos, 1, Tidy(text), 0);
+    }
+  else
+    {
+    Commit(pos, 1, 0, LOGRING_SKIP);
+    int nslots = len / LOGRING_SLOT_SIZE + 1;
+    if (nslots > LOGRING_MAX_SLOTS)
+      {
+      nslots = LOGRING_MAX_SLOTS;
+      m_truncated.fetch_add(1, std::memory_order_relaxed);
+      }
+    m_longrecords.fetch_add(1, std::memory_order_relaxed);
+    if (Reserve(nslots, &pos, &text))
+      {
+      int size = nslots * LOGRING_SLOT_SIZE;
+      if (vsnprintf(text, size, fmt, args2) >= size)
+        text[size-2] = '\n';
+      Commit(pos, nslots, Tidy(text), 0);
+      }
+    }
+  va_end(args2);
+  return len;
+  }
+
+/**
+ * Write: copy a preformatted log line into the ring
+ */
+int OvmsLogRing::Write(const char* text, size_t len)
+  {
+  char* dst;
+  int nslots = len / LOGRING_SLOT_SIZE + 1;
+  if (nslots > LOGRING_MAX_SLOTS)
+    {
+    nslots = LOGRING_MAX_SLOTS;
+    m_truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+  size_t size = nslots * LOGRING_SLOT_SIZE;
+  uint32_t pos;
+  if (!Reserve(nslots, &pos, &dst))
+    return 0;
+  if (len < size)
+    {
+    memcpy(dst, text, len);
+    dst[len] = 0;
+    }
+  else
+    {
+    memcpy(dst, text, size-2);
+    dst[size-2] = '\n';
+    dst[size-1] = 0;
+    }
+  Commit(pos, nslots, Tidy(dst), 0);
+  return len;
+  }
+
+/**
+ * Attach: position a reader at the current ring head
+ */
+void OvmsLogRing::Attach(OvmsLogReader* reader)
+  {
+  reader->m_cursor = m_head.load(std::memory_order_acquire);
+  reader->m_recno = m_records.load(std::memory_order_relaxed);
+  reader->m_resync = false;
+  reader->m_stallpos = reader->m_cursor - 1;
+  reader->m_pending = false;
+  }
+
+bool OvmsLogRing::Available(OvmsLogReader* reader)
+  {
+  return m_text && reader->m_cursor != m_head.load(std::memory_order_acquire);
+  }
+
+/**
+ * Read: copy the next record into buf (NUL terminated, truncated to size-1)
+ *  Returns the text length, 0 if no committed record is available.
+ *  Records overwritten before the reader could get them are added to the
+ *  reader's drop counter.
+ *  An uncommitted record is skipped if later records are available and
+ *  the record has not been committed within LOGRING_STALL_TIME.
+ */
+int OvmsLogRing::Read(OvmsLogReader* reader, char* buf, size_t size)
+  {
+  if (!m_text || size == 0)
+    return 0;
+
+  for (;;)
+    {
+    uint32_t head = m_head.load(std::memory_order_acquire);
+    uint32_t pos = reader->m_cursor;
+    if (pos == head)
+      return 0;
+    if (head - pos > m_slots)
+      {
+      // lapped by the producers, skip to the oldest slot still in the ring:
+      reader->m_cursor = head - m_slots;
+      reader->m_resync = true;
+      continue;
+      }
+
+    LogRingSlot* slot = &m_slot[pos & m_mask];
+    uint32_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq != pos)
+      {
+      if (seq != LOGRING_BUSY && (int32_t)(seq - pos) > 0)
+        {
+        reader->m_cursor = pos + 1;   // overwritten
+        reader->m_resync = true;
+        continue;
+        }
+      // not yet committed, wait unless later records are available:
+      uint32_t next = pos + 1;
+      while (next != head && m_slot[next & m_mask].seq.load(std::memory_order_acquire) != next)
+        next++;
+      if (next == head)
+        return 0;
+      int64_t now = esp_timer_get_time();
+      if (reader->m_stallpos != pos)
+        {
+        reader->m_stallpos = pos;
+        reader->m_stallsince = now;
+        return 0;
+        }
+      if (now - reader->m_stallsince < LOGRING_STALL_TIME)
+        return 0;
+      // stalled by a preempted producer, skip its slots:
+      reader->m_cursor = next;
+      reader->m_dropped++;
+      reader->m_resync = true;
+      continue;
+      }
+
+    uint8_t flags = slot->flags;
+    int nslots = slot->nslots;
+    uint32_t recno = slot->recno;
+    size_t len = slot->len;
+    if ((flags & (LOGRING_CONT|LOGRING_SKIP)) || nslots < 1 || nslots > LOGRING_MAX_SLOTS
+      || len >= (size_t)nslots * LOGRING_SLOT_SIZE)
+      {
+      reader->m_cursor = pos + 1;
+      continue;
+      }
+    if (len > size-1)
+      len = size-1;
+    memcpy(buf, m_text + (pos & m_mask) * LOGRING_SLOT_SIZE, len);
+    buf[len] = 0;
+
+    // validate the copy:
+    std::atomic_thread_fence(std::memory_order_acquire);
+    bool valid = true;
+    for (int i = 0; i < nslots && valid; i++)
+      valid = (m_slot[(pos+i) & m_mask].seq.load(std::memory_order_relaxed) == pos+i);
+    reader->m_cursor = pos + (valid ? nslots : 1);
+    if (!valid)
+      {
+      reader->m_resync = true;
+      continue;
+      }
+
+    // Records are numbered in commit order, which can differ slightly from
+    // the slot order, so the gap is only evaluated after a resync:
+    if (reader->m_resync && (int32_t)(recno - reader->m_recno) > 0)
+      reader->m_dropped += recno - reader->m_recno;
+    reader->m_resync = false;
+    reader->m_recno = recno + 1;
+    if (len == 0)
+      continue;
+    return len;
+    }
+  }
@@ -0,0 +1,142 @@
+/*
+;    Project:       Open Vehicle Monitor System
+;    Module:        Log record ring buffer
+;    Date:          17th October 2026
+;
+;    (C) 2026       OVMS developers
+;
+; Permission is hereby granted, free of charge, to any person obtaining a copy
+; of this software and associated documentation files (the "Software"), to deal
+; in the Software without restriction, including without limitation the rights
+; to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+; copies of the Software, and to permit persons to whom the Software is
+; furnished to do so, subject to the following conditions:
+;
+; The above copyright notice and this permission notice shall be included in
+; all copies or substantial portions of the Software.
+;
+; THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+; IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+; FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+; AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+; LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+; OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+; THE SOFTWARE.
+*/
+
+#ifndef __LOG_RING_H__
+#define __LOG_RING_H__
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <atomic>
+
+// Log record ring buffer
+//
+// Log lines are formatted once, directly into a preallocated ring of fixed
+// size slots (in PSRAM). A line longer than one slot occupies a contiguous
+// run of up to LOGRING_MAX_SLOTS slots, longer lines are truncated.
+//
+// Producers reserve slots by a compare-and-swap on the ring head, so any
+// number of tasks can log concurrently without locks or allocations. Each
+// slot header carries a sequence number, which is set to the slot position
+// when the record is committed. Consumers (OvmsLogReader) read the ring with
+// their own cursors and validate the sequence numbers after copying a record,
+// so a slow consumer never blocks a producer: it loses the overwritten
+// records, which are counted as dropped.
+//
+// A slot position can only be reserved after the record occupying the slot
+// in the previous lap has been committed. If a producer gets preempted
+// between reserving and committing for longer than it takes the other
+// producers to fill the whole ring, these drop their records (counted as
+// overruns) until it has finished, so a record can never be overwritten
+// while being written.
+//
+// A reader waits for an uncommitted record as long as no later records are
+// available. If later records are waiting, it skips the uncommitted record
+// at its first read after LOGRING_STALL_TIME (reads are triggered by new
+// records), so a preempted low priority producer can delay but not stop the
+// consumers. The record skipped is counted as dropped.
+//
+// Note: atomic read-modify-write operations are not possible on PSRAM on the
+// ESP32, so the head & record counters are kept in the ring object (internal
+// RAM), slot headers only use plain atomic loads & stores.
+
+#define LOGRING_SLOT_SIZE       128         // Text bytes per slot
+#define LOGRING_MAX_SLOTS       16          // Max slots per record (max line length 2047)
+#define LOGRING_MAX_LINE        (LOGRING_SLOT_SIZE * LOGRING_MAX_SLOTS)
+
+#define LOGRING_SKIP            0x01        // Record is padding / abandoned reservation
+#define LOGRING_CONT            0x02        // Slot is a continuation of the previous record
+
+#define LOGRING_BUSY            0xffffffff  // Slot sequence while being written
+
+#define LOGRING_STALL_TIME      100000      // Max wait for an uncommitted record [us]
+
+struct LogRingSlot
+  {
+  std::atomic<uint32_t> seq;                // Slot position when committed
+  uint32_t recno;                           // Record number (first slot)
+  uint16_t len;                             // Text length (first slot)
+  uint8_t nslots;                           // Slots used by the record (first slot)
+  uint8_t flags;                            // LOGRING_SKIP / LOGRING_CONT
+  };
+
+class OvmsLogReader
+  {
+  public:
+    OvmsLogReader();
+
+  public:
+    uint32_t m_cursor;                      // Next slot position to read
+    uint32_t m_recno;                       // Next record number expected
+    uint32_t m_dropped;                     // Records lost by ring overruns
+    bool m_resync;                          // Records have been skipped
+    uint32_t m_stallpos;                    // Uncommitted slot position waited for
+    int64_t m_stallsince;                   // … since [us]
+    std::atomic<bool> m_pending;            // Consumer has been signalled
+  };
+
+class OvmsLogRing
+  {
+  public:
+    OvmsLogRing();
+    ~OvmsLogRing();
+
+  public:
+    bool Init(uint32_t slots);
+    bool IsReady() { return m_text != NULL; }
+    int VPrintf(const char* fmt, va_list args) __attribute__ ((format (printf, 2, 0)));
+    int Write(const char* text, size_t len);
+
+  public:
+    void Attach(OvmsLogReader* reader);
+    int Read(OvmsLogReader* reader, char* buf, size_t size);
+    bool Available(OvmsLogReader* reader);
+
+  public:
+    uint32_t GetSlots() { return m_slots; }
+    uint32_t GetRecords() { return m_records; }
+    uint32_t GetLongRecords() { return m_longrecords.load(std::memory_order_relaxed); }
+    uint32_t GetTruncated() { return m_truncated.load(std::memory_order_relaxed); }
+    uint32_t GetOverruns() { return m_overruns.load(std::memory_order_relaxed); }
+
+  protected:
+    bool Reserve(int nslots, uint32_t* pos, char** text);
+    void Commit(uint32_t pos, int nslots, size_t len, uint8_t flags);
+    static size_t Tidy(char* text);
+
+  protected:
+    LogRingSlot* m_slot;                    // Slot headers
+    char* m_text;                           // Slot text
+    uint32_t m_slots;                       // Number of slots (power of 2)
+    uint32_t m_mask;
+    std::atomic<uint32_t> m_head;           // Next slot position to reserve
+    std::atomic<uint32_t> m_records;        // Records committed
+    std::atomic<uint32_t> m_longrecords;    // Records needing a second formatting pass
+    std::atomic<uint32_t> m_truncated;      // Records truncated to LOGRING_MAX_LINE
+    std::atomic<uint32_t> m_overruns;       // Records dropped, slots still in use by a producer
+  };
+
+#endif //#ifndef __LOG_RING_H__
@@ -44,6 +44,18 @@ MetricsStandard::MetricsStandard()
   ms_m_freeram = new OvmsMetricInt(MS_M_FREERAM, SM_STALE_MID);
   ms_m_monotonic = new OvmsMetricInt(MS_M_MONOTONIC, SM_STALE_MIN, Seconds);
   ms_m_timeutc = new OvmsMetricInt64(MS_M_TIME_UTC, SM_STALE_MIN, DateUTC);
+  ms_m_event_queue_max = new OvmsMetricInt(MS_M_EVENT_QUEUE_MAX, SM_STALE_MID);
+  ms_m_event_queue_drops = new OvmsMetricInt(MS_M_EVENT_QUEUE_DROPS, SM_STALE_MID);
+  ms_m_event_latency_max = new OvmsMetricFloat(MS_M_EVENT_LATENCY_MAX, SM_STALE_MID, Seconds);
+  ms_m_event_slowest = new OvmsMetricString(MS_M_EVENT_SLOWEST, SM_STALE_MID);
+  ms_m_event_slowest_time = new OvmsMetricFloat(MS_M_EVENT_SLOWEST_TIME, SM_STALE_MID, Seconds);
+  ms_m_can_rx_rate = new OvmsMetricInt(MS_M_CAN_RX_RATE, SM_STALE_MID);
+  ms_m_can_rx_queue_max = new OvmsMetricInt(MS_M_CAN_RX_QUEUE_MAX, SM_STALE_MID);
+  ms_m_can_rx_batch = new OvmsMetricFloat(MS_M_CAN_RX_BATCH, SM_STALE_MID);
+  ms_m_can_load = new OvmsMetricFloat(MS_M_CAN_LOAD, SM_STALE_MID, Percentage);
+  ms_m_can_load_callbacks = new OvmsMetricFloat(MS_M_CAN_LOAD_CALLBACKS, SM_STALE_MID, Percentage);
+  ms_m_can_load_log = new OvmsMetricFloat(MS_M_CAN_LOAD_LOG, SM_STALE_MID, Percentage);
+  ms_m_can_load_listeners = new OvmsMetricFloat(MS_M_CAN_LOAD_LISTENERS, SM_STALE_MID, Percentage);
 
   ms_m_net_type = new OvmsMetricString(MS_N_TYPE, SM_STALE_MAX);
   ms_m_net_sq = new OvmsMetricInt(MS_N_SQ, SM_STALE_MAX, dbm);
@@ -47,6 +47,18 @@
 #define MS_M_FREERAM                "m.freeram"
 #define MS_M_MONOTONIC              "m.monotonic"
 #define MS_M_TIME_UTC               "m.time.utc"
+#define MS_M_EVENT_QUEUE_MAX        "m.event.queue.max"
+#define MS_M_EVENT_QUEUE_DROPS      "m.event.queue.drops"
+#define MS_M_EVENT_LATENCY_MAX      "m.event.latency.max"
+#define MS_M_EVENT_SLOWEST          "m.event.slowest"
+#define MS_M_EVENT_SLOWEST_TIME     "m.event.slowest.time"
+#define MS_M_CAN_RX_RATE            "m.can.rx.rate"
+#define MS_M_CAN_RX_QUEUE_MAX       "m.can.rx.queue.max"
+#define MS_M_CAN_RX_BATCH           "m.can.rx.batch"
+#define MS_M_CAN_LOAD               "m.can.load"
+#define MS_M_CAN_LOAD_CALLBACKS     "m.can.load.callbacks"
+#define MS_M_CAN_LOAD_LOG           "m.can.load.log"
+#define MS_M_CAN_LOAD_LISTENERS     "m.can.load.listeners"
 
 #define MS_N_TYPE                   "m.net.type"
 #define MS_N_SQ                     "m.net.sq"
@@ -291,6 +303,18 @@ class MetricsStandard
     OvmsMetricInt*    ms_m_freeram;
     OvmsMetricInt*    ms_m_monotonic;
     OvmsMetricInt64*  ms_m_timeutc;
+    OvmsMetricInt*    ms_m_event_queue_max;               // Event queue depth high water mark
+    OvmsMetricInt*    ms_m_event_queue_drops;             // Events dropped due to queue full
+    OvmsMetricFloat*  ms_m_event_latency_max;             // Max event signal → dispatch latency [s]
+    OvmsMetricString* ms_m_event_slowest;                 // Slowest event handler by P99 runtime (<event>/<caller>)
+    OvmsMetricFloat*  ms_m_event_slowest_time;            // … P99 runtime of that handler [s]
+    OvmsMetricInt*    ms_m_can_rx_rate;                   // CAN frames received per second (all buses)
+    OvmsMetricInt*    ms_m_can_rx_queue_max;              // CAN RX queue depth high water mark
+    OvmsMetricFloat*  ms_m_can_rx_batch;                  // Avg messages processed per CAN task wakeup
+    OvmsMetricFloat*  ms_m_can_load;                      // CAN task RX processing CPU load [%]
+    OvmsMetricFloat*  ms_m_can_load_callbacks;            // … thereof frame callbacks [%]
+    OvmsMetricFloat*  ms_m_can_load_log;                  // … thereof logging [%]
+    OvmsMetricFloat*  ms_m_can_load_listeners;            // … thereof listener notification [%]
 
     OvmsMetricString* ms_m_net_type;                      // none, wifi, modem
     OvmsMetricInt*    ms_m_net_sq;                        // Network signal quality [dbm]
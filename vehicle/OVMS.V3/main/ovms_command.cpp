@@ -50,7 +50,6 @@ static const char *TAG = "command";
 #include "ovms_utils.h"
 #include "ovms_script.h"
 #include "buffered_shell.h"
-#include "log_buffers.h"
 #include "ovms_semaphore.h"
 #include "ovms_vfs.h"
 
@@ -830,9 +829,13 @@ OvmsCommandApp::OvmsCommandApp()
   m_logfile_maxsize = 0;
   m_logtask = NULL;
   m_logtask_queue = NULL;
-  m_logtask_dropcnt = 0;
+  m_logtask_line = NULL;
   m_logfile_cyclecnt = 0;
   m_expiretask = 0;
+  m_partials_count = 0;
+
+  if (!m_logring.Init(CONFIG_OVMS_LOG_RING_SLOTS))
+    ESP_LOGE(TAG, "Unable to allocate log ring (out of memory)");
 
   m_root.RegisterCommand("help", "Ask for help", help, "", 0, 0, false);
   m_root.RegisterCommand("exit", "End console session", cmd_exit, "", 0, 0, false);
@@ -980,75 +983,64 @@ int OvmsCommandApp::Log(const char* fmt, ...)
 
 int OvmsCommandApp::Log(const char* fmt, va_list args)
   {
-  LogBuffers* lb;
-  TaskHandle_t task = xTaskGetCurrentTaskHandle();
-  PartialLogs::iterator it = m_partials.find(task);
-  if (it == m_partials.end())
-    lb = new LogBuffers();
-  else
+  if (!m_logring.IsReady())
+    return vprintf(fmt, args);
+
+  int ret;
+  std::string line;
+  if (m_partials_count > 0)
     {
-    lb = it->second;
-    m_partials.erase(task);
+    OvmsMutexLock lock(&m_partials_mutex);
+    PartialLogs::iterator it = m_partials.find(xTaskGetCurrentTaskHandle());
+    if (it != m_partials.end())
+      {
+      line.swap(it->second);
+      m_partials.erase(it);
+      m_partials_count--;
+      }
     }
-  int ret = LogBuffer(lb, fmt, args);
-  lb->set(m_consoles.size());
-  for (ConsoleSet::iterator it = m_consoles.begin(); it != m_consoles.end(); ++it)
+  if (line.empty())
     {
-    (*it)->Log(lb);
+    ret = m_logring.VPrintf(fmt, args);
     }
-  return ret;
-  }
-
-int OvmsCommandApp::LogPartial(const char* fmt, ...)
-  {
-  LogBuffers* lb;
-  TaskHandle_t task = xTaskGetCurrentTaskHandle();
-  PartialLogs::iterator it = m_partials.find(task);
-  if (it == m_partials.end())
+  else
     {
-    lb = new LogBuffers();
-    m_partials[task] = lb;
+    char *buffer;
+    ret = vasprintf(&buffer, fmt, args);
+    if (ret > 0)
+      {
+      line.append(buffer, ret);
+      free(buffer);
+      }
+    m_logring.Write(line.data(), line.size());
     }
-  else
+
+  for (ConsoleSet::iterator it = m_consoles.begin(); it != m_consoles.end(); ++it)
     {
-    lb = it->second;
+    (*it)->LogNotify();
     }
-  va_list args;
-  va_start(args, fmt);
-  int ret = LogBuffer(lb, fmt, args);
-  va_end(args);
   return ret;
   }
 
-int OvmsCommandApp::LogBuffer(LogBuffers* lb, const char* fmt, va_list args)
+int OvmsCommandApp::LogPartial(const char* fmt, ...)
   {
   char *buffer;
+  va_list args;
+  va_start(args, fmt);
   int ret = vasprintf(&buffer, fmt, args);
+  va_end(args);
   if (ret < 0) return ret;
 
-  // Replace CR/LF except last by "|", but don't leave '|' at the end.
-  // An ESC sequence to change color may be appended after the log text.
-  char* s;
-  for (s=buffer; *s; s++)
+  OvmsMutexLock lock(&m_partials_mutex);
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  PartialLogs::iterator it = m_partials.find(task);
+  if (it == m_partials.end())
     {
-    if (*s=='\r' || *s=='\n')
-      {
-      char *t = s;
-      if (*(s+1) == '\033')
-        ++s;
-      else if (*(s+1) != '\0')
-        {
-        *s = '|';
-        continue;
-        }
-      while (t > buffer && *(t-1) == '|')
-        --t;
-      while ((*t++ = *s++)) ;
-      break;
-      }
+    it = m_partials.insert(std::make_pair(task, std::string())).first;
+    m_partials_count++;
     }
-
-  lb->append(buffer);
+  it->second.append(buffer, ret);
+  free(buffer);
   return ret;
   }
 
@@ -1096,12 +1088,11 @@ struct LogTaskCmd
   {
   enum
     {
-    LTC_Log,          // write data.logbuffers to file
+    LTC_Log,          // write new log ring records to file
     LTC_Exit,         // close file, give data.cmdack, exit
     } type;
   union
     {
-    LogBuffers*       logbuffers;
     OvmsSemaphore*    cmdack;
     } data;
   };
@@ -1134,10 +1125,11 @@ void OvmsCommandApp::LogTask()
       // cmd received:
       if (cmd.type == LogTaskCmd::LTC_Log)
         {
-        // write logbuffers messages:
-        for (auto it = cmd.data.logbuffers->begin(); it != cmd.data.logbuffers->end(); it++)
+        // write log ring records:
+        m_logtask_reader.m_pending = false;
+        while (m_logring.Read(&m_logtask_reader, m_logtask_line, LOGRING_MAX_LINE) > 0)
           {
-          std::string le = stripesc(*it);
+          std::string le = stripesc(m_logtask_line);
           if (*(le.data() + 1) == ' ' && *(le.data() + 2) == '(')
             {
             struct timeval stamp;
@@ -1173,7 +1165,6 @@ void OvmsCommandApp::LogTask()
           m_logfile_size += fwrite(le.data(), 1, le.size(), m_logfile);
           m_logtask_linecnt++;
           }
-        cmd.data.logbuffers->release();
 
         // check file size:
         if (m_logfile_maxsize && m_logfile_size > (m_logfile_maxsize*1024))
@@ -1222,11 +1213,7 @@ void OvmsCommandApp::LogTask()
   LogTaskCmd drop;
   while (xQueueReceive(m_logtask_queue, (void*)&drop, 0) == pdTRUE)
     {
-    if (drop.type == LogTaskCmd::LTC_Log)
-      {
-      drop.data.logbuffers->release();
-      }
-    else if (drop.type == LogTaskCmd::LTC_Exit)
+    if (drop.type == LogTaskCmd::LTC_Exit)
       {
       if (drop.data.cmdack)
         drop.data.cmdack->Give();
@@ -1247,14 +1234,24 @@ bool OvmsCommandApp::StartLogTask(FILE* file)
   m_logfile = file;
   if (m_logtask)
     return true;
-  // create queue:
-  m_logtask_dropcnt = 0;
-  m_logtask_queue = xQueueCreate(CONFIG_OVMS_LOGFILE_QUEUE_SIZE, sizeof(LogTaskCmd));
+  // allocate line buffer:
+  if (!m_logtask_line)
+    m_logtask_line = (char*) ExternalRamMalloc(LOGRING_MAX_LINE);
+  if (!m_logtask_line)
+    {
+    ESP_LOGE(TAG, "StartLogTask: unable to allocate line buffer (out of memory)");
+    return false;
+    }
+  // create queue (log records are read from the log ring, LTC_Log is only
+  // queued once per wakeup):
+  m_logtask_queue = xQueueCreate(4, sizeof(LogTaskCmd));
   if (!m_logtask_queue)
     {
     ESP_LOGE(TAG, "StartLogTask: unable to create queue (out of memory)");
     return false;
     }
+  m_logring.Attach(&m_logtask_reader);
+  m_logtask_reader.m_dropped = 0;
   // create task:
   BaseType_t res = xTaskCreatePinnedToCore(LogTaskEntry, "OVMS FileLog", 3*1024, (void*)this,
     CONFIG_OVMS_LOGFILE_TASK_PRIORITY, &m_logtask, CORE(1));
@@ -1398,22 +1395,16 @@ bool OvmsCommandApp::CycleLogfile()
   return OpenLogfile();
   }
 
-void OvmsCommandApp::Log(LogBuffers* msg)
+void OvmsCommandApp::LogNotify()
   {
-  if (!m_logtask || !m_logtask_queue)
-    {
-    msg->release();
+  if (!m_logtask || !m_logtask_queue || m_logtask_reader.m_pending.exchange(true))
     return;
-    }
-  // send to LogTask:
+  // wake up LogTask:
   LogTaskCmd cmd;
   cmd.type = LogTaskCmd::LTC_Log;
-  cmd.data.logbuffers = msg;
+  cmd.data.cmdack = NULL;
   if (xQueueSend(m_logtask_queue, &cmd, 0) != pdTRUE)
-    {
-    m_logtask_dropcnt++;
-    msg->release();
-    }
+    m_logtask_reader.m_pending = false;
   }
 
 void OvmsCommandApp::SetLoglevel(std::string tag, std::string level)
@@ -1542,15 +1533,28 @@ void OvmsCommandApp::ShowLogStatus(int verbosity, OvmsWriter* writer)
     "  Dropped messages : %" PRIu32 "\n"
     "  Messages logged  : %" PRIu32 "\n"
     "  Total fsync time : %.1f s\n"
+    "Log ring buffer    : %s\n"
+    "  Size             : %" PRIu32 " slots, %u kB\n"
+    "  Records written  : %" PRIu32 "\n"
+    "  Long records     : %" PRIu32 "\n"
+    "  Truncated        : %" PRIu32 "\n"
+    "  Overrun drops    : %" PRIu32 "\n"
     , m_consoles.size()
     , m_logfile ? "active" : "inactive"
     , m_logfile_path.empty() ? "-" : m_logfile_path.c_str()
     , (float) m_logfile_size / 1024.0f
     , m_logfile_maxsize
     , m_logfile_cyclecnt
-    , m_logtask_dropcnt
+    , m_logtask_reader.m_dropped
     , m_logtask_linecnt
-    , m_logtask_fsynctime / 1e6);
+    , m_logtask_fsynctime / 1e6
+    , m_logring.IsReady() ? "active" : "unavailable"
+    , m_logring.GetSlots()
+    , (unsigned int)(m_logring.GetSlots() * (LOGRING_SLOT_SIZE + sizeof(LogRingSlot)) / 1024)
+    , m_logring.GetRecords()
+    , m_logring.GetLongRecords()
+    , m_logring.GetTruncated()
+    , m_logring.GetOverruns());
   }
 
 void OvmsCommandApp::EventHandler(std::string event, void* data)
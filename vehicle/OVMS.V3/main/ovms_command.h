@@ -38,10 +38,12 @@
 #include <list>
 #include <functional>
 #include <limits.h>
+#include <atomic>
 #include "ovms.h"
 #include "ovms_utils.h"
 #include "ovms_mutex.h"
 #include "task_base.h"
+#include "log_ring.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "microrl_config.h"
@@ -54,8 +56,7 @@
 class OvmsWriter;
 class OvmsCommand;
 class OvmsCommandMap;
-class LogBuffers;
-typedef std::map<TaskHandle_t, LogBuffers*> PartialLogs;
+typedef std::map<TaskHandle_t, std::string> PartialLogs;
 typedef bool (*InsertCallback)(OvmsWriter* writer, void* userData, char);
 
 class OvmsWriter
@@ -72,7 +73,7 @@ class OvmsWriter
     virtual char** GetCompletions(int &common_len, bool &finished ) { return NULL; }
     virtual void SetArgv(const char* const* argv) { return; }
     virtual const char* const* GetArgv() { return NULL; }
-    virtual void Log(LogBuffers* message) {};
+    virtual void LogNotify() {};
     virtual void Exit();
     virtual bool IsInteractive() { return true; }
     void RegisterInsertCallback(InsertCallback cb, void* ctx);
@@ -381,17 +382,18 @@ class OvmsCommandApp : public OvmsWriter
     void ReadConfig();
 
     OvmsCommand* CheckCreateUsr(OvmsCommand *, bool allow_create_user);
-  private:
-    int LogBuffer(LogBuffers* lb, const char* fmt, va_list args) __attribute__ ((format (printf, 3, 0)));
-
   public:
-    void Log(LogBuffers* message);
+    OvmsLogRing* GetLogRing() { return &m_logring; }
+    void LogNotify();
 
   private:
     OvmsCommand m_root;
     typedef std::set<OvmsWriter*> ConsoleSet;
     ConsoleSet m_consoles;
+    OvmsLogRing m_logring;
     PartialLogs m_partials;
+    OvmsMutex m_partials_mutex;
+    std::atomic<int> m_partials_count;
     FILE* m_logfile;
     std::string m_logfile_path;
     size_t m_logfile_size;
@@ -399,7 +401,8 @@ class OvmsCommandApp : public OvmsWriter
     TaskHandle_t m_logtask;
     OvmsMutex m_logtask_mutex;
     QueueHandle_t m_logtask_queue;
-    uint32_t m_logtask_dropcnt;
+    OvmsLogReader m_logtask_reader;
+    char* m_logtask_line;
     uint32_t m_logfile_cyclecnt;
     uint32_t m_logtask_linecnt;
     uint32_t m_logtask_fsynctime;
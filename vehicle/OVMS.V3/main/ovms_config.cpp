@@ -35,8 +35,11 @@ static const char *TAG = "config";
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <string.h>
+#include <inttypes.h>
 #include <sstream>
 #include <dirent.h>
+#include <algorithm>
+#include "esp_timer.h"
 #include "crypt_base64.h"
 #include "ovms_config.h"
 #include "ovms_command.h"
@@ -52,7 +55,10 @@ static const char *TAG = "config";
 #endif // CONFIG_OVMS_SC_ZIP
 
 #define OVMS_CONFIGPATH "/store/ovms_config"
+#define OVMS_JOURNALPATH OVMS_CONFIGPATH "/.journal"
 #define OVMS_MAXVALSIZE 2500
+#define OVMS_JOURNAL_DELAY 10           // Seconds without changes before compaction
+#define OVMS_JOURNAL_MAXENTRIES 50      // Compact regardless of changes when reached
 //#define OVMS_PERSIST_METADATA
 
 
@@ -174,6 +180,38 @@ void config_rm(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, co
   writer->printf("Parameter %s has been removed.\n", argv[0]);
   }
 
+void config_test(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int loops = (argc > 0) ? atoi(argv[0]) : 10000;
+  if (loops <= 0) loops = 10000;
+  float sum = 0;
+
+  uint64_t start = esp_timer_get_time();
+  for (int i = 0; i < loops; i++)
+    sum += MyConfig.GetParamValueFloat("vehicle", "bms.dev.voltage.maxgrad", 0.01);
+  uint64_t time_get = esp_timer_get_time() - start;
+
+  ConfigValue<float> handle("vehicle", "bms.dev.voltage.maxgrad", 0.01);
+  start = esp_timer_get_time();
+  for (int i = 0; i < loops; i++)
+    sum += handle;
+  uint64_t time_handle = esp_timer_get_time() - start;
+
+  writer->printf("%d reads of vehicle/bms.dev.voltage.maxgrad (sum %g):\n", loops, sum);
+  writer->printf("  GetParamValueFloat: %8" PRIu64 " us = %.3f us/read\n", time_get, (double)time_get / loops);
+  writer->printf("  ConfigValue<float>: %8" PRIu64 " us = %.3f us/read\n", time_handle, (double)time_handle / loops);
+  }
+
+void config_stats(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  MyConfig.OutputStats(writer);
+  if (strcmp(cmd->GetName(), "reset") == 0)
+    {
+    MyConfig.ResetStats();
+    writer->puts("Statistics reset");
+    }
+  }
+
 #ifdef CONFIG_OVMS_SC_ZIP
 void config_backup(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
@@ -394,6 +432,8 @@ OvmsConfig::OvmsConfig()
   ESP_LOGI(TAG, "Initialising CONFIG (1400)");
 
   m_mounted = false;
+  memset(&m_stats, 0, sizeof(m_stats));
+  m_generation = 1;
 
   OvmsCommand* cmd_store = MyCommandApp.RegisterCommand("store","STORE framework");
   cmd_store->RegisterCommand("mount","Mount STORE",store_mount);
@@ -403,6 +443,8 @@ OvmsConfig::OvmsConfig()
   cmd_config->RegisterCommand("list","Show configuration parameters/instances",config_list,"[<param>]",0,1, true, config_validate);
   cmd_config->RegisterCommand("set","Set parameter:instance=value",config_set,"<param> <instance> <value>",3,3, true, config_validate);
   cmd_config->RegisterCommand("rm","Remove parameter:instance",config_rm,"<param> {<instance> | *}",2,2, true, config_validate);
+  OvmsCommand* cmd_stats = cmd_config->RegisterCommand("stats","Show config store statistics",config_stats);
+  cmd_stats->RegisterCommand("reset","Show statistics and reset",config_stats);
 
 #ifdef CONFIG_OVMS_SC_ZIP
   cmd_config->RegisterCommand("backup", "Backup to file", config_backup,
@@ -421,6 +463,15 @@ OvmsConfig::OvmsConfig()
     "The default password is not available after flash is erased.", 1, 2, true, vfs_file_validate);
 #endif // CONFIG_OVMS_SC_ZIP
 
+  OvmsCommand* cmd_test = MyCommandApp.RegisterCommand("test","Test framework");
+  cmd_test->RegisterCommand("config","Test config read access performance",config_test,"[<loops>]",0,1);
+
+  #undef bind  // Kludgy, but works
+  using std::placeholders::_1;
+  using std::placeholders::_2;
+  MyEvents.RegisterEvent(TAG,"ticker.1", std::bind(&OvmsConfig::EventTicker, this, _1, _2));
+  MyEvents.RegisterEvent(TAG,"system.shuttingdown", std::bind(&OvmsConfig::EventTicker, this, _1, _2));
+
   RegisterParam("password", "Password store", true, false);
   RegisterParam("module", "Module configuration", true, true);
   RegisterParam("usr", "Custom plugin configuration", true, true);
@@ -470,6 +521,8 @@ esp_err_t OvmsConfig::mount()
     ESP_LOGI(TAG, "Initialising OVMS CONFIG within STORE");
     mkdir(OVMS_CONFIGPATH,0);
     }
+  if (stat(OVMS_JOURNALPATH, &ds) != 0)
+    mkdir(OVMS_JOURNALPATH,0);
 
   DIR *dir;
   struct dirent *dp;
@@ -480,6 +533,9 @@ esp_err_t OvmsConfig::mount()
     }
   while ((dp = readdir(dir)) != NULL)
     {
+    // Skip the journal directory:
+    if (dp->d_name[0] == '.')
+      continue;
     // Register the param in case this was not already done
     if (CachedParam(dp->d_name) == NULL)
       RegisterParam(dp->d_name, "", true, false);
@@ -493,6 +549,7 @@ esp_err_t OvmsConfig::mount()
     }
   upgrade();
 
+  m_generation++;
   MyEvents.SignalEvent("config.mounted", NULL);
   return ESP_OK;
   }
@@ -504,12 +561,14 @@ esp_err_t OvmsConfig::unmount()
 
   if (m_mounted)
     {
+    CompactJournals(true);
 #if ESP_IDF_VERSION_MAJOR >= 5
     esp_vfs_fat_spiflash_unmount_rw_wl("/store", m_store_wlh);
 #else
     esp_vfs_fat_spiflash_unmount("/store", m_store_wlh);
 #endif
     m_mounted = false;
+    m_generation++;
     MyEvents.SignalEvent("config.unmounted", NULL);
     }
 
@@ -832,6 +891,10 @@ bool OvmsConfig::Backup(std::string path, std::string password, OvmsWriter* writ
   else
     ESP_LOGD(TAG, "Backup: creating '%s'...", path.c_str());
 
+  // Fold pending journals into the param files, so the backup is readable
+  // by firmware versions without journal support:
+  CompactJournals(true);
+
   OvmsMutexLock store_lock(&m_store_lock);
   bool ok = true;
 
@@ -1003,6 +1066,9 @@ bool OvmsConfig::Restore(std::string path, std::string password, OvmsWriter* wri
     return false;
     }
 
+  // The journals of the previous config must not be compacted on shutdown:
+  m_dirty.clear();
+
   if (writer)
     writer->puts("Done, rebooting now...");
   else
@@ -1034,6 +1100,98 @@ void OvmsConfig::SupportSummary(OvmsWriter* writer)
     }
   }
 
+void OvmsConfig::EventTicker(std::string event, void* data)
+  {
+  CompactJournals(event == "system.shuttingdown");
+  }
+
+/**
+ * CompactJournals: rewrite param files with pending journal records
+ *  - without force, only params idle for OVMS_JOURNAL_DELAY seconds or with
+ *    OVMS_JOURNAL_MAXENTRIES records are compacted, so bursts of changes
+ *    (scripts, web config pages) result in a single file rewrite
+ */
+void OvmsConfig::CompactJournals(bool force /*=false*/)
+  {
+  // Don't block the event task, the store may be locked by a backup/restore:
+  OvmsMutexLock store_lock(&m_store_lock, force ? pdMS_TO_TICKS(5000) : 0);
+  if (!store_lock.IsLocked() || m_dirty.empty())
+    return;
+  int64_t now = esp_timer_get_time();
+  size_t i = 0;
+  while (i < m_dirty.size())
+    {
+    OvmsConfigParam* p = m_dirty[i];
+    if (force || p->m_journal_entries >= OVMS_JOURNAL_MAXENTRIES ||
+        now - p->m_journal_time >= OVMS_JOURNAL_DELAY * 1000000LL)
+      {
+      if (p->CompactConfig())
+        continue;   // removed from m_dirty
+      p->m_journal_time = now;  // retry after delay
+      }
+    i++;
+    }
+  }
+
+void OvmsConfig::OutputStats(OvmsWriter* writer)
+  {
+  OvmsMutexLock store_lock(&m_store_lock);
+  const ConfigStats_t& s = m_stats;
+  writer->printf("Changes:        %10" PRIu32 "  avg %" PRIu64 " us, max %" PRIu32 " us\n",
+    s.changes, s.changes ? s.change_total / s.changes : 0, s.change_max);
+  writer->printf("Journal writes: %10" PRIu32 "  %" PRIu32 " bytes\n", s.journal_writes, s.journal_bytes);
+  writer->printf("Compactions:    %10" PRIu32 "  %" PRIu32 " bytes\n", s.compactions, s.compact_bytes);
+  writer->printf("Flash writes:   %10" PRIu32 "  (%" PRIu32 " full rewrites saved)\n",
+    s.journal_writes + s.compactions,
+    (s.changes > s.compactions) ? s.changes - s.compactions : 0);
+  writer->printf("Errors:         %10" PRIu32 "\n", s.errors);
+  writer->printf("Pending:        %10u\n", (unsigned)m_dirty.size());
+  for (OvmsConfigParam* p : m_dirty)
+    writer->printf("  %-20s %d records\n", p->m_name.c_str(), p->m_journal_entries);
+  }
+
+void OvmsConfig::ResetStats()
+  {
+  OvmsMutexLock store_lock(&m_store_lock);
+  memset(&m_stats, 0, sizeof(m_stats));
+  }
+
+template<> void ConfigValue<float>::Update()
+  {
+  uint32_t generation = MyConfig.m_generation;
+  std::string value = MyConfig.GetParamValue(m_param, m_instance);
+  m_defined = !value.empty();
+  if (m_defined) m_value = atof(value.c_str());
+  m_generation = generation;
+  }
+
+template<> void ConfigValue<int>::Update()
+  {
+  uint32_t generation = MyConfig.m_generation;
+  std::string value = MyConfig.GetParamValue(m_param, m_instance);
+  m_defined = !value.empty();
+  if (m_defined) m_value = atoi(value.c_str());
+  m_generation = generation;
+  }
+
+template<> void ConfigValue<bool>::Update()
+  {
+  uint32_t generation = MyConfig.m_generation;
+  std::string value = MyConfig.GetParamValue(m_param, m_instance);
+  m_defined = !value.empty();
+  if (m_defined) m_value = strtobool(value);
+  m_generation = generation;
+  }
+
+template<> void ConfigValue<std::string>::Update()
+  {
+  uint32_t generation = MyConfig.m_generation;
+  std::string value = MyConfig.GetParamValue(m_param, m_instance);
+  m_defined = !value.empty();
+  if (m_defined) m_value = std::move(value);
+  m_generation = generation;
+  }
+
 OvmsConfigParam::OvmsConfigParam(std::string name, std::string title, bool writable, bool readable)
   {
   m_name = name;
@@ -1041,6 +1199,8 @@ OvmsConfigParam::OvmsConfigParam(std::string name, std::string title, bool writa
   m_writable = writable;
   m_readable = readable;
   m_loaded = false;
+  m_journal_entries = 0;
+  m_journal_time = 0;
 
   if (MyConfig.ismounted())
     {
@@ -1061,6 +1221,19 @@ void OvmsConfigParam::LoadConfig()
   std::string path(OVMS_CONFIGPATH);
   path.append("/");
   path.append(m_name);
+  std::string tmppath = OVMS_JOURNALPATH "/" + m_name + ".new";
+
+  // Recover from an interrupted compaction: a new file without the old one
+  // is complete, else the old file and the journal are still valid
+  struct stat st;
+  if (stat(tmppath.c_str(), &st) == 0)
+    {
+    if (stat(path.c_str(), &st) == 0)
+      unlink(tmppath.c_str());
+    else
+      rename(tmppath.c_str(), path.c_str());
+    }
+
   // ESP_LOGI(TAG, "Trying %s",path.c_str());
   FILE* f = fopen(path.c_str(), "r");
   if (f)
@@ -1068,7 +1241,19 @@ void OvmsConfigParam::LoadConfig()
     char* buf = new char[OVMS_MAXVALSIZE];
     while (fgets(buf, OVMS_MAXVALSIZE, f))
       {
-      buf[strlen(buf)-1] = 0; // Remove trailing newline
+      size_t len = strlen(buf);
+      if (len > 0 && buf[len-1] == '\n')
+        {
+        buf[len-1] = 0; // Remove trailing newline
+        }
+      else if (!feof(f))
+        {
+        // Line exceeds the buffer: skip it including the remainder
+        int c;
+        while ((c = fgetc(f)) != EOF && c != '\n');
+        continue;
+        }
+      // else: last line without newline (e.g. edited file), use as is
 #ifdef OVMS_PERSIST_METADATA
       // check for meta data:
       if (buf[0] == '#')
@@ -1100,41 +1285,120 @@ void OvmsConfigParam::LoadConfig()
     delete[] buf;
     fclose(f);
     }
+  LoadJournal(OVMS_JOURNALPATH "/" + m_name + ".jnl");
   m_loaded = true;
+  MyConfig.m_generation++;
+  }
+
+/**
+ * LoadJournal: replay the changes recorded since the last compaction
+ *  - records are "+<instance>\t<value>" (set) and "-<instance>" (delete)
+ *  - a truncated last record (power loss during append) is ignored
+ */
+void OvmsConfigParam::LoadJournal(const std::string& path)
+  {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) return;
+
+  int entries = 0;
+  char* buf = new char[OVMS_MAXVALSIZE];
+  while (fgets(buf, OVMS_MAXVALSIZE, f))
+    {
+    size_t len = strlen(buf);
+    if (len == 0 || buf[len-1] != '\n')
+      {
+      // Truncated last record, or record exceeding the buffer: skip it
+      //  including the remainder, so that is not parsed as a record
+      int c;
+      while ((c = fgetc(f)) != EOF && c != '\n');
+      continue;
+      }
+    buf[len-1] = 0;
+    if (buf[0] == '+')
+      {
+      char *p = index(buf,char(9));
+      if (!p) continue;
+      *p++ = 0;
+      m_map[std::string(buf+1)] = std::string(p);
+      }
+    else if (buf[0] == '-')
+      {
+      m_map.erase(std::string(buf+1));
+      }
+    else
+      continue;
+    entries++;
+    }
+  delete[] buf;
+  fclose(f);
+
+  // Schedule compaction:
+  m_journal_entries = std::max(entries, 1);
+  m_journal_time = 0;
+  if (std::find(MyConfig.m_dirty.begin(), MyConfig.m_dirty.end(), this) == MyConfig.m_dirty.end())
+    MyConfig.m_dirty.push_back(this);
+  ESP_LOGD(TAG, "LoadJournal: %s: replayed %d records", m_name.c_str(), entries);
   }
 
 void OvmsConfigParam::SetValue(std::string instance, std::string value)
   {
-  if (m_map.find(instance) == m_map.end() || m_map[instance] != value)
     {
+    OvmsMutexLock store_lock(&MyConfig.m_store_lock);
+    int64_t start = esp_timer_get_time();
+    auto k = m_map.find(instance);
+    if (k != m_map.end() && k->second == value)
+      return;
     m_map[instance] = value;
-    RewriteConfig();
-    MyEvents.SignalEvent("config.changed", this);
+    AppendJournal('+', instance, value);
+    uint32_t elapsed = esp_timer_get_time() - start;
+    MyConfig.m_stats.changes++;
+    MyConfig.m_stats.change_total += elapsed;
+    if (elapsed > MyConfig.m_stats.change_max) MyConfig.m_stats.change_max = elapsed;
     }
+  MyConfig.m_generation++;
+  MyEvents.SignalEvent("config.changed", this);
   }
 
 void OvmsConfigParam::DeleteParam()
   {
-  OvmsMutexLock store_lock(&MyConfig.m_store_lock);
-
-  std::string path(OVMS_CONFIGPATH);
-  path.append("/");
-  path.append(m_name);
-  unlink(path.c_str());
-  m_map.clear();
+    {
+    // The files, m_dirty & the map are all store state, change them
+    //  atomically with respect to CompactJournals() on the events task:
+    OvmsMutexLock store_lock(&MyConfig.m_store_lock);
+    std::string path(OVMS_CONFIGPATH);
+    path.append("/");
+    path.append(m_name);
+    unlink(path.c_str());
+    unlink((OVMS_JOURNALPATH "/" + m_name + ".jnl").c_str());
+    unlink((OVMS_JOURNALPATH "/" + m_name + ".new").c_str());
+    auto d = std::find(MyConfig.m_dirty.begin(), MyConfig.m_dirty.end(), this);
+    if (d != MyConfig.m_dirty.end()) MyConfig.m_dirty.erase(d);
+    m_journal_entries = 0;
+    m_map.clear();
+    }
+  MyConfig.m_generation++;
   MyEvents.SignalEvent("config.changed", this);
   }
 
 bool OvmsConfigParam::DeleteInstance(std::string instance)
   {
   bool ret = false;
-  auto k = m_map.find(instance);
-  if (k != m_map.end())
     {
-    m_map.erase(k);
-    RewriteConfig();
-    ret = true;
+    OvmsMutexLock store_lock(&MyConfig.m_store_lock);
+    int64_t start = esp_timer_get_time();
+    auto k = m_map.find(instance);
+    if (k != m_map.end())
+      {
+      m_map.erase(k);
+      AppendJournal('-', instance, "");
+      uint32_t elapsed = esp_timer_get_time() - start;
+      MyConfig.m_stats.changes++;
+      MyConfig.m_stats.change_total += elapsed;
+      if (elapsed > MyConfig.m_stats.change_max) MyConfig.m_stats.change_max = elapsed;
+      ret = true;
+      }
     }
+  MyConfig.m_generation++;
   MyEvents.SignalEvent("config.changed", this);
   return ret;
   }
@@ -1183,28 +1447,95 @@ std::string OvmsConfigParam::GetName()
 void OvmsConfigParam::RewriteConfig()
   {
   OvmsMutexLock store_lock(&MyConfig.m_store_lock);
+  CompactConfig();
+  }
 
+/**
+ * AppendJournal: record a single change (caller holds the store lock)
+ *  - falls back to a full rewrite if the journal cannot be written
+ */
+bool OvmsConfigParam::AppendJournal(char op, const std::string& instance, const std::string& value)
+  {
+  std::string path = OVMS_JOURNALPATH "/" + m_name + ".jnl";
+  FILE* f = fopen(path.c_str(), "a");
+  if (!f)
+    {
+    ESP_LOGW(TAG, "AppendJournal: can't open '%s': %s", path.c_str(), strerror(errno));
+    MyConfig.m_stats.errors++;
+    return CompactConfig();
+    }
+  int len;
+  if (op == '+')
+    len = fprintf(f, "+%s\t%s\n", instance.c_str(), value.c_str());
+  else
+    len = fprintf(f, "-%s\n", instance.c_str());
+  if (fclose(f) || len < 0)
+    {
+    ESP_LOGW(TAG, "AppendJournal: error writing '%s': %s", path.c_str(), strerror(errno));
+    MyConfig.m_stats.errors++;
+    return CompactConfig();
+    }
+  MyConfig.m_stats.journal_writes++;
+  MyConfig.m_stats.journal_bytes += len;
+  if (m_journal_entries++ == 0)
+    MyConfig.m_dirty.push_back(this);
+  m_journal_time = esp_timer_get_time();
+  return true;
+  }
+
+/**
+ * CompactConfig: rewrite the param file from memory (caller holds the store lock)
+ *  - the file is written to the journal directory and renamed into place,
+ *    LoadConfig() recovers from a power loss at any point of this sequence
+ */
+bool OvmsConfigParam::CompactConfig()
+  {
   std::string path(OVMS_CONFIGPATH);
   path.append("/");
   path.append(m_name);
-  FILE* f = fopen(path.c_str(), "w");
+  std::string tmppath = OVMS_JOURNALPATH "/" + m_name + ".new";
+  FILE* f = fopen(tmppath.c_str(), "w");
   if (!f)
-    ESP_LOGE(TAG, "RewriteConfig: can't open '%s': %s", path.c_str(), strerror(errno));
-  else
     {
+    ESP_LOGE(TAG, "RewriteConfig: can't open '%s': %s", tmppath.c_str(), strerror(errno));
+    MyConfig.m_stats.errors++;
+    return false;
+    }
+  long size;
 #ifdef OVMS_PERSIST_METADATA
-    // write meta data:
-    fprintf(f, "#access=%s%s\n", m_readable ? "r" : "", m_writable ? "w" : "");
-    fprintf(f, "#title=%s\n", m_title.c_str());
+  // write meta data:
+  fprintf(f, "#access=%s%s\n", m_readable ? "r" : "", m_writable ? "w" : "");
+  fprintf(f, "#title=%s\n", m_title.c_str());
 #endif
-    // write instances:
-    for (ConfigParamMap::iterator it=m_map.begin(); it!=m_map.end(); ++it)
-      {
-      fprintf(f,"%s\t%s\n",it->first.c_str(),it->second.c_str());
-      }
-    if (fclose(f))
-      ESP_LOGE(TAG, "RewriteConfig: error writing '%s': %s", path.c_str(), strerror(errno));
+  // write instances:
+  for (ConfigParamMap::iterator it=m_map.begin(); it!=m_map.end(); ++it)
+    {
+    fprintf(f,"%s\t%s\n",it->first.c_str(),it->second.c_str());
+    }
+  size = ftell(f);
+  if (fclose(f))
+    {
+    ESP_LOGE(TAG, "RewriteConfig: error writing '%s': %s", tmppath.c_str(), strerror(errno));
+    MyConfig.m_stats.errors++;
+    unlink(tmppath.c_str());
+    return false;
     }
+  unlink(path.c_str());
+  if (rename(tmppath.c_str(), path.c_str()) != 0)
+    {
+    ESP_LOGE(TAG, "RewriteConfig: can't rename '%s': %s", tmppath.c_str(), strerror(errno));
+    MyConfig.m_stats.errors++;
+    return false;
+    }
+
+  // Journal is obsolete now:
+  unlink((OVMS_JOURNALPATH "/" + m_name + ".jnl").c_str());
+  auto d = std::find(MyConfig.m_dirty.begin(), MyConfig.m_dirty.end(), this);
+  if (d != MyConfig.m_dirty.end()) MyConfig.m_dirty.erase(d);
+  m_journal_entries = 0;
+  MyConfig.m_stats.compactions++;
+  if (size > 0) MyConfig.m_stats.compact_bytes += size;
+  return true;
   }
 
 void OvmsConfigParam::Load()
@@ -1217,6 +1548,7 @@ void OvmsConfigParam::Save()
   if (m_name != "")
     {
     RewriteConfig();
+    MyConfig.m_generation++;
     MyEvents.SignalEvent("config.changed", this);
     }
   }
@@ -1227,7 +1559,14 @@ void OvmsConfigParam::Save()
  */
 void OvmsConfigParam::SetMap(ConfigParamMap& map)
   {
-  m_map.clear();
-  m_map = std::move(map);
-  Save();
+    {
+    // Replace & rewrite atomically with respect to CompactJournals():
+    OvmsMutexLock store_lock(&MyConfig.m_store_lock);
+    m_map.clear();
+    m_map = std::move(map);
+    if (m_name != "")
+      CompactConfig();
+    }
+  MyConfig.m_generation++;
+  MyEvents.SignalEvent("config.changed", this);
   }
@@ -33,6 +33,8 @@
 
 #include "string"
 #include "map"
+#include "vector"
+#include "atomic"
 #include "esp_err.h"
 #include "esp_vfs_fat.h"
 #include "wear_levelling.h"
@@ -67,6 +69,10 @@ class OvmsConfigParam
   protected:
     void RewriteConfig();
     void LoadConfig();
+    void LoadJournal(const std::string& path);
+    bool AppendJournal(char op, const std::string& instance, const std::string& value);
+    bool CompactConfig();
+    friend class OvmsConfig;
 
   protected:
     std::string m_name;
@@ -74,6 +80,8 @@ class OvmsConfigParam
     bool m_writable;
     bool m_readable;
     bool m_loaded;
+    int m_journal_entries;          // Records appended since last compaction
+    int64_t m_journal_time;         // Time of last journal append [us]
 
   public:
     ConfigParamMap m_map;
@@ -81,6 +89,18 @@ class OvmsConfigParam
 
 typedef NameMap<OvmsConfigParam*> ConfigMap;
 
+typedef struct
+  {
+  uint32_t changes;               // Instance value changes (set & delete)
+  uint32_t journal_writes;        // Journal record appends
+  uint32_t journal_bytes;
+  uint32_t compactions;           // Full param file rewrites
+  uint32_t compact_bytes;
+  uint32_t errors;
+  uint32_t change_max;            // Max set/delete latency [us]
+  uint64_t change_total;          // Total set/delete latency [us]
+  } ConfigStats_t;
+
 typedef enum
   {
   Encoding_HEX = 0,
@@ -128,9 +148,13 @@ class OvmsConfig
 
   public:
     void SupportSummary(OvmsWriter* writer);
+    void CompactJournals(bool force=false);
+    void OutputStats(OvmsWriter* writer);
+    void ResetStats();
 
   protected:
     void upgrade();
+    void EventTicker(std::string event, void* data);
 
   protected:
     bool m_mounted;
@@ -140,8 +164,66 @@ class OvmsConfig
   public:
     ConfigMap m_map;
     OvmsMutex m_store_lock;
+    std::vector<OvmsConfigParam*> m_dirty;  // Params with uncompacted journal, m_store_lock
+    ConfigStats_t m_stats;
+    std::atomic<uint32_t> m_generation;     // Incremented on every change, see ConfigValue
   };
 
 extern OvmsConfig MyConfig;
 
+/**
+ * ConfigValue: typed config instance handle for hot paths
+ *  - binds (param, instance, default) once, caches the parsed value
+ *  - the cache is invalidated by the config generation counter, which is
+ *    incremented everywhere "config.changed" is signalled, so an unchanged
+ *    config read is a single compare & load
+ *  - T: float, int, bool or std::string (parsed like GetParamValue<T>())
+ *  - param & instance must be static strings
+ *
+ *  Usage:
+ *    ConfigValue<float> m_cfg_ref { "vehicle", "12v.ref", 12.6 };
+ *    float dref = m_cfg_ref;
+ */
+template <typename T> class ConfigValue
+  {
+  public:
+    ConfigValue(const char* param, const char* instance, T defvalue = T())
+      : m_param(param), m_instance(instance), m_default(defvalue) {}
+
+  public:
+    T Get()
+      {
+      if (m_generation != MyConfig.m_generation) Update();
+      return m_defined ? m_value : m_default;
+      }
+    T Get(T defvalue)
+      {
+      if (m_generation != MyConfig.m_generation) Update();
+      return m_defined ? m_value : defvalue;
+      }
+    operator T() { return Get(); }
+    bool IsDefined()
+      {
+      if (m_generation != MyConfig.m_generation) Update();
+      return m_defined;
+      }
+    void SetDefault(T defvalue) { m_default = defvalue; }
+
+  protected:
+    void Update();
+
+  protected:
+    const char* m_param;
+    const char* m_instance;
+    T m_default;
+    T m_value = T();
+    bool m_defined = false;
+    uint32_t m_generation = 0;    // 0 = invalid, config generation starts at 1
+  };
+
+template<> void ConfigValue<float>::Update();
+template<> void ConfigValue<int>::Update();
+template<> void ConfigValue<bool>::Update();
+template<> void ConfigValue<std::string>::Update();
+
 #endif //#ifndef __CONFIG_H__
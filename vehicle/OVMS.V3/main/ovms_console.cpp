@@ -34,7 +34,7 @@
 #include "ovms_log.h"
 #include "ovms_console.h"
 #include "ovms_version.h"
-#include "log_buffers.h"
+#include "ovms_malloc.h"
 
 //static const char *TAG = "Console";
 static char CRbuf[4] = { '\r', '\033', '[', 'K' };
@@ -57,12 +57,15 @@ OvmsConsole::OvmsConsole()
   m_discarded = 0;
   m_state = AT_PROMPT;
   m_lost = m_acked = 0;
+  m_logline = NULL;
   }
 
 OvmsConsole::~OvmsConsole()
   {
   m_ready = false;
   MyCommandApp.DeregisterConsole(this);
+  if (m_logline)
+    free(m_logline);
   }
 
 void OvmsConsole::Initialize(const char* console)
@@ -74,6 +77,9 @@ void OvmsConsole::Initialize(const char* console)
     printf("\nWelcome to the Open Vehicle Monitoring System (OVMS) - %s Console\n", console);
     printf("Firmware: %s\nHardware: %s\n",GetOVMSVersion().c_str(),GetOVMSHardware().c_str());
     ProcessChar('\n');
+    if (!m_logline)
+      m_logline = (char*) ExternalRamMalloc(LOGRING_MAX_LINE);
+    MyCommandApp.GetLogRing()->Attach(&m_logreader);
     MyCommandApp.RegisterConsole(this);
     }
   m_ready = true;
@@ -126,22 +132,16 @@ char** OvmsConsole::GetCompletions(int &common_len, bool &finished )
   return m_completions;
   }
 
-void OvmsConsole::Log(LogBuffers* message)
+void OvmsConsole::LogNotify()
   {
-  if (!m_ready)
-    {
-    message->release();
+  // Signal new log ring records, unless a signal is already pending:
+  if (!m_ready || !m_logline || m_logreader.m_pending.exchange(true))
     return;
-    }
   Event event;
-  event.type = ALERT_MULTI;
-  event.multi = message;
+  event.type = ALERT_RING;
   BaseType_t ret = xQueueSendToBack(m_queue, (void * )&event, 0);
   if (ret != pdPASS)
-    {
-    message->release();
-    ++m_lost;
-    }
+    m_logreader.m_pending = false;
   }
 
 void OvmsConsole::Service()
@@ -173,6 +173,18 @@ void OvmsConsole::Poll(portTickType ticks, QueueHandle_t queue)
         HandleDeviceEvent(&event);
         continue;
         }
+      // Log ring records are read by our own cursor.  While a command that
+      // takes input is executing, they are left in the ring until finalise().
+      if (event.type == ALERT_RING)
+        {
+        m_logreader.m_pending = false;
+        if (!m_insert)
+          {
+          PollLog();
+          ticks = 200 / portTICK_PERIOD_MS;
+          }
+        continue;
+        }
       // While a command that takes input is executing, put alert events into a
       // separate "deferred" queue.  If that queue fills, keep only the last N
       // events and count those discarded.
@@ -185,66 +197,14 @@ void OvmsConsole::Poll(portTickType ticks, QueueHandle_t queue)
           Event discard;
           xQueueReceive(m_deferred, (void*)&discard, 0);
           xQueueSendToBack(m_deferred, (void *)&event, 0);
-          if (discard.type == ALERT_MULTI)
-            discard.multi->release();
-          else
-            free(discard.buffer);
+          free(discard.buffer);
           ++m_discarded;
           }
         continue;
         }
-      // We remove the newline from the end of a log message so that we can later
-      // output a newline as part of restoring the command prompt and its line
-      // without leaving a blank line above it.  So before we display a new log
-      // message we need to output a newline if the last action was displaying a
-      // log message, or output a carriage return to back over the prompt.
-      if (m_monitoring &&
-        (event.type != ALERT_MULTI || event.multi->begin() != event.multi->end()))
-        {
-        if (m_state == AWAITING_NL)
-          write(NLbuf, 2);
-        else if (m_state == AT_PROMPT)
-          write(CRbuf, 4);
-        char* buffer;
-        size_t len;
-        if (event.type == ALERT_MULTI)
-          {
-          LogBuffers::iterator before = event.multi->begin(), after;
-          while (true)
-            {
-            buffer = *before;
-            len = strlen(buffer);
-            after = before;
-            ++after;
-            if (after == event.multi->end())
-              break;
-            write(buffer, len);
-            before = after;
-            }
-          }
-        else
-          {
-          buffer = event.buffer;
-          len = strlen(buffer);
-          }
-        if (buffer[len-1] == '\n')
-          {
-          --len;
-          if (buffer[len-1] == '\r')  // Omit CR, too, in case of \r\n
-            --len;
-          m_state = AWAITING_NL;
-          write(buffer, len);
-          }
-        else
-          {
-          m_state = NO_NL;
-          write(buffer, len);
-          }
-        }
-      if (event.type == ALERT_MULTI)
-        event.multi->release();
-      else
-        free(event.buffer);
+      if (m_monitoring)
+        DisplayLog(event.buffer, strlen(event.buffer));
+      free(event.buffer);
       ticks = 200 / portTICK_PERIOD_MS;
       }
     else
@@ -270,6 +230,51 @@ void OvmsConsole::Poll(portTickType ticks, QueueHandle_t queue)
     }
   }
 
+void OvmsConsole::PollLog()
+  {
+  OvmsLogRing* ring = MyCommandApp.GetLogRing();
+  int len;
+  while ((len = ring->Read(&m_logreader, m_logline, LOGRING_MAX_LINE)) > 0)
+    {
+    if (m_monitoring)
+      DisplayLog(m_logline, len);
+    }
+  if (m_logreader.m_dropped)
+    {
+    if (m_monitoring)
+      m_lost += m_logreader.m_dropped;
+    m_logreader.m_dropped = 0;
+    }
+  }
+
+void OvmsConsole::DisplayLog(char* buffer, size_t len)
+  {
+  // We remove the newline from the end of a log message so that we can later
+  // output a newline as part of restoring the command prompt and its line
+  // without leaving a blank line above it.  So before we display a new log
+  // message we need to output a newline if the last action was displaying a
+  // log message, or output a carriage return to back over the prompt.
+  if (len == 0)
+    return;
+  if (m_state == AWAITING_NL)
+    write(NLbuf, 2);
+  else if (m_state == AT_PROMPT)
+    write(CRbuf, 4);
+  if (buffer[len-1] == '\n')
+    {
+    --len;
+    if (len && buffer[len-1] == '\r')  // Omit CR, too, in case of \r\n
+      --len;
+    m_state = AWAITING_NL;
+    write(buffer, len);
+    }
+  else
+    {
+    m_state = NO_NL;
+    write(buffer, len);
+    }
+  }
+
 void OvmsConsole::finalise()
   {
   if (m_deferred)
@@ -284,4 +289,10 @@ void OvmsConsole::finalise()
     vQueueDelete(m_deferred);
     m_deferred = NULL;
     }
+  // Signal log ring records left while the command was running:
+  if (m_logline && MyCommandApp.GetLogRing()->Available(&m_logreader))
+    {
+    m_logreader.m_pending = false;
+    LogNotify();
+    }
   }
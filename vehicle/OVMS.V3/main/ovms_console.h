@@ -33,13 +33,13 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "ovms_shell.h"
+#include "log_ring.h"
 
 #define TOKEN_MAX_LENGTH 32
 #define COMPLETION_MAX_TOKENS 20
 
 class OvmsCommandMap;
 class Parent;
-class LogBuffers;
 struct mbuf;
 
 class OvmsConsole : public OvmsShell
@@ -57,7 +57,7 @@ class OvmsConsole : public OvmsShell
       {
       RECV = 0x10000,
       ALERT,
-      ALERT_MULTI
+      ALERT_RING
       } event_type_t;
 
     typedef struct
@@ -66,7 +66,6 @@ class OvmsConsole : public OvmsShell
       union
         {
         char* buffer;       // Pointer to ALERT buffer
-        LogBuffers* multi;  // Pointer to ALERT_MULTI message
         ssize_t size;       // Buffer size for RECV
         struct mbuf* mbuf;  // Buffer pointer for RECV with Mongoose
         };
@@ -83,12 +82,14 @@ class OvmsConsole : public OvmsShell
     void Initialize(const char* console);
     char** SetCompletion(int index, const char* token, bool isfinal) override;
     char** GetCompletions(int &common_len, bool &finished ) override;
-    void Log(LogBuffers* message);
+    void LogNotify();
     void Poll(portTickType ticks, QueueHandle_t queue = NULL);
 
   protected:
     void Service();
     void finalise();
+    void PollLog();
+    void DisplayLog(char* buffer, size_t len);
 
   protected:
     virtual void HandleDeviceEvent(void* event) = 0;
@@ -103,8 +104,10 @@ class OvmsConsole : public OvmsShell
     QueueHandle_t m_deferred;
     int m_discarded;
     DisplayState m_state;
-    unsigned int m_lost;        // Log messages lost due to full queue
+    unsigned int m_lost;        // Log messages lost due to log ring overruns
     unsigned int m_acked;       // Log messages acknowledged as lost
+    OvmsLogReader m_logreader;  // Our log ring cursor
+    char* m_logline;            // Log ring record buffer
   };
 
 #endif //#ifndef __CONSOLE_H__
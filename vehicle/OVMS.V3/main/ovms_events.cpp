@@ -34,11 +34,15 @@ static const char *TAG = "events";
 #include <string.h>
 #include <stdio.h>
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
 #include "ovms_module.h"
 #include "ovms_events.h"
 #include "ovms_command.h"
 #include "ovms_script.h"
 #include "ovms_boot.h"
+#include "metrics_standard.h"
+#include <algorithm>
+#include <vector>
 #if ESP_IDF_VERSION_MAJOR >= 4
 #include <esp_netif_types.h>
 #include <esp_eth_com.h>
@@ -58,7 +62,7 @@ static const char *TAG = "events";
 OvmsEvents MyEvents __attribute__ ((init_priority (1200)));
 
 typedef void (*event_signal_done_fn)(const char* event, void* data);
-static void CheckQueueOverflow(const char* from, char* event);
+static void CheckQueueOverflow(const char* from, const char* event);
 
 bool EventMap::GetCompletion(OvmsWriter* writer, const char* token) const
   {
@@ -70,7 +74,7 @@ bool EventMap::GetCompletion(OvmsWriter* writer, const char* token) const
     size_t len = strlen(token);
     for (const_iterator it = begin(); it != end(); ++it)
       {
-      if (it->first.compare("*") == 0)
+      if (it->first.compare("*") == 0 || it->second->m_callbacks.empty())
         continue;
       if (it->first.compare(0, len, token) == 0)
         {
@@ -106,19 +110,44 @@ void event_trace(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
 
 void event_status(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
-  writer->printf("Event map has %d listeners, and queue has %d/%d entries\n",
-    MyEvents.Map().size(),
+  int listened = 0;
+  for (auto it : MyEvents.Map())
+    {
+    if (!it.second->m_callbacks.empty())
+      listened++;
+    }
+  writer->printf("Event map has %d listeners (%d interned events), and queue has %d/%d entries\n",
+    listened,
+    MyEvents.GetInternedCount(),
     uxQueueMessagesWaiting(MyEvents.m_taskqueue),
     CONFIG_OVMS_HW_EVENT_QUEUE_SIZE);
 
   EventCallbackEntry* cbe = MyEvents.m_current_callback;
-  if (cbe != NULL)
+  const char* event = MyEvents.m_current_event;
+  if (cbe != NULL && event != NULL)
     {
     writer->printf("Currently dispatching:\n");
-    writer->printf("  Event: %s\n",MyEvents.m_current_event.c_str());
+    writer->printf("  Event: %s\n",event);
     writer->printf("  To:    %s\n",cbe->m_caller.c_str());
     writer->printf("  For:   %" PRIu32 " second(s)\n",monotonictime-MyEvents.m_current_started);
     }
+
+  MyEvents.OutputLatency(writer);
+  if (strcmp(cmd->GetName(), "reset") == 0)
+    {
+    MyEvents.ResetLatency();
+    writer->puts("Latency statistics reset");
+    }
+  }
+
+void event_profile(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  MyEvents.OutputProfile(writer);
+  if (strcmp(cmd->GetName(), "reset") == 0)
+    {
+    MyEvents.ResetProfile();
+    writer->puts("Profile reset");
+    }
   }
 
 void event_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
@@ -128,9 +157,11 @@ void event_list(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, c
     {
     if (argc > 0 && itm->first.find(argv[0]) == std::string::npos)
       continue;
+    EventCallbackList* el = &itm->second->m_callbacks;
+    if (el->empty())
+      continue;
     event.append(itm->first);
     event.append(":  ");
-    EventCallbackList* el = itm->second;
     for (EventCallbackList::iterator itc=el->begin(); itc!=el->end(); )
       {
       EventCallbackEntry* ec = *itc;
@@ -206,6 +237,20 @@ OvmsEvents::OvmsEvents()
   ESP_LOGI(TAG, "Initialising EVENTS (1200)");
 
   m_current_callback = NULL;
+  m_current_event = NULL;
+  m_current_started = 0;
+  m_queue_max = 0;
+  m_queue_drops = 0;
+  ResetLatency();
+
+  // Pre-intern the well known events, IDs need to match the EVENT_ID_* defines:
+  Intern("*");
+  Intern("ticker.1");
+  Intern("ticker.10");
+  Intern("ticker.60");
+  Intern("ticker.300");
+  Intern("ticker.600");
+  Intern("ticker.3600");
 
 #ifdef CONFIG_OVMS_DEV_DEBUGEVENTS
   m_trace = true;
@@ -222,7 +267,10 @@ OvmsEvents::OvmsEvents()
 
   // Register our commands
   OvmsCommand* cmd_event = MyCommandApp.RegisterCommand("event","EVENT framework", event_status, "", 0, 0, false);
-  cmd_event->RegisterCommand("status","Show status of event system",event_status);
+  OvmsCommand* cmd_eventstatus = cmd_event->RegisterCommand("status","Show status of event system",event_status);
+  cmd_eventstatus->RegisterCommand("reset","Show status and reset latency statistics",event_status);
+  OvmsCommand* cmd_eventprofile = cmd_event->RegisterCommand("profile","Show event handler runtime profile",event_profile);
+  cmd_eventprofile->RegisterCommand("reset","Show profile and reset",event_profile);
   cmd_event->RegisterCommand("list","List registered events",event_list,"[<key>]", 0, 1);
   cmd_event->RegisterCommand("raise","Raise a textual event",event_raise,"[-d<delay_ms>] <event>", 1, 2, true, event_validate);
   OvmsCommand* cmd_eventtrace = cmd_event->RegisterCommand("trace","EVENT trace framework");
@@ -269,11 +317,26 @@ void OvmsEvents::EventTask()
           HandleQueueRemoveHandlers(&msg);
           break;
         case EVENT_signal:
+          {
+          uint32_t depth = uxQueueMessagesWaiting(m_taskqueue) + 1;
+          if (depth > m_queue_max) m_queue_max = depth;
+          uint32_t latency = esp_timer_get_time() - msg.body.signal.queued;
+          static const uint32_t limits[EVENT_LATENCY_BUCKETS] = EVENT_LATENCY_LIMITS;
+          int bucket = 0;
+          while (bucket < EVENT_LATENCY_BUCKETS && latency >= limits[bucket]*1000)
+            bucket++;
+          m_latency_hist[bucket]++;
+          if (latency > m_latency_max) m_latency_max = latency;
+          m_latency_sum += latency;
+          m_latency_cnt++;
+
           m_current_event = msg.body.signal.event;
           HandleQueueSignalEvent(&msg);
           esp_task_wdt_reset(); // Reset WATCHDOG timer for this task
-          m_current_event.clear();
+          m_current_event = NULL;
+          FreeQueueSignalEvent(&msg);
           break;
+          }
         default:
           break;
         }
@@ -299,63 +362,60 @@ void OvmsEvents::EventTask()
 
 void OvmsEvents::HandleQueueSignalEvent(event_queue_t* msg)
   {
+  const char* event = msg->body.signal.event;
+  OvmsEventId id = msg->body.signal.id;
+
   // Log everything but the ticker & clock signals
-  if (!startsWith(m_current_event, "ticker.") && !startsWith(m_current_event, "clock."))
+  if (strncmp(event, "ticker.", 7) != 0 && strncmp(event, "clock.", 6) != 0)
     {
     if (m_trace)
-      ESP_LOGI(TAG, "Signal(%s)",m_current_event.c_str());
+      ESP_LOGI(TAG, "Signal(%s)",event);
     else
-      ESP_LOGD(TAG, "Signal(%s)",m_current_event.c_str());
+      ESP_LOGD(TAG, "Signal(%s)",event);
     }
 
   // Run callbacks:
     {
     OvmsRecMutexLock lock(&m_map_mutex);
 
-    auto k = m_map.find(m_current_event);
-    if (k != m_map.end())
+    EventEntry* entries[2] = { NULL, NULL };
       {
-      EventCallbackList* el = k->second;
-      if (el)
-        {
-        for (EventCallbackList::iterator itc=el->begin(); itc!=el->end(); ++itc)
-          {
-          m_current_started = monotonictime;
-          m_current_callback = *itc;
-          if (m_current_callback->m_callback)
-            {
-            m_current_callback->m_callback(m_current_event, msg->body.signal.data);
-            }
-          m_current_callback = NULL;
-          }
-        }
+      OvmsMutexLock idlock(&m_ids_mutex);
+      if (id != EVENT_ID_NONE && id != EVENT_ID_ANY)
+        entries[0] = m_events[id];
+      entries[1] = m_events[EVENT_ID_ANY];
       }
 
-    k = m_map.find("*");
-    if (k != m_map.end())
+    for (EventEntry* entry : entries)
       {
-      EventCallbackList* el = k->second;
-      if (el)
+      if (!entry) continue;
+      EventCallbackList* el = &entry->m_callbacks;
+      for (EventCallbackList::iterator itc=el->begin(); itc!=el->end(); ++itc)
         {
-        for (EventCallbackList::iterator itc=el->begin(); itc!=el->end(); ++itc)
+        m_current_started = monotonictime;
+        m_current_callback = *itc;
+        if (m_current_callback->m_callback)
           {
-          m_current_started = monotonictime;
-          m_current_callback = *itc;
-          if (m_current_callback->m_callback)
-            {
-            m_current_callback->m_callback(m_current_event, msg->body.signal.data);
-            }
-          m_current_callback = NULL;
+          int64_t started = esp_timer_get_time();
+          m_current_callback->m_callback(event, msg->body.signal.data);
+          m_current_callback->m_profile.Add(esp_timer_get_time() - started);
           }
+        m_current_callback = NULL;
         }
       }
     }
 
   // Run scripts:
   m_current_started = monotonictime;
-  MyScripts.EventScript(m_current_event, msg->body.signal.data);
-
-  FreeQueueSignalEvent(msg);
+  int64_t started = esp_timer_get_time();
+  MyScripts.EventScript(event, msg->body.signal.data);
+  EventProfile* profile = &m_script_profile;
+  if (id != EVENT_ID_NONE)
+    {
+    OvmsMutexLock idlock(&m_ids_mutex);
+    profile = &m_events[id]->m_script_profile;
+    }
+  profile->Add(esp_timer_get_time() - started);
   }
 
 void OvmsEvents::FreeQueueSignalEvent(event_queue_t* msg)
@@ -364,7 +424,193 @@ void OvmsEvents::FreeQueueSignalEvent(event_queue_t* msg)
     {
     msg->body.signal.donefn(msg->body.signal.event, msg->body.signal.data);
     }
-  free(msg->body.signal.event);
+  if (msg->body.signal.id == EVENT_ID_NONE)
+    free(msg->body.signal.event);
+  }
+
+/**
+ * Intern: get the ID of an event, add it to the event table if necessary
+ *  Interned events are never removed, so their IDs & names stay valid.
+ */
+OvmsEventId OvmsEvents::Intern(const char* event)
+  {
+  OvmsMutexLock lock(&m_ids_mutex);
+  auto it = m_map.find(event);
+  if (it != m_map.end())
+    return it->second->m_id;
+  if (m_events.size() >= EVENT_ID_NONE)
+    {
+    ESP_LOGE(TAG, "Intern: event table full, cannot add '%s'", event);
+    return EVENT_ID_NONE;
+    }
+  char* name = (char*)ExternalRamMalloc(strlen(event)+1);
+  strcpy(name, event);
+  EventEntry* entry = new EventEntry(m_events.size(), name);
+  m_events.push_back(entry);
+  m_map[event] = entry;
+  return entry->m_id;
+  }
+
+/**
+ * FindId: get the ID of an event, EVENT_ID_NONE if not interned
+ */
+OvmsEventId OvmsEvents::FindId(const char* event)
+  {
+  OvmsMutexLock lock(&m_ids_mutex);
+  auto it = m_map.find(event);
+  return (it != m_map.end()) ? it->second->m_id : EVENT_ID_NONE;
+  }
+
+size_t OvmsEvents::GetInternedCount()
+  {
+  OvmsMutexLock lock(&m_ids_mutex);
+  return m_events.size();
+  }
+
+void OvmsEvents::OutputLatency(OvmsWriter* writer)
+  {
+  static const uint32_t limits[EVENT_LATENCY_BUCKETS] = EVENT_LATENCY_LIMITS;
+  uint32_t cnt = m_latency_cnt;
+  writer->printf("Event loop latency: %" PRIu32 " events, avg %.1f ms, max %.1f ms\n",
+    cnt, cnt ? (double)m_latency_sum / cnt / 1000 : 0.0, (double)m_latency_max / 1000);
+  if (cnt == 0)
+    return;
+  for (int i = 0; i <= EVENT_LATENCY_BUCKETS; i++)
+    {
+    if (i < EVENT_LATENCY_BUCKETS)
+      writer->printf("  <%5" PRIu32 " ms: ", limits[i]);
+    else
+      writer->printf("  >=%4" PRIu32 " ms: ", limits[i-1]);
+    writer->printf("%10" PRIu32 " %5.1f%%\n", m_latency_hist[i], (double)m_latency_hist[i] * 100 / cnt);
+    }
+  }
+
+typedef struct
+  {
+  const char* event;
+  const char* caller;
+  EventProfile profile;
+  } event_profile_entry_t;
+
+void OvmsEvents::OutputProfile(OvmsWriter* writer)
+  {
+  // Note: don't wait for a hanging handler, this is meant to find it
+  OvmsRecMutexLock lock(&m_map_mutex, pdMS_TO_TICKS(1000));
+  if (!lock.IsLocked())
+    {
+    writer->puts("Error: event task busy, try again");
+    return;
+    }
+
+  writer->printf("Queue: max %" PRIu32 "/%d entries, %" PRIu32 " dropped\n",
+    m_queue_max, CONFIG_OVMS_HW_EVENT_QUEUE_SIZE, m_queue_drops);
+
+  // Collect & sort by total runtime:
+  std::vector<event_profile_entry_t> list;
+    {
+    OvmsMutexLock idlock(&m_ids_mutex);
+    for (EventEntry* entry : m_events)
+      {
+      for (EventCallbackEntry* ec : entry->m_callbacks)
+        {
+        EventProfile profile = ec->m_profile.Snapshot();
+        if (profile.m_count)
+          list.push_back({ entry->m_name, ec->m_caller.c_str(), profile });
+        }
+      EventProfile profile = entry->m_script_profile.Snapshot();
+      if (profile.m_count)
+        list.push_back({ entry->m_name, "EventScript", profile });
+      }
+    }
+  EventProfile profile = m_script_profile.Snapshot();
+  if (profile.m_count)
+    list.push_back({ "(other)", "EventScript", profile });
+  std::sort(list.begin(), list.end(),
+    [](const event_profile_entry_t& a, const event_profile_entry_t& b)
+      { return a.profile.m_total > b.profile.m_total; });
+
+  writer->printf("%-28s %-16s %8s %10s %8s %8s %8s\n",
+    "Event", "Handler", "Calls", "Total[ms]", "Avg[ms]", "Max[ms]", "P99[ms]");
+  for (const event_profile_entry_t& e : list)
+    {
+    const EventProfile* p = &e.profile;
+    writer->printf("%-28.28s %-16.16s %8" PRIu32 " %10.1f %8.2f %8.1f %8.1f\n",
+      e.event, e.caller, p->m_count,
+      (double)p->m_total / 1000,
+      (double)p->m_total / p->m_count / 1000,
+      (double)p->m_max / 1000,
+      (double)p->GetPercentile(99) / 1000);
+    }
+  }
+
+void OvmsEvents::ResetProfile()
+  {
+  OvmsRecMutexLock lock(&m_map_mutex);
+  OvmsMutexLock idlock(&m_ids_mutex);
+  for (EventEntry* entry : m_events)
+    {
+    for (EventCallbackEntry* ec : entry->m_callbacks)
+      ec->m_profile.Reset();
+    entry->m_script_profile.Reset();
+    }
+  m_script_profile.Reset();
+  m_queue_max = 0;
+  m_queue_drops = 0;
+  }
+
+/**
+ * UpdateMetrics: publish the event system health as metrics
+ *  (called by the housekeeping ticker)
+ */
+void OvmsEvents::UpdateMetrics()
+  {
+  if (StandardMetrics.ms_m_event_queue_max == NULL)
+    return;
+
+  StandardMetrics.ms_m_event_queue_max->SetValue((int)m_queue_max);
+  StandardMetrics.ms_m_event_queue_drops->SetValue((int)m_queue_drops);
+  StandardMetrics.ms_m_event_latency_max->SetValue((float)m_latency_max / 1000000);
+
+  // Find slowest handler by P99 runtime
+  // Note: don't stall housekeeping on a hanging handler, retry next time
+  OvmsRecMutexLock lock(&m_map_mutex, pdMS_TO_TICKS(1000));
+  if (!lock.IsLocked())
+    return;
+  OvmsMutexLock idlock(&m_ids_mutex, pdMS_TO_TICKS(1000));
+  if (!idlock.IsLocked())
+    return;
+  const char* event = NULL;
+  const char* caller = NULL;
+  uint32_t p99max = 0;
+  for (EventEntry* entry : m_events)
+    {
+    for (EventCallbackEntry* ec : entry->m_callbacks)
+      {
+      uint32_t p99 = ec->m_profile.Snapshot().GetPercentile(99);
+      if (p99 > p99max)
+        {
+        p99max = p99;
+        event = entry->m_name;
+        caller = ec->m_caller.c_str();
+        }
+      }
+    }
+  if (event)
+    {
+    std::string slowest = event;
+    slowest.append("/");
+    slowest.append(caller);
+    StandardMetrics.ms_m_event_slowest->SetValue(slowest);
+    StandardMetrics.ms_m_event_slowest_time->SetValue((float)p99max / 1000000);
+    }
+  }
+
+void OvmsEvents::ResetLatency()
+  {
+  memset(m_latency_hist, 0, sizeof(m_latency_hist));
+  m_latency_max = 0;
+  m_latency_sum = 0;
+  m_latency_cnt = 0;
   }
 
 
@@ -376,13 +622,14 @@ void OvmsEvents::RegisterEvent(std::string caller, std::string event, EventCallb
 
   event_queue_t msg = {};
   msg.type = EVENT_addhandler;
-  msg.body.addhandler.event = strdup(event.c_str());
+  msg.body.addhandler.id = Intern(event.c_str());
+  if (msg.body.addhandler.id == EVENT_ID_NONE)
+    return;
   msg.body.addhandler.handler = new EventCallbackEntry(caller, callback);
 
   if (xQueueSend(m_taskqueue, &msg, 0) != pdTRUE)
     {
-    CheckQueueOverflow("RegisterEvent", msg.body.addhandler.event);
-    free(msg.body.addhandler.event);
+    CheckQueueOverflow("RegisterEvent", event.c_str());
     delete msg.body.addhandler.handler;
     }
   }
@@ -390,29 +637,14 @@ void OvmsEvents::RegisterEvent(std::string caller, std::string event, EventCallb
 void OvmsEvents::HandleQueueAddHandler(event_queue_t* msg)
   {
   // EventTask command EVENT_addhandler
-  std::string event = msg->body.addhandler.event;
-
-  OvmsRecMutexLock lock(&m_map_mutex);
-
-  auto k = m_map.find(event);
-  if (k == m_map.end())
-    {
-    m_map[event] = new EventCallbackList();
-    k = m_map.find(event);
-    }
-  if (k == m_map.end())
+  EventEntry* entry;
     {
-    ESP_LOGE(TAG, "Problem registering event %s for caller %s", event.c_str(),
-      msg->body.addhandler.handler->m_caller.c_str());
-    free(msg->body.addhandler.event);
-    delete msg->body.addhandler.handler;
-    }
-  else
-    {
-    EventCallbackList *el = k->second;
-    el->push_back(msg->body.addhandler.handler);
-    free(msg->body.addhandler.event);
+    OvmsMutexLock idlock(&m_ids_mutex);
+    entry = m_events[msg->body.addhandler.id];
     }
+
+  OvmsRecMutexLock lock(&m_map_mutex);
+  entry->m_callbacks.push_back(msg->body.addhandler.handler);
   }
 
 
@@ -425,21 +657,16 @@ void OvmsEvents::DeregisterEvent(std::string caller)
   // Invalidate callbacks:
     {
     OvmsRecMutexLock lock(&m_map_mutex);
-    EventMap::iterator itm=m_map.begin();
-    while (itm!=m_map.end())
+    OvmsMutexLock idlock(&m_ids_mutex);
+    for (EventEntry* entry : m_events)
       {
-      EventCallbackList* el = itm->second;
-      EventCallbackList::iterator itc=el->begin();
-      while (itc!=el->end())
+      for (EventCallbackEntry* ec : entry->m_callbacks)
         {
-        EventCallbackEntry* ec = *itc;
         if (ec->m_caller == caller)
           {
           ec->m_callback = nullptr;
           }
-        ++itc;
         }
-      ++itm;
       }
     }
 
@@ -461,11 +688,11 @@ void OvmsEvents::HandleQueueRemoveHandlers(event_queue_t* msg)
   std::string caller = msg->body.removehandlers.caller;
 
   OvmsRecMutexLock lock(&m_map_mutex);
+  OvmsMutexLock idlock(&m_ids_mutex);
 
-  EventMap::iterator itm=m_map.begin();
-  while (itm!=m_map.end())
+  for (EventEntry* entry : m_events)
     {
-    EventCallbackList* el = itm->second;
+    EventCallbackList* el = &entry->m_callbacks;
     EventCallbackList::iterator itc=el->begin();
     while (itc!=el->end())
       {
@@ -480,28 +707,20 @@ void OvmsEvents::HandleQueueRemoveHandlers(event_queue_t* msg)
         ++itc;
         }
       }
-    if (el->empty())
-      {
-      itm = m_map.erase(itm);
-      delete el;
-      }
-    else
-      {
-      ++itm;
-      }
     }
   
   free(msg->body.removehandlers.caller);
   }
 
-static void CheckQueueOverflow(const char* from, char* event)
+static void CheckQueueOverflow(const char* from, const char* event)
   {
+  MyEvents.m_queue_drops++;
   EventCallbackEntry* cbe = MyEvents.m_current_callback;
-  if (cbe != NULL)
+  if (cbe != NULL && MyEvents.m_current_event != NULL)
     {
     ESP_LOGE(TAG, "%s: queue overflow (running %s->%s for %" PRIu32 " sec), event '%s' dropped",
       from,
-      MyEvents.m_current_event.c_str(),
+      MyEvents.m_current_event,
       cbe->m_caller.c_str(),
       monotonictime-MyEvents.m_current_started,
       event);
@@ -542,6 +761,7 @@ void OvmsEvents::SignalScheduledEvent(TimerHandle_t timer)
     }
 
   // … and pass on to event task:
+  msg->body.signal.queued = esp_timer_get_time();
   if (xQueueSend(MyEvents.m_taskqueue, msg, 0) != pdTRUE)
     {
     CheckQueueOverflow("SignalScheduledEvent", msg->body.signal.event);
@@ -608,73 +828,89 @@ bool OvmsEvents::ScheduleEvent(event_queue_t* msg, uint32_t delay_ms)
   return true;
   }
 
-void OvmsEvents::SignalEvent(std::string event, void* data, event_signal_done_fn callback /*=NULL*/,
-                             uint32_t delay_ms /*=0*/)
+void OvmsEvents::SignalEventMsg(event_queue_t* msg, uint32_t delay_ms)
   {
-  event_queue_t msg;
-  memset(&msg, 0, sizeof(msg));
-
-  msg.type = EVENT_signal;
-  msg.body.signal.event = (char*)ExternalRamMalloc(event.size()+1);
-  strcpy(msg.body.signal.event, event.c_str());
-  msg.body.signal.data = data;
-  msg.body.signal.donefn = callback;
-
   if (delay_ms == 0)
     {
-    if (xQueueSend(m_taskqueue, &msg, 0) != pdTRUE)
+    msg->body.signal.queued = esp_timer_get_time();
+    if (xQueueSend(m_taskqueue, msg, 0) != pdTRUE)
       {
-      CheckQueueOverflow("SignalEvent", msg.body.signal.event);
-      FreeQueueSignalEvent(&msg);
+      CheckQueueOverflow("SignalEvent", msg->body.signal.event);
+      FreeQueueSignalEvent(msg);
       }
     }
   else
     {
-    if (ScheduleEvent(&msg, delay_ms) != true)
+    if (ScheduleEvent(msg, delay_ms) != true)
       {
-      ESP_LOGE(TAG, "SignalEvent: no timer available, event '%s' dropped", msg.body.signal.event);
-      FreeQueueSignalEvent(&msg);
+      ESP_LOGE(TAG, "SignalEvent: no timer available, event '%s' dropped", msg->body.signal.event);
+      FreeQueueSignalEvent(msg);
       }
     }
   }
 
-void OvmsEvents::SignalEvent(std::string event, void* data, size_t length,
+void OvmsEvents::SignalEvent(std::string event, void* data, event_signal_done_fn callback /*=NULL*/,
                              uint32_t delay_ms /*=0*/)
   {
   event_queue_t msg;
   memset(&msg, 0, sizeof(msg));
 
   msg.type = EVENT_signal;
+  msg.body.signal.id = FindId(event.c_str());
+  if (msg.body.signal.id != EVENT_ID_NONE)
+    {
+    SignalEvent(msg.body.signal.id, data, callback, delay_ms);
+    return;
+    }
   msg.body.signal.event = (char*)ExternalRamMalloc(event.size()+1);
   strcpy(msg.body.signal.event, event.c_str());
+  msg.body.signal.data = data;
+  msg.body.signal.donefn = callback;
+
+  SignalEventMsg(&msg, delay_ms);
+  }
+
+void OvmsEvents::SignalEvent(std::string event, void* data, size_t length,
+                             uint32_t delay_ms /*=0*/)
+  {
   if (data != NULL)
     {
-    msg.body.signal.data = ExternalRamMalloc(length);
-    memcpy(msg.body.signal.data, data, length);
-    msg.body.signal.donefn = EventStdFree;
+    void* copy = ExternalRamMalloc(length);
+    memcpy(copy, data, length);
+    SignalEvent(event, copy, EventStdFree, delay_ms);
     }
   else
     {
-    msg.body.signal.data = NULL;
-    msg.body.signal.donefn = NULL;
+    SignalEvent(event, NULL, (event_signal_done_fn)NULL, delay_ms);
     }
+  }
 
-  if (delay_ms == 0)
-    {
-    if (xQueueSend(m_taskqueue, &msg, 0) != pdTRUE)
-      {
-      CheckQueueOverflow("SignalEvent", msg.body.signal.event);
-      FreeQueueSignalEvent(&msg);
-      }
-    }
-  else
+/**
+ * SignalEvent: signal an interned event (see Intern())
+ *  This avoids the name lookup & copy, use this for frequent events.
+ */
+void OvmsEvents::SignalEvent(OvmsEventId id, void* data, event_signal_done_fn callback /*=NULL*/,
+                             uint32_t delay_ms /*=0*/)
+  {
+  event_queue_t msg;
+  memset(&msg, 0, sizeof(msg));
+
+  msg.type = EVENT_signal;
     {
-    if (ScheduleEvent(&msg, delay_ms) != true)
+    OvmsMutexLock lock(&m_ids_mutex);
+    if (id >= m_events.size())
       {
-      ESP_LOGE(TAG, "SignalEvent: no timer available, event '%s' dropped", msg.body.signal.event);
-      FreeQueueSignalEvent(&msg);
+      ESP_LOGE(TAG, "SignalEvent: invalid event ID %u", id);
+      if (callback) callback("", data);
+      return;
       }
+    msg.body.signal.id = id;
+    msg.body.signal.event = (char*)m_events[id]->m_name;
     }
+  msg.body.signal.data = data;
+  msg.body.signal.donefn = callback;
+
+  SignalEventMsg(&msg, delay_ms);
   }
 
 #if ESP_IDF_VERSION_MAJOR >= 4
@@ -883,6 +1119,63 @@ void OvmsEvents::SignalSystemEvent(system_event_t *event)
 
 #endif
 
+static portMUX_TYPE event_profile_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+void EventProfile::Reset()
+  {
+  portENTER_CRITICAL(&event_profile_spinlock);
+  m_count = 0;
+  m_max = 0;
+  m_total = 0;
+  memset(m_hist, 0, sizeof(m_hist));
+  portEXIT_CRITICAL(&event_profile_spinlock);
+  }
+
+void EventProfile::Add(uint32_t us)
+  {
+  int bucket = (us < 128) ? 0 : (31 - __builtin_clz(us)) - 6;
+  if (bucket >= EVENT_PROFILE_BUCKETS) bucket = EVENT_PROFILE_BUCKETS-1;
+  portENTER_CRITICAL(&event_profile_spinlock);
+  m_count++;
+  m_total += us;
+  if (us > m_max) m_max = us;
+  m_hist[bucket]++;
+  portEXIT_CRITICAL(&event_profile_spinlock);
+  }
+
+/**
+ * Snapshot: get a consistent copy of the counters
+ */
+EventProfile EventProfile::Snapshot() const
+  {
+  EventProfile copy;
+  portENTER_CRITICAL(&event_profile_spinlock);
+  copy.m_count = m_count;
+  copy.m_max = m_max;
+  copy.m_total = m_total;
+  memcpy(copy.m_hist, m_hist, sizeof(m_hist));
+  portEXIT_CRITICAL(&event_profile_spinlock);
+  return copy;
+  }
+
+/**
+ * GetPercentile: get the upper bound of the runtime bucket containing the percentile [us]
+ */
+uint32_t EventProfile::GetPercentile(int percent) const
+  {
+  if (m_count == 0)
+    return 0;
+  uint64_t limit = ((uint64_t)m_count * percent + 99) / 100;
+  uint64_t cnt = 0;
+  for (int i = 0; i < EVENT_PROFILE_BUCKETS-1; i++)
+    {
+    cnt += m_hist[i];
+    if (cnt >= limit)
+      return std::min((uint32_t)128 << i, m_max);
+    }
+  return m_max;
+  }
+
 EventCallbackEntry::EventCallbackEntry(std::string caller, EventCallback callback)
   {
   m_caller = caller;
@@ -35,6 +35,7 @@
 #include <functional>
 #include <map>
 #include <list>
+#include <vector>
 #include "esp_idf_version.h"
 #if ESP_IDF_VERSION_MAJOR >= 4
 #include <esp_event.h>
@@ -48,7 +49,43 @@
 #include "ovms_command.h"
 #include "ovms_mutex.h"
 
-typedef std::function<void(std::string,void*)> EventCallback;
+// Event callbacks get the event name as a C string, handlers taking a
+// std::string are still supported by implicit conversion:
+typedef std::function<void(const char*,void*)> EventCallback;
+
+// Interned event IDs (see OvmsEvents::Intern()):
+typedef uint16_t OvmsEventId;
+#define EVENT_ID_NONE           0xFFFF    // name not interned (no handlers)
+#define EVENT_ID_ANY            0         // "*"
+#define EVENT_ID_TICKER_1       1
+#define EVENT_ID_TICKER_10      2
+#define EVENT_ID_TICKER_60      3
+#define EVENT_ID_TICKER_300     4
+#define EVENT_ID_TICKER_600     5
+#define EVENT_ID_TICKER_3600    6
+
+// Event handler runtime profile:
+//  updated by the event task, read & reset by others. Add(), Reset() and
+//  Snapshot() are atomic, read the counters from a Snapshot().
+#define EVENT_PROFILE_BUCKETS   14        // log2 buckets: [0] < 128 us … [13] >= 512 ms
+
+class EventProfile
+  {
+  public:
+    EventProfile() { Reset(); }
+
+  public:
+    void Reset();
+    void Add(uint32_t us);
+    EventProfile Snapshot() const;
+    uint32_t GetPercentile(int percent) const;
+
+  public:
+    uint32_t m_count;
+    uint32_t m_max;                       // [us]
+    uint64_t m_total;                     // [us]
+    uint32_t m_hist[EVENT_PROFILE_BUCKETS];
+  };
 
 class EventCallbackEntry
   {
@@ -59,16 +96,37 @@ class EventCallbackEntry
   public:
     std::string m_caller;
     EventCallback m_callback;
+    EventProfile m_profile;
   };
 
 typedef std::list<EventCallbackEntry*> EventCallbackList;
 
-class EventMap : public  std::map<std::string, EventCallbackList*>
+class EventEntry
+  {
+  public:
+    EventEntry(OvmsEventId id, const char* name)
+      {
+      m_id = id;
+      m_name = name;
+      }
+
+  public:
+    OvmsEventId m_id;
+    const char* m_name;                   // Interned name, never freed
+    EventCallbackList m_callbacks;
+    EventProfile m_script_profile;        // Event script runtime
+  };
+
+class EventMap : public  std::map<std::string, EventEntry*>
   {
   public:
     bool GetCompletion(OvmsWriter* writer, const char* token) const;
   };
 
+// Event loop latency histogram (signal → dispatch) bucket limits [ms]:
+#define EVENT_LATENCY_BUCKETS   10
+#define EVENT_LATENCY_LIMITS    { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 }
+
 typedef void (*event_signal_done_fn)(const char* event, void* data);
 
 extern void EventStdFree(const char* event, void* data);
@@ -87,7 +145,7 @@ typedef struct
     {
     struct
       {
-      char* event;
+      OvmsEventId id;
       EventCallbackEntry* handler;
       } addhandler;
     struct
@@ -96,9 +154,11 @@ typedef struct
       } removehandlers;
     struct
       {
+      OvmsEventId id;                     // EVENT_ID_NONE = event is a heap copy
       char* event;
       void* data;
       event_signal_done_fn donefn;
+      int64_t queued;                     // esp_timer time of queueing
       } signal;
     } body;
   event_msg_t type;
@@ -118,6 +178,12 @@ class OvmsEvents
     void DeregisterEvent(std::string caller);
     void SignalEvent(std::string event, void* data, event_signal_done_fn callback = NULL, uint32_t delay_ms = 0);
     void SignalEvent(std::string event, void* data, size_t length, uint32_t delay_ms = 0);
+    void SignalEvent(OvmsEventId id, void* data, event_signal_done_fn callback = NULL, uint32_t delay_ms = 0);
+
+  public:
+    OvmsEventId Intern(const char* event);
+    OvmsEventId FindId(const char* event);
+    size_t GetInternedCount();
 
   public:
     void EventTask();
@@ -129,8 +195,14 @@ class OvmsEvents
     void SignalSystemEvent(system_event_t *event);
 #endif
     const EventMap& Map() { return m_map; }
+    void OutputLatency(OvmsWriter* writer);
+    void ResetLatency();
+    void OutputProfile(OvmsWriter* writer);
+    void ResetProfile();
+    void UpdateMetrics();
 
   protected:
+    void SignalEventMsg(event_queue_t* msg, uint32_t delay_ms);
     void HandleQueueSignalEvent(event_queue_t* msg);
     void HandleQueueAddHandler(event_queue_t* msg);
     void HandleQueueRemoveHandlers(event_queue_t* msg);
@@ -140,8 +212,10 @@ class OvmsEvents
     static void SignalScheduledEvent(TimerHandle_t timer);
 
   protected:
-    EventMap m_map;
-    OvmsRecMutex m_map_mutex;
+    EventMap m_map;                       // name → interned event
+    std::vector<EventEntry*> m_events;    // ID → interned event
+    OvmsMutex m_ids_mutex;                // Protects m_map & m_events structure
+    OvmsRecMutex m_map_mutex;             // Protects callback lists
     TimerList m_timers;
     TimerStatusMap m_timer_active;
     OvmsMutex m_timers_mutex;
@@ -156,8 +230,19 @@ class OvmsEvents
 
   public:
     EventCallbackEntry* m_current_callback;
-    std::string m_current_event;
+    const char* m_current_event;          // NULL = idle
     uint32_t m_current_started;
+
+  protected:
+    uint32_t m_latency_hist[EVENT_LATENCY_BUCKETS+1];
+    uint32_t m_latency_max;               // [us]
+    uint64_t m_latency_sum;               // [us]
+    uint32_t m_latency_cnt;
+
+  public:
+    EventProfile m_script_profile;        // Event script runtime for non-interned events
+    uint32_t m_queue_max;                 // Queue depth high water mark
+    uint32_t m_queue_drops;               // Events/commands dropped due to queue full
   };
 
 extern OvmsEvents MyEvents;
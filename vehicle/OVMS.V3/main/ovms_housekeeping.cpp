@@ -111,25 +111,25 @@ void HousekeepingTicker1( TimerHandle_t timer )
   StandardMetrics.ms_m_timeutc->SetValue(time(NULL));
 
   HousekeepingUpdate12V();
-  MyEvents.SignalEvent("ticker.1", NULL);
+  MyEvents.SignalEvent(EVENT_ID_TICKER_1, NULL);
 
   tick++;
   if ((tick % 10)==0)
     {
-    MyEvents.SignalEvent("ticker.10", NULL);
+    MyEvents.SignalEvent(EVENT_ID_TICKER_10, NULL);
     if ((tick % 60)==0)
       {
-      MyEvents.SignalEvent("ticker.60", NULL);
+      MyEvents.SignalEvent(EVENT_ID_TICKER_60, NULL);
       if ((tick % 300)==0)
         {
-        MyEvents.SignalEvent("ticker.300", NULL);
+        MyEvents.SignalEvent(EVENT_ID_TICKER_300, NULL);
         if ((tick % 600)==0)
           {
-          MyEvents.SignalEvent("ticker.600", NULL);
+          MyEvents.SignalEvent(EVENT_ID_TICKER_600, NULL);
           if ((tick % 3600)==0)
             {
             tick = 0;
-            MyEvents.SignalEvent("ticker.3600", NULL);
+            MyEvents.SignalEvent(EVENT_ID_TICKER_3600, NULL);
             }
           }
         }
@@ -307,6 +307,8 @@ void Housekeeping::Metrics(std::string event, void* data)
   size_t free = heap_caps_get_free_size(caps);
   m3->SetValue(free);
 
+  MyEvents.UpdateMetrics();
+
   // set boot stable flag after some seconds uptime:
   if (!MyBoot.GetStable() && monotonictime >= AUTO_INIT_STABLE_TIME)
     {
@@ -35,6 +35,7 @@ static const char *TAG = "metrics";
 #include <stdio.h>
 #include <sstream>
 #include <functional>
+#include <algorithm>
 #include <map>
 #include "ovms.h"
 #include "ovms_metrics.h"
@@ -1083,6 +1084,23 @@ OvmsMetrics::OvmsMetrics()
   m_nextmodifier = 1;
   m_first = NULL;
   m_trace = false;
+  m_index = NULL;
+  m_index_readers = 0;
+  m_indexused = 0;
+  m_indexremoved = 0;
+  m_index_failed = false;
+  memset(m_registry, 0, sizeof(m_registry));
+  m_registry_used = 0;
+  m_registry_gen = 0;
+  m_modifiermask = 0;
+  m_changelog_head = 0;
+  m_changelog = new metric_change_t[METRICS_CHANGELOG_SIZE];
+  for (uint32_t i = 0; i < METRICS_CHANGELOG_SIZE; i++)
+    {
+    // mark entries as not yet written for the first round:
+    m_changelog[i].seq = i - METRICS_CHANGELOG_SIZE;
+    m_changelog[i].slot = METRICS_NO_SLOT;
+    }
 
   // Register our commands
   OvmsCommand* cmd_metric = MyCommandApp.RegisterCommand("metrics","METRICS framework");
@@ -1146,62 +1164,345 @@ OvmsMetrics::~OvmsMetrics()
     m = m->m_next;
     delete c;
     }
+  free(m_index.load());
+  for (auto index : m_index_retired)
+    free(index);
+  for (int i = 0; i < METRICS_REGISTRY_BLOCKS; i++)
+    free(m_registry[i]);
+  delete [] m_changelog;
   }
 
-void OvmsMetrics::RegisterMetric(OvmsMetric* metric)
+/**
+ * metric_namehash: FNV-1a hash of a metric name, used for the lookup index
+ */
+static inline uint32_t metric_namehash(const char* name)
   {
-  // Quick simple check for if we are the first metric.
-  if (m_first == NULL)
+  uint32_t hash = 2166136261u;
+  while (*name)
     {
-    m_first = metric;
-    return;
+    hash ^= (uint8_t) *name++;
+    hash *= 16777619u;
+    }
+  return hash;
+  }
+
+// Index slot of a removed metric, keeps the probe chain intact:
+#define METRIC_INDEX_REMOVED ((OvmsMetric*)1)
+
+static bool metric_nameless(const OvmsMetric* a, const char* name)
+  {
+  return strcmp(a->m_name, name) < 0;
+  }
+
+bool OvmsMetrics::IndexResize(size_t capacity)
+  {
+  metric_index_t* cur = m_index.load();
+  metric_index_t* index = (metric_index_t*) ExternalRamCalloc(1,
+    sizeof(metric_index_t) + capacity * sizeof(metric_slot_t));
+  if (!index)
+    {
+    // Stay in linear mode from now on: a later smaller allocation succeeding
+    //  must not build an index lacking the metrics registered up to here
+    ESP_LOGE(TAG, "IndexResize: failed to allocate %u slots, falling back to linear lookup", capacity);
+    m_index_failed = true;
+    m_index = NULL;
+    m_indexused = 0;
+    m_indexremoved = 0;
+    IndexRetire(cur);
+    return false;
     }
 
-  // Now, check if we are before the first
-  if (strcmp(m_first->m_name,metric->m_name)>=0)
+  index->size = capacity;
+  size_t mask = capacity - 1;
+  if (cur)
     {
-    metric->m_next = m_first;
-    m_first = metric;
+    for (size_t k = 0; k < cur->size; k++)
+      {
+      if (!cur->slot[k].metric || cur->slot[k].metric == METRIC_INDEX_REMOVED)
+        continue;
+      size_t i = cur->slot[k].hash & mask;
+      while (index->slot[i].metric)
+        i = (i + 1) & mask;
+      index->slot[i] = cur->slot[k];
+      }
+    }
+
+  m_index = index;
+  m_indexremoved = 0;
+  IndexRetire(cur);
+  return true;
+  }
+
+/**
+ * IndexRetire: queue a replaced index table for release, free all queued tables
+ *  if no Find() is probing. A Find() entering after the new table has been
+ *  published cannot see the retired ones, so a zero reader count is a safe
+ *  grace period.
+ */
+void OvmsMetrics::IndexRetire(metric_index_t* index)
+  {
+  if (index)
+    m_index_retired.push_back(index);
+  if (!m_index_retired.empty() && m_index_readers == 0)
+    {
+    for (auto retired : m_index_retired)
+      free(retired);
+    m_index_retired.clear();
+    }
+  }
+
+void OvmsMetrics::IndexInsert(OvmsMetric* metric, uint32_t hash)
+  {
+  if (m_index_failed)
     return;
+  IndexRetire(NULL);
+
+  // Keep the load factor (including tombstones) below 50% for short probe
+  //  sequences; if mostly tombstones, rebuild at the same size:
+  metric_index_t* index = m_index;
+  if (!index || (m_indexused + m_indexremoved + 1) * 2 > index->size)
+    {
+    size_t capacity = 512;
+    if (index)
+      capacity = ((m_indexused + 1) * 4 > index->size) ? index->size * 2 : index->size;
+    if (!IndexResize(capacity))
+      return;
+    index = m_index;
     }
 
-  // Search for the correct place to insert
-  for (OvmsMetric*m = m_first; m!=NULL; m=m->m_next)
+  size_t mask = index->size - 1;
+  size_t i = hash & mask;
+  OvmsMetric* m;
+  while ((m = index->slot[i].metric) != NULL)
     {
-    if (m->m_next == NULL)
+    if (m != METRIC_INDEX_REMOVED && index->slot[i].hash == hash && strcmp(m->m_name, metric->m_name) == 0)
       {
-      m->m_next = metric;
+      // Duplicate name: the newest registration shadows the older one,
+      //  same as in the sorted list
+      index->slot[i].metric = metric;
       return;
       }
-    if (strcmp(m->m_next->m_name,metric->m_name)>=0)
+    i = (i + 1) & mask;
+    }
+  // Publish the hash before the metric, so Find() never matches a stale hash:
+  index->slot[i].hash = hash;
+  std::atomic_thread_fence(std::memory_order_release);
+  index->slot[i].metric = metric;
+  m_indexused++;
+  }
+
+/**
+ * IndexRemove: remove a metric from the index
+ *  The slot is replaced by the uncovered (older, same name) metric if given,
+ *  else by a tombstone. Slots are not moved, so a concurrent Find() always
+ *  sees a complete probe chain.
+ */
+bool OvmsMetrics::IndexRemove(OvmsMetric* metric, uint32_t hash, OvmsMetric* uncover /*=NULL*/)
+  {
+  metric_index_t* index = m_index;
+  if (!index)
+    return false;
+
+  size_t mask = index->size - 1;
+  size_t i = hash & mask;
+  while (index->slot[i].metric && index->slot[i].metric != metric)
+    i = (i + 1) & mask;
+  if (!index->slot[i].metric)
+    return false;
+
+  if (uncover)
+    {
+    index->slot[i].metric = uncover;
+    }
+  else
+    {
+    index->slot[i].metric = METRIC_INDEX_REMOVED;
+    m_indexused--;
+    m_indexremoved++;
+    }
+  return true;
+  }
+
+void OvmsMetrics::RegisterMetric(OvmsMetric* metric)
+  {
+  // Find insert position in the sorted index (before the first metric with
+  //  an equal or greater name), then link into the list behind its predecessor:
+  auto pos = std::lower_bound(m_sorted.begin(), m_sorted.end(), metric->m_name, metric_nameless);
+  if (pos == m_sorted.begin())
+    {
+    metric->m_next = m_first;
+    m_first = metric;
+    }
+  else
+    {
+    OvmsMetric* prev = *(pos - 1);
+    metric->m_next = prev->m_next;
+    prev->m_next = metric;
+    }
+  m_sorted.insert(pos, metric);
+
+  IndexInsert(metric, metric_namehash(metric->m_name));
+
+  // Assign registry slot:
+  size_t slot;
+  if (!m_registry_free.empty())
+    {
+    slot = m_registry_free.back();
+    m_registry_free.pop_back();
+    m_registry_gen++;
+    }
+  else if (m_registry_used < METRICS_REGISTRY_BLOCK * METRICS_REGISTRY_BLOCKS)
+    {
+    slot = m_registry_used;
+    OvmsMetric**& block = m_registry[slot / METRICS_REGISTRY_BLOCK];
+    if (!block)
+      block = (OvmsMetric**) ExternalRamCalloc(METRICS_REGISTRY_BLOCK, sizeof(OvmsMetric*));
+    if (!block)
       {
-      metric->m_next = m->m_next;
-      m->m_next = metric;
+      ESP_LOGE(TAG, "RegisterMetric: registry block allocation failed for '%s'", metric->m_name);
       return;
       }
     }
+  else
+    {
+    ESP_LOGE(TAG, "RegisterMetric: registry full, no slot for '%s'", metric->m_name);
+    return;
+    }
+  m_registry[slot / METRICS_REGISTRY_BLOCK][slot % METRICS_REGISTRY_BLOCK] = metric;
+  metric->m_slot = slot;
+  if (slot == m_registry_used)
+    m_registry_used++;
   }
 
 void OvmsMetrics::DeregisterMetric(OvmsMetric* metric)
   {
-  if (m_first == metric)
-    {
+  auto pos = std::lower_bound(m_sorted.begin(), m_sorted.end(), metric->m_name, metric_nameless);
+  while (pos != m_sorted.end() && *pos != metric && strcmp((*pos)->m_name, metric->m_name) == 0)
+    ++pos;
+  if (pos == m_sorted.end() || *pos != metric)
+    return;
+
+  if (pos == m_sorted.begin())
     m_first = metric->m_next;
-    delete metric;
+  else
+    (*(pos - 1))->m_next = metric->m_next;
+  pos = m_sorted.erase(pos);
+
+  // Uncover an older metric of the same name, if any:
+  OvmsMetric* uncover = NULL;
+  if (pos != m_sorted.end() && strcmp((*pos)->m_name, metric->m_name) == 0)
+    uncover = *pos;
+  IndexRemove(metric, metric_namehash(metric->m_name), uncover);
+
+  if (metric->m_slot != METRICS_NO_SLOT)
+    {
+    m_registry[metric->m_slot / METRICS_REGISTRY_BLOCK][metric->m_slot % METRICS_REGISTRY_BLOCK] = NULL;
+    m_registry_free.push_back(metric->m_slot);
+    metric->m_slot = METRICS_NO_SLOT;
+    }
+
+  delete metric;
+  }
+
+/**
+ * ChangeLogAdd: log a metric change for the change readers
+ *  pending: the modifier flags set before the change; if all registered
+ *  modifiers still had the change pending, it's already in the log.
+ */
+void OvmsMetrics::ChangeLogAdd(OvmsMetric* metric, unsigned long pending)
+  {
+  unsigned long mask = m_modifiermask;
+  if (mask == 0 || (pending & mask) == mask || !m_changelog)
+    return;
+  if (metric->m_slot == METRICS_NO_SLOT)
+    {
+    ChangeLogOverflow();
     return;
     }
+  uint32_t seq = m_changelog_head.fetch_add(1);
+  metric_change_t& entry = m_changelog[seq & (METRICS_CHANGELOG_SIZE-1)];
+  entry.slot.store(metric->m_slot, std::memory_order_relaxed);
+  entry.seq.store(seq, std::memory_order_release);
+  }
+
+/**
+ * ChangeLogOverflow: force all change readers to do a full registry scan
+ */
+void OvmsMetrics::ChangeLogOverflow()
+  {
+  m_changelog_head.fetch_add(METRICS_CHANGELOG_SIZE + 1);
+  }
+
+OvmsMetricChanges::OvmsMetricChanges()
+  {
+  m_modifier = 0;
+  m_seq = 0;
+  m_scan = -1;
+  }
+
+void OvmsMetricChanges::Init(size_t modifier)
+  {
+  m_modifier = modifier;
+  m_seq = MyMetrics.m_changelog_head;
+  m_scan = 0;
+  }
+
+void OvmsMetricChanges::Sync()
+  {
+  m_seq = MyMetrics.m_changelog_head;
+  m_scan = -1;
+  }
 
-  for (OvmsMetric* m=m_first;m!=NULL;m=m->m_next)
+OvmsMetric* OvmsMetricChanges::Next()
+  {
+  OvmsMetric* m;
+  for (;;)
     {
-    if (m->m_next == metric)
+    if (m_scan >= 0)
       {
-      m->m_next = metric->m_next;
-      delete metric;
-      return;
+      // Full registry scan:
+      while (m_scan < (int)MyMetrics.GetSlotCount())
+        {
+        m = MyMetrics.GetSlot(m_scan++);
+        if (m && m->IsModifiedAndClear(m_modifier))
+          return m;
+        }
+      m_scan = -1;
       }
+
+    uint32_t head = MyMetrics.m_changelog_head.load(std::memory_order_acquire);
+    if (m_seq == head)
+      return NULL;
+    if (head - m_seq > METRICS_CHANGELOG_SIZE)
+      {
+      // Overflow, entries lost:
+      m_seq = head;
+      m_scan = 0;
+      continue;
+      }
+
+    OvmsMetrics::metric_change_t& entry = MyMetrics.m_changelog[m_seq & (METRICS_CHANGELOG_SIZE-1)];
+    int32_t age = entry.seq.load(std::memory_order_acquire) - m_seq;
+    if (age < 0)
+      return NULL; // producer has not yet written this entry
+    uint16_t slot = entry.slot.load(std::memory_order_relaxed);
+    head = MyMetrics.m_changelog_head.load(std::memory_order_acquire);
+    if (age > 0 || head - m_seq > METRICS_CHANGELOG_SIZE)
+      {
+      // Entry has been / may have been overwritten:
+      m_seq = head;
+      m_scan = 0;
+      continue;
+      }
+    m_seq++;
+
+    m = MyMetrics.GetSlot(slot);
+    if (m && m->IsModifiedAndClear(m_modifier))
+      return m;
     }
   }
 
+
 std::string OvmsMetrics::GetUnitStr(const char* metric, const char *unit)
   {
   OvmsMetric* m = Find(metric);
@@ -1262,6 +1563,40 @@ bool OvmsMetrics::SetFloat(const char* metric, float value)
   }
 
 OvmsMetric* OvmsMetrics::Find(const char* metric)
+  {
+  // Announce the probe before loading the table pointer, so IndexRetire()
+  //  will not free the table while we use it:
+  m_index_readers++;
+  metric_index_t* index = m_index;
+  OvmsMetric* found = NULL;
+  if (!index)
+    {
+    found = FindLinear(metric);
+    }
+  else
+    {
+    uint32_t hash = metric_namehash(metric);
+    size_t mask = index->size - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask)
+      {
+      OvmsMetric* m = index->slot[i].metric;
+      if (!m)
+        break;
+      if (m == METRIC_INDEX_REMOVED)
+        continue;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (index->slot[i].hash == hash && strcmp(m->m_name, metric) == 0)
+        {
+        found = m;
+        break;
+        }
+      }
+    }
+  m_index_readers--;
+  return found;
+  }
+
+OvmsMetric* OvmsMetrics::FindLinear(const char* metric) const
   {
   for (OvmsMetric* m=m_first; m != NULL; m=m->m_next)
     {
@@ -1462,6 +1797,7 @@ void OvmsMetrics::NotifyModified(OvmsMetric* metric)
 
 size_t OvmsMetrics::RegisterModifier()
   {
+  m_modifiermask |= 1ul << m_nextmodifier;
   return m_nextmodifier++;
   }
 
@@ -1475,6 +1811,8 @@ void OvmsMetrics::InitialiseSlot(size_t modifier)
      if (m->IsDefined())
        m->m_modified |= bit;
     }
+  // The flags have been set without logging, let change readers rescan:
+  ChangeLogOverflow();
   }
 
 void OvmsMetrics::SetAllUnitSend(size_t modifier)
@@ -1508,6 +1846,7 @@ OvmsMetric::OvmsMetric(const char* name, uint16_t autostale, metric_unit_t units
   m_units = units;
   m_next = NULL;
   m_persist = false;          // only set by metrics supporting persistence
+  m_slot = METRICS_NO_SLOT;
   MyMetrics.RegisterMetric(this);
   }
 
@@ -1590,7 +1929,8 @@ void OvmsMetric::SetModified(bool changed)
   m_lastmodified = monotonictime;
   if (changed)
     {
-    m_modified = ULONG_MAX;
+    unsigned long pending = m_modified.exchange(ULONG_MAX);
+    MyMetrics.ChangeLogAdd(this, pending);
     MyMetrics.NotifyModified(this);
     }
   }
@@ -41,6 +41,7 @@
 #include <set>
 #include <vector>
 #include <atomic>
+#include "ovms.h"
 #include "ovms_mutex.h"
 #include "dbc_number.h"
 #ifdef CONFIG_OVMS_SC_JAVASCRIPT_DUKTAPE
@@ -54,6 +55,11 @@
 
 #define METRICS_MAX_MODIFIERS 32
 
+#define METRICS_REGISTRY_BLOCK      64      // Metric slots per registry block
+#define METRICS_REGISTRY_BLOCKS     64      // Max registry blocks (64*64 = 4096 metrics)
+#define METRICS_NO_SLOT             0xffff
+#define METRICS_CHANGELOG_SIZE      256     // Change log entries (power of 2)
+
 using namespace std;
 
 typedef enum : uint8_t
@@ -282,6 +288,7 @@ class OvmsMetric
     metric_defined_t m_defined;
     bool m_stale;
     bool m_persist;
+    uint16_t m_slot;            // registry slot (stable while registered)
   };
 
 class OvmsMetricBool : public OvmsMetric
@@ -1166,6 +1173,30 @@ class UnitConfigMap
 typedef std::list<MetricCallbackEntry*> MetricCallbackList;
 typedef std::map<std::string, MetricCallbackList*> MetricCallbackMap;
 
+/**
+ * OvmsMetricChanges: change log reader for a metrics modifier
+ *
+ * Next() returns the next metric modified since the last call (clearing the
+ * modifier flag), or NULL if no more changes are pending. Readers only visit
+ * the metrics logged as changed. If the reader falls behind by more than
+ * METRICS_CHANGELOG_SIZE changes, it falls back to a full registry scan.
+ */
+class OvmsMetricChanges
+  {
+  public:
+    OvmsMetricChanges();
+
+  public:
+    void Init(size_t modifier);     // attach & check all metrics on first Next()
+    void Sync();                    // skip pending log entries (caller clears flags)
+    OvmsMetric* Next();
+
+  protected:
+    size_t m_modifier;
+    uint32_t m_seq;                 // change log read position
+    int m_scan;                     // registry scan position, -1 = no scan
+  };
+
 class OvmsMetrics
   {
   public:
@@ -1243,6 +1274,78 @@ class OvmsMetrics
   protected:
     size_t m_nextmodifier;
 
+  protected:
+    // Name lookup index: open addressing hash table (linear probing,
+    //  power of 2 capacity) plus a name sorted vector for O(log n) insertion
+    //  into the m_first list.
+    // Find() probes the table without a lock. Slots are never moved in a
+    //  published table: removals leave a tombstone (so probe chains stay
+    //  intact), tombstones are dropped by rebuilding the table. The table is
+    //  published by a single pointer, replaced tables are retired and only
+    //  freed once no Find() is in progress (m_index_readers).
+    typedef struct
+      {
+      uint32_t hash;
+      OvmsMetric* metric;
+      } metric_slot_t;
+    typedef struct
+      {
+      size_t size;
+      metric_slot_t slot[];
+      } metric_index_t;
+    typedef std::vector<OvmsMetric*, ExtRamAllocator<OvmsMetric*>> metric_vector_t;
+    void IndexInsert(OvmsMetric* metric, uint32_t hash);
+    bool IndexRemove(OvmsMetric* metric, uint32_t hash, OvmsMetric* uncover=NULL);
+    bool IndexResize(size_t capacity);
+    void IndexRetire(metric_index_t* index);
+    std::atomic<metric_index_t*> m_index;
+    std::atomic_int m_index_readers;
+    std::vector<metric_index_t*> m_index_retired;
+    size_t m_indexused;
+    size_t m_indexremoved;            // tombstones in the current table
+    bool m_index_failed;              // allocation failed: linear lookup only
+    metric_vector_t m_sorted;
+
+  public:
+    size_t Count() const { return m_sorted.size(); }
+    OvmsMetric* FindLinear(const char* metric) const;
+
+  protected:
+    // Registry: stable slot numbers for metrics, allocated in blocks
+    //  so readers never see a reallocation.
+    OvmsMetric** m_registry[METRICS_REGISTRY_BLOCKS];
+    size_t m_registry_used;
+    std::vector<uint16_t> m_registry_free;
+    std::atomic_uint32_t m_registry_gen;  // incremented on reuse of a freed slot
+
+  public:
+    OvmsMetric* GetSlot(size_t slot) const
+      {
+      if (slot >= m_registry_used) return NULL;
+      return m_registry[slot / METRICS_REGISTRY_BLOCK][slot % METRICS_REGISTRY_BLOCK];
+      }
+    size_t GetSlotCount() const { return m_registry_used; }
+    // Slot cursors (i.e. for chunked transfers) need to restart if the
+    //  generation changes, as a new metric may have been placed before them:
+    uint32_t GetSlotGeneration() const { return m_registry_gen; }
+
+  protected:
+    // Change log: multi producer ring of modified metric slots, read by
+    //  OvmsMetricChanges. Entries are valid if seq matches their position.
+    struct metric_change_t : public ExternalRamAllocated
+      {
+      std::atomic_uint32_t seq;
+      std::atomic_uint16_t slot;
+      };
+    metric_change_t* m_changelog;
+    std::atomic_uint32_t m_changelog_head;
+    std::atomic_ulong m_modifiermask;
+    friend class OvmsMetricChanges;
+
+  public:
+    void ChangeLogAdd(OvmsMetric* metric, unsigned long pending);
+    void ChangeLogOverflow();
+
   public:
     OvmsMetric* m_first;
     bool m_trace;
@@ -715,7 +715,16 @@ class ovms_callback_register_t
       {
       Register(nametag, nullptr);
       }
-    typedef std::function<void (const std::string &nametag, FN callback)> visit_fn_t;
+    bool HasCallbacks() const
+      {
+      for (auto it = m_list.begin(); it != m_list.end(); ++it)
+        {
+        if ((*it).m_callback)
+          return true;
+        }
+      return false;
+      }
+    typedef std::function<void (const std::string &nametag, const FN &callback)> visit_fn_t;
     void Call(visit_fn_t visit)
       {
       for (auto it = m_list.begin(); it != m_list.end(); ++it)
@@ -380,6 +380,69 @@ void test_string(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc,
     (int)((esp_timer_get_time() - time_start_us) / 1000));
   }
 
+void test_metrics(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
+  {
+  int loopcnt = (argc > 0) ? atoi(argv[0]) : 100;
+  int regcnt = (argc > 1) ? atoi(argv[1]) : 500;
+  int64_t started;
+  int found;
+
+  std::vector<const char*> names;
+  names.reserve(MyMetrics.Count());
+  for (OvmsMetric* m = MyMetrics.m_first; m; m = m->m_next)
+    names.push_back(m->m_name);
+  if (names.empty() || loopcnt <= 0)
+    {
+    writer->puts("Error: no metrics / invalid loop count");
+    return;
+    }
+  int lookups = loopcnt * names.size();
+  writer->printf("Looking up %d metrics %d times...\n", (int)names.size(), loopcnt);
+
+  found = 0;
+  started = esp_timer_get_time();
+  for (int j = 0; j < loopcnt; j++)
+    for (const char* name : names)
+      found += (MyMetrics.Find(name) != NULL);
+  int64_t hashed = esp_timer_get_time() - started;
+  writer->printf("  Find (hash index): %d found in %lld us = %.3f us/lookup\n",
+    found, hashed, (double)hashed / lookups);
+
+  found = 0;
+  started = esp_timer_get_time();
+  for (int j = 0; j < loopcnt; j++)
+    for (const char* name : names)
+      found += (MyMetrics.FindLinear(name) != NULL);
+  int64_t linear = esp_timer_get_time() - started;
+  writer->printf("  FindLinear (list): %d found in %lld us = %.3f us/lookup\n",
+    found, linear, (double)linear / lookups);
+
+  if (regcnt <= 0)
+    return;
+  writer->printf("Registering %d temporary metrics...\n", regcnt);
+  std::vector<OvmsMetricInt*> temps;
+  std::vector<std::string> tempnames(regcnt);
+  temps.reserve(regcnt);
+  for (int k = 0; k < regcnt; k++)
+    {
+    // spread names over the sorted list:
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%c.test.%d", 'a' + (k % 26), k);
+    tempnames[k] = buf;
+    }
+  started = esp_timer_get_time();
+  for (int k = 0; k < regcnt; k++)
+    temps.push_back(new OvmsMetricInt(tempnames[k].c_str()));
+  int64_t regtime = esp_timer_get_time() - started;
+  started = esp_timer_get_time();
+  for (OvmsMetricInt* m : temps)
+    MyMetrics.DeregisterMetric(m);
+  int64_t deregtime = esp_timer_get_time() - started;
+  writer->printf("  Register: %lld us = %.3f us/metric\n"
+                 "  Deregister: %lld us = %.3f us/metric\n",
+    regtime, (double)regtime / regcnt, deregtime, (double)deregtime / regcnt);
+  }
+
 void test_command(int verbosity, OvmsWriter* writer, OvmsCommand* cmd, int argc, const char* const* argv)
   {
   MyCommandApp.Display(writer);
@@ -412,5 +475,8 @@ TestFrameworkInit::TestFrameworkInit()
   cmd_test->RegisterCommand("mkstemp", "Test mkstemp function", test_mkstemp, "<file>", 1, 1);
   cmd_test->RegisterCommand("string", "Test std::string memory corruption", test_string, "<loopcnt> <mode>\n"
     "mode: 1=m.AsJSON, 2=m.AsString, 3=m.name, 4=const cfg string, 5=const local cstr, 6=const local string", 2, 2);
+  cmd_test->RegisterCommand("metrics", "Test metrics registry performance", test_metrics, "[<loopcnt>] [<regcnt>]\n"
+    "Times Find() via hash index vs. linear list scan for all metrics,\n"
+    "then registration and deregistration of <regcnt> temporary metrics (default 500)", 0, 2);
   cmd_test->RegisterCommand("commands", "List command tree", test_command);
   }